@@ -0,0 +1,103 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Loopback plumbing shared by the benchmark executables: listeners on
+// ephemeral ports, client connects, header reads and peak-RSS sampling.
+
+#include "../include/Common.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+static inline void benchSocketsInit() {
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+}
+
+// Sends the proxy's per-request console log to /dev/null and returns a stream
+// on the original stdout for the benchmark's own report.
+static inline FILE* benchQuietStdout() {
+#ifdef _WIN32
+    return stdout;
+#else
+    std::fflush(stdout);
+    FILE* report = fdopen(dup(1), "w");
+    FILE* sink = std::fopen("/dev/null", "w");
+    if (!report || !sink) return stdout;
+    dup2(fileno(sink), 1);
+    std::fclose(sink);
+    return report;
+#endif
+}
+
+static inline long peakRssKb() {
+#ifdef _WIN32
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::atol(line.c_str() + 6);
+    }
+    return 0;
+#endif
+}
+
+static inline SOCKET listenLoopback(int& port) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    bind(s, (sockaddr*)&addr, sizeof(addr));
+    listen(s, SOMAXCONN);
+    socklen_t len = sizeof(addr);
+    getsockname(s, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    return s;
+}
+
+static inline SOCKET connectLoopback(int port) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+// Byte-at-a-time so nothing past the blank line is consumed.
+static inline bool readHeaders(SOCKET s, std::string& out) {
+    char c;
+    while (out.size() < 4 || out.compare(out.size() - 4, 4, "\r\n\r\n") != 0) {
+        if (recv(s, &c, 1, 0) <= 0) return false;
+        out += c;
+    }
+    return true;
+}
+
+static inline std::string readAll(SOCKET s) {
+    std::string out;
+    char buf[16384];
+    int n;
+    while ((n = recv(s, buf, sizeof(buf), 0)) > 0) out.append(buf, n);
+    return out;
+}
+
+static inline void acceptLoop(SOCKET listener, void (*handler)(SOCKET)) {
+    while (true) {
+        SOCKET c = accept(listener, NULL, NULL);
+        if (c == INVALID_SOCKET) return;
+        std::thread(handler, c).detach();
+    }
+}
+
+#endif
\ No newline at end of file
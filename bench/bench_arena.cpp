@@ -0,0 +1,215 @@
+/**
+ * @file bench_arena.cpp
+ * @brief Heap allocations per request with the request arena against the
+ *        plain heap, through the same steps handleClient() takes.
+ *
+ * Usage: bench_arena [requests per case, default 20000]
+ * Each request is written into a loopback connection and taken through
+ * recvHeaders(), parseHttpRequest(), the connection's host copy, isBlocked(),
+ * buildRequestSlices(), modifyRequestLine() and logProxy(), with every
+ * request-scoped string on a fresh RequestArena or on new/delete. Global
+ * operator new, plain and aligned, is replaced to count allocations. After a
+ * warm-up, a typical GET must make none; exits non-zero otherwise or if a
+ * check of the parser or the blocklist fails.
+ */
+
+#include "../include/Arena.h"
+#include "../include/BufferPool.h"
+#include "../include/Config.h"
+#include "../include/Filter.h"
+#include "../include/Logger.h"
+#include "../include/Parser.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::atomic<size_t> g_allocs{0};
+
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// std::pmr::new_delete_resource() allocates through the aligned forms.
+void* operator new(size_t n, std::align_val_t al) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    size_t a = (size_t)al;
+#ifdef _WIN32
+    if (void* p = _aligned_malloc(n, a)) return p;
+#else
+    if (void* p = std::aligned_alloc(a, (n + a - 1) / a * a)) return p;
+#endif
+    throw std::bad_alloc();
+}
+#ifdef _WIN32
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+struct Case {
+    const char* name;
+    std::string raw;
+    bool typical; // held to zero allocations
+};
+
+static std::vector<Case> corpus() {
+    std::vector<Case> cases;
+    cases.push_back({ "browser GET",
+        "GET http://www.example.com/articles/2024/10/proxy-internals.html?ref=home HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/129.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Cookie: session=4f2a9c1e7b; theme=dark; _ga=GA1.2.1234567890.1700000000\r\n"
+        "Proxy-Connection: keep-alive\r\n"
+        "Connection: keep-alive\r\n\r\n", true });
+    cases.push_back({ "curl GET",
+        "GET http://api.example-services.net:8080/v1/status HTTP/1.1\r\n"
+        "Host: api.example-services.net:8080\r\n"
+        "User-Agent: curl/8.5.0\r\n"
+        "Accept: */*\r\n"
+        "Proxy-Connection: Keep-Alive\r\n\r\n", true });
+    cases.push_back({ "form POST",
+        "POST http://forms.example.org/submit HTTP/1.1\r\n"
+        "Host: forms.example.org\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length: 27\r\n"
+        "Connection: keep-alive\r\n\r\n"
+        "name=proxy&email=a%40b.test", false });
+    std::string cookie = "GET http://shop.example.com/cart HTTP/1.1\r\n"
+                         "Host: shop.example.com\r\n"
+                         "Cookie: ";
+    for (int i = 0; i < 64; i++) cookie += "tracker" + std::to_string(i) + "=" + std::string(48, 'a' + i % 26) + "; ";
+    cookie += "end=1\r\nConnection: keep-alive\r\n\r\n";
+    cases.push_back({ "4KB cookie GET", cookie, false });
+    return cases;
+}
+
+// One request as handleClient() sees it, short of the upstream.
+static size_t serveOne(SOCKET client, SOCKET server, const std::string& raw, std::pmr::memory_resource* mr) {
+    send(client, raw.data(), (int)raw.size(), 0);
+    std::pmr::string head(mr);
+    if (recvHeaders(server, head) <= 0) return 0;
+    HttpRequest req = parseHttpRequest(std::move(head));
+    std::pmr::string host(req.host, mr); // ActiveConnection's copy for the close probe
+    bool blocked = isBlocked(req.host);
+    RequestSlices slices = buildRequestSlices(req);
+    std::pmr::string flat = modifyRequestLine(req, mr);
+    logProxy("127.0.0.1", req.host, req.port, req.method, req.path, blocked ? "BLOCKED" : "ALLOWED",
+             (long long)slices.totalLen, 200, 0);
+    return flat.size() + host.size();
+}
+
+struct Result {
+    double allocsPerRequest;
+    double nsPerRequest;
+};
+
+static Result run(SOCKET client, SOCKET server, const std::string& raw, bool arena, int requests) {
+    size_t sink = 0;
+    auto once = [&] {
+        if (arena) {
+            RequestArena a;
+            sink += serveOne(client, server, raw, &a);
+        } else {
+            sink += serveOne(client, server, raw, std::pmr::new_delete_resource());
+        }
+    };
+    for (int i = 0; i < 200; i++) once(); // metric slots, the log path, time zone data
+    size_t a0 = g_allocs.load();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; i++) once();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    if (sink == 42) std::fputc(' ', out);
+    return { (double)(g_allocs.load() - a0) / requests, ns / requests };
+}
+
+int main(int argc, char** argv) {
+    int requests = argc > 1 ? std::atoi(argv[1]) : 20000;
+    if (requests < 1) requests = 1;
+    benchSocketsInit();
+    out = benchQuietStdout();
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / ("proxy-arena-" + std::to_string(std::random_device{}()));
+    std::filesystem::create_directories(dir);
+    {
+        std::ofstream cfg(dir / "bench.cfg");
+        cfg << "LOG_PATH=" << (dir / "proxy.log").string() << "\n";
+        std::ofstream list(dir / "blocked.txt");
+        list << "ads.example.com\n  Tracker.Example.NET \r\n";
+        for (int i = 0; i < 1000; i++) list << "blocked" << i << ".example\n";
+    }
+    Config::load((dir / "bench.cfg").string());
+    loadFilters((dir / "blocked.txt").string());
+
+    int port = 0;
+    SOCKET listener = listenLoopback(port);
+    SOCKET client = connectLoopback(port);
+    SOCKET server = accept(listener, NULL, NULL);
+
+    std::vector<Case> cases = corpus();
+    std::fprintf(out, "%-16s %16s %16s %14s %14s\n", "request", "heap allocs/req", "arena allocs/req", "heap ns/req",
+                 "arena ns/req");
+    bool typicalZero = true, heapAllocates = true;
+    for (const Case& c : cases) {
+        Result heap = run(client, server, c.raw, false, requests);
+        Result arena = run(client, server, c.raw, true, requests);
+        std::fprintf(out, "%-16s %16.2f %16.2f %14.0f %14.0f\n", c.name, heap.allocsPerRequest, arena.allocsPerRequest,
+                     heap.nsPerRequest, arena.nsPerRequest);
+        if (c.typical) {
+            typicalZero = typicalZero && arena.allocsPerRequest == 0;
+            heapAllocates = heapAllocates && heap.allocsPerRequest > 0;
+        }
+    }
+    std::fprintf(out, "\n");
+
+    RequestArena arena;
+    HttpRequest post = parseHttpRequest(cases[2].raw, &arena);
+    HttpRequest get = parseHttpRequest(cases[1].raw, &arena);
+    expect(post.method == "POST" && post.path == "http://forms.example.org/submit" && post.version == "HTTP/1.1" &&
+               post.host == "forms.example.org" && post.port == "80" && post.contentLength == 27 &&
+               get.host == "api.example-services.net" && get.port == "8080" && get.contentLength == -1,
+           "arena-backed requests parse as before");
+    expect(modifyRequestLine(get, &arena) == modifyRequestLine(get), "the rewrite is the same on the arena and the heap");
+    expect(isBlocked("ads.example.com") && isBlocked("www.ads.example.com") && isBlocked(" WWW.Ads.Example.COM\r\n") &&
+               isBlocked("a.b.tracker.example.net") && isBlocked("blocked999.example"),
+           "blocked domains and their subdomains are blocked");
+    expect(!isBlocked("badads.example.com") && !isBlocked(".ads.example.com") && !isBlocked("example.com") &&
+               !isBlocked("ads.example.com.evil.test") && !isBlocked(""),
+           "look-alikes and parent domains are not");
+    arena.reset();
+    expect(heapAllocates, "the heap path allocates (the count is live)");
+    expect(typicalZero, "a typical GET makes no heap allocations on the arena");
+    expect(bufferPoolStats().classes[BUF_HEADER].inUse == 0, "every arena block is back in the pool");
+
+    closesocket(client);
+    closesocket(server);
+    closesocket(listener);
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
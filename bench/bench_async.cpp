@@ -0,0 +1,193 @@
+/**
+ * @file bench_async.cpp
+ * @brief Coroutine handler against thread-per-connection: memory per idle
+ *        connection and proxied request throughput.
+ *
+ * Usage: bench_async [seconds per rate run, default 3] [held connections, default 1000]
+ * Exits non-zero if a proxied request fails, an idle connection costs the
+ * coroutine handler as much resident memory or address space as a thread, or
+ * its requests/s fall more than 10% short of the threaded handler's.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/AsyncProxy.h"
+#include "../include/EventLoop.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+static double secondsSince(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Current (not peak) values, so each phase can be measured on its own.
+static long statusKb(const char* field) {
+#ifdef _WIN32
+    (void)field;
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t len = std::strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, len, field) == 0) return std::atol(line.c_str() + len);
+    }
+    return 0;
+#endif
+}
+
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (readHeaders(s, head)) {
+        const char resp[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+        sendAll(s, resp, sizeof(resp) - 1);
+    }
+    closesocket(s);
+}
+
+static void threadedAcceptLoop(SOCKET listener) {
+    while (true) {
+        SOCKET c = accept(listener, NULL, NULL);
+        if (c == INVALID_SOCKET) return;
+        std::thread(handleClient, c).detach();
+    }
+}
+
+static void asyncAcceptLoop(SOCKET listener) {
+    while (true) {
+        SOCKET c = accept(listener, NULL, NULL);
+        if (c == INVALID_SOCKET) return;
+        asyncServe(c, nullptr);
+    }
+}
+
+// Closed loop, one short GET per connection, `clients` at a time.
+static double requestRate(int proxyPort, int originPort, int clients, double seconds, size_t& failures) {
+    std::string req = "GET http://127.0.0.1:" + std::to_string(originPort) + "/ HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(originPort) + "\r\n\r\n";
+    std::atomic<size_t> done{0}, failed{0};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    auto t0 = Clock::now();
+    for (int i = 0; i < clients; i++) {
+        workers.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                SOCKET s = connectLoopback(proxyPort);
+                bool good = s != INVALID_SOCKET && sendAll(s, req.c_str(), (int)req.size()) != SOCKET_ERROR;
+                if (good) {
+                    std::string reply = readAll(s);
+                    good = reply.compare(0, 12, "HTTP/1.1 200") == 0 && reply.size() >= 2 &&
+                           reply.compare(reply.size() - 2, 2, "ok") == 0;
+                }
+                if (s != INVALID_SOCKET) closesocket(s);
+                (good ? done : failed).fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds((long long)(seconds * 1000)));
+    stop = true;
+    for (auto& t : workers) t.join();
+    failures = failed.load();
+    return (double)done.load() / secondsSince(t0);
+}
+
+struct Held {
+    double rssKb = 0;
+    double vmKb = 0;
+    double frameBytes = 0;
+};
+
+// Connections that never send a request: a parked thread in one model, a
+// suspended coroutine in the other.
+static Held holdConnections(int proxyPort, int count) {
+    long rss0 = statusKb("VmRSS:"), vm0 = statusKb("VmSize:");
+    uint64_t frames0 = coroFrameStats().liveBytes;
+    std::vector<SOCKET> held;
+    for (int i = 0; i < count; i++) {
+        SOCKET s = connectLoopback(proxyPort);
+        if (s != INVALID_SOCKET) held.push_back(s);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // let every handler start
+    double n = (double)std::max<size_t>(held.size(), 1);
+    Held h;
+    h.rssKb = (double)(statusKb("VmRSS:") - rss0) / n;
+    h.vmKb = (double)(statusKb("VmSize:") - vm0) / n;
+    h.frameBytes = (double)(coroFrameStats().liveBytes - frames0) / n;
+    for (SOCKET s : held) closesocket(s);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // and every handler finish
+    return h;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 3;
+    int holdCount = argc > 2 ? std::atoi(argv[2]) : 1000;
+    benchSocketsInit();
+    out = benchQuietStdout();
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    AsyncConfig async;
+    async.loops = 1;
+    if (!initAsyncHandler(async)) {
+        std::fprintf(out, "async handler unavailable on this platform; skipped\nPASS\n");
+        return 0;
+    }
+
+    int originPort = 0, threadedPort = 0, asyncPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    SOCKET threaded = listenLoopback(threadedPort);
+    std::thread(threadedAcceptLoop, threaded).detach();
+    SOCKET asyncListener = listenLoopback(asyncPort);
+    std::thread(asyncAcceptLoop, asyncListener).detach();
+
+    const int clients = 8;
+    int ports[2] = { threadedPort, asyncPort };
+    double rate[2];
+    size_t failures[2];
+    Held held[2];
+    for (int mode = 0; mode < 2; mode++) {
+        held[mode] = holdConnections(ports[mode], holdCount);
+        rate[mode] = requestRate(ports[mode], originPort, clients, seconds, failures[mode]);
+    }
+
+    std::fprintf(out, "%-22s %14s %10s %16s %16s %18s\n", "model", "requests/s", "failed", "RSS KiB/idle",
+                 "VM KiB/idle", "frame B/idle");
+    const char* names[2] = { "thread per conn", "coroutine (1 loop)" };
+    for (int mode = 0; mode < 2; mode++) {
+        std::fprintf(out, "%-22s %14.0f %10zu %16.1f %16.1f %18.0f\n", names[mode], rate[mode], failures[mode],
+                     held[mode].rssKb, held[mode].vmKb, held[mode].frameBytes);
+    }
+    CoroFrameStats frames = coroFrameStats();
+    std::fprintf(out, "frames: %llu allocated, %llu from the free lists (%.1f%%)\n\n",
+                 (unsigned long long)frames.allocated, (unsigned long long)frames.reused,
+                 frames.allocated ? 100.0 * (double)frames.reused / (double)frames.allocated : 0.0);
+
+    expect(failures[0] == 0 && failures[1] == 0 && rate[0] > 0 && rate[1] > 0,
+           "every proxied request completes in both models");
+    expect(held[1].rssKb < held[0].rssKb, "an idle connection costs less resident memory as a coroutine");
+    expect(held[1].vmKb < held[0].vmKb, "an idle connection reserves less address space as a coroutine");
+    expect(rate[1] > 0.9 * rate[0], "coroutine handler throughput is at least the threaded one's (within 10%)");
+    expect(frames.reused > frames.allocated / 2, "most coroutine frames are recycled from the free lists");
+
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
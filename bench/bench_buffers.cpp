@@ -0,0 +1,186 @@
+/**
+ * @file bench_buffers.cpp
+ * @brief Slab buffer pool against new[]/delete[]: acquire/release rate and
+ *        resident memory under connection churn.
+ *
+ * Usage: bench_buffers [threads, default 4] [churn operations per thread, default 200000]
+ * Each thread models connections that come and go: a fixed number of live
+ * slots, each replaced at random by a new connection holding a header buffer,
+ * one or two I/O buffers and now and then a large one, with a random prefix
+ * of each written as a recv() would. Exits non-zero if the pool is slower
+ * than the heap or its peak resident memory under churn exceeds the heap's by
+ * more than 10%. The pool keeps its slabs afterwards; that is reported too.
+ */
+
+#include "../include/BufferPool.h"
+#include "BenchUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+static long currentRssKb() {
+#ifdef _WIN32
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) return std::atol(line.c_str() + 6);
+    }
+    return 0;
+#endif
+}
+
+static bool pooled = false;
+
+static char* take(BufferClass c) {
+    return pooled ? bufferAcquire(c) : new char[bufferClassSize(c)];
+}
+
+static void give(char* p, BufferClass c) {
+    if (pooled) bufferRelease(p, c);
+    else delete[] p;
+}
+
+// Back-to-back acquire/release of one I/O buffer: the per-request cost.
+static double pairRate(int threads, size_t pairs) {
+    std::vector<std::thread> workers;
+    auto t0 = Clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([pairs] {
+            for (size_t i = 0; i < pairs; i++) {
+                char* p = take(BUF_IO);
+                p[0] = (char)i;
+                give(p, BUF_IO);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    return (double)(pairs * (size_t)threads) / std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+struct Conn {
+    char* bufs[4] = {};
+    BufferClass classes[4] = {};
+    int count = 0;
+};
+
+static void fill(char* p, size_t size, std::mt19937& rng) {
+    size_t len = 1 + rng() % size;
+    for (size_t off = 0; off < len; off += 4096) p[off] = (char)off;
+}
+
+static void open(Conn& c, std::mt19937& rng) {
+    c.count = 0;
+    BufferClass want[4] = { BUF_HEADER, BUF_IO, BUF_IO, BUF_IO_LARGE };
+    int n = 2 + (rng() % 2 == 0);
+    for (int i = 0; i < 4; i++) {
+        if (i >= n && !(i == 3 && rng() % 10 == 0)) continue;
+        c.classes[c.count] = want[i];
+        c.bufs[c.count] = take(want[i]);
+        fill(c.bufs[c.count], bufferClassSize(want[i]), rng);
+        c.count++;
+    }
+}
+
+static void close(Conn& c) {
+    for (int i = 0; i < c.count; i++) give(c.bufs[i], c.classes[i]);
+    c.count = 0;
+}
+
+// Churn with random lifetimes; returns operations per second.
+static double churn(int threads, size_t ops, size_t live) {
+    std::vector<std::thread> workers;
+    auto t0 = Clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([ops, live, t] {
+            std::mt19937 rng(1234 + t);
+            std::vector<Conn> conns(live);
+            for (Conn& c : conns) open(c, rng);
+            for (size_t i = 0; i < ops; i++) {
+                Conn& c = conns[rng() % live];
+                close(c);
+                open(c, rng);
+            }
+            for (Conn& c : conns) close(c);
+        });
+    }
+    for (auto& w : workers) w.join();
+    return (double)(ops * (size_t)threads) / std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    size_t ops = argc > 2 ? (size_t)std::atol(argv[2]) : 200000;
+    out = benchQuietStdout();
+
+    const size_t live = 500; // connections per thread
+    const size_t pairs = 2000000;
+    double rate[2], churnRate[2];
+    long peakGrowth[2], retained[2];
+    // The pool runs first so its slabs are not carved from memory the heap
+    // phase already faulted in; peaks are sampled while the churn runs.
+    for (int mode = 1; mode >= 0; mode--) {
+        pooled = mode == 1;
+        rate[mode] = pairRate(threads, pairs);
+        long before = currentRssKb();
+        std::atomic<bool> sampling{true};
+        long peak = before;
+        std::thread sampler([&] {
+            while (sampling) {
+                peak = std::max(peak, currentRssKb());
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        });
+        churnRate[mode] = churn(threads, ops, live);
+        sampling = false;
+        sampler.join();
+        peakGrowth[mode] = std::max(peak, currentRssKb()) - before;
+        retained[mode] = currentRssKb() - before;
+    }
+
+    std::fprintf(out, "%-14s %18s %16s %18s %18s\n", "allocator", "acquire+release/s", "churn ops/s", "peak RSS +KiB",
+                 "kept RSS +KiB");
+    const char* names[2] = { "new/delete", "buffer pool" };
+    for (int mode = 0; mode < 2; mode++) {
+        std::fprintf(out, "%-14s %18.0f %16.0f %18ld %18ld\n", names[mode], rate[mode], churnRate[mode], peakGrowth[mode],
+                     retained[mode]);
+    }
+    BufferPoolStats stats = bufferPoolStats();
+    for (int c = 0; c < BUF_CLASS_COUNT; c++) {
+        const BufferClassStats& s = stats.classes[c];
+        std::fprintf(out, "pool %-9s %8llu KiB of slabs, %llu in use, %llu in depot, %llu acquired, %llu depot fetches\n",
+                     bufferClassName((BufferClass)c), (unsigned long long)(s.slabBytes >> 10),
+                     (unsigned long long)s.inUse, (unsigned long long)s.depot, (unsigned long long)s.acquired,
+                     (unsigned long long)s.depotFetches);
+    }
+    std::fprintf(out, "\n");
+
+    bool balanced = true;
+    for (int c = 0; c < BUF_CLASS_COUNT; c++) balanced = balanced && stats.classes[c].inUse == 0;
+    expect(balanced, "every pooled buffer is back in the pool");
+    expect(rate[1] > rate[0], "pool acquire/release beats new/delete");
+    expect(churnRate[1] > 0.9 * churnRate[0], "churn runs at least as fast with the pool (within 10%)");
+    expect(peakGrowth[1] <= peakGrowth[0] * 1.1 + 1024, "pool peak resident memory under churn is within 10% of the heap's");
+
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+/**
+ * @file bench_cache.cpp
+ * @brief Requests/sec through handleClient() for cache hits versus origin
+ *        round trips, plus a revalidation check (stale entry + 304).
+ *
+ * Usage: bench_cache [threads, default 8] [requests per thread, default 2000]
+ * Exits non-zero if hits reach the origin or revalidation misbehaves.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/Cache.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<int> originRequests{0};
+static std::atomic<int> originNotModified{0};
+static const std::string ASSET(4096, 'a');
+
+// /asset is fresh for an hour, /stale must be revalidated every time, /nostore is never cached.
+// /broken is like /stale, but its revalidation gets half a 304 head and then a close.
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (!readHeaders(s, head)) { closesocket(s); return; }
+    originRequests++;
+
+    std::string resp;
+    if (head.find(" /stale ") != std::string::npos && head.find("If-None-Match: \"v1\"") != std::string::npos) {
+        originNotModified++;
+        resp = "HTTP/1.1 304 Not Modified\r\nETag: \"v1\"\r\nCache-Control: max-age=0\r\n\r\n";
+    } else if (head.find(" /broken ") != std::string::npos && head.find("If-None-Match: \"v1\"") != std::string::npos) {
+        resp = "HTTP/1.1 304 Not Modified\r\nETag: \"v1\"\r\n";
+    } else {
+        std::string cc = head.find(" /asset ") != std::string::npos ? "public, max-age=3600"
+                       : head.find(" /stale ") != std::string::npos ||
+                         head.find(" /broken ") != std::string::npos ? "max-age=0" : "no-store";
+        resp = "HTTP/1.1 200 OK\r\nContent-Type: application/javascript\r\nCache-Control: " + cc +
+               "\r\nETag: \"v1\"\r\nContent-Length: " + std::to_string(ASSET.size()) + "\r\n\r\n" + ASSET;
+    }
+    sendAll(s, resp.c_str(), (int)resp.size());
+    closesocket(s);
+}
+
+static bool fetch(int proxyPort, int originPort, const char* path, std::string& response) {
+    SOCKET s = connectLoopback(proxyPort);
+    if (s == INVALID_SOCKET) return false;
+    std::string req = std::string("GET ") + path + " HTTP/1.1\r\nHost: 127.0.0.1:" + std::to_string(originPort) +
+                      "\r\nAccept: */*\r\n\r\n";
+    sendAll(s, req.c_str(), (int)req.size());
+    response = readAll(s);
+    closesocket(s);
+    return response.compare(0, 12, "HTTP/1.1 200") == 0 && response.size() > ASSET.size();
+}
+
+static double requestsPerSec(int threads, int perThread, int proxyPort, int originPort, const char* path, int& failures) {
+    std::atomic<int> failed{0};
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            std::string response;
+            for (int i = 0; i < perThread; i++) {
+                if (!fetch(proxyPort, originPort, path, response)) failed++;
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    failures = failed;
+    return threads * perThread / secs;
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 8;
+    int perThread = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    benchSocketsInit();
+    FILE* out = benchQuietStdout();
+    initCache(64u << 20, 1u << 20);
+
+    int originPort = 0, proxyPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    std::thread(acceptLoop, proxy, handleClient).detach();
+
+    bool ok = true;
+    std::string response;
+    fetch(proxyPort, originPort, "/asset", response); // prime
+
+    int failures = 0;
+    int before = originRequests;
+    double miss = requestsPerSec(threads, perThread, proxyPort, originPort, "/nostore", failures);
+    ok = ok && failures == 0 && originRequests - before == threads * perThread;
+
+    before = originRequests;
+    double hit = requestsPerSec(threads, perThread, proxyPort, originPort, "/asset", failures);
+    int hitOrigin = originRequests - before;
+    ok = ok && failures == 0 && hitOrigin == 0;
+
+    // Revalidation: first fetch stores, the second must send If-None-Match and
+    // serve the stored body after the origin's 304.
+    fetch(proxyPort, originPort, "/stale", response);
+    bool revalidated = fetch(proxyPort, originPort, "/stale", response) && originNotModified == 1 &&
+                       response.find("Age: ") != std::string::npos;
+    ok = ok && revalidated;
+
+    // An origin that dies mid-304 leaves the proxy nothing to serve; the
+    // client must still get an answer, and it is a 502.
+    fetch(proxyPort, originPort, "/broken", response);
+    fetch(proxyPort, originPort, "/broken", response);
+    bool brokenAnswered = response.compare(0, 12, "HTTP/1.1 502") == 0;
+    ok = ok && brokenAnswered;
+
+    CacheStats stats = cacheStats();
+    std::fprintf(out, "%-24s %12s\n", "path", "req/s");
+    std::fprintf(out, "%-24s %12.0f\n", "origin (no-store)", miss);
+    std::fprintf(out, "%-24s %12.0f\n", "cache hit", hit);
+    std::fprintf(out, "hit-path origin requests: %d\n", hitOrigin);
+    std::fprintf(out, "revalidation via 304: %s\n", revalidated ? "OK" : "FAILED");
+    std::fprintf(out, "truncated 304 answered: %s\n", brokenAnswered ? "502" : "FAILED");
+    std::fprintf(out, "cache: %zu entries, %zu bytes, %llu hits, %llu misses\n",
+                 stats.entries, stats.bytes, stats.hits, stats.misses);
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
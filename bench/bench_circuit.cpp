@@ -0,0 +1,123 @@
+/**
+ * @file bench_circuit.cpp
+ * @brief Circuit breaker check: requests to a refused upstream trip the
+ *        breaker after the failure threshold and then fail fast without a
+ *        connect(); once the upstream comes back, a half-open probe closes it.
+ *        Hosts that failed once and went quiet are dropped from the table.
+ *
+ * Usage: bench_circuit [requests per phase, default 200]
+ * Exits non-zero if the breaker trips at the wrong point, never recovers, or
+ * keeps idle hosts.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/CircuitBreaker.h"
+#include "BenchUtil.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (readHeaders(s, head)) {
+        const char resp[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+        sendAll(s, resp, sizeof(resp) - 1);
+    }
+    closesocket(s);
+}
+
+// Returns the proxy's status code (502, 200, ...) or 0 on a transport error.
+static int request(int proxyPort, const std::string& host, int port, double& micros) {
+    auto t0 = std::chrono::steady_clock::now();
+    SOCKET s = connectLoopback(proxyPort);
+    if (s == INVALID_SOCKET) return 0;
+    std::string req = "GET http://" + host + ":" + std::to_string(port) + "/ HTTP/1.1\r\nHost: " + host + ":" +
+                      std::to_string(port) + "\r\n\r\n";
+    sendAll(s, req.c_str(), (int)req.size());
+    std::string response = readAll(s);
+    closesocket(s);
+    micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    return response.size() >= 12 ? std::atoi(response.c_str() + 9) : 0;
+}
+
+struct Phase {
+    int failures = 0;
+    double firstMicros = 0;  // mean latency of requests that really tried to connect
+    double fastMicros = 0;   // mean latency once the breaker is open
+};
+
+static Phase hammer(int proxyPort, const std::string& host, int port, int requests, int threshold) {
+    Phase p;
+    uint64_t before = circuitBreakerStats().fastFails;
+    for (int i = 0; i < requests; i++) {
+        double us = 0;
+        if (request(proxyPort, host, port, us) == 502) p.failures++;
+        (i < threshold ? p.firstMicros : p.fastMicros) += us;
+    }
+    p.firstMicros /= threshold;
+    p.fastMicros /= (requests - threshold);
+    p.failures -= (int)(circuitBreakerStats().fastFails - before); // real connect failures only
+    return p;
+}
+
+int main(int argc, char** argv) {
+    int requests = argc > 1 ? std::atoi(argv[1]) : 200;
+    const int threshold = 5;
+
+    benchSocketsInit();
+    FILE* out = benchQuietStdout();
+
+    CircuitBreakerConfig config;
+    config.failureThreshold = threshold;
+    config.openMs = 200;
+    config.maxOpenMs = 400;
+    config.halfOpenProbes = 1;
+    initCircuitBreaker(config);
+
+    int proxyPort = 0, deadPort = 0;
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, proxy, handleClient).detach();
+    closesocket(listenLoopback(deadPort)); // nothing listens here any more: connect() is refused
+
+    bool ok = true;
+    Phase refused = hammer(proxyPort, "127.0.0.1", deadPort, requests, threshold);
+    ok = ok && refused.failures == threshold;
+
+    Phase dns = hammer(proxyPort, "proxy-bench.invalid", 80, requests, threshold);
+    ok = ok && dns.failures == threshold;
+
+    // Bring the upstream back: after the open period one probe gets through and closes the breaker.
+    SOCKET revived = listenLoopback(deadPort);
+    std::thread(acceptLoop, revived, originConnection).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(config.maxOpenMs + 50));
+    double us = 0;
+    int recovered = 0;
+    for (int i = 0; i < 10; i++) {
+        if (request(proxyPort, "127.0.0.1", deadPort, us) == 200) recovered++;
+    }
+    CircuitBreakerStats stats = circuitBreakerStats();
+    ok = ok && recovered == 10;
+
+    // Hosts that fail once and are never asked for again must not pile up.
+    const int strays = 2000;
+    for (int i = 0; i < strays; i++) upstreamResult("stray-" + std::to_string(i) + ".invalid", "80", false, false);
+    uint64_t trackedBefore = circuitBreakerStats().tracked;
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * config.maxOpenMs + 1100));
+    for (int i = 0; i < 200; i++) upstreamResult("late-" + std::to_string(i) + ".invalid", "80", false, false);
+    uint64_t trackedAfter = circuitBreakerStats().tracked;
+    ok = ok && trackedBefore >= (uint64_t)strays && trackedAfter <= 201;
+
+    std::fprintf(out, "%-22s %10s %14s %14s\n", "upstream", "connects", "connect us", "fast-fail us");
+    std::fprintf(out, "%-22s %10d %14.1f %14.1f\n", "refused (loopback)", refused.failures, refused.firstMicros,
+                 refused.fastMicros);
+    std::fprintf(out, "%-22s %10d %14.1f %14.1f\n", "unresolvable host", dns.failures, dns.firstMicros, dns.fastMicros);
+    std::fprintf(out, "recovered after probe: %d/10\n", recovered);
+    std::fprintf(out, "tracked hosts: %llu after %d one-off failures, %llu once they went quiet\n",
+                 (unsigned long long)trackedBefore, strays, (unsigned long long)trackedAfter);
+    std::fprintf(out, "breaker: %llu trips, %llu fast fails, %llu open\n", (unsigned long long)stats.trips,
+                 (unsigned long long)stats.fastFails, (unsigned long long)stats.open);
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
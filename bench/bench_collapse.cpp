@@ -0,0 +1,124 @@
+/**
+ * @file bench_collapse.cpp
+ * @brief Collapsed forwarding check: N simultaneous clients request the same
+ *        URL from a slow local origin through handleClient(). With collapsing
+ *        on, the origin must see exactly one fetch and every client the full
+ *        body; the same run with collapsing off is shown for comparison.
+ *
+ * Usage: bench_collapse [clients, default 500]
+ * Exits non-zero on a short body or if more than one fetch reaches the origin.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/Collapse.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<int> originRequests{0};
+static const std::string BODY(256 << 10, 'v');
+
+// Waits a second before the head, then trickles the body out in 8 slices.
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (!readHeaders(s, head)) { closesocket(s); return; }
+    originRequests++;
+    std::string cc = head.find(" /nostore") != std::string::npos ? "no-store" : "public, max-age=60";
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::string resp = "HTTP/1.1 200 OK\r\nCache-Control: " + cc + "\r\nContent-Length: " +
+                       std::to_string(BODY.size()) + "\r\n\r\n";
+    sendAll(s, resp.c_str(), (int)resp.size());
+    size_t slice = BODY.size() / 8;
+    for (size_t off = 0; off < BODY.size(); off += slice) {
+        sendAll(s, BODY.data() + off, (int)slice);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    closesocket(s);
+}
+
+static bool fetch(int proxyPort, int originPort, const std::string& path) {
+    SOCKET s = connectLoopback(proxyPort);
+    if (s == INVALID_SOCKET) return false;
+    std::string req = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1:" + std::to_string(originPort) + "\r\n\r\n";
+    sendAll(s, req.c_str(), (int)req.size());
+    std::string response = readAll(s);
+    closesocket(s);
+    size_t bodyPos = response.find("\r\n\r\n");
+    return response.compare(0, 12, "HTTP/1.1 200") == 0 && bodyPos != std::string::npos &&
+           response.size() - bodyPos - 4 == BODY.size();
+}
+
+struct Run {
+    int failures;
+    int originFetches;
+    double secs;
+};
+
+// All clients are released at once so they overlap the origin's delay.
+static Run simultaneous(int clients, int proxyPort, int originPort, const std::string& path) {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool go = false;
+    std::atomic<int> failed{0};
+    int before = originRequests;
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < clients; i++) {
+        workers.emplace_back([&] {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return go; });
+            }
+            if (!fetch(proxyPort, originPort, path)) failed++;
+        });
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        go = true;
+    }
+    cv.notify_all();
+    for (auto& w : workers) w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return Run{ failed.load(), originRequests - before, secs };
+}
+
+int main(int argc, char** argv) {
+    int clients = argc > 1 ? std::atoi(argv[1]) : 500;
+
+    benchSocketsInit();
+    FILE* out = benchQuietStdout();
+
+    int originPort = 0, proxyPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    std::thread(acceptLoop, proxy, handleClient).detach();
+
+    // No cache tier is enabled, so every request that is not collapsed reaches the origin.
+    initCollapse(0, 0);
+    Run off = simultaneous(clients, proxyPort, originPort, "/viral?run=off");
+
+    initCollapse(10000, 8u << 20);
+    Run on = simultaneous(clients, proxyPort, originPort, "/viral?run=on");
+    // Declined (no-store) responses fall back to independent fetches.
+    Run declined = simultaneous(50, proxyPort, originPort, "/nostore");
+
+    bool ok = on.failures == 0 && on.originFetches == 1 && declined.failures == 0 &&
+              declined.originFetches == 50;
+
+    std::fprintf(out, "%-20s %8s %10s %10s %10s\n", "mode", "clients", "fetches", "failures", "seconds");
+    std::fprintf(out, "%-20s %8d %10d %10d %10.2f\n", "collapsing off", clients, off.originFetches, off.failures, off.secs);
+    std::fprintf(out, "%-20s %8d %10d %10d %10.2f\n", "collapsing on", clients, on.originFetches, on.failures, on.secs);
+    std::fprintf(out, "%-20s %8d %10d %10d %10.2f\n", "declined (no-store)", 50, declined.originFetches,
+                 declined.failures, declined.secs);
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
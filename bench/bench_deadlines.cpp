@@ -0,0 +1,267 @@
+/**
+ * @file bench_deadlines.cpp
+ * @brief Timing wheel and connection deadline check: arm/cancel/expire cost
+ *        with up to a million armed timers (against a std::multimap timer
+ *        queue), exact firing, and the header, idle and tunnel lifetime
+ *        deadlines cutting real connections through the proxy.
+ *
+ * Usage: bench_deadlines [timers, default 1000000]
+ * Exits non-zero if a timer fires at the wrong tick, a cancelled timer fires,
+ * the wheel is slower than the multimap at full size, or a deadline fails to
+ * close (or wrongly closes) a proxied connection.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/TimerWheel.h"
+#include "../include/Deadline.h"
+#include "BenchUtil.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+static double nsSince(Clock::time_point t0, size_t ops) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / (double)ops;
+}
+
+struct BenchTimer {
+    TimerNode node;
+    uint64_t firedAt = 0;
+    bool cancelled = false;
+};
+
+static TimerWheel* benchWheel = nullptr;
+static size_t misfired = 0;
+
+static void onFire(TimerNode* node) {
+    BenchTimer& t = *reinterpret_cast<BenchTimer*>(node);
+    t.firedAt = benchWheel->now();
+    if (t.cancelled || t.firedAt != node->expires) misfired++;
+}
+
+struct Costs {
+    double arm = 0, rearm = 0, cancel = 0, expire = 0;
+};
+
+// Deadlines spread over ~1M ticks (almost three hours at 10 ms) so every level
+// of the wheel is used; half the timers are re-armed, a quarter cancelled.
+static Costs wheelCosts(size_t n, bool verify) {
+    std::vector<BenchTimer> timers(n);
+    std::vector<uint64_t> when(n), later(n);
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i < n; i++) {
+        when[i] = 1 + rng() % 1000000;
+        later[i] = 1 + rng() % 1000000;
+        timers[i].node.fire = onFire;
+    }
+    TimerWheel wheel(0);
+    benchWheel = &wheel;
+    misfired = 0;
+    Costs c;
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < n; i++) wheel.arm(timers[i].node, when[i]);
+    c.arm = nsSince(t0, n);
+    t0 = Clock::now();
+    for (size_t i = 0; i < n; i += 2) wheel.arm(timers[i].node, later[i]);
+    c.rearm = nsSince(t0, n / 2);
+    t0 = Clock::now();
+    size_t cancels = 0;
+    for (size_t i = 1; i < n; i += 4, cancels++) {
+        wheel.cancel(timers[i].node);
+        timers[i].cancelled = true;
+    }
+    c.cancel = nsSince(t0, cancels);
+    size_t live = wheel.size();
+    t0 = Clock::now();
+    size_t fired = wheel.advance(1000001);
+    c.expire = nsSince(t0, fired);
+    if (verify) {
+        size_t unfired = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (!timers[i].cancelled && timers[i].firedAt == 0) unfired++;
+        }
+        std::fprintf(out, "  %zu armed after churn, %zu fired, %zu misfired, %zu never fired\n", live, fired, misfired,
+                     unfired);
+        expect(fired == live && misfired == 0 && unfired == 0 && wheel.size() == 0,
+               "every live timer fires exactly at its tick; cancelled ones never fire");
+    }
+    return c;
+}
+
+// The usual alternative: an ordered multimap keyed by deadline, with the
+// iterator kept for cancellation.
+static Costs multimapCosts(size_t n) {
+    typedef std::multimap<uint64_t, size_t> Queue;
+    Queue queue;
+    std::vector<Queue::iterator> where(n);
+    std::vector<uint64_t> when(n), later(n);
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i < n; i++) {
+        when[i] = 1 + rng() % 1000000;
+        later[i] = 1 + rng() % 1000000;
+    }
+    Costs c;
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < n; i++) where[i] = queue.emplace(when[i], i);
+    c.arm = nsSince(t0, n);
+    t0 = Clock::now();
+    for (size_t i = 0; i < n; i += 2) {
+        queue.erase(where[i]);
+        where[i] = queue.emplace(later[i], i);
+    }
+    c.rearm = nsSince(t0, n / 2);
+    t0 = Clock::now();
+    size_t cancels = 0;
+    for (size_t i = 1; i < n; i += 4, cancels++) queue.erase(where[i]);
+    c.cancel = nsSince(t0, cancels);
+    size_t live = queue.size();
+    volatile size_t sink = 0;
+    t0 = Clock::now();
+    while (!queue.empty()) {
+        sink = sink + queue.begin()->second;
+        queue.erase(queue.begin());
+    }
+    c.expire = nsSince(t0, live);
+    return c;
+}
+
+static void echoConnection(SOCKET s) {
+    char buf[4096];
+    int n;
+    while ((n = recv(s, buf, sizeof(buf), 0)) > 0) sendAll(s, buf, n);
+    closesocket(s);
+}
+
+// Milliseconds until the proxy closes `s`, reading (and discarding) anything
+// it sends; gives up after `limitMs`.
+static double msUntilClosed(SOCKET s, int limitMs, std::string* received = nullptr) {
+    setSocketTimeout(s, limitMs);
+    auto t0 = Clock::now();
+    char buf[4096];
+    int n;
+    while ((n = recv(s, buf, sizeof(buf), 0)) > 0) {
+        if (received) received->append(buf, n);
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    return n == 0 || ms < limitMs ? ms : -1;
+}
+
+static SOCKET openTunnel(int proxyPort, int echoPort) {
+    SOCKET s = connectLoopback(proxyPort);
+    std::string target = "127.0.0.1:" + std::to_string(echoPort);
+    std::string req = "CONNECT " + target + " HTTP/1.1\r\nHost: " + target + "\r\n\r\n";
+    sendAll(s, req.c_str(), (int)req.size());
+    std::string head;
+    if (!readHeaders(s, head)) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+// Echoes a byte every `gapMs` for `totalMs`; returns right after the last one.
+static bool keepTalking(SOCKET s, int gapMs, int totalMs) {
+    auto t0 = Clock::now();
+    while (std::chrono::duration<double, std::milli>(Clock::now() - t0).count() < totalMs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(gapMs));
+        char c = 'x';
+        if (send(s, &c, 1, 0) != 1 || recv(s, &c, 1, 0) != 1) return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? (size_t)std::atoll(argv[1]) : 1000000;
+    benchSocketsInit();
+    out = benchQuietStdout();
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN); // the proxy's relay writes to sockets the deadlines shut down
+#endif
+
+    std::fprintf(out, "%-22s %10s %10s %10s %10s\n", "timers", "arm ns", "re-arm ns", "cancel ns", "expire ns");
+    Costs wheelBig{}, mapBig{};
+    for (size_t size = 10000; size <= n; size *= 10) {
+        Costs w = wheelCosts(size, false);
+        Costs m = multimapCosts(size);
+        std::fprintf(out, "%-22s %10.1f %10.1f %10.1f %10.1f\n", ("wheel " + std::to_string(size)).c_str(), w.arm,
+                     w.rearm, w.cancel, w.expire);
+        std::fprintf(out, "%-22s %10.1f %10.1f %10.1f %10.1f\n", ("multimap " + std::to_string(size)).c_str(), m.arm,
+                     m.rearm, m.cancel, m.expire);
+        wheelBig = w;
+        mapBig = m;
+    }
+    std::fprintf(out, "\nverification run, %zu timers\n", n);
+    wheelCosts(n, true);
+    expect(wheelBig.arm < mapBig.arm && wheelBig.rearm < mapBig.rearm && wheelBig.cancel < mapBig.cancel,
+           "arm, re-arm and cancel beat the multimap at full size");
+
+    // Through the proxy, with deadlines short enough to watch.
+    int echoPort = 0, proxyPort = 0;
+    SOCKET echo = listenLoopback(echoPort);
+    std::thread(acceptLoop, echo, echoConnection).detach();
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, proxy, handleClient).detach();
+    DeadlineConfig cfg;
+    cfg.headerMs = 1000;
+    cfg.idleMs = 500;
+    cfg.tunnelMaxMs = 0;
+    initDeadlines(cfg);
+
+    std::fprintf(out, "\nheader 1000 ms, idle 500 ms\n");
+    // Slowloris: one byte every 200 ms never trips a per-syscall timeout.
+    SOCKET slow = connectLoopback(proxyPort);
+    std::thread([slow] {
+        const char* req = "GET http://127.0.0.1/ HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+        for (const char* p = req; *p; p++) {
+            if (send(slow, p, 1, 0) != 1) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    }).detach();
+    std::string reply;
+    double headerMs = msUntilClosed(slow, 5000, &reply);
+    std::fprintf(out, "  byte-every-200ms client closed after %.0f ms, got \"%.12s\"\n", headerMs, reply.c_str());
+    expect(headerMs > 900 && headerMs < 1300 && reply.compare(0, 12, "HTTP/1.1 408") == 0,
+           "a trickling request head gets a 408 at the header deadline");
+
+    SOCKET busy = openTunnel(proxyPort, echoPort);
+    bool survived = busy != INVALID_SOCKET && keepTalking(busy, 300, 2000);
+    std::fprintf(out, "  tunnel with a byte every 300 ms %s 2 s\n", survived ? "survived" : "did not survive");
+    expect(survived, "a tunnel with pauses shorter than the idle timeout stays open");
+    double idleMs = busy != INVALID_SOCKET ? msUntilClosed(busy, 5000) : -1;
+    std::fprintf(out, "  then closed %.0f ms after going quiet\n", idleMs);
+    expect(idleMs > 400 && idleMs < 800, "a quiet tunnel is closed at the idle deadline");
+
+    cfg.idleMs = 60000;
+    cfg.tunnelMaxMs = 1000;
+    initDeadlines(cfg);
+    SOCKET longLived = openTunnel(proxyPort, echoPort);
+    auto t0 = Clock::now();
+    if (longLived != INVALID_SOCKET) keepTalking(longLived, 100, 3000);
+    double lifeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    if (longLived != INVALID_SOCKET) closesocket(longLived);
+    std::fprintf(out, "  busy tunnel with 1000 ms lifetime ended after %.0f ms\n", lifeMs);
+    expect(lifeMs > 900 && lifeMs < 1400, "tunnels are closed at their maximum lifetime even when busy");
+
+    DeadlineStats stats = deadlineStats();
+    std::fprintf(out, "  expired: header %llu, idle %llu, lifetime %llu; still armed %llu\n",
+                 (unsigned long long)stats.expired[DL_HEADER], (unsigned long long)stats.expired[DL_IDLE],
+                 (unsigned long long)stats.expired[DL_LIFETIME], (unsigned long long)stats.armed);
+
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
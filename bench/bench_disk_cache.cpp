@@ -0,0 +1,156 @@
+/**
+ * @file bench_disk_cache.cpp
+ * @brief Requests/sec for disk-tier hits (sendfile from a segment file) versus
+ *        origin round trips on a large object, a restart check that the
+ *        mmap'd index and segments are picked up again, and a shutdown of the
+ *        tier while hits are being served.
+ *
+ * Usage: bench_disk_cache [threads, default 8] [requests per thread, default 500]
+ * The memory tier stays disabled so every hit comes from disk.
+ * Exits non-zero if hits reach the origin, entries do not survive a restart,
+ * or a request fails while the tier shuts down.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/DiskCache.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<int> originRequests{0};
+static const std::string ASSET(1 << 20, 'd');
+
+// /asset is fresh for an hour, /nostore is never cached.
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (!readHeaders(s, head)) { closesocket(s); return; }
+    originRequests++;
+    std::string cc = head.find(" /asset") != std::string::npos ? "public, max-age=3600" : "no-store";
+    std::string resp = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nCache-Control: " + cc +
+                       "\r\nContent-Length: " + std::to_string(ASSET.size()) + "\r\n\r\n";
+    sendAll(s, resp.c_str(), (int)resp.size());
+    sendAll(s, ASSET.data(), (int)ASSET.size());
+    closesocket(s);
+}
+
+static bool fetch(int proxyPort, int originPort, const std::string& path) {
+    SOCKET s = connectLoopback(proxyPort);
+    if (s == INVALID_SOCKET) return false;
+    std::string req = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1:" + std::to_string(originPort) + "\r\n\r\n";
+    sendAll(s, req.c_str(), (int)req.size());
+    std::string response = readAll(s);
+    closesocket(s);
+    size_t bodyPos = response.find("\r\n\r\n");
+    return response.compare(0, 12, "HTTP/1.1 200") == 0 && bodyPos != std::string::npos &&
+           response.size() - bodyPos - 4 == ASSET.size() && response.compare(bodyPos + 4, 64, ASSET, 0, 64) == 0;
+}
+
+static double requestsPerSec(int threads, int perThread, int proxyPort, int originPort, const char* path, int& failures) {
+    std::atomic<int> failed{0};
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < perThread; i++) {
+                if (!fetch(proxyPort, originPort, path)) failed++;
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    failures = failed;
+    return threads * perThread / secs;
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 8;
+    int perThread = argc > 2 ? std::atoi(argv[2]) : 500;
+
+    benchSocketsInit();
+    FILE* out = benchQuietStdout();
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / ("proxy-disk-cache-" + std::to_string(std::rand()));
+    DiskCacheConfig config;
+    config.dir = dir.string();
+    config.budgetBytes = 256ull << 20;
+    config.segmentBytes = 16ull << 20;
+    config.indexSlots = 4096;
+    if (!initDiskCache(config)) {
+        std::fprintf(out, "disk cache unavailable\nFAIL\n");
+        return 1;
+    }
+
+    int originPort = 0, proxyPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    std::thread(acceptLoop, proxy, handleClient).detach();
+
+    bool ok = fetch(proxyPort, originPort, "/asset"); // prime
+
+    int failures = 0;
+    int before = originRequests;
+    double miss = requestsPerSec(threads, perThread, proxyPort, originPort, "/nostore", failures);
+    ok = ok && failures == 0 && originRequests - before == threads * perThread;
+
+    before = originRequests;
+    double hit = requestsPerSec(threads, perThread, proxyPort, originPort, "/asset", failures);
+    int hitOrigin = originRequests - before;
+    ok = ok && failures == 0 && hitOrigin == 0;
+
+    // Fill past the budget so whole segments are evicted, then restart the tier.
+    for (int i = 0; i < 300; i++) fetch(proxyPort, originPort, "/asset?v=" + std::to_string(i));
+    DiskCacheStats filled = diskCacheStats();
+    ok = ok && filled.evictedSegments > 0 && filled.bytes <= config.budgetBytes;
+
+    shutdownDiskCache();
+    initDiskCache(config);
+    before = originRequests;
+    bool survived = fetch(proxyPort, originPort, "/asset?v=299") && originRequests == before;
+    ok = ok && survived;
+
+    DiskCacheStats stats = diskCacheStats();
+
+    // Shut the tier down under load, as a hot restart does. Hits in flight
+    // finish from their segment and later requests go to the origin.
+    std::atomic<bool> stop{false};
+    std::atomic<int> duringShutdown{0}, failedDuringShutdown{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < threads; t++) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                duringShutdown++;
+                if (!fetch(proxyPort, originPort, "/asset")) failedDuringShutdown++;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    shutdownDiskCache();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    stop = true;
+    for (auto& r : readers) r.join();
+    ok = ok && failedDuringShutdown == 0 && !diskCacheEnabled();
+
+    std::fprintf(out, "%-24s %12s %12s\n", "path", "req/s", "MiB/s");
+    std::fprintf(out, "%-24s %12.0f %12.1f\n", "origin (no-store)", miss, miss * ASSET.size() / (1 << 20));
+    std::fprintf(out, "%-24s %12.0f %12.1f\n", "disk hit (sendfile)", hit, hit * ASSET.size() / (1 << 20));
+    std::fprintf(out, "hit-path origin requests: %d\n", hitOrigin);
+    std::fprintf(out, "evicted segments: %llu, bytes on disk: %llu\n",
+                 (unsigned long long)filled.evictedSegments, (unsigned long long)filled.bytes);
+    std::fprintf(out, "survives restart: %s\n", survived ? "OK" : "FAILED");
+    std::fprintf(out, "shutdown under load: %d requests, %d failed\n", duringShutdown.load(), failedDuringShutdown.load());
+    std::fprintf(out, "disk cache: %llu segments, %llu entries\n",
+                 (unsigned long long)stats.segments, (unsigned long long)stats.entries);
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+
+    shutdownDiskCache();
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+/**
+ * @file bench_latency.cpp
+ * @brief Latency histogram accuracy against known distributions (exact
+ *        percentiles from the sorted samples) and the per-record cost.
+ *
+ * Usage: bench_latency [samples per distribution, default 1000000] [threads, default 4]
+ * Exits non-zero if any reported percentile is off by more than 1%, if the
+ * merged per-thread counts do not add up, or if a thread that has timed one
+ * request holds more than 8 KB of histogram.
+ */
+
+#include "../include/Latency.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+struct Distribution {
+    const char* name;
+    std::function<double(std::mt19937_64&)> draw; // ns
+};
+
+static uint64_t exactPercentile(const std::vector<uint64_t>& sorted, double q) {
+    size_t rank = (size_t)std::ceil(q * (double)sorted.size());
+    return sorted[rank < 1 ? 0 : rank - 1];
+}
+
+template <typename F>
+static double nsPerOp(long long ops, F op) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (long long i = 0; i < ops; i++) op(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (double)ops;
+}
+
+int main(int argc, char** argv) {
+    size_t samples = argc > 1 ? (size_t)std::atoll(argv[1]) : 1000000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+    bool ok = true;
+
+    std::uniform_real_distribution<double> uniform(1e3, 1e8);
+    std::exponential_distribution<double> exponential(1.0 / 2e6);
+    std::lognormal_distribution<double> lognormal(std::log(1e6), 1.5);
+    std::bernoulli_distribution slow(0.1);
+    std::normal_distribution<double> fastMode(2e5, 2e4), slowMode(5e7, 5e6);
+    std::vector<Distribution> dists = {
+        { "uniform 1us-100ms", [&](std::mt19937_64& r) { return uniform(r); } },
+        { "exponential 2ms", [&](std::mt19937_64& r) { return exponential(r); } },
+        { "lognormal 1ms s=1.5", [&](std::mt19937_64& r) { return lognormal(r); } },
+        { "bimodal 200us/50ms", [&](std::mt19937_64& r) { return slow(r) ? slowMode(r) : fastMode(r); } },
+    };
+    const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    std::printf("%-22s %8s %14s %14s %10s\n", "distribution", "quantile", "exact ns", "reported ns", "error");
+    for (const Distribution& d : dists) {
+        std::mt19937_64 rng(42);
+        std::vector<uint64_t> values(samples);
+        auto hist = std::make_unique<LatencyHistogram>();
+        for (uint64_t& v : values) {
+            double x = d.draw(rng);
+            v = x < 1 ? 1 : (uint64_t)x;
+            hist->record(v);
+        }
+        std::sort(values.begin(), values.end());
+        LatencySnapshot snap;
+        snap.add(*hist);
+        ok = ok && snap.count == samples && snap.max == values.back();
+        for (double q : QUANTILES) {
+            uint64_t exact = exactPercentile(values, q);
+            uint64_t reported = snap.percentile(q);
+            double err = std::fabs((double)reported - (double)exact) / (double)exact;
+            ok = ok && err <= 0.01;
+            std::printf("%-22s %8.3f %14llu %14llu %9.3f%%\n", d.name, q, (unsigned long long)exact,
+                        (unsigned long long)reported, err * 100);
+        }
+    }
+
+    // Per-record cost: bare histogram, the per-thread registry, and a timed phase as handleClient does it.
+    const long long OPS = 20000000;
+    auto hist = std::make_unique<LatencyHistogram>();
+    double bare = nsPerOp(OPS, [&](long long i) { hist->record((uint64_t)(i * 7919) & 0xFFFFFFF); });
+    setLatencyEnabled(true);
+    double registry = nsPerOp(OPS, [](long long i) { latencyRecord(LAT_FILTER, (uint64_t)(i * 7919) & 0xFFFFFFF); });
+    double timed = nsPerOp(OPS / 4, [](long long) {
+        uint64_t t0 = latencyNow();
+        latencyRecord(LAT_TTFB, latencyNow() - t0);
+    });
+    setLatencyEnabled(false);
+    double disabled = nsPerOp(OPS, [](long long i) { latencyRecord(LAT_FILTER, (uint64_t)i); });
+    setLatencyEnabled(true);
+
+    // Per-thread recording merges back to the exact total.
+    uint64_t before = latencyMerge(LAT_DNS).count;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([] {
+            for (int i = 0; i < 1000000; i++) latencyRecord(LAT_DNS, (uint64_t)i);
+        });
+    }
+    for (auto& w : workers) w.join();
+    auto t0 = std::chrono::steady_clock::now();
+    LatencySnapshot dns = latencyMerge(LAT_DNS);
+    double mergeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    bool mergedOk = dns.count - before == (uint64_t)threads * 1000000;
+    ok = ok && mergedOk;
+
+    // What a connection thread holds after one request: a value in every phase.
+    const uint64_t ONE_REQUEST[LAT_PHASE_COUNT] = { 3000000, 800000, 250000, 400, 5000000 };
+    size_t slotBytes = 0;
+    for (uint64_t ns : ONE_REQUEST) {
+        auto h = std::make_unique<LatencyHistogram>();
+        h->record(ns);
+        slotBytes += h->bytes();
+    }
+    size_t denseBytes = (size_t)LAT_PHASE_COUNT * LatencyHistogram::BUCKETS * sizeof(uint64_t);
+    ok = ok && slotBytes <= 8192;
+
+    std::printf("\n%-34s %10s\n", "record path", "ns/op");
+    std::printf("%-34s %10.2f\n", "LatencyHistogram::record", bare);
+    std::printf("%-34s %10.2f\n", "latencyRecord (per-thread slot)", registry);
+    std::printf("%-34s %10.2f\n", "two clock reads + latencyRecord", timed);
+    std::printf("%-34s %10.2f\n", "latencyRecord (disabled)", disabled);
+    std::printf("merge of one phase across slots: %.1f us; %d-thread count %s\n", mergeUs, threads,
+                mergedOk ? "OK" : "MISMATCH");
+    std::printf("histogram bytes after one request: %zu (dense buckets: %zu)\n", slotBytes, denseBytes);
+    std::printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+/**
+ * @file bench_metrics.cpp
+ * @brief Metrics overhead: metricAdd() scaling across threads against a single
+ *        shared atomic counter, and requests/sec through handleClient() with
+ *        metrics off vs on. Also scrapes the admin endpoint and checks the
+ *        counters add up, that a silent admin client does not hold up a
+ *        scrape behind it, and that the endpoint outlives running out of
+ *        descriptors.
+ *
+ * Usage: bench_metrics [threads, default 8] [requests per thread, default 2000]
+ * Exits non-zero if the scraped counters disagree with the requests sent.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/Metrics.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<int64_t> sharedCounter{0};
+
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (readHeaders(s, head)) {
+        const char resp[] = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+        sendAll(s, resp, sizeof(resp) - 1);
+    }
+    closesocket(s);
+}
+
+// Aggregate ns per operation across all threads: falls with thread count when
+// updates scale, rises when threads fight over one cache line.
+template <typename F>
+static double nsPerOp(int threads, long long perThread, F op) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (long long i = 0; i < perThread; i++) op();
+        });
+    }
+    for (auto& w : workers) w.join();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    return ns / ((double)perThread * threads);
+}
+
+static double requestsPerSec(int threads, int perThread, int proxyPort, int originPort, int& failures) {
+    std::atomic<int> failed{0};
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            std::string req = "GET http://127.0.0.1:" + std::to_string(originPort) + "/ HTTP/1.1\r\nHost: 127.0.0.1:" +
+                              std::to_string(originPort) + "\r\n\r\n";
+            for (int i = 0; i < perThread; i++) {
+                SOCKET s = connectLoopback(proxyPort);
+                if (s == INVALID_SOCKET) { failed++; continue; }
+                sendAll(s, req.c_str(), (int)req.size());
+                std::string response = readAll(s);
+                closesocket(s);
+                if (response.compare(0, 12, "HTTP/1.1 200") != 0) failed++;
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    failures = failed;
+    return threads * perThread / secs;
+}
+
+static long long scrapeValue(const std::string& body, const std::string& series) {
+    size_t pos = body.find("\n" + series + " ");
+    return pos == std::string::npos ? -1 : std::atoll(body.c_str() + pos + series.size() + 2);
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 8;
+    int perThread = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    benchSocketsInit();
+    FILE* out = benchQuietStdout();
+
+    const long long OPS = 10000000;
+    std::fprintf(out, "%-8s %16s %16s %16s\n", "threads", "off ns/op", "slots ns/op", "shared ns/op");
+    for (int t = 1; t <= threads; t *= 2) {
+        setMetricsEnabled(false);
+        double off = nsPerOp(t, OPS, [] { metricAdd(M_BYTES_UPSTREAM, 3); });
+        setMetricsEnabled(true);
+        double on = nsPerOp(t, OPS, [] { metricAdd(M_BYTES_UPSTREAM, 3); });
+        double shared = nsPerOp(t, OPS, [] { sharedCounter.fetch_add(3, std::memory_order_relaxed); });
+        std::fprintf(out, "%-8d %16.2f %16.2f %16.2f\n", t, off, on, shared);
+    }
+
+    int originPort = 0, proxyPort = 0, adminPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    SOCKET proxy = listenLoopback(proxyPort);
+    closesocket(listenLoopback(adminPort));
+    std::thread(acceptLoop, origin, originConnection).detach();
+    std::thread(acceptLoop, proxy, handleClient).detach();
+
+    int failures = 0;
+    setMetricsEnabled(false);
+    requestsPerSec(threads, perThread / 4, proxyPort, originPort, failures); // warm-up
+    double off = requestsPerSec(threads, perThread, proxyPort, originPort, failures);
+    bool ok = failures == 0;
+
+    // A handler from the run above may still be unwinding; with metrics on by
+    // then, its decrement of the active gauge would count and its increment not.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ok = ok && startMetricsServer("127.0.0.1", adminPort);
+    int64_t allowedBefore = metricValue(M_REQ_ALLOWED);
+    double on = requestsPerSec(threads, perThread, proxyPort, originPort, failures);
+    ok = ok && failures == 0;
+
+    // handleClient() may still be unwinding after the client has read the response.
+    std::string body;
+    for (int i = 0; i < 100; i++) {
+        SOCKET s = connectLoopback(adminPort);
+        const char req[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        sendAll(s, req, sizeof(req) - 1);
+        body = readAll(s);
+        closesocket(s);
+        if (scrapeValue(body, "proxy_active_connections") == 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    long long allowed = scrapeValue(body, "proxy_requests_total{outcome=\"allowed\"}");
+    long long active = scrapeValue(body, "proxy_active_connections");
+    ok = ok && allowed - allowedBefore == (long long)threads * perThread && active == 0;
+
+    // A client that connects and never sends a request must not stall the
+    // next scrape until its receive timeout runs out.
+    SOCKET silent = connectLoopback(adminPort);
+    auto s0 = std::chrono::steady_clock::now();
+    SOCKET s = connectLoopback(adminPort);
+    const char req[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    sendAll(s, req, sizeof(req) - 1);
+    std::string scrape = readAll(s);
+    closesocket(s);
+    double scrapeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s0).count();
+    closesocket(silent);
+    bool notStalled = scrape.compare(0, 12, "HTTP/1.1 200") == 0 && scrapeMs < 1000;
+    ok = ok && notStalled;
+
+    // With the process out of descriptors, the admin accept() fails on a
+    // waiting client. Once descriptors are free again that client, and the
+    // endpoint, must still be served. A blocked accept() holds a descriptor
+    // in reserve, so the first client gets through and only the next call
+    // fails; both client sockets exist before the table is filled.
+    bool survivesEmfile = true;
+#ifndef _WIN32
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    rlimit tight = limit;
+    tight.rlim_cur = 256;
+    sockaddr_in admin{};
+    admin.sin_family = AF_INET;
+    admin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    admin.sin_port = htons((unsigned short)adminPort);
+    SOCKET first = socket(AF_INET, SOCK_STREAM, 0);
+    SOCKET waiting = socket(AF_INET, SOCK_STREAM, 0);
+    std::vector<int> fillers;
+    if (limit.rlim_cur > 256 && setrlimit(RLIMIT_NOFILE, &tight) == 0) {
+        for (int fd; (fd = dup(0)) >= 0;) fillers.push_back(fd);
+        connect(first, (sockaddr*)&admin, sizeof(admin));
+        connect(waiting, (sockaddr*)&admin, sizeof(admin));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        for (int fd : fillers) close(fd);
+        setrlimit(RLIMIT_NOFILE, &limit);
+        setSocketTimeout(waiting, 3000);
+        sendAll(waiting, req, sizeof(req) - 1);
+        std::string late = readAll(waiting);
+        survivesEmfile = late.compare(0, 12, "HTTP/1.1 200") == 0;
+    }
+    closesocket(first);
+    closesocket(waiting);
+    ok = ok && survivesEmfile;
+#endif
+
+    std::fprintf(out, "%-24s %12s\n", "handleClient", "req/s");
+    std::fprintf(out, "%-24s %12.0f\n", "metrics off", off);
+    std::fprintf(out, "%-24s %12.0f  (%+.1f%%)\n", "metrics on", on, (on - off) / off * 100);
+    std::fprintf(out, "scraped allowed=%lld (expected %lld), active=%lld\n", allowed - allowedBefore,
+                 (long long)threads * perThread, active);
+    std::fprintf(out, "scrape behind a silent client: %.0f ms (%s)\n", scrapeMs, notStalled ? "OK" : "STALLED");
+    std::fprintf(out, "scrape after running out of descriptors: %s\n", survivesEmfile ? "OK" : "FAILED");
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
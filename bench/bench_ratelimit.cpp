@@ -0,0 +1,203 @@
+/**
+ * @file bench_ratelimit.cpp
+ * @brief Per-client rate limiting check: connection-rate and concurrency
+ *        buckets, subnet rules, idle expiry, 429s from the accept path and
+ *        byte throttling through the proxy, plus admit/release cost.
+ *
+ * Usage: bench_ratelimit [distinct addresses for the cost run, default 100000]
+ * Exits non-zero if any limit lets through more (or less) than it should.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/RateLimit.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+static const long long BODY = 1 << 20;
+
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (readHeaders(s, head)) {
+        std::string resp = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(BODY) + "\r\n\r\n";
+        resp.append((size_t)BODY, 'r');
+        sendAll(s, resp.c_str(), (int)resp.size());
+    }
+    closesocket(s);
+}
+
+// The accept path from main.cpp: refuse over-limit clients before a thread exists.
+static void limitedAcceptLoop(SOCKET listener) {
+    while (true) {
+        sockaddr_in peer{};
+        socklen_t len = sizeof(peer);
+        SOCKET c = accept(listener, (sockaddr*)&peer, &len);
+        if (c == INVALID_SOCKET) return;
+        uint32_t ip = ntohl(peer.sin_addr.s_addr);
+        if (clientAdmit(ip) != RATE_ALLOW) {
+            rejectClient(c, HTTP_429);
+            continue;
+        }
+        std::thread([c, ip] {
+            handleClient(c);
+            clientRelease(ip);
+        }).detach();
+    }
+}
+
+static int admitted(uint32_t ip, int attempts, bool release) {
+    int n = 0;
+    for (int i = 0; i < attempts; i++) {
+        if (clientAdmit(ip) != RATE_ALLOW) continue;
+        n++;
+        if (release) clientRelease(ip);
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    int distinct = argc > 1 ? std::atoi(argv[1]) : 100000;
+    benchSocketsInit();
+    out = benchQuietStdout();
+    const uint32_t CLIENT = 0xC0A80117; // 192.168.1.23
+
+    // New-connection rate: the burst goes through at once, then tokens trickle in.
+    RateLimitConfig cfg;
+    cfg.defaults.connPerSec = 10;
+    cfg.defaults.connBurst = 10;
+    initRateLimit(cfg);
+    int burst = admitted(CLIENT, 50, true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    int refilled = admitted(CLIENT, 50, true);
+    std::fprintf(out, "conn_rate=10 burst=10: %d of 50 at once, %d more after 300 ms\n", burst, refilled);
+    expect(burst == 10 && refilled >= 2 && refilled <= 4, "new-connection bucket admits the burst, then 10/s");
+
+    // Concurrency cap, with slots coming back on release.
+    cfg = RateLimitConfig();
+    cfg.defaults.maxConcurrent = 5;
+    initRateLimit(cfg);
+    int held = admitted(CLIENT, 6, false);
+    clientRelease(CLIENT);
+    bool again = clientAdmit(CLIENT) == RATE_ALLOW;
+    expect(held == 5 && again, "concurrent=5 refuses the sixth open connection until one closes");
+
+    // Subnet rules: longest prefix wins, unlisted fields inherit, exempt ranges keep no state.
+    std::filesystem::path rules = std::filesystem::temp_directory_path() / "bench_ratelimit_rules.txt";
+    {
+        std::ofstream f(rules);
+        f << "# test rules\n10.0.0.0/8 concurrent=2\n10.1.0.0/16 concurrent=4\n\n127.0.0.0/8 concurrent=0\n";
+    }
+    cfg = RateLimitConfig();
+    cfg.defaults.maxConcurrent = 3;
+    cfg.rulesPath = rules.string();
+    bool parsed = initRateLimit(cfg);
+    int wide = admitted(0x0A020304, 10, false);   // 10.2.3.4
+    int narrow = admitted(0x0A010203, 10, false); // 10.1.2.3
+    int other = admitted(0xC0A80101, 10, false);  // 192.168.1.1
+    int exempt = admitted(0x7F000001, 1000, false);
+    std::fprintf(out, "subnets: 10/8 %d, 10.1/16 %d, default %d, 127/8 %d of 1000 (tracked %llu)\n", wide, narrow,
+                 other, exempt, (unsigned long long)rateLimitStats().tracked);
+    expect(parsed && wide == 2 && narrow == 4 && other == 3 && exempt == 1000 && rateLimitStats().tracked == 3,
+           "subnet rules apply by longest prefix");
+    {
+        std::ofstream f(rules);
+        f << "10.0.0.0/33 concurrent=2\n";
+    }
+    expect(!initRateLimit(cfg), "a malformed rule is reported");
+    std::filesystem::remove(rules);
+
+    // Idle expiry: addresses with nothing open disappear after idleMs.
+    cfg = RateLimitConfig();
+    cfg.defaults.connPerSec = 1000;
+    cfg.idleMs = 100;
+    initRateLimit(cfg);
+    for (uint32_t i = 0; i < 10000; i++) admitted(0x0B000000 + i, 1, true);
+    uint64_t before = rateLimitStats().tracked;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100)); // one sweep interval
+    for (uint32_t i = 0; i < 2000; i++) admitted(0x0C000000 + i * 7919, 1, true);
+    uint64_t after = rateLimitStats().tracked;
+    std::fprintf(out, "idle expiry: %llu tracked, %llu after 1.1 s and 2000 new clients\n",
+                 (unsigned long long)before, (unsigned long long)after);
+    expect(before == 10000 && after <= 2000, "idle clients are expired");
+
+    // Admit/release cost across many addresses.
+    cfg = RateLimitConfig();
+    cfg.defaults.connPerSec = 1e9;
+    cfg.defaults.maxConcurrent = 1000;
+    initRateLimit(cfg);
+    const int ROUNDS = 5;
+    for (int threads : { 1, 4 }) {
+        auto t0 = Clock::now();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) {
+            pool.emplace_back([=] {
+                for (int r = 0; r < ROUNDS; r++) {
+                    for (int i = t; i < distinct; i += threads) admitted(0x0D000000 + (uint32_t)i, 1, true);
+                }
+            });
+        }
+        for (auto& th : pool) th.join();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / ((double)distinct * ROUNDS);
+        std::fprintf(out, "admit+release, %d distinct clients, %d thread%s: %.1f ns/op\n", distinct, threads,
+                     threads == 1 ? "" : "s", ns);
+    }
+
+    // Through the proxy: 429s from the accept path, then byte throttling.
+    int originPort = 0, proxyPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(limitedAcceptLoop, proxy).detach();
+    std::string req = "GET http://127.0.0.1:" + std::to_string(originPort) + "/ HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(originPort) + "\r\n\r\n";
+
+    cfg = RateLimitConfig();
+    cfg.defaults.maxConcurrent = 2;
+    initRateLimit(cfg);
+    std::vector<SOCKET> idle = { connectLoopback(proxyPort), connectLoopback(proxyPort) };
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    SOCKET extra = connectLoopback(proxyPort);
+    sendAll(extra, req.c_str(), (int)req.size());
+    std::string refused = readAll(extra);
+    closesocket(extra);
+    for (SOCKET s : idle) closesocket(s);
+    expect(refused.compare(0, 12, "HTTP/1.1 429") == 0, "third concurrent connection gets a 429 from the accept path");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const double KB_RATE = 256;
+    cfg = RateLimitConfig();
+    cfg.defaults.bytesPerSec = KB_RATE * 1024;
+    cfg.defaults.bytesBurst = 64 * 1024;
+    initRateLimit(cfg);
+    auto t0 = Clock::now();
+    SOCKET s = connectLoopback(proxyPort);
+    sendAll(s, req.c_str(), (int)req.size());
+    std::string body = readAll(s);
+    closesocket(s);
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    double kbps = (double)body.size() / 1024 / secs;
+    std::fprintf(out, "kb_rate=%.0f: %zu bytes in %.2f s = %.0f KB/s, throttled %llu ms\n", KB_RATE, body.size(), secs,
+                 kbps, (unsigned long long)rateLimitStats().throttledMs);
+    expect(body.size() > (size_t)BODY && kbps > KB_RATE * 0.75 && kbps < KB_RATE * 1.25,
+           "byte limit holds a 1 MiB download to the configured rate");
+
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,213 @@
+/**
+ * @file bench_relay.cpp
+ * @brief Relay buffer sizing: fixed 16 KB reads against adaptive 4-64 KB
+ *        reads (with and without matched socket buffers), on small API
+ *        responses, bulk downloads and a mix of both.
+ *
+ * Usage: bench_relay [seconds per small/mixed run, default 2] [bulk MB per download, default 64]
+ * The proxy (threaded handler) and an origin run in-process on loopback. A
+ * sampler adds up the pooled buffer bytes held every millisecond. Exits
+ * non-zero if a response is cut short, adaptive sizing holds more buffer
+ * memory than fixed on small responses, or its bulk throughput falls more
+ * than 10% short of fixed.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/BufferPool.h"
+#include "BenchUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+static const size_t SMALL_BYTES = 1024;
+static size_t bulkBytes = 64u << 20;
+static int originPort = 0;
+static int proxyPort = 0;
+
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (readHeaders(s, head)) {
+        bool bulk = head.find("/bulk") != std::string::npos;
+        size_t len = bulk ? bulkBytes : SMALL_BYTES;
+        std::string resp = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(len) + "\r\nConnection: close\r\n\r\n";
+        sendAll(s, resp.data(), (int)resp.size());
+        static const std::string chunk(256 << 10, 'x');
+        for (size_t sent = 0; sent < len;) {
+            int n = (int)std::min(chunk.size(), len - sent);
+            if (sendAll(s, chunk.data(), n) == SOCKET_ERROR) break;
+            sent += (size_t)n;
+        }
+    }
+    closesocket(s);
+}
+
+// Body bytes of one proxied GET, or -1 if the response was cut short.
+static long long fetch(const char* path, size_t want) {
+    SOCKET s = connectLoopback(proxyPort);
+    if (s == INVALID_SOCKET) return -1;
+    std::string req = "GET http://127.0.0.1:" + std::to_string(originPort) + path + " HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(originPort) + "\r\n\r\n";
+    sendAll(s, req.data(), (int)req.size());
+    std::string head;
+    long long body = -1;
+    if (readHeaders(s, head)) {
+        body = 0;
+        char buf[65536];
+        int n;
+        while ((n = recv(s, buf, sizeof(buf), 0)) > 0) body += n;
+    }
+    closesocket(s);
+    return body == (long long)want ? body : -1;
+}
+
+static uint64_t heldBytes() {
+    BufferPoolStats b = bufferPoolStats();
+    uint64_t held = 0;
+    for (int c = 0; c < BUF_CLASS_COUNT; c++) held += b.classes[c].inUse * bufferClassSize((BufferClass)c);
+    return held;
+}
+
+struct Phase {
+    double smallRps = 0;
+    double bulkMBps = 0;
+    double avgHeldKb = 0;
+    double peakHeldKb = 0;
+    bool intact = true;
+};
+
+// Runs `smallClients` request loops for `seconds` (or until the bulk
+// downloads finish, if any) while sampling held buffer memory.
+static Phase runPhase(int smallClients, int bulkClients, double seconds) {
+    Phase p;
+    std::atomic<bool> stop{false};
+    std::atomic<long long> smallDone{0};
+    std::atomic<bool> broken{false};
+    std::atomic<long long> bulkDone{0};
+
+    double sum = 0;
+    long samples = 0;
+    uint64_t peak = 0;
+    std::thread sampler([&] {
+        while (!stop) {
+            uint64_t h = heldBytes();
+            sum += (double)h;
+            samples++;
+            peak = std::max(peak, h);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    auto t0 = Clock::now();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < smallClients; i++) {
+        clients.emplace_back([&] {
+            while (!stop) {
+                if (fetch("/small", SMALL_BYTES) < 0) broken = true;
+                else smallDone++;
+            }
+        });
+    }
+    std::vector<std::thread> bulk;
+    for (int i = 0; i < bulkClients; i++) {
+        bulk.emplace_back([&] {
+            long long n = fetch("/bulk", bulkBytes);
+            if (n < 0) broken = true;
+            else bulkDone += n;
+        });
+    }
+    if (bulkClients > 0) {
+        for (auto& t : bulk) t.join();
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds((long)(seconds * 1000)));
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+    stop = true;
+    for (auto& t : clients) t.join();
+    sampler.join();
+
+    p.smallRps = smallDone / elapsed;
+    p.bulkMBps = bulkDone / elapsed / (1 << 20);
+    p.avgHeldKb = samples ? sum / samples / 1024 : 0;
+    p.peakHeldKb = peak / 1024.0;
+    p.intact = !broken;
+    return p;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    bulkBytes = (size_t)(argc > 2 ? std::atol(argv[2]) : 64) << 20;
+    benchSocketsInit();
+    out = benchQuietStdout();
+
+    SOCKET origin = listenLoopback(originPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, proxy, handleClient).detach();
+
+    struct Mode {
+        const char* name;
+        bool adaptive;
+        bool tune;
+    };
+    const Mode modes[] = {
+        { "fixed 16 KB", false, false },
+        { "adaptive", true, false },
+        { "adaptive+sockbuf", true, true },
+    };
+    const int SMALL_CLIENTS = 8, BULK_CLIENTS = 2;
+    Phase small[3], bulk[3], mixed[3];
+    uint64_t grows[3];
+    for (int m = 0; m < 3; m++) {
+        RelayBufferConfig cfg;
+        cfg.adaptive = modes[m].adaptive;
+        cfg.tuneSocketBuffers = modes[m].tune;
+        initRelayBuffers(cfg);
+        uint64_t g0 = bufferPoolStats().relayGrows;
+        small[m] = runPhase(SMALL_CLIENTS, 0, seconds);
+        bulk[m] = runPhase(0, BULK_CLIENTS, seconds);
+        mixed[m] = runPhase(SMALL_CLIENTS, BULK_CLIENTS, seconds);
+        grows[m] = bufferPoolStats().relayGrows - g0;
+    }
+
+    std::fprintf(out, "%-17s %-7s %12s %10s %14s %14s\n", "mode", "load", "small req/s", "bulk MB/s", "avg held KiB",
+                 "peak held KiB");
+    for (int m = 0; m < 3; m++) {
+        const Phase* phases[3] = { &small[m], &bulk[m], &mixed[m] };
+        const char* loads[3] = { "small", "bulk", "mixed" };
+        for (int i = 0; i < 3; i++) {
+            const Phase& p = *phases[i];
+            std::fprintf(out, "%-17s %-7s %12.0f %10.1f %14.1f %14.1f\n", i == 0 ? modes[m].name : "", loads[i],
+                         p.smallRps, p.bulkMBps, p.avgHeldKb, p.peakHeldKb);
+        }
+    }
+    std::fprintf(out, "relay buffer grows: fixed %llu, adaptive %llu, adaptive+sockbuf %llu\n\n",
+                 (unsigned long long)grows[0], (unsigned long long)grows[1], (unsigned long long)grows[2]);
+
+    bool intact = true;
+    for (int m = 0; m < 3; m++) intact = intact && small[m].intact && bulk[m].intact && mixed[m].intact;
+    expect(intact, "every response arrives whole in every mode");
+    expect(small[1].avgHeldKb < small[0].avgHeldKb, "adaptive buffers hold less memory on small responses");
+    expect(bulk[1].bulkMBps >= 0.9 * bulk[0].bulkMBps, "adaptive bulk throughput within 10% of fixed or better");
+    expect(grows[0] == 0 && grows[1] > 0, "only adaptive buffers grow");
+
+    closesocket(proxy);
+    closesocket(origin);
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+/**
+ * @file bench_shaping.cpp
+ * @brief Bandwidth shaping check: cost of the disabled hook, fairness and
+ *        interactive latency under deficit round robin with mixed bulk and
+ *        small flows, and CONNECT tunnels held to the global cap through
+ *        the proxy while small GETs still get through.
+ *
+ * Usage: bench_shaping [seconds per run, default 2]
+ * Exits non-zero if the cap is not held, bulk flows are not treated evenly,
+ * or small transfers queue behind bulk ones.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/Shaper.h"
+#include "BenchUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+static double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(q * (double)v.size()))];
+}
+
+static double jain(const std::vector<double>& x) {
+    double sum = 0, sq = 0;
+    for (double v : x) {
+        sum += v;
+        sq += v * v;
+    }
+    return sq > 0 ? sum * sum / ((double)x.size() * sq) : 0;
+}
+
+struct MixResult {
+    std::vector<double> bulkMiBps;
+    double totalMiBps = 0;
+    std::vector<double> smallWaitUs;
+};
+
+// Bulk flows ask for 32 KiB chunks back to back (a tunnel relaying a download);
+// one small flow asks for 2 KiB every 10 ms (an interactive request).
+static MixResult mix(int bulkFlows, double seconds) {
+    MixResult r;
+    std::atomic<bool> stop{false};
+    std::vector<long long> bytes(bulkFlows, 0);
+    std::vector<std::thread> pool;
+    auto t0 = Clock::now();
+    for (int i = 0; i < bulkFlows; i++) {
+        pool.emplace_back([&, i] {
+            ShapedFlow flow;
+            while (!stop) {
+                shapeBytes(flow, 32768);
+                bytes[i] += 32768;
+            }
+        });
+    }
+    ShapedFlow small;
+    while (Clock::now() - t0 < std::chrono::duration<double>(seconds)) {
+        auto s = Clock::now();
+        shapeBytes(small, 2048);
+        r.smallWaitUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - s).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stop = true;
+    for (auto& t : pool) t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    for (long long b : bytes) {
+        r.bulkMiBps.push_back((double)b / secs / (1 << 20));
+        r.totalMiBps += r.bulkMiBps.back();
+    }
+    return r;
+}
+
+static void sinkConnection(SOCKET s) {
+    char buf[65536];
+    while (recv(s, buf, sizeof(buf), 0) > 0) {}
+    closesocket(s);
+}
+
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (readHeaders(s, head)) {
+        std::string resp = "HTTP/1.1 200 OK\r\nContent-Length: 4096\r\n\r\n" + std::string(4096, 'i');
+        sendAll(s, resp.c_str(), (int)resp.size());
+    }
+    closesocket(s);
+}
+
+struct ProxyRun {
+    double tunnelMiBps = 0;
+    std::vector<double> getMs;
+};
+
+// Three CONNECT tunnels push bytes as fast as they can while a client issues
+// small GETs through the same proxy.
+static ProxyRun throughProxy(int proxyPort, int sinkPort, int originPort, double seconds) {
+    ProxyRun r;
+    std::atomic<bool> stop{false};
+    std::atomic<long long> sent{0};
+    std::vector<std::thread> tunnels;
+    for (int i = 0; i < 3; i++) {
+        tunnels.emplace_back([&] {
+            SOCKET s = connectLoopback(proxyPort);
+            std::string target = "127.0.0.1:" + std::to_string(sinkPort);
+            std::string req = "CONNECT " + target + " HTTP/1.1\r\nHost: " + target + "\r\n\r\n";
+            sendAll(s, req.c_str(), (int)req.size());
+            std::string head;
+            if (!readHeaders(s, head)) return;
+            std::string chunk(65536, 'b');
+            while (!stop && sendAll(s, chunk.c_str(), (int)chunk.size()) != SOCKET_ERROR) sent += (long long)chunk.size();
+            closesocket(s);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // let the tunnels saturate the cap
+    long long base = sent;
+    auto t0 = Clock::now();
+    std::string get = "GET http://127.0.0.1:" + std::to_string(originPort) + "/ HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(originPort) + "\r\n\r\n";
+    while (Clock::now() - t0 < std::chrono::duration<double>(seconds)) {
+        auto s0 = Clock::now();
+        SOCKET s = connectLoopback(proxyPort);
+        sendAll(s, get.c_str(), (int)get.size());
+        std::string resp = readAll(s);
+        closesocket(s);
+        if (resp.size() >= 4096) r.getMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - s0).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    r.tunnelMiBps = (double)(sent - base) / secs / (1 << 20);
+    stop = true;
+    for (auto& t : tunnels) t.join();
+    return r;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2;
+    benchSocketsInit();
+    out = benchQuietStdout();
+
+    // Disabled: the hook must cost no more than a predictable branch. The
+    // compiler barrier makes every iteration reload the flag, as a relay loop
+    // with a recv() between calls would.
+    initShaper(ShaperConfig());
+    const long long CALLS = 100000000;
+    ShapedFlow idle;
+    auto t0 = Clock::now();
+    for (long long i = 0; i < CALLS; i++) std::atomic_signal_fence(std::memory_order_seq_cst);
+    double emptyNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / CALLS;
+    t0 = Clock::now();
+    for (long long i = 0; i < CALLS; i++) {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        shapeBytes(idle, 32768);
+    }
+    double offNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / CALLS - emptyNs;
+    std::fprintf(out, "disabled shapeBytes: %.2f ns/call over an empty loop\n", offNs);
+    expect(offNs < 2.0, "disabled shaping costs a branch per chunk");
+
+    // Fairness: four bulk flows and one small flow share 16 MiB/s. In a FIFO
+    // the small request would queue behind one 32 KiB chunk per bulk flow;
+    // with DRR it waits for at most one quantum per flow.
+    const double CAP = 16.0;
+    const int BULK = 4;
+    ShaperConfig fair;
+    fair.bytesPerSec = CAP * (1 << 20);
+    fair.quantum = 8192;
+    initShaper(fair);
+    MixResult drr = mix(BULK, seconds);
+    double fifoUs = BULK * 32768.0 / fair.bytesPerSec * 1e6;
+    double roundUs = BULK * (double)fair.quantum / fair.bytesPerSec * 1e6;
+    std::fprintf(out, "\n%d bulk flows + 1 small flow, %.0f MiB/s cap, 8 KiB quantum\n", BULK, CAP);
+    std::fprintf(out, "  total %.2f MiB/s, per flow %.2f..%.2f MiB/s, Jain index %.3f\n", drr.totalMiBps,
+                 *std::min_element(drr.bulkMiBps.begin(), drr.bulkMiBps.end()),
+                 *std::max_element(drr.bulkMiBps.begin(), drr.bulkMiBps.end()), jain(drr.bulkMiBps));
+    std::fprintf(out, "  small flow wait p50 %.0f us, p99 %.0f us (one DRR round %.0f us, FIFO behind chunks %.0f us)\n",
+                 percentile(drr.smallWaitUs, 0.5), percentile(drr.smallWaitUs, 0.99), roundUs, fifoUs);
+    expect(drr.totalMiBps > CAP * 0.9 && drr.totalMiBps < CAP * 1.05, "bulk flows together stay at the 16 MiB/s cap");
+    expect(jain(drr.bulkMiBps) > 0.95, "bulk flows get equal shares (Jain index > 0.95)");
+    expect(percentile(drr.smallWaitUs, 0.99) < fifoUs, "small transfers wait less than they would behind whole bulk chunks");
+
+    // Through the proxy: tunnels at full speed, then capped at 32 MiB/s.
+    int sinkPort = 0, originPort = 0, proxyPort = 0;
+    SOCKET sink = listenLoopback(sinkPort);
+    std::thread(acceptLoop, sink, sinkConnection).detach();
+    SOCKET origin = listenLoopback(originPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, proxy, handleClient).detach();
+
+    std::fprintf(out, "\n%-16s %12s %10s %10s %10s\n", "proxy", "tunnel MiB/s", "GETs", "GET p50 ms", "GET p99 ms");
+    initShaper(ShaperConfig());
+    ProxyRun unshaped = throughProxy(proxyPort, sinkPort, originPort, seconds);
+    ShaperConfig cfg;
+    cfg.bytesPerSec = 32.0 * (1 << 20);
+    initShaper(cfg);
+    ProxyRun shaped = throughProxy(proxyPort, sinkPort, originPort, seconds);
+    std::fprintf(out, "%-16s %12.1f %10zu %10.2f %10.2f\n", "shaping off", unshaped.tunnelMiBps, unshaped.getMs.size(),
+                 percentile(unshaped.getMs, 0.5), percentile(unshaped.getMs, 0.99));
+    std::fprintf(out, "%-16s %12.1f %10zu %10.2f %10.2f\n", "32 MiB/s cap", shaped.tunnelMiBps, shaped.getMs.size(),
+                 percentile(shaped.getMs, 0.5), percentile(shaped.getMs, 0.99));
+    expect(shaped.tunnelMiBps < 32 * 1.1 && shaped.tunnelMiBps > 32 * 0.7, "tunnels are held to the global cap");
+    expect(!shaped.getMs.empty() && percentile(shaped.getMs, 0.99) < 100, "small GETs still complete promptly under the cap");
+
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
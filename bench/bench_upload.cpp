@@ -0,0 +1,161 @@
+/**
+ * @file bench_upload.cpp
+ * @brief Upload streaming check: pushes multi-GB request bodies through
+ *        handleClient() to a local sink origin and verifies that every byte
+ *        arrives while the process' peak RSS stays flat.
+ *
+ * Usage: bench_upload [MiB per upload, default 2048]
+ * Exits non-zero if a byte count mismatches or memory grows with upload size.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/Framing.h"
+#include "BenchUtil.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <strings.h>
+#else
+#define strncasecmp _strnicmp
+#endif
+
+static bool hasHeader(const std::string& headers, const char* needle) {
+    for (size_t i = 0; i + std::strlen(needle) <= headers.size(); i++) {
+        if (strncasecmp(headers.c_str() + i, needle, std::strlen(needle)) == 0) return true;
+    }
+    return false;
+}
+
+// Sink origin: swallows the body (honouring 100-continue) and answers with the byte count.
+static void originConnection(SOCKET s) {
+    std::string headers;
+    if (!readHeaders(s, headers)) { closesocket(s); return; }
+    if (hasHeader(headers, "Expect: 100-continue")) {
+        const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        sendAll(s, cont, sizeof(cont) - 1);
+    }
+
+    bool chunked = hasHeader(headers, "Transfer-Encoding: chunked");
+    long long remaining = 0;
+    size_t clPos = headers.find("Content-Length: ");
+    if (clPos != std::string::npos) remaining = std::atoll(headers.c_str() + clPos + 16);
+
+    ChunkedDecoder decoder;
+    unsigned long long received = 0;
+    static thread_local char buffer[65536];
+    while (chunked ? !decoder.done() : remaining > 0) {
+        int n = recv(s, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        if (chunked) {
+            decoder.feed(buffer, (size_t)n);
+        } else {
+            remaining -= n;
+            received += (unsigned long long)n;
+        }
+    }
+    if (chunked) received = decoder.payloadBytes();
+
+    std::string count = std::to_string(received);
+    std::string resp = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(count.size()) +
+                       "\r\nConnection: close\r\n\r\n" + count;
+    sendAll(s, resp.c_str(), (int)resp.size());
+    closesocket(s);
+}
+
+enum Mode { CONTENT_LENGTH, CHUNKED, EXPECT_CONTINUE };
+
+// Returns the byte count the origin reported, or -1 on protocol failure.
+static long long upload(int proxyPort, int originPort, Mode mode, unsigned long long bytes) {
+    SOCKET s = connectLoopback(proxyPort);
+    if (s == INVALID_SOCKET) return -1;
+
+    std::string head = "POST http://127.0.0.1:" + std::to_string(originPort) + "/upload HTTP/1.1\r\n"
+                       "Host: 127.0.0.1:" + std::to_string(originPort) + "\r\n";
+    if (mode == CHUNKED) {
+        head += "Transfer-Encoding: chunked\r\n";
+    } else {
+        head += "Content-Length: " + std::to_string(bytes) + "\r\n";
+    }
+    if (mode == EXPECT_CONTINUE) head += "Expect: 100-continue\r\n";
+    head += "\r\n";
+    sendAll(s, head.c_str(), (int)head.size());
+
+    std::string interim;
+    if (mode == EXPECT_CONTINUE) {
+        if (!readHeaders(s, interim) || interim.compare(0, 12, "HTTP/1.1 100") != 0) {
+            closesocket(s);
+            return -1;
+        }
+    }
+
+    static char payload[65536];
+    std::memset(payload, 'x', sizeof(payload));
+    unsigned long long sent = 0;
+    while (sent < bytes) {
+        size_t n = (bytes - sent) < sizeof(payload) ? (size_t)(bytes - sent) : sizeof(payload);
+        if (mode == CHUNKED) {
+            char size[32];
+            int len = std::snprintf(size, sizeof(size), "%zx\r\n", n);
+            IoSlice parts[3] = { { size, (size_t)len }, { payload, n }, { "\r\n", 2 } };
+            if (sendAllv(s, parts, 3) == SOCKET_ERROR) break;
+        } else if (sendAll(s, payload, (int)n) == SOCKET_ERROR) {
+            break;
+        }
+        sent += n;
+    }
+    if (mode == CHUNKED) sendAll(s, "0\r\nX-Trailer: done\r\n\r\n", 23);
+
+    std::string response = readAll(s);
+    closesocket(s);
+
+    size_t bodyPos = response.find("\r\n\r\n");
+    if (response.compare(0, 12, "HTTP/1.1 200") != 0 || bodyPos == std::string::npos) return -1;
+    return std::atoll(response.c_str() + bodyPos + 4);
+}
+
+int main(int argc, char** argv) {
+    unsigned long long mib = argc > 1 ? std::strtoull(argv[1], NULL, 10) : 2048;
+    unsigned long long bytes = mib << 20;
+
+    benchSocketsInit();
+    int originPort = 0, proxyPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    std::thread(acceptLoop, proxy, handleClient).detach();
+
+    // Warm-up so thread stacks and buffers are already counted in the baseline.
+    upload(proxyPort, originPort, CONTENT_LENGTH, 4 << 20);
+    upload(proxyPort, originPort, CHUNKED, 4 << 20);
+    long baseline = peakRssKb();
+
+    struct Case { const char* name; Mode mode; } cases[] = {
+        { "content-length", CONTENT_LENGTH },
+        { "chunked", CHUNKED },
+        { "expect-100", EXPECT_CONTINUE },
+    };
+
+    bool ok = true;
+    std::printf("%-16s %12s %12s %10s\n", "mode", "MiB", "MiB/s", "result");
+    for (const Case& c : cases) {
+        auto t0 = std::chrono::steady_clock::now();
+        long long got = upload(proxyPort, originPort, c.mode, bytes);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        bool pass = got == (long long)bytes;
+        ok = ok && pass;
+        std::printf("%-16s %12llu %12.1f %10s\n", c.name, mib, (double)mib / secs, pass ? "OK" : "MISMATCH");
+    }
+
+    long growth = peakRssKb() - baseline;
+    std::printf("peak RSS growth: %ld KiB\n", growth);
+    if (growth > 16 * 1024) {
+        std::printf("FAIL: memory grew with upload size\n");
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+/**
+ * @file bench_workers.cpp
+ * @brief Worker pool against thread-per-connection: raw dispatch rate,
+ *        proxied connection setup rate, and memory per held connection.
+ *
+ * Usage: bench_workers [seconds per rate run, default 3] [held connections, default 1000]
+ * Exits non-zero if a proxied request fails, the pool dispatches slower than
+ * std::thread creation, proxied connections/s drop by more than 10%, or a
+ * held connection costs more address space on the pool than on its own thread,
+ * or if a PoolThread that cannot get a thread runs its task on the caller.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/WorkerPool.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* out = stdout;
+static bool ok = true;
+
+static void expect(bool cond, const char* what) {
+    std::fprintf(out, "[%s] %s\n", cond ? "PASS" : "FAIL", what);
+    ok = ok && cond;
+}
+
+static double secondsSince(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Current (not peak) values, so each phase can be measured on its own.
+static long statusKb(const char* field) {
+#ifdef _WIN32
+    (void)field;
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t len = std::strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, len, field) == 0) return std::atol(line.c_str() + len);
+    }
+    return 0;
+#endif
+}
+
+static void originConnection(SOCKET s) {
+    std::string head;
+    if (readHeaders(s, head)) {
+        const char resp[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+        sendAll(s, resp, sizeof(resp) - 1);
+    }
+    closesocket(s);
+}
+
+// The proxy's accept loop, in either dispatch model.
+static bool pooled = false;
+
+static void proxyAcceptLoop(SOCKET listener) {
+    while (true) {
+        SOCKET c = accept(listener, NULL, NULL);
+        if (c == INVALID_SOCKET) return;
+        if (pooled) poolSubmit([c] { handleClient(c); });
+        else std::thread(handleClient, c).detach();
+    }
+}
+
+// Empty tasks: what creating a thread costs against queueing to a worker.
+static double dispatchRate(size_t tasks) {
+    std::atomic<size_t> finished{0};
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < tasks; i++) {
+        auto task = [&finished] { finished.fetch_add(1, std::memory_order_relaxed); };
+        if (pooled) poolSubmit(task);
+        else std::thread(task).detach();
+    }
+    while (finished.load(std::memory_order_relaxed) < tasks) std::this_thread::yield();
+    return (double)tasks / secondsSince(t0);
+}
+
+// Closed loop, one short GET per connection, `clients` at a time.
+static double connectionRate(int proxyPort, int originPort, int clients, double seconds, size_t& failures) {
+    std::string req = "GET http://127.0.0.1:" + std::to_string(originPort) + "/ HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(originPort) + "\r\n\r\n";
+    std::atomic<size_t> done{0}, failed{0};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    auto t0 = Clock::now();
+    for (int i = 0; i < clients; i++) {
+        workers.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                SOCKET s = connectLoopback(proxyPort);
+                bool good = s != INVALID_SOCKET && sendAll(s, req.c_str(), (int)req.size()) != SOCKET_ERROR;
+                if (good) {
+                    std::string reply = readAll(s);
+                    good = reply.compare(0, 12, "HTTP/1.1 200") == 0 && reply.size() >= 2 &&
+                           reply.compare(reply.size() - 2, 2, "ok") == 0;
+                }
+                if (s != INVALID_SOCKET) closesocket(s);
+                (good ? done : failed).fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds((long long)(seconds * 1000)));
+    stop = true;
+    for (auto& t : workers) t.join();
+    failures = failed.load();
+    return (double)done.load() / secondsSince(t0);
+}
+
+struct Held {
+    double rssKb = 0;
+    double vmKb = 0;
+};
+
+// Connections that never send a request keep their handler parked in recv().
+static Held holdConnections(int proxyPort, int count) {
+    long rss0 = statusKb("VmRSS:"), vm0 = statusKb("VmSize:");
+    std::vector<SOCKET> held;
+    for (int i = 0; i < count; i++) {
+        SOCKET s = connectLoopback(proxyPort);
+        if (s != INVALID_SOCKET) held.push_back(s);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // let every handler start
+    Held h;
+    h.rssKb = (double)(statusKb("VmRSS:") - rss0) / (double)std::max<size_t>(held.size(), 1);
+    h.vmKb = (double)(statusKb("VmSize:") - vm0) / (double)std::max<size_t>(held.size(), 1);
+    for (SOCKET s : held) closesocket(s);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // and every handler finish
+    return h;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 3;
+    int holdCount = argc > 2 ? std::atoi(argv[2]) : 1000;
+    benchSocketsInit();
+    out = benchQuietStdout();
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    int originPort = 0, proxyPort = 0;
+    SOCKET origin = listenLoopback(originPort);
+    std::thread(acceptLoop, origin, originConnection).detach();
+    SOCKET proxy = listenLoopback(proxyPort);
+    std::thread(proxyAcceptLoop, proxy).detach();
+
+    WorkerPoolConfig cfg;
+    cfg.threads = 16;
+    cfg.maxThreads = holdCount + 64;
+    initWorkerPool(cfg);
+
+    const size_t tasks = 50000;
+    const int clients = 8;
+    double rate[2], conns[2];
+    size_t failures[2];
+    Held held[2];
+    for (int mode = 0; mode < 2; mode++) {
+        pooled = mode == 1;
+        // Memory first, while the pool still has only its initial workers,
+        // so the held connections pay for the workers they make it grow.
+        held[mode] = holdConnections(proxyPort, holdCount);
+        rate[mode] = dispatchRate(tasks);
+        conns[mode] = connectionRate(proxyPort, originPort, clients, seconds, failures[mode]);
+    }
+
+    std::fprintf(out, "%-22s %14s %14s %10s %16s %16s\n", "model", "tasks/s", "conns/s", "failed", "RSS KiB/held",
+                 "VM KiB/held");
+    const char* names[2] = { "thread per conn", "worker pool" };
+    for (int mode = 0; mode < 2; mode++) {
+        std::fprintf(out, "%-22s %14.0f %14.0f %10zu %16.1f %16.1f\n", names[mode], rate[mode], conns[mode],
+                     failures[mode], held[mode].rssKb, held[mode].vmKb);
+    }
+    WorkerPoolStats stats = workerPoolStats();
+    std::fprintf(out, "pool: %llu workers (%llu spawned beyond 16), %llu tasks, %llu stolen\n\n",
+                 (unsigned long long)stats.workers, (unsigned long long)stats.spawned,
+                 (unsigned long long)stats.executed, (unsigned long long)stats.stolen);
+
+    expect(failures[0] == 0 && failures[1] == 0 && conns[0] > 0 && conns[1] > 0,
+           "every proxied request completes in both models");
+    expect(rate[1] > rate[0], "queueing to a worker beats creating a thread");
+    expect(conns[1] > 0.9 * conns[0], "proxied connection setup rate is at least as good with the pool (within 10%)");
+    expect(held[1].vmKb < held[0].vmKb, "a held connection reserves less address space on a pool worker");
+
+#ifndef _WIN32
+    // Every worker busy and no address space for another stack: the task must
+    // not run on the caller, which would serialize it with what waits for it.
+    std::atomic<bool> release{false};
+    std::atomic<int> parked{0};
+    int busy = (int)workerPoolStats().idle;
+    for (int i = 0; i < busy; i++) {
+        poolSubmit([&] {
+            parked++;
+            while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+    while (parked < busy || workerPoolStats().idle > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    rlimit limit{};
+    getrlimit(RLIMIT_AS, &limit);
+    rlimit tight = limit;
+    tight.rlim_cur = (rlim_t)statusKb("VmSize:") * 1024 + (64u << 10);
+    std::atomic<bool> ranOnCaller{false};
+    std::thread::id caller = std::this_thread::get_id();
+    bool started = true;
+    if (setrlimit(RLIMIT_AS, &tight) == 0) {
+        PoolThread t([&] { ranOnCaller = std::this_thread::get_id() == caller; });
+        started = t.joinable();
+        setrlimit(RLIMIT_AS, &limit);
+        if (started) t.join();
+    }
+    release = true;
+    expect(!started && !ranOnCaller, "a PoolThread without a thread reports it instead of running inline");
+#endif
+
+    std::fprintf(out, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,312 @@
+/**
+ * @file loadgen.cpp
+ * @brief Multi-threaded load generator that drives the proxy over loopback.
+ *
+ * Workloads (pick one):
+ *   --path <target path>          GET http://<target><path> through the proxy (default /fixed/1024)
+ *   --upload <bytes>              POST /upload with a Content-Length body
+ *   --connect <host:port>         CONNECT tunnel, send --tunnel-bytes opaque bytes to an
+ *                                 origin_server sink and check the echoed count
+ * Arrival models:
+ *   --mode closed --concurrency C   C workers, each sends its next request when the last finishes
+ *   --mode open --rate R [--threads T]  requests scheduled at R/s; latency is measured from the
+ *                                   scheduled start, so a stalled proxy is not hidden
+ *                                   (no coordinated omission)
+ * Other flags: --proxy host:port (127.0.0.1:8888), --target host:port (127.0.0.1:9000),
+ *   --duration <s> (10), --requests <n> (stop early), --label <name>,
+ *   --json <file|-> (append one JSON object per run for regression tracking).
+ * Byte throughput counts everything sent and received on the client sockets.
+ * A 503 or 429 from the proxy is counted as "rejected", with its own latency
+ * histogram, so shed requests neither hide nor flatter the admitted ones.
+ *
+ * Exit status is non-zero if any request failed.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/Latency.h"
+#include "BenchUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string proxyHost = "127.0.0.1";
+    int proxyPort = 8888;
+    std::string target = "127.0.0.1:9000";
+    std::string path = "/fixed/1024";
+    std::string connectTarget;
+    long long tunnelBytes = 65536;
+    long long uploadBytes = -1;
+    bool open = false;
+    int concurrency = 16;
+    double rate = 1000;
+    int threads = 64;
+    double duration = 10;
+    long long maxRequests = 0;
+    std::string label;
+    std::string json;
+};
+
+enum Outcome { OK, ERR_CONNECT, ERR_STATUS, ERR_SHORT, REJECTED, OUTCOME_COUNT };
+
+struct WorkerStats {
+    LatencyHistogram latency; // everything but rejections
+    LatencyHistogram rejectLatency;
+    long long outcomes[OUTCOME_COUNT] = {};
+    long long bytes = 0;
+};
+
+static char payload[65536];
+
+static bool splitHostPort(const std::string& s, std::string& host, int& port) {
+    size_t colon = s.rfind(':');
+    if (colon == std::string::npos) return false;
+    host = s.substr(0, colon);
+    port = std::atoi(s.c_str() + colon + 1);
+    return port > 0;
+}
+
+static SOCKET connectTo(const std::string& host, int port) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+static bool sendPayload(SOCKET s, long long bytes) {
+    while (bytes > 0) {
+        int n = bytes < (long long)sizeof(payload) ? (int)bytes : (int)sizeof(payload);
+        if (sendAll(s, payload, n) == SOCKET_ERROR) return false;
+        bytes -= n;
+    }
+    return true;
+}
+
+static bool refusal(const std::string& head) {
+    return head.compare(0, 12, "HTTP/1.1 503") == 0 || head.compare(0, 12, "HTTP/1.1 429") == 0;
+}
+
+// Reads the whole response; checks the status and, when present, Content-Length.
+static Outcome readResponse(SOCKET s, long long& bytes, const char* expectBody) {
+    std::string head;
+    char buf[65536];
+    long long body = 0;
+    size_t headEnd = std::string::npos;
+    std::string bodyStart;
+    int n;
+    while ((n = recv(s, buf, sizeof(buf), 0)) > 0) {
+        bytes += n;
+        if (headEnd == std::string::npos) {
+            head.append(buf, n);
+            headEnd = head.find("\r\n\r\n");
+            if (headEnd != std::string::npos) {
+                body = (long long)(head.size() - headEnd - 4);
+                bodyStart = head.substr(headEnd + 4, 64);
+                head.resize(headEnd + 4);
+            }
+        } else {
+            body += n;
+        }
+    }
+    if (headEnd == std::string::npos) return ERR_SHORT;
+    if (refusal(head)) return REJECTED;
+    if (head.compare(0, 9, "HTTP/1.1 ") != 0 || head.compare(9, 1, "2") != 0) return ERR_STATUS;
+    size_t cl = head.find("Content-Length: ");
+    if (cl != std::string::npos && std::atoll(head.c_str() + cl + 16) != body) return ERR_SHORT;
+    if (expectBody && bodyStart != expectBody) return ERR_SHORT;
+    return OK;
+}
+
+static Outcome runOne(const Options& o, const std::string& request, long long& bytes) {
+    SOCKET s = connectTo(o.proxyHost, o.proxyPort);
+    if (s == INVALID_SOCKET) return ERR_CONNECT;
+    setSocketTimeout(s, 30000);
+    Outcome result = OK;
+    if (sendAll(s, request.c_str(), (int)request.size()) == SOCKET_ERROR) {
+        closesocket(s);
+        return ERR_SHORT;
+    }
+    bytes += (long long)request.size();
+    if (!o.connectTarget.empty()) {
+        // Tunnel: 200 from the proxy, opaque bytes to the sink, then its count back.
+        std::string established;
+        if (!readHeaders(s, established) || established.size() < 12 || established.compare(9, 3, "200") != 0) {
+            result = refusal(established) ? REJECTED : ERR_STATUS;
+        } else {
+            bytes += (long long)established.size();
+            bool sent = sendPayload(s, o.tunnelBytes);
+            shutdown(s, SD_SEND);
+            std::string echoed = readAll(s);
+            bytes += o.tunnelBytes + (long long)echoed.size();
+            if (!sent || std::atoll(echoed.c_str()) != o.tunnelBytes) result = ERR_SHORT;
+        }
+    } else {
+        if (o.uploadBytes > 0) {
+            if (sendPayload(s, o.uploadBytes)) bytes += o.uploadBytes;
+            else result = ERR_SHORT;
+        }
+        std::string expect = o.uploadBytes >= 0 ? std::to_string(o.uploadBytes) : std::string();
+        if (result == OK) result = readResponse(s, bytes, o.uploadBytes >= 0 ? expect.c_str() : nullptr);
+    }
+    closesocket(s);
+    return result;
+}
+
+static std::string buildRequest(const Options& o) {
+    if (!o.connectTarget.empty()) {
+        return "CONNECT " + o.connectTarget + " HTTP/1.1\r\nHost: " + o.connectTarget + "\r\n\r\n";
+    }
+    if (o.uploadBytes >= 0) {
+        return "POST http://" + o.target + "/upload HTTP/1.1\r\nHost: " + o.target +
+               "\r\nContent-Length: " + std::to_string(o.uploadBytes) + "\r\n\r\n";
+    }
+    return "GET http://" + o.target + o.path + " HTTP/1.1\r\nHost: " + o.target + "\r\n\r\n";
+}
+
+static std::string workloadName(const Options& o) {
+    if (!o.connectTarget.empty()) return "connect:" + std::to_string(o.tunnelBytes);
+    if (o.uploadBytes >= 0) return "upload:" + std::to_string(o.uploadBytes);
+    return "get:" + o.path;
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string key = argv[i], value = argv[i + 1];
+        if (key == "--proxy") splitHostPort(value, o.proxyHost, o.proxyPort);
+        else if (key == "--target") o.target = value;
+        else if (key == "--path") o.path = value;
+        else if (key == "--connect") o.connectTarget = value;
+        else if (key == "--tunnel-bytes") o.tunnelBytes = std::atoll(value.c_str());
+        else if (key == "--upload") o.uploadBytes = std::atoll(value.c_str());
+        else if (key == "--mode") o.open = value == "open";
+        else if (key == "--concurrency") o.concurrency = std::max(1, std::atoi(value.c_str()));
+        else if (key == "--rate") o.rate = std::atof(value.c_str());
+        else if (key == "--threads") o.threads = std::max(1, std::atoi(value.c_str()));
+        else if (key == "--duration") o.duration = std::atof(value.c_str());
+        else if (key == "--requests") o.maxRequests = std::atoll(value.c_str());
+        else if (key == "--label") o.label = value;
+        else if (key == "--json") o.json = value;
+        else {
+            std::fprintf(stderr, "unknown option %s\n", key.c_str());
+            return 2;
+        }
+    }
+    if (o.open && o.rate <= 0) {
+        std::fprintf(stderr, "--rate must be positive in open mode\n");
+        return 2;
+    }
+
+    benchSocketsInit();
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    std::memset(payload, 'x', sizeof(payload));
+    const std::string request = buildRequest(o);
+
+    int workers = o.open ? o.threads : o.concurrency;
+    std::vector<std::unique_ptr<WorkerStats>> stats;
+    for (int w = 0; w < workers; w++) stats.emplace_back(new WorkerStats());
+    std::atomic<long long> issued{0};
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::microseconds((long long)(o.duration * 1e6));
+
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; w++) {
+        pool.emplace_back([&, w] {
+            WorkerStats& st = *stats[w];
+            while (true) {
+                long long i = issued++;
+                if (o.maxRequests > 0 && i >= o.maxRequests) break;
+                Clock::time_point t0 = Clock::now();
+                if (o.open) {
+                    // Open loop: request i is due at start + i/rate whether or not we are keeping up.
+                    Clock::time_point due = start + std::chrono::nanoseconds((long long)(i * 1e9 / o.rate));
+                    if (due >= end) break;
+                    std::this_thread::sleep_until(due);
+                    t0 = due;
+                } else if (t0 >= end) {
+                    break;
+                }
+                Outcome r = runOne(o, request, st.bytes);
+                st.outcomes[r]++;
+                (r == REJECTED ? st.rejectLatency : st.latency).record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+            }
+        });
+    }
+    for (auto& t : pool) t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    LatencySnapshot lat, rejectLat;
+    long long outcomes[OUTCOME_COUNT] = {};
+    long long bytes = 0;
+    for (const auto& st : stats) {
+        lat.add(st->latency);
+        rejectLat.add(st->rejectLatency);
+        for (int k = 0; k < OUTCOME_COUNT; k++) outcomes[k] += st->outcomes[k];
+        bytes += st->bytes;
+    }
+    long long total = (long long)(lat.count + rejectLat.count);
+    long long errors = total - outcomes[OK];
+    double rps = total / secs;
+    double mibps = bytes / secs / (1 << 20);
+    auto us = [&](double q) { return lat.percentile(q) / 1e3; };
+
+    std::printf("[LOADGEN] %s %s via %s:%d, %s %d, %.1f s\n", workloadName(o).c_str(),
+                o.connectTarget.empty() ? o.target.c_str() : o.connectTarget.c_str(), o.proxyHost.c_str(),
+                o.proxyPort, o.open ? "open-loop threads" : "closed-loop concurrency", workers, secs);
+    if (o.open) std::printf("          target rate %.0f req/s\n", o.rate);
+    std::printf("          requests %lld, errors %lld (connect %lld, status %lld, short %lld, rejected %lld)\n", total,
+                errors, outcomes[ERR_CONNECT], outcomes[ERR_STATUS], outcomes[ERR_SHORT], outcomes[REJECTED]);
+    std::printf("          throughput %.1f req/s, %.2f MiB/s\n", rps, mibps);
+    std::printf("          latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  mean %.1f\n", us(0.5),
+                us(0.9), us(0.99), us(0.999), lat.max / 1e3, lat.count ? lat.sum / 1e3 / lat.count : 0.0);
+    if (rejectLat.count) {
+        std::printf("          rejected latency us: p50 %.1f  p99 %.1f\n", rejectLat.percentile(0.5) / 1e3,
+                    rejectLat.percentile(0.99) / 1e3);
+    }
+
+    if (!o.json.empty()) {
+        char line[1024];
+        std::snprintf(line, sizeof(line),
+                      "{\"label\":\"%s\",\"workload\":\"%s\",\"mode\":\"%s\",\"workers\":%d,\"rate\":%.1f,"
+                      "\"duration_s\":%.3f,\"requests\":%lld,\"errors\":%lld,\"errors_connect\":%lld,"
+                      "\"errors_status\":%lld,\"errors_short\":%lld,\"errors_rejected\":%lld,\"throughput_rps\":%.1f,"
+                      "\"throughput_mib_s\":%.3f,"
+                      "\"latency_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f,\"mean\":%.1f},"
+                      "\"rejected_latency_us\":{\"p50\":%.1f,\"p99\":%.1f}}\n",
+                      o.label.c_str(), workloadName(o).c_str(), o.open ? "open" : "closed", workers,
+                      o.open ? o.rate : 0.0, secs, total, errors, outcomes[ERR_CONNECT], outcomes[ERR_STATUS],
+                      outcomes[ERR_SHORT], outcomes[REJECTED], rps, mibps, us(0.5), us(0.9), us(0.99), us(0.999),
+                      lat.max / 1e3, lat.count ? lat.sum / 1e3 / lat.count : 0.0, rejectLat.percentile(0.5) / 1e3,
+                      rejectLat.percentile(0.99) / 1e3);
+        if (o.json == "-") {
+            std::fputs(line, stdout);
+        } else {
+            FILE* f = std::fopen(o.json.c_str(), "a");
+            if (!f) {
+                std::fprintf(stderr, "could not open %s\n", o.json.c_str());
+                return 2;
+            }
+            std::fputs(line, f);
+            std::fclose(f);
+        }
+    }
+    return errors == 0 && total > 0 ? 0 : 1;
+}
\ No newline at end of file
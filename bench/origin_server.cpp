@@ -0,0 +1,219 @@
+/**
+ * @file origin_server.cpp
+ * @brief Configurable local origin for driving the proxy without the internet.
+ *
+ * HTTP routes (one request per connection, like the proxy):
+ *   GET  /fixed/<bytes>                       Content-Length body
+ *   GET  /chunked/<bytes>[?chunk=<size>]      chunked body (default 8192-byte chunks)
+ *   GET  /slow/<ms>/<bytes>                   waits <ms> before the head, then a fixed body
+ *   GET  /stream/<bytes>[?piece=<n>&interval=<ms>]  close-delimited body trickled out
+ *   GET  /conflict/<bytes>                    two Content-Length headers that disagree
+ *   POST /upload                              swallows the body, answers with its size
+ * Any route accepts ?cache=<seconds> to send Cache-Control: max-age instead of no-store.
+ *
+ * The sink port stands in for a TLS server behind CONNECT: it reads opaque
+ * bytes until the client half-closes, then answers with the decimal count.
+ *
+ * Usage: origin_server [--port 9000] [--sink-port 9001] [--address 127.0.0.1]
+ */
+
+#include "../include/ProxyCore.h"
+#include "../include/Framing.h"
+#include "BenchUtil.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static char payload[65536];
+
+static long long queryInt(const std::string& target, const char* key, long long def) {
+    size_t q = target.find('?');
+    if (q == std::string::npos) return def;
+    std::string needle = std::string(key) + "=";
+    size_t pos = target.find(needle, q);
+    if (pos == std::string::npos || (target[pos - 1] != '?' && target[pos - 1] != '&')) return def;
+    return std::atoll(target.c_str() + pos + needle.size());
+}
+
+// Reads the request head; `extra` receives any body bytes that came with it.
+static bool readRequest(SOCKET s, std::string& head, std::string& extra) {
+    char buf[4096];
+    while (true) {
+        size_t end = head.find("\r\n\r\n");
+        if (end != std::string::npos) {
+            extra = head.substr(end + 4);
+            head.resize(end + 4);
+            return true;
+        }
+        if (head.size() > 65536) return false;
+        int n = recv(s, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        head.append(buf, n);
+    }
+}
+
+static bool sendBody(SOCKET s, long long bytes) {
+    while (bytes > 0) {
+        int n = bytes < (long long)sizeof(payload) ? (int)bytes : (int)sizeof(payload);
+        if (sendAll(s, payload, n) == SOCKET_ERROR) return false;
+        bytes -= n;
+    }
+    return true;
+}
+
+static void respond(SOCKET s, const char* status, const std::string& headers, const std::string& body) {
+    std::string resp = std::string("HTTP/1.1 ") + status + "\r\n" + headers + "Content-Length: " +
+                       std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    sendAll(s, resp.c_str(), (int)resp.size());
+}
+
+static void httpConnection(SOCKET s) {
+    std::string head, extra;
+    if (!readRequest(s, head, extra)) { closesocket(s); return; }
+    size_t sp1 = head.find(' ');
+    size_t sp2 = head.find(' ', sp1 + 1);
+    std::string method = head.substr(0, sp1);
+    std::string target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+    // Absolute-form targets arrive when a client talks to the origin directly through a proxy.
+    if (target.compare(0, 7, "http://") == 0) {
+        size_t slash = target.find('/', 7);
+        target = slash == std::string::npos ? "/" : target.substr(slash);
+    }
+
+    long long cache = queryInt(target, "cache", -1);
+    std::string common = cache >= 0 ? "Cache-Control: max-age=" + std::to_string(cache) + "\r\n"
+                                    : std::string("Cache-Control: no-store\r\n");
+    common += "Content-Type: application/octet-stream\r\n";
+
+    if (method == "POST" && target.compare(0, 7, "/upload") == 0) {
+        std::string value;
+        bool chunked = findHeader(head.data(), head.size(), "Transfer-Encoding", value) && value == "chunked";
+        long long remaining = findHeader(head.data(), head.size(), "Content-Length", value) ? std::atoll(value.c_str()) : 0;
+        ChunkedDecoder decoder;
+        long long received = 0;
+        char buf[65536];
+        const char* data = extra.data();
+        int n = (int)extra.size();
+        while (true) {
+            if (chunked) {
+                decoder.feed(data, (size_t)n);
+                if (decoder.done() || decoder.failed()) break;
+            } else {
+                received += n;
+                if (received >= remaining) break;
+            }
+            n = recv(s, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            data = buf;
+        }
+        if (chunked) received = (long long)decoder.payloadBytes();
+        respond(s, "200 OK", common, std::to_string(received));
+    } else if (method == "GET" && target.compare(0, 7, "/fixed/") == 0) {
+        long long bytes = std::atoll(target.c_str() + 7);
+        std::string resp = "HTTP/1.1 200 OK\r\n" + common + "Content-Length: " + std::to_string(bytes) +
+                           "\r\nConnection: close\r\n\r\n";
+        if (sendAll(s, resp.c_str(), (int)resp.size()) != SOCKET_ERROR) sendBody(s, bytes);
+    } else if (method == "GET" && target.compare(0, 9, "/chunked/") == 0) {
+        long long bytes = std::atoll(target.c_str() + 9);
+        long long chunk = queryInt(target, "chunk", 8192);
+        if (chunk <= 0 || chunk > (long long)sizeof(payload)) chunk = 8192;
+        std::string resp = "HTTP/1.1 200 OK\r\n" + common + "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n";
+        bool ok = sendAll(s, resp.c_str(), (int)resp.size()) != SOCKET_ERROR;
+        while (ok && bytes > 0) {
+            size_t n = (size_t)(bytes < chunk ? bytes : chunk);
+            char size[32];
+            int len = std::snprintf(size, sizeof(size), "%zx\r\n", n);
+            IoSlice parts[3] = { { size, (size_t)len }, { payload, n }, { "\r\n", 2 } };
+            ok = sendAllv(s, parts, 3) != SOCKET_ERROR;
+            bytes -= (long long)n;
+        }
+        if (ok) sendAll(s, "0\r\n\r\n", 5);
+    } else if (method == "GET" && target.compare(0, 10, "/conflict/") == 0) {
+        long long bytes = std::atoll(target.c_str() + 10);
+        std::string resp = "HTTP/1.1 200 OK\r\n" + common + "Content-Length: " + std::to_string(bytes) +
+                           "\r\nContent-Length: " + std::to_string(bytes + 1) + "\r\nConnection: close\r\n\r\n";
+        if (sendAll(s, resp.c_str(), (int)resp.size()) != SOCKET_ERROR) sendBody(s, bytes + 1);
+    } else if (method == "GET" && target.compare(0, 6, "/slow/") == 0) {
+        long long ms = std::atoll(target.c_str() + 6);
+        size_t slash = target.find('/', 6);
+        long long bytes = slash == std::string::npos ? 0 : std::atoll(target.c_str() + slash + 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        std::string resp = "HTTP/1.1 200 OK\r\n" + common + "Content-Length: " + std::to_string(bytes) +
+                           "\r\nConnection: close\r\n\r\n";
+        if (sendAll(s, resp.c_str(), (int)resp.size()) != SOCKET_ERROR) sendBody(s, bytes);
+    } else if (method == "GET" && target.compare(0, 8, "/stream/") == 0) {
+        long long bytes = std::atoll(target.c_str() + 8);
+        long long piece = queryInt(target, "piece", 1024);
+        long long interval = queryInt(target, "interval", 10);
+        if (piece <= 0 || piece > (long long)sizeof(payload)) piece = 1024;
+        std::string resp = "HTTP/1.1 200 OK\r\n" + common + "Connection: close\r\n\r\n";
+        bool ok = sendAll(s, resp.c_str(), (int)resp.size()) != SOCKET_ERROR;
+        while (ok && bytes > 0) {
+            int n = (int)(bytes < piece ? bytes : piece);
+            ok = sendAll(s, payload, n) != SOCKET_ERROR;
+            bytes -= n;
+            if (bytes > 0) std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        }
+    } else {
+        respond(s, "404 Not Found", "", "");
+    }
+    closesocket(s);
+}
+
+static void sinkConnection(SOCKET s) {
+    char buf[65536];
+    long long received = 0;
+    int n;
+    while ((n = recv(s, buf, sizeof(buf), 0)) > 0) received += n;
+    std::string count = std::to_string(received);
+    sendAll(s, count.c_str(), (int)count.size());
+    closesocket(s);
+}
+
+static SOCKET listenOn(const std::string& address, int port) {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1 ||
+        bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR || listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+int main(int argc, char** argv) {
+    std::string address = "127.0.0.1";
+    int port = 9000, sinkPort = 9001;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string key = argv[i];
+        if (key == "--port") port = std::atoi(argv[i + 1]);
+        else if (key == "--sink-port") sinkPort = std::atoi(argv[i + 1]);
+        else if (key == "--address") address = argv[i + 1];
+    }
+
+    benchSocketsInit();
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    std::memset(payload, 'x', sizeof(payload));
+
+    SOCKET http = listenOn(address, port);
+    SOCKET sink = listenOn(address, sinkPort);
+    if (http == INVALID_SOCKET || sink == INVALID_SOCKET) {
+        std::fprintf(stderr, "[FATAL] Could not listen on %s:%d / %d\n", address.c_str(), port, sinkPort);
+        return 1;
+    }
+    std::printf("[ORIGIN] http on %s:%d, CONNECT sink on %s:%d\n", address.c_str(), port, address.c_str(), sinkPort);
+    std::fflush(stdout);
+    std::thread(acceptLoop, sink, sinkConnection).detach();
+    acceptLoop(http, httpConnection);
+    return 0;
+}
\ No newline at end of file
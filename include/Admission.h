@@ -0,0 +1,62 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <cstdint>
+
+// Admission control at the listener. Every accepted connection is checked
+// before a thread is spent on it:
+//   - at most `maxConnections` handlers run at once;
+//   - while connections wait too long to be picked up, a growing share of new
+//     ones is shed. The signal is dispatch delay (accept() to handler start),
+//     which rises once the box is out of CPU or threads. As in CoDel, the
+//     minimum over each `shedIntervalMs` window is compared with the target:
+//     one noisy sample does not start shedding, and a standing queue does.
+//     Each window above target raises the shed ratio by 10 points (max 95%);
+//     each window below halves it. A window in which no handler started is
+//     judged by the age of the oldest connection still queued, or leaves the
+//     ratio alone when none is.
+// Refused connections get a canned 503 from the accept loop. Separately, at
+// most `maxConnecting` upstream connects may be in flight; a request over
+// that cap gets a 503 instead of queueing behind a slow DNS or SYN.
+//
+// A value of 0 disables that limit.
+
+struct AdmissionConfig {
+    int maxConnections = 0;
+    int maxConnecting = 0;
+    int shedTargetMs = 0;
+    int shedIntervalMs = 100;
+};
+
+enum AdmitVerdict { ADMIT_OK, ADMIT_FULL, ADMIT_SHED };
+
+struct AdmissionStats {
+    uint64_t active = 0;          // admitted connections still open
+    uint64_t connecting = 0;      // upstream connects in flight
+    uint64_t rejectedFull = 0;
+    uint64_t rejectedShed = 0;
+    uint64_t rejectedConnect = 0;
+    double shedRatio = 0;
+    uint64_t windowMinDelayUs = 0; // last completed window's minimum dispatch delay
+};
+
+void initAdmission(const AdmissionConfig& config);
+bool admissionEnabled();
+
+// Called by the accept loop with latencyNow(). ADMIT_OK takes a slot that must
+// be returned with admissionRelease().
+AdmitVerdict admitConnection(uint64_t nowNs);
+// Called when an admitted connection is handed to a worker, thread or event
+// loop, then first thing on the handler with the same accept timestamp.
+void admissionQueued(uint64_t acceptedNs);
+void admissionDispatched(uint64_t acceptedNs, uint64_t nowNs);
+void admissionRelease();
+
+// False when the in-flight connect cap is reached; true must be paired with
+// upstreamConnectEnd().
+bool upstreamConnectBegin();
+void upstreamConnectEnd();
+
+AdmissionStats admissionStats();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+
+// Memory for one request. The head, the parsed fields and anything else that
+// lives exactly as long as the request are std::pmr containers on this
+// resource: allocation bumps a pointer through blocks taken from the buffer
+// pool, deallocation does nothing, and reset() or the destructor hands every
+// block back at once. The first block is 4 KB, which a typical request head
+// and its fields fit in; larger heads move on to 16 KB and 64 KB blocks, and
+// only a single allocation bigger than that goes to the heap. No block is
+// taken before the first allocation, so a connection still waiting for its
+// request holds none.
+class RequestArena : public std::pmr::memory_resource {
+public:
+    RequestArena() = default;
+    ~RequestArena() override { reset(); }
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    // Returns every block; whatever was allocated from the arena is gone.
+    void reset();
+
+    size_t used() const { return usedBytes; }       // bytes handed out since the last reset
+    size_t reserved() const { return reservedBytes; } // block bytes held
+
+private:
+    struct Block;
+
+    void* do_allocate(size_t bytes, size_t align) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    Block* blocks = nullptr; // newest first
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t usedBytes = 0;
+    size_t reservedBytes = 0;
+};
+
+#endif
\ No newline at end of file
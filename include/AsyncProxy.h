@@ -0,0 +1,41 @@
+#ifndef ASYNC_PROXY_H
+#define ASYNC_PROXY_H
+
+#include "Common.h"
+#include <cstdint>
+#include <functional>
+
+// Connection handler as a C++20 coroutine on a few EventLoop threads instead
+// of a blocked thread per connection. recv, send, connect and the DNS lookup
+// are co_awaited, so an idle connection holds a few hundred bytes of
+// coroutine frames rather than a stack. Connections are spread over `loops`
+// threads round robin and stay on theirs.
+//
+// The coroutine path covers the pass-through proxy: filtering, forwarding with
+// request body and response framing, CONNECT tunnels, the circuit breaker,
+// the upstream connect cap and every deadline. The memory and disk caches,
+// request collapsing, bandwidth shaping and per-client byte limits block in
+// their own code, so main() keeps the threaded handler while any of them is
+// configured. Linux only (epoll); elsewhere initAsyncHandler() reports the
+// handler as unavailable.
+
+struct AsyncConfig {
+    int loops = 0; // 0 disables the async handler
+};
+
+struct AsyncStats {
+    uint64_t loops = 0;
+    uint64_t connections = 0; // open on the loops
+    uint64_t served = 0;      // finished since startup
+};
+
+bool initAsyncHandler(const AsyncConfig& config);
+bool asyncHandlerEnabled();
+
+// Takes ownership of an accepted socket. `done` runs on the loop thread once
+// the connection is closed (admission and rate-limit release).
+void asyncServe(SOCKET clientSocket, std::function<void()> done);
+
+AsyncStats asyncStats();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Connection buffers from slabs in three size classes. Each thread keeps a
+// short free list per class; when one grows past its limit, half of it goes
+// back to a global depot as one batch, and an empty list refills with a whole
+// batch, so the depot lock is taken once per batch rather than per buffer. A
+// thread that exits hands its lists to the depot. Slabs are carved when the
+// depot runs dry and are kept for reuse, so connection churn settles into a
+// fixed set of buffers instead of fragmenting the heap.
+//
+// Buffers are meant to be held only while bytes are moving: relay loops take
+// one when a socket becomes readable and give it back when it runs dry, so an
+// idle connection holds none.
+
+enum BufferClass {
+    BUF_HEADER,   // 4 KB: request heads
+    BUF_IO,       // 16 KB: relay, body and response buffers
+    BUF_IO_LARGE, // 64 KB: bulk transfers
+    BUF_CLASS_COUNT
+};
+
+size_t bufferClassSize(BufferClass c);
+
+char* bufferAcquire(BufferClass c);
+void bufferRelease(char* p, BufferClass c);
+
+// Owns at most one pooled buffer; empty until acquire().
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    explicit PooledBuffer(BufferClass c) { acquire(c); }
+    ~PooledBuffer() { release(); }
+    PooledBuffer(PooledBuffer&& other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), cls(other.cls) {}
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            ptr = std::exchange(other.ptr, nullptr);
+            cls = other.cls;
+        }
+        return *this;
+    }
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    // Returns the buffer, taking one of class `c` if none is held.
+    char* acquire(BufferClass c) {
+        if (ptr && cls != c) release();
+        if (!ptr) {
+            ptr = bufferAcquire(c);
+            cls = c;
+        }
+        return ptr;
+    }
+    void release() {
+        if (ptr) bufferRelease(std::exchange(ptr, nullptr), cls);
+    }
+
+    explicit operator bool() const { return ptr != nullptr; }
+    char* data() const { return ptr; }
+    size_t size() const { return ptr ? bufferClassSize(cls) : 0; }
+
+private:
+    char* ptr = nullptr;
+    BufferClass cls = BUF_IO;
+};
+
+struct RelayBufferConfig {
+    bool adaptive = true;           // false: every relay read uses BUF_IO
+    bool tuneSocketBuffers = false; // set SO_RCVBUF/SO_SNDBUF to follow the read size
+};
+
+void initRelayBuffers(const RelayBufferConfig& config);
+bool relaySocketTuning();
+
+// A relay loop's buffer, sized from how full its reads come back. It starts
+// at BUF_HEADER, moves up a class after two reads in a row fill it and down
+// one after eight in a row that use under a quarter of it, so an API response
+// moves through 4 KB while a bulk transfer works up to 64 KB within a few
+// reads. The buffer itself is still released whenever the socket runs dry.
+class RelayBuffer {
+public:
+    RelayBuffer();
+
+    // The class the next read should use.
+    BufferClass sizeClass() const { return cls; }
+    // Feeds back a read of `n` bytes; true when the next read uses another class.
+    bool record(int n);
+
+    PooledBuffer pooled;
+
+private:
+    BufferClass cls;
+    int fullReads = 0;
+    int sparseReads = 0;
+};
+
+struct BufferClassStats {
+    uint64_t slabBytes = 0;   // carved from the system, never returned
+    uint64_t inUse = 0;       // buffers held by connections
+    uint64_t depot = 0;       // buffers parked in the global depot
+    uint64_t acquired = 0;    // acquisitions since startup
+    uint64_t depotFetches = 0; // thread lists refilled from the depot
+    uint64_t depotReturns = 0; // batches handed back to the depot
+};
+
+struct BufferPoolStats {
+    BufferClassStats classes[BUF_CLASS_COUNT];
+    uint64_t relayGrows = 0;   // relay buffers moved up a class
+    uint64_t relayShrinks = 0; // and down
+};
+
+BufferPoolStats bufferPoolStats();
+const char* bufferClassName(BufferClass c);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "Common.h"
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One stored response. Entries are immutable once published; a 304 refresh
+// publishes a new entry that shares the same wire bytes.
+struct CachedResponse {
+    std::shared_ptr<const std::string> wire; // origin head (Age stripped) + body
+    size_t headLen = 0;
+    int status = 0;
+    long long bodyBytes = 0;
+    time_t storedAt = 0;        // when the response (or its last 304) arrived
+    long long initialAge = 0;   // corrected age at storedAt, seconds
+    long long freshFor = 0;     // freshness lifetime, seconds (0 = always revalidate)
+    std::string etag;
+    std::string lastModified;
+    std::vector<std::pair<std::string, std::string>> vary; // request header -> value when stored
+
+    long long currentAge(time_t now) const { return initialAge + (now > storedAt ? now - storedAt : 0); }
+    bool isFresh(time_t now) const { return currentAge(now) < freshFor; }
+    bool hasValidators() const { return !etag.empty() || !lastModified.empty(); }
+};
+
+typedef std::shared_ptr<const CachedResponse> CacheEntryPtr;
+
+struct CacheStats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long evictions = 0;
+};
+
+// Freshness and storability of one response head, shared by the memory and disk tiers.
+struct CacheMeta {
+    int status = 0;
+    bool storable = false;
+    bool varies = false;      // carries a Vary header
+    long long initialAge = 0;
+    long long freshFor = 0;
+};
+
+bool cacheResponseMeta(const char* head, size_t headLen, time_t requestTime, time_t responseTime, CacheMeta& meta);
+std::string cacheKey(const HttpRequest& req);
+std::string cacheStripAge(const char* head, size_t headLen);
+
+// budgetBytes == 0 leaves the cache disabled.
+void initCache(size_t budgetBytes, size_t maxObjectBytes);
+bool cacheEnabled();
+size_t cacheMaxObjectBytes();
+
+// GET without Authorization, Range, client validators or no-store.
+bool isCacheableRequest(const HttpRequest& req);
+
+// Finds the stored variant matching req's Vary headers. `fresh` is false when
+// the entry is stale or the client asked for revalidation (no-cache, max-age).
+CacheEntryPtr cacheLookup(const HttpRequest& req, time_t now, bool& fresh);
+
+// Early check on a just-parsed response head (first bytes of `wire`): false
+// means the response can never be stored, so the caller stops capturing.
+bool cacheWorthCapturing(const std::string& wire);
+
+// Stores a complete response as captured from the origin. Returns false when
+// the response is not storable (status, Cache-Control, Vary: *, Set-Cookie...).
+bool cacheStore(const HttpRequest& req, const std::string& wire, long long bodyBytes,
+                time_t requestTime, time_t responseTime);
+
+// Applies a 304 Not Modified head to `entry` and republishes it; returns the refreshed entry.
+CacheEntryPtr cacheRefresh(const HttpRequest& req, const CacheEntryPtr& entry,
+                           const char* head, size_t headLen, time_t requestTime, time_t responseTime);
+
+// Builds "If-None-Match/If-Modified-Since" lines for revalidating `entry`.
+std::string cacheConditionalHeaders(const CachedResponse& entry);
+
+CacheStats cacheStats();
+
+#endif
\ No newline at end of file
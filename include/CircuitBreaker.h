@@ -0,0 +1,39 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Per host:port upstream health. After `failureThreshold` consecutive connect
+// failures (DNS or TCP) the breaker opens and requests fail fast with a 502
+// instead of waiting on getaddrinfo()/connect(). Once the open period has
+// passed, up to `halfOpenProbes` requests at a time are let through; a success
+// closes the breaker, a failure reopens it with the period doubled (capped).
+// An entry nobody has failed on for twice maxOpenMs is forgotten.
+
+struct CircuitBreakerConfig {
+    int failureThreshold = 5;  // 0 disables the breaker
+    int openMs = 10000;
+    int maxOpenMs = 60000;
+    int halfOpenProbes = 1;
+};
+
+struct CircuitBreakerStats {
+    uint64_t tracked = 0;    // host:port entries with recent failures
+    uint64_t open = 0;
+    uint64_t fastFails = 0;
+    uint64_t trips = 0;
+};
+
+void initCircuitBreaker(const CircuitBreakerConfig& config);
+bool circuitBreakerEnabled();
+
+// Returns false when the request must fail fast. When true and `probe` is set,
+// the caller holds one of the half-open slots and must report the outcome.
+bool upstreamAllow(std::string_view host, std::string_view port, bool& probe);
+void upstreamResult(std::string_view host, std::string_view port, bool ok, bool probe);
+
+CircuitBreakerStats circuitBreakerStats();
+
+#endif
\ No newline at end of file
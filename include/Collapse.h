@@ -0,0 +1,56 @@
+#ifndef COLLAPSE_H
+#define COLLAPSE_H
+
+#include "Common.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Collapsed forwarding: the first miss for a cacheable GET leads the upstream
+// fetch and concurrent identical requests follow it, streaming the leader's
+// response bytes as they arrive instead of opening their own connections.
+// Only responses a shared cache could store (no Vary) with a Content-Length
+// within the configured bound are shared; anything else is declined and the
+// followers fetch on their own.
+
+struct SharedFetch {
+    enum State { WAITING, STREAMING, DECLINED };
+
+    std::string key;
+    std::mutex mtx;
+    std::condition_variable cv;
+    State state = WAITING;
+    bool finished = false;
+    bool complete = false;      // leader received the whole response
+    bool awaitFinish = false;   // declined, but followers should retry the cache once the leader is done
+    std::unique_ptr<char[]> bytes; // head + body, capacity fixed at collapseStart()
+    size_t capacity = 0;
+    size_t length = 0;
+    int status = 0;
+    long long bodyBytes = 0;
+};
+
+typedef std::shared_ptr<SharedFetch> SharedFetchPtr;
+
+// timeoutMs = 0 disables collapsing.
+void initCollapse(int timeoutMs, size_t maxBytes);
+bool collapseEnabled();
+size_t collapseMaxBytes();
+
+// Joins the in-flight fetch for `key` or registers a new one; `leader` tells which.
+SharedFetchPtr collapseJoin(const std::string& key, bool& leader);
+
+// Leader side. start() fixes the size of the shared response; bytes published
+// afterwards must fit in it. decline() lets followers go their own way.
+void collapseStart(SharedFetch& fetch, int status, size_t headLen, size_t bodyLen);
+void collapsePublish(SharedFetch& fetch, const char* data, size_t len);
+void collapseDecline(SharedFetch& fetch, bool awaitFinish);
+void collapseFinish(SharedFetch& fetch, bool complete);
+
+// Follower side. Streams the leader's response to `client` and returns the
+// bytes sent, or -1 when the caller must fetch on its own (declined, leader
+// failed before the head, or nothing arrived within the timeout).
+long long collapseFollow(SOCKET client, SharedFetch& fetch, bool& complete);
+
+#endif
\ No newline at end of file
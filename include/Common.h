@@ -1,24 +1,69 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
-#include <string>
-#include <vector>
 
 #pragma comment(lib, "ws2_32.lib")
+#else
+// POSIX build: map the handful of WinSock names the proxy uses onto BSD sockets.
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR   (-1)
+#define SD_RECEIVE     SHUT_RD
+#define SD_SEND        SHUT_WR
+#define SD_BOTH        SHUT_RDWR
+#define closesocket    close
+#endif
 
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Every field allocates from the resource it was built with: the handler's
+// RequestArena on the proxy's paths, so a request's strings go in one reset.
 struct HttpRequest {
-    std::string method;
-    std::string host;
-    std::string port = "80"; 
-    std::string path;
-    std::string version;
-    std::string raw;
+    explicit HttpRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : method(mr), host(mr), port("80", mr), path(mr), version(mr), raw(mr) {}
+
+    std::pmr::string method;
+    std::pmr::string host;
+    std::pmr::string port;
+    std::pmr::string path;
+    std::pmr::string version;
+    std::pmr::string raw;
+    size_t headerLen = 0;         // bytes of raw up to and including the blank line
+    long long contentLength = -1; // -1 when no Content-Length header was sent
+    bool chunked = false;         // Transfer-Encoding ends in "chunked"
+    // Framing a server could read differently from us: Content-Length with
+    // Transfer-Encoding, either header twice, a bad length, or a coding that
+    // does not end in chunked. Answered with a 400, never forwarded.
+    bool badFraming = false;
+};
+
+// A borrowed span of bytes for scatter-gather sends. Never owns its data.
+struct IoSlice {
+    const char* data;
+    size_t len;
 };
 
+const std::string HTTP_400 = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
 const std::string HTTP_403 = "HTTP/1.1 403 Forbidden\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\nAccess Denied: Domain is blocked.";
 const std::string HTTP_200_CON = "HTTP/1.1 200 Connection Established\r\n\r\n";
 const std::string HTTP_502 = "HTTP/1.1 502 Bad Gateway\r\nConnection: close\r\n\r\n";
+const std::string HTTP_408 = "HTTP/1.1 408 Request Timeout\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+const std::string HTTP_503 = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+const std::string HTTP_429 = "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
 
 #endif
\ No newline at end of file
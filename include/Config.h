@@ -1,17 +1,121 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <map>
+#include <vector>
+
+// server.cfg, parsed once into typed fields. A file is read whole into a
+// Settings and checked: every line must be a known KEY=value, and every
+// value must parse and fall in range. Only then is it published. A published
+// Settings is never changed, so readers take a shared_ptr from
+// Config::current() and read fields with no lock and no lookup. Reloading
+// publishes a new snapshot with one pointer swap; the old one is freed once
+// the last reader still holding it lets go.
+//
+// Durations take ms, s, m or h suffixes and sizes take KB, MB or GB (K, M
+// and G also work). A bare number is in the unit the key's name gives, so
+// HEADER_TIMEOUT_MS=10000 and HEADER_TIMEOUT_MS=10s mean the same. Booleans
+// are 0/1, true/false, on/off or yes/no.
+//
+// LOG_PATH, MAX_HEADER_SIZE and FILTER_PATH are read per request and take
+// effect on reload. Everything else is handed to its module once at startup.
+// A reload keeps the running value of those and reports the key, to be
+// applied by a restart (see RESTART_SOCKET).
+
+struct Settings {
+    // Listener and per-request
+    int port = 8888;
+    std::string filterPath = "config/blocked.txt";
+    std::string logPath = "proxy.log";
+    uint64_t maxHeaderBytes = 8192;
+
+    // Caching and collapsing
+    uint64_t cacheMemoryBytes = 0;
+    uint64_t cacheMaxObjectBytes = 8192u << 10;
+    std::string cacheDiskPath;
+    uint64_t cacheDiskBytes = 1024ull << 20;
+    uint64_t cacheDiskSegmentBytes = 64u << 20;
+    int cacheDiskIndexSlots = 262144;
+    int collapseTimeoutMs = 5000;
+    uint64_t collapseMaxBytes = 8192u << 10;
+
+    // Upstream health
+    int circuitFailureThreshold = 5;
+    int circuitOpenMs = 10000;
+    int circuitMaxOpenMs = 60000;
+    int circuitHalfOpenProbes = 1;
+
+    // Per-client limits and shaping
+    int rateConnPerSec = 0;
+    int rateConnBurst = 0;
+    int rateMaxConcurrent = 0;
+    uint64_t rateBytesPerSec = 0;
+    uint64_t rateBytesBurst = 0;
+    std::string rateLimitRules;
+    int rateIdleMs = 60000;
+    uint64_t shapeBytesPerSec = 0;
+    uint64_t shapeQuantumBytes = 8u << 10;
+
+    // Deadlines and admission
+    int headerTimeoutMs = 10000;
+    int connectTimeoutMs = 10000;
+    int idleTimeoutMs = 120000;
+    int tunnelMaxLifetimeMs = 0;
+    int maxConnections = 10000;
+    int maxUpstreamConnects = 1024;
+    int shedTargetMs = 0;
+    int shedIntervalMs = 100;
+
+    // Handlers and buffers
+    int workerThreads = 64;
+    int workerMaxThreads = 10000;
+    uint64_t workerStackBytes = 256u << 10;
+    int workerIdleMs = 30000;
+    int asyncLoops = 0;
+    bool relayAdaptiveBuffers = true;
+    bool relayTuneSocketBuffers = false;
+
+    // Observability
+    bool latencyHistograms = true;
+    int latencyMergeMs = 1000;
+    std::string metricsAddress = "127.0.0.1";
+    int metricsPort = 0;
+
+    // Restart and shutdown
+    std::string restartSocket;
+    int restartDrainMs = 30000;
+    int shutdownDrainMs = 20000;
+};
 
 class Config {
 public:
-    static bool load(const std::string& filename);
-    static int getInt(const std::string& key, int defaultVal);
-    static std::string getString(const std::string& key, const std::string& defaultVal);
+    // Parses and publishes `filename`. False if it is missing (defaults stay
+    // in effect) or invalid (one message per bad line in `errors`, nothing
+    // published).
+    static bool load(const std::string& filename, std::vector<std::string>* errors = nullptr);
+
+    // Parses and checks without publishing.
+    static bool parse(const std::string& filename, Settings& out, std::vector<std::string>& errors);
+
+    // Re-reads the file load() was given. An invalid file leaves the running
+    // snapshot as it is. Keys that only apply at startup keep their running
+    // values; the changed ones are listed in `restartOnly`.
+    static bool reload(std::vector<std::string>& errors, std::vector<std::string>& restartOnly);
+
+    static std::shared_ptr<const Settings> current() {
+        std::shared_ptr<const Settings> s = snapshot.load(std::memory_order_acquire);
+        return s ? s : defaults();
+    }
+
+    static const std::string& path();
 
 private:
-    static std::map<std::string, std::string> settings;
+    static void publish(const Settings& next);
+    static const std::shared_ptr<const Settings>& defaults();
+    static std::atomic<std::shared_ptr<const Settings>> snapshot;
 };
 
 #endif
\ No newline at end of file
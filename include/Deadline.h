@@ -0,0 +1,82 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include "Common.h"
+#include "TimerWheel.h"
+#include <atomic>
+#include <cstdint>
+
+// Per-connection deadlines on one shared timing wheel. Socket timeouts apply
+// per syscall, so a client trickling a byte every few seconds never trips
+// them; these bound the whole phase instead. When a deadline passes, the
+// connection's sockets are shut down, which wakes whatever recv(), send() or
+// connect() the handler is blocked in, and its normal cleanup runs.
+//
+//   header   - the request head must be complete headerMs after accept (408)
+//   connect  - upstream connect(); the DNS lookup before it cannot be cut short
+//   idle     - no byte relayed in either direction for idleMs
+//   lifetime - CONNECT tunnels are closed tunnelMaxMs after they open
+//
+// A value of 0 disables that deadline. Recording activity is one relaxed
+// store of a coarse clock; the idle timer re-arms itself for the remainder
+// when it fires on a connection that was busy meanwhile.
+
+struct DeadlineConfig {
+    int headerMs = 10000;
+    int connectMs = 10000;
+    int idleMs = 120000;
+    int tunnelMaxMs = 0;
+    int tickMs = 10; // wheel resolution; fixed by the first initDeadlines()
+};
+
+enum DeadlineKind { DL_HEADER, DL_CONNECT, DL_IDLE, DL_LIFETIME, DL_KIND_COUNT };
+
+struct ConnDeadlines;
+
+struct DeadlineTimer {
+    TimerNode node; // first member: the wheel hands back &node
+    ConnDeadlines* owner = nullptr;
+    DeadlineKind kind = DL_HEADER;
+};
+
+// Lives on the handler's stack. Every deadline must be stopped (the
+// destructor does it) before the sockets it names are closed, so a timer
+// never shuts down a descriptor number that has been reused.
+struct ConnDeadlines {
+    SOCKET client = INVALID_SOCKET;
+    SOCKET remote = INVALID_SOCKET; // set with deadlineWatchRemote()
+    std::atomic<uint64_t> lastActivity{0};
+    DeadlineTimer timers[DL_KIND_COUNT];
+
+    explicit ConnDeadlines(SOCKET clientSocket);
+    ~ConnDeadlines();
+    ConnDeadlines(const ConnDeadlines&) = delete;
+    ConnDeadlines& operator=(const ConnDeadlines&) = delete;
+};
+
+struct DeadlineStats {
+    uint64_t armed = 0;
+    uint64_t expired[DL_KIND_COUNT] = {};
+};
+
+// Starts the wheel's ticker thread on first use; later calls only change the
+// durations.
+void initDeadlines(const DeadlineConfig& config);
+bool deadlinesEnabled();
+
+// No-ops until initDeadlines() has run, or when the kind is disabled.
+void deadlineStart(ConnDeadlines& d, DeadlineKind kind);
+void deadlineStop(ConnDeadlines& d, DeadlineKind kind);
+void deadlineStopAll(ConnDeadlines& d);
+void deadlineWatchRemote(ConnDeadlines& d, SOCKET remote);
+
+extern std::atomic<uint64_t> deadlineClockMs; // advanced by the ticker
+
+inline void deadlineTouch(ConnDeadlines* d) {
+    if (d) d->lastActivity.store(deadlineClockMs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+DeadlineStats deadlineStats();
+const char* deadlineKindName(DeadlineKind kind);
+
+#endif
\ No newline at end of file
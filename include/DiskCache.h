@@ -0,0 +1,72 @@
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include "Common.h"
+#include "Cache.h"
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+
+// Second cache tier on local disk. Responses are appended to fixed-size
+// segment files; an mmap'd open-addressing index maps URL hashes to records,
+// so both survive restarts. Hits are sent from file to socket with sendfile().
+// Eviction drops whole segments, oldest first, so files never fragment.
+// POSIX only: on Windows initDiskCache() reports the tier as unavailable.
+
+struct DiskSegment;
+
+struct DiskCacheConfig {
+    std::string dir;                  // empty disables the tier
+    uint64_t budgetBytes = 1ull << 30;
+    uint64_t segmentBytes = 64ull << 20;
+    uint32_t indexSlots = 1u << 18;
+};
+
+struct DiskCacheHit {
+    std::shared_ptr<DiskSegment> segment;
+    std::string head;        // stored head, Age stripped
+    uint64_t bodyOffset = 0; // within the segment file
+    uint64_t bodyLen = 0;
+    long long age = 0;
+    int status = 0;
+};
+
+// An in-progress store. Space is reserved up front from the Content-Length,
+// body bytes are written straight to the segment as they stream past, and the
+// index only learns about the record in diskCacheCommit(). Dropping a writer
+// without committing leaves a dead record that segment eviction reclaims.
+struct DiskCacheWriter {
+    std::shared_ptr<DiskSegment> segment;
+    std::string key;
+    uint64_t keyHash = 0;
+    uint64_t recordOffset = 0;
+    uint64_t bodyOffset = 0;
+    uint64_t bodyLen = 0;
+    uint64_t written = 0;
+    uint32_t headLen = 0;
+    bool failed = false;
+};
+
+bool initDiskCache(const DiskCacheConfig& config);
+void shutdownDiskCache();
+bool diskCacheEnabled();
+
+// Only fresh entries are returned; stale ones are left to the origin.
+bool diskCacheLookup(const HttpRequest& req, time_t now, DiskCacheHit& hit);
+long long diskCacheServe(SOCKET client, const DiskCacheHit& hit);
+
+std::unique_ptr<DiskCacheWriter> diskCacheBegin(const HttpRequest& req, const std::string& head, uint64_t bodyLen);
+bool diskCacheWrite(DiskCacheWriter& writer, const char* data, size_t len);
+void diskCacheCommit(DiskCacheWriter& writer, const CacheMeta& meta, time_t storedAt);
+
+struct DiskCacheStats {
+    uint64_t segments = 0;
+    uint64_t bytes = 0;
+    uint64_t entries = 0;
+    uint64_t hits = 0;
+    uint64_t evictedSegments = 0;
+};
+DiskCacheStats diskCacheStats();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "Common.h"
+#include "BufferPool.h"
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Single-threaded epoll executor for C++20 coroutines. A coroutine that would
+// block on a socket suspends on its IoWatch instead, and the loop resumes it
+// when the descriptor becomes ready, so a parked connection costs its frames
+// rather than a thread. Descriptors are watched edge triggered for both
+// directions at once; each direction has at most one waiter.
+//
+// Coroutine frames come from per-thread free lists in 64-byte size classes,
+// so steady-state connection churn does not reach the global allocator.
+//
+// Linux only: elsewhere EventLoop::valid() is false and callers fall back to
+// the threaded handler.
+
+void* coroFrameAlloc(size_t size);
+void coroFrameFree(void* p, size_t size);
+
+struct CoroFrameStats {
+    uint64_t live = 0;
+    uint64_t liveBytes = 0;
+    uint64_t allocated = 0; // every frame ever handed out
+    uint64_t reused = 0;    // of those, served from a free list
+};
+CoroFrameStats coroFrameStats();
+
+struct FramePooled {
+    static void* operator new(size_t size) { return coroFrameAlloc(size); }
+    static void operator delete(void* p, size_t size) { coroFrameFree(p, size); }
+};
+
+// Lazily started coroutine; co_await runs it and resumes the awaiter when it
+// finishes (symmetric transfer, so long chains do not grow the stack).
+template <typename T = void> class Task;
+
+struct TaskPromiseBase : FramePooled {
+    std::coroutine_handle<> continuation;
+
+    struct FinalAwait {
+        bool await_ready() noexcept { return false; }
+        template <typename P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            std::coroutine_handle<> next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwait final_suspend() noexcept { return {}; }
+    void unhandled_exception() { std::terminate(); } // as for an exception escaping a thread
+};
+
+template <typename T> struct TaskPromise : TaskPromiseBase {
+    T value{};
+    void return_value(T v) { value = std::move(v); }
+    T result() { return std::move(value); }
+};
+
+template <> struct TaskPromise<void> : TaskPromiseBase {
+    void return_void() {}
+    void result() {}
+};
+
+template <typename T> class Task {
+public:
+    struct promise_type : TaskPromise<T> {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task(Task&& other) noexcept : h(std::exchange(other.h, {})) {}
+    Task(const Task&) = delete;
+    ~Task() {
+        if (h) h.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        h.promise().continuation = caller;
+        return h;
+    }
+    T await_resume() { return h.promise().result(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : h(handle) {}
+    std::coroutine_handle<promise_type> h;
+};
+
+// Starts a top-level task that owns itself, like a detached thread; its frames
+// are freed when it finishes.
+void spawnDetached(Task<void> task);
+
+// Runs tasks side by side and lets one coroutine wait for all of them, like
+// joining threads. The group must outlive its tasks (await wait() before it
+// goes out of scope).
+class TaskGroup {
+public:
+    void spawn(Task<void> task);
+    bool running() const { return pending > 0; }
+    struct WaitAll {
+        TaskGroup& group;
+        bool await_ready() const noexcept { return group.pending == 0; }
+        void await_suspend(std::coroutine_handle<> h) noexcept { group.waiter = h; }
+        void await_resume() noexcept {}
+    };
+    WaitAll wait() { return WaitAll{ *this }; }
+
+private:
+    friend struct TaskRunner;
+    int pending = 0;
+    std::coroutine_handle<> waiter;
+};
+
+// One watched descriptor. Owned by the loop and recycled only after the event
+// batch that might still name it, so a stale event never lands on a freed one.
+struct IoWatch {
+    SOCKET fd = INVALID_SOCKET;
+    bool readable = true; // no EAGAIN since the last edge (optimistic at first)
+    bool writable = true;
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+};
+
+struct IoWait {
+    IoWatch& w;
+    bool write;
+    bool await_ready() const noexcept { return write ? w.writable : w.readable; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { (write ? w.writer : w.reader) = h; }
+    void await_resume() const noexcept {}
+};
+
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool valid() const { return epfd >= 0; }
+    // Dispatches events and posted work forever; call on the loop's thread.
+    void run();
+    // Thread-safe: `fn` runs on the loop thread.
+    void post(std::function<void()> fn);
+
+    // Loop thread only. watch() makes `s` non-blocking; unwatch() must come
+    // before the descriptor is closed.
+    IoWatch* watch(SOCKET s);
+    void unwatch(IoWatch* w);
+    size_t watching() const { return active; }
+
+private:
+    int epfd = -1;
+    int wakeFd = -1;
+    std::mutex postMtx;
+    std::vector<std::function<void()>> posted;
+    std::vector<IoWatch*> spare;   // free for reuse
+    std::vector<IoWatch*> retired; // unwatched during the current batch
+    size_t active = 0;
+};
+
+// Socket operations for coroutines on an EventLoop. Results follow recv() and
+// send(): bytes moved, 0 for an orderly close, negative on error.
+Task<int> asyncRecv(IoWatch& w, char* buf, int len);
+// Receives into a pooled buffer of class `c`, which is handed back to the pool
+// while the socket has nothing to read, so a waiting connection holds none.
+Task<int> asyncRecvBuffered(IoWatch& w, PooledBuffer& buf, BufferClass c);
+Task<int> asyncSendAll(IoWatch& w, const char* buf, int len);
+Task<int> asyncSendAllv(IoWatch& w, IoSlice* slices, int count);
+Task<bool> asyncConnect(IoWatch& w, const sockaddr* addr, int addrLen);
+// getaddrinfo() blocks, so it runs on a worker (or a short-lived thread) and
+// the coroutine resumes on `loop` with the first IPv4 address.
+Task<int> asyncResolve(EventLoop& loop, const char* host, const char* port, sockaddr_in& out);
+
+#endif
\ No newline at end of file
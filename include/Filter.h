@@ -2,8 +2,12 @@
 #define FILTER_H
 
 #include <string>
+#include <string_view>
 
-void loadFilters(const std::string& filename); 
-bool isBlocked(std::string host);
+// Reads the whole file into a new list and swaps it in. If the file cannot
+// be read, the list in use is kept and false is returned.
+bool loadFilters(const std::string& filename);
+bool isBlocked(std::string_view host);
+std::string normalize(std::string str);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Case-insensitive "Name:" test for one header line (no CRLF).
+bool headerNameIs(const char* line, size_t lineLen, const char* name, size_t nameLen);
+
+// Looks up header `name` in an HTTP message head (start line + header lines).
+// The value is returned with surrounding whitespace trimmed.
+bool findHeader(const char* head, size_t headLen, const char* name, std::string& value);
+
+// Steps through a comma-separated header value: sets `token` to the next
+// element with surrounding whitespace trimmed, skipping empty ones, and
+// advances `value`. False once the list is exhausted.
+bool nextListToken(const char*& value, const char* end, const char*& token, size_t& tokenLen);
+
+// True when the last transfer coding in a Transfer-Encoding value is exactly
+// "chunked" (any case); RFC 9112 6.1 lets only that one delimit the body.
+bool lastCodingIsChunked(const char* value, size_t len);
+
+// True when one element of a comma-separated header value equals `token`,
+// ignoring case; "xclose" does not match "close".
+bool headerHasToken(const char* value, size_t len, const char* token);
+
+// A Content-Length value: 1*DIGIT with optional surrounding whitespace. -1 for
+// anything else, including a sign, a suffix or a value past LLONG_MAX.
+long long parseContentLength(std::string_view v);
+
+// Incremental scanner for HTTP/1.1 chunked transfer coding. It never copies or
+// rewrites payload bytes: callers forward the input verbatim and use feed()'s
+// return value to learn where the message ends.
+class ChunkedDecoder {
+public:
+    // Consumes bytes up to the end of the chunked message; returns how many of
+    // `len` belong to it. Anything past the return value is the next message.
+    size_t feed(const char* data, size_t len);
+
+    bool done() const { return state == DONE; }
+    bool failed() const { return state == FAILED; }
+    uint64_t payloadBytes() const { return payload; }
+
+private:
+    enum State {
+        SIZE, SIZE_EXT, SIZE_LF,
+        DATA, DATA_CR, DATA_LF,
+        TRAILER_START, TRAILER_LINE, TRAILER_LF, FINAL_LF,
+        DONE, FAILED
+    };
+
+    State state = SIZE;
+    uint64_t remaining = 0;
+    uint64_t payload = 0;
+    int sizeDigits = 0;
+};
+
+// Where a request body ends: Content-Length bytes still owed upstream, or the
+// chunked scanner. Shared by the threaded and the async handler.
+struct RequestBodyFraming {
+    bool chunked = false;
+    long long remaining = 0;
+    ChunkedDecoder chunks;
+
+    bool complete() const { return chunked ? chunks.done() : remaining == 0; }
+
+    // Returns how many of `len` bytes belong to this request's body.
+    size_t consume(const char* data, size_t len) {
+        if (chunked) return chunks.feed(data, len);
+        size_t take = (long long)len < remaining ? len : (size_t)remaining;
+        remaining -= (long long)take;
+        return take;
+    }
+};
+
+// Streaming HTTP/1.1 response parser. Only the status line and headers are
+// buffered (bounded by MAX_HEAD); body bytes are counted and passed through.
+// Interim 1xx responses are consumed transparently and the parser moves on to
+// the final response, so status() always reports the final code.
+class ResponseParser {
+public:
+    enum Framing { NONE, LENGTH, CHUNKED, CLOSE };
+    static const size_t MAX_HEAD = 65536;
+
+    explicit ResponseParser(bool headRequest = false) : headRequest(headRequest) {}
+
+    // Consumes bytes up to the end of the response; returns how many of `len`
+    // belong to it. Anything past the return value belongs to the next response.
+    size_t feed(const char* data, size_t len);
+
+    // Upstream EOF: completes a close-delimited body.
+    void finishOnClose() { if (state == BODY_CLOSE) state = DONE; }
+
+    bool done() const { return state == DONE; }
+    bool failed() const { return state == FAILED; }
+    // The final head itself was unusable (bad status line, conflicting or
+    // malformed Content-Length, oversized), so no body can be delimited.
+    bool headFailed() const { return state == FAILED && statusCode == 0; }
+    int status() const { return statusCode; }
+    Framing framing() const { return bodyFraming; }
+    uint64_t bodyBytes() const { return bodyFraming == CHUNKED ? chunks.payloadBytes() : body; }
+    // Declared body size for LENGTH framing; 0 otherwise.
+    uint64_t contentLength() const { return bodyFraming == LENGTH ? body + remaining : 0; }
+    // The final response head, available once status() is non-zero.
+    const std::string& headBytes() const { return head; }
+    // True when the upstream connection may carry another request afterwards.
+    bool reusable() const { return done() && keepAlive && bodyFraming != CLOSE; }
+
+private:
+    enum State { HEAD, BODY_LENGTH, BODY_CHUNKED, BODY_CLOSE, DONE, FAILED };
+
+    void parseHead();
+
+    bool headRequest;
+    State state = HEAD;
+    std::string head;
+    int statusCode = 0;
+    Framing bodyFraming = NONE;
+    bool keepAlive = true;
+    uint64_t remaining = 0;
+    uint64_t body = 0;
+    ChunkedDecoder chunks;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,130 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// HDR-style latency histograms in nanoseconds: values below 128 ns are exact,
+// above that each power of two is split into 64 linear sub-buckets, so any
+// recorded value is reported within 1/128 (< 0.8%) of itself. Values beyond
+// ~68 s are clamped into the last bucket. Buckets live in one page per power
+// of two, allocated on the first value that lands there, so a histogram only
+// pays for the ranges it has actually seen.
+//
+// handleClient() and friends record into a per-thread slot (leased like the
+// metric slots, grown on demand) with relaxed single-writer stores; a merger
+// thread periodically folds all slots into the snapshot the admin endpoint serves.
+
+enum LatencyPhase {
+    LAT_TTFB,     // request sent upstream -> first response byte
+    LAT_DNS,      // getaddrinfo()
+    LAT_CONNECT,  // TCP connect() to the origin
+    LAT_FILTER,   // isBlocked()
+    LAT_TOTAL,    // whole handleClient() call
+    LAT_PHASE_COUNT
+};
+
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 7;
+    static const int HALF = 1 << (SUB_BITS - 1);
+    static const int MAX_BITS = 36;
+    static const int BUCKETS = (MAX_BITS - SUB_BITS + 2) * HALF;
+    static const int PAGES = BUCKETS / HALF;
+
+    struct Page {
+        std::atomic<uint64_t> counts[HALF] = {};
+    };
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    ~LatencyHistogram() {
+        for (auto& p : pages) delete p.load(std::memory_order_relaxed);
+    }
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < (1u << SUB_BITS)) return (int)ns;
+#ifdef _MSC_VER
+        unsigned long msb;
+        _BitScanReverse64(&msb, ns);
+#else
+        int msb = 63 - __builtin_clzll(ns);
+#endif
+        if ((int)msb >= MAX_BITS) return BUCKETS - 1;
+        int shift = (int)msb - (SUB_BITS - 1);
+        return shift * HALF + (int)(ns >> shift);
+    }
+    // Midpoint of the values that land in bucket `b`.
+    static uint64_t valueOf(int b) {
+        if (b < (1 << SUB_BITS)) return (uint64_t)b;
+        int shift = b / HALF - 1;
+        uint64_t low = (uint64_t)(b - shift * HALF) << shift;
+        return low + ((1ull << shift) >> 1);
+    }
+
+    // Single writer per histogram; readers may merge concurrently.
+    void record(uint64_t ns) {
+        int b = bucketOf(ns);
+        Page* page = pages[b / HALF].load(std::memory_order_acquire);
+        if (!page) {
+            page = new Page();
+            pages[b / HALF].store(page, std::memory_order_release);
+        }
+        bump(page->counts[b % HALF], 1);
+        bump(sum, ns);
+        if (ns > max.load(std::memory_order_relaxed)) max.store(ns, std::memory_order_relaxed);
+    }
+
+    // Bytes held, including the pages allocated so far.
+    size_t bytes() const {
+        size_t total = sizeof(*this);
+        for (const auto& p : pages) total += p.load(std::memory_order_relaxed) ? sizeof(Page) : 0;
+        return total;
+    }
+
+    std::atomic<Page*> pages[PAGES] = {};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+private:
+    static void bump(std::atomic<uint64_t>& v, uint64_t d) {
+        v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+    }
+};
+
+// A merged, plain copy used for reporting.
+struct LatencySnapshot {
+    std::vector<uint64_t> counts = std::vector<uint64_t>(LatencyHistogram::BUCKETS, 0);
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    void add(const LatencyHistogram& h);
+    uint64_t percentile(double q) const; // ns; 0 when empty
+};
+
+void setLatencyEnabled(bool on);
+bool latencyEnabled();
+void latencyRecord(LatencyPhase phase, uint64_t ns);
+uint64_t latencyNow(); // monotonic ns, for timing a phase
+
+// Merges every thread's slot for `phase` right now.
+LatencySnapshot latencyMerge(LatencyPhase phase);
+// Starts the background merger; latencySnapshot() then returns its latest result.
+void startLatencyMerger(int intervalMs);
+LatencySnapshot latencySnapshot(LatencyPhase phase);
+
+const char* latencyPhaseName(LatencyPhase phase);
+std::string renderLatencyMetrics();   // Prometheus summaries
+void dumpLatency(std::ostream& out);  // p50/p99/p99.9/max table
+
+#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef LIFECYCLE_H
+#define LIFECYCLE_H
+
+#include "Common.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Hot restart and draining shutdown.
+//
+// A proxy started with RESTART_SOCKET set first connects to that Unix socket.
+// If an older proxy is listening there, the listening sockets (proxy, then
+// metrics) are passed over with SCM_RIGHTS. The new process acks and starts
+// accepting on them straight away. The old one stops its accept loop, lets
+// go of the disk cache, and says so. Only then does the new process go on to
+// open the cache. Both processes share the kernel's accept queue, so a
+// client arriving during the switch waits in the backlog rather than being
+// refused.
+//
+// After the handoff the old process drains: its open connections run to
+// completion, up to `drainMs`, and then it exits. The new process binds the
+// Unix socket for the next restart. If nothing answers on the path, the
+// proxy binds its own listeners as usual.
+//
+// The accept loop waits in waitForClient(), which returns false once a stop
+// has been requested. The listener is non-blocking so that a connection the
+// other process took first cannot leave accept() stuck.
+//
+// SIGTERM and SIGINT stop the loop the same way. The proxy closes its
+// listener and drains for SHUTDOWN_DRAIN_MS, then exits. Hot restart needs
+// POSIX; the stop and drain work on Windows too, where Ctrl+C closes the
+// listener to wake accept().
+//
+// SIGHUP re-reads server.cfg. The handler only wakes a watcher thread, which
+// runs the reload callback outside signal context. Windows has no SIGHUP.
+
+struct RestartConfig {
+    std::string socketPath; // empty disables hot restart
+    int drainMs = 30000;
+};
+
+void initRestart(const RestartConfig& config);
+bool restartEnabled();
+
+// Takes over the listeners of a running proxy on config.socketPath. Fills
+// `listeners` (INVALID_SOCKET for one the old process did not have) and
+// returns true once the old process has stopped accepting.
+bool inheritListeners(std::vector<SOCKET>& listeners);
+
+// Serves takeover requests on config.socketPath from a background thread.
+// `listeners` is what a successor receives, in inheritListeners() order.
+bool startRestartServer(const std::vector<SOCKET>& listeners);
+
+// Readies `listener` for waitForClient(): non-blocking, not inherited by exec.
+void prepareListener(SOCKET listener);
+
+// Blocks until `listener` has a connection to accept; false once a stop was
+// requested. Safe to call requestStop() from a signal handler.
+bool waitForClient(SOCKET listener);
+void requestStop();
+bool stopRequested();
+// True when the stop came from a successor taking the listeners.
+bool handedOff();
+
+// Call when accept() on a listener fails. An interrupted call or a peer that
+// gave up is retried at once; anything else, such as running out of
+// descriptors, is logged at most once a second under `tag` and waited out
+// for 100 ms, since the listener stays readable and would spin the loop.
+// Returns false only once the listener itself is gone.
+bool acceptBackoff(const char* tag);
+
+// Waits until every admitted connection has closed or `deadlineMs` passes,
+// reporting the count once a second. Returns the number still open.
+int drainConnections(int deadlineMs);
+bool draining();
+
+// Runs `onReload` on a background thread each time requestReload() is
+// called; requestReload() is safe from a signal handler.
+void startReloadWatcher(std::function<void()> onReload);
+void requestReload();
+
+#endif
\ No newline at end of file
@@ -1,13 +1,19 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
-#include <string>
+#include <string_view>
 
-void logProxy(const std::string& ip,
-              const std::string& host,
-              const std::string& port,
-              const std::string& method,
-              const std::string& path,
-              const std::string& status,
-              int bytes);
+void logProxy(std::string_view ip,
+              std::string_view host,
+              std::string_view port,
+              std::string_view method,
+              std::string_view path,
+              std::string_view status,
+              long long bytes,
+              int httpStatus = 0,
+              long long bodyBytes = -1);
+
+// Waits out any line being written and flushes console output. Called on the
+// way out, once the handlers have drained.
+void flushLogs();
 #endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "Common.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Counters and gauges for the hot path. Every thread leases its own
+// cache-line-aligned slot on first use and updates it with plain relaxed
+// stores, so recording never takes a lock or writes a line another thread
+// writes. A scrape sums all slots. Threads beyond MAX_SLOTS share an overflow
+// slot that is updated with atomic adds.
+
+enum Metric {
+    M_CONNECTIONS,        // accepted client connections
+    M_ACTIVE_CONNECTIONS, // gauge
+    M_ACTIVE_TUNNELS,     // gauge
+    M_BYTES_UPSTREAM,     // client -> origin
+    M_BYTES_DOWNSTREAM,   // origin -> client
+    M_REQ_ALLOWED,
+    M_REQ_INCOMPLETE,
+    M_REQ_BLOCKED,
+    M_REQ_TUNNEL,
+    M_REQ_HIT,
+    M_REQ_HIT_DISK,
+    M_REQ_REVALIDATED,
+    M_REQ_COLLAPSED,
+    M_REQ_MALFORMED,
+    M_ERR_CONN,
+    M_ERR_CIRCUIT,
+    METRIC_COUNT
+};
+
+struct alignas(64) MetricSlot {
+    std::atomic<bool> owned{false};
+    bool shared = false; // the overflow slot
+    std::atomic<int64_t> values[METRIC_COUNT];
+};
+
+extern bool metricsOn;
+extern thread_local MetricSlot* metricsSlot;
+MetricSlot* metricsLeaseSlot();
+
+inline void metricAdd(Metric m, int64_t delta = 1) {
+    if (!metricsOn) return;
+    MetricSlot* slot = metricsSlot ? metricsSlot : metricsLeaseSlot();
+    if (slot->shared) {
+        slot->values[m].fetch_add(delta, std::memory_order_relaxed);
+    } else {
+        // Single writer: no read-modify-write instruction needed.
+        slot->values[m].store(slot->values[m].load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+}
+
+void setMetricsEnabled(bool on);
+int64_t metricValue(Metric m);
+
+// Prometheus text exposition (format 0.0.4) of all metrics.
+std::string renderMetrics();
+
+// Serves renderMetrics() on GET /metrics from a background thread, on a
+// listener inherited in a hot restart if one is given.
+bool startMetricsServer(const std::string& address, int port, SOCKET inherited = INVALID_SOCKET);
+// The endpoint's listening socket, or INVALID_SOCKET when it is not running.
+SOCKET metricsListener();
+
+#endif
\ No newline at end of file
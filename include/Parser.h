@@ -3,9 +3,24 @@
 
 #include "Common.h"
 #include <string>
+#include <string_view>
 
-int recvHeaders(SOCKET sock, std::string& outData);
-HttpRequest parseHttpRequest(const std::string& data);
-std::string modifyRequestLine(const HttpRequest& req);
+// The outgoing request expressed as spans of req.raw plus static snippets.
+// Valid only while the HttpRequest it was built from is alive and unmodified.
+struct RequestSlices {
+    static const int MAX_PARTS = 7;
+    IoSlice parts[MAX_PARTS];
+    int count = 0;
+    size_t totalLen = 0;
+};
+
+int recvHeaders(SOCKET sock, std::pmr::string& outData);
+// Takes over `raw` as req.raw; the fields share its allocator.
+HttpRequest parseHttpRequest(std::pmr::string&& raw);
+HttpRequest parseHttpRequest(std::string_view data, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+RequestSlices buildRequestSlices(const HttpRequest& req);
+void appendRequestHeaders(RequestSlices& slices, const HttpRequest& req, const std::string& headers);
+std::pmr::string modifyRequestLine(const HttpRequest& req,
+                                   std::pmr::memory_resource* mr = std::pmr::get_default_resource());
 
 #endif
\ No newline at end of file
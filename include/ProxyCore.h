@@ -4,8 +4,15 @@
 #include "Common.h"
 
 void handleClient(SOCKET clientSocket);
-SOCKET connectToRemote(const std::string& host, const std::string& port); 
+SOCKET connectToRemote(const char* host, const char* port); 
 int sendAll(SOCKET s, const char* buf, int len);
+int sendAllv(SOCKET s, IoSlice* slices, int count);
 void setSocketTimeout(SOCKET s, int milliseconds);
+// With RELAY_TUNE_SOCKET_BUFFERS on, sizes SO_RCVBUF on `src` and SO_SNDBUF on
+// `dst` for relay reads of `readBytes`.
+void tuneRelaySockets(SOCKET src, SOCKET dst, size_t readBytes);
+// Sends a canned response (such as a 429) and closes without reading the request,
+// for refusing a connection before any thread or parsing is spent on it.
+void rejectClient(SOCKET s, const std::string& response);
 
 #endif
\ No newline at end of file
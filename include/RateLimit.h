@@ -0,0 +1,59 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <cstdint>
+#include <string>
+
+// Per source IPv4 address limits on new connections per second, concurrent
+// connections and relayed bytes per second. Rates are token buckets refilled
+// lazily whenever an address is touched; state lives in a sharded hash table
+// and an entry is dropped once its address has had no open connection for
+// `idleMs`, so one-off clients do not accumulate. Subnet rules from
+// `rulesPath` override the defaults, longest prefix first:
+//
+//   # <subnet> [conn_rate=N] [conn_burst=N] [concurrent=N] [kb_rate=N] [kb_burst=N]
+//   10.0.0.0/8       concurrent=500 conn_rate=200
+//   192.168.7.23/32  kb_rate=1024
+//   127.0.0.0/8      conn_rate=0 concurrent=0 kb_rate=0   (exempt)
+//
+// A value of 0 means unlimited; fields a rule leaves out keep the default.
+
+struct RateLimits {
+    double connPerSec = 0;
+    double connBurst = 0;   // bucket depth; 0 means one second's worth
+    int maxConcurrent = 0;
+    double bytesPerSec = 0; // both directions together
+    double bytesBurst = 0;  // 0 means one second's worth
+};
+
+struct RateLimitConfig {
+    RateLimits defaults;
+    std::string rulesPath; // empty: defaults apply to everyone
+    int idleMs = 60000;
+};
+
+struct RateLimitStats {
+    uint64_t tracked = 0;            // addresses with live state
+    uint64_t rejectedRate = 0;       // over the new-connection rate
+    uint64_t rejectedConcurrent = 0; // over the concurrent-connection cap
+    uint64_t throttledMs = 0;        // total time reads were delayed
+};
+
+enum RateVerdict { RATE_ALLOW, RATE_TOO_FAST, RATE_TOO_MANY };
+
+// Returns false if the rules file exists but has a line it cannot parse.
+bool initRateLimit(const RateLimitConfig& config);
+bool rateLimitEnabled();
+
+// `ip` is in host byte order. RATE_ALLOW takes a concurrency slot that must be
+// returned with clientRelease() when the connection ends.
+RateVerdict clientAdmit(uint32_t ip);
+void clientRelease(uint32_t ip);
+
+// Charges `bytes` to the client's byte bucket and, when it is overdrawn,
+// sleeps before the caller's next read so TCP flow control slows the sender.
+void clientThrottle(uint32_t ip, size_t bytes);
+
+RateLimitStats rateLimitStats();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef SHAPER_H
+#define SHAPER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+// Global bandwidth shaping with deficit round robin across flows. Every relay
+// loop (tunnel direction, response, request body) is one flow and asks for
+// each chunk before sending it. While the global token bucket has room, the
+// grant is immediate; once it runs dry, waiting flows are served in turn, each
+// getting up to `quantum` bytes per round, so a short interactive response
+// finishes within one round instead of queueing behind bulk transfers.
+// Per-client caps come from the rate limiter (RATE_KB_PER_SEC).
+//
+// Disabled (the default), shapeBytes() is a single branch.
+
+struct ShaperConfig {
+    double bytesPerSec = 0; // 0 disables shaping
+    size_t quantum = 8192;  // bytes per flow per round
+};
+
+struct ShapedFlow {
+    std::condition_variable cv;
+    size_t pending = 0; // bytes still to be granted for the current chunk
+    size_t deficit = 0;
+    bool inTurn = false; // deficit already topped up this round
+};
+
+struct ShaperStats {
+    uint64_t grantedBytes = 0;
+    uint64_t waits = 0;     // chunks that had to queue
+    uint64_t waitingFlows = 0;
+};
+
+void initShaper(const ShaperConfig& config);
+extern bool shaperOn;
+
+void shapeBytesSlow(ShapedFlow& flow, size_t bytes);
+
+// Blocks until `bytes` may be sent on this flow.
+inline void shapeBytes(ShapedFlow& flow, size_t bytes) {
+    if (shaperOn) shapeBytesSlow(flow, bytes);
+}
+
+ShaperStats shaperStats();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Hierarchical timing wheel: four levels of 256 slots, each level covering
+// 256 times the span of the one below, so 2^32 ticks are addressable. Timers
+// are intrusive nodes on doubly linked slot lists, which makes arm() and
+// cancel() O(1) with no allocation; advance() fires a slot per tick and
+// cascades a higher-level slot down every 256 ticks.
+//
+// Not thread-safe: the owner serializes calls (see Deadline.cpp). A fire
+// callback may arm or cancel any timer, including its own.
+
+struct TimerNode {
+    TimerNode* prev = nullptr; // null while not armed
+    TimerNode* next = nullptr;
+    uint64_t expires = 0;      // absolute tick
+    void (*fire)(TimerNode*) = nullptr;
+
+    bool armed() const { return prev != nullptr; }
+};
+
+class TimerWheel {
+public:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 8;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+    explicit TimerWheel(uint64_t startTick = 0);
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // (Re)arms `node` for absolute tick `expires`; ticks already passed fire
+    // on the next advance(). Deadlines past 2^32 ticks are clamped.
+    void arm(TimerNode& node, uint64_t expires);
+    void cancel(TimerNode& node);
+    // Fires every timer due up to and including `nowTick`; returns how many.
+    size_t advance(uint64_t nowTick);
+
+    uint64_t now() const { return current; }
+    size_t size() const { return count; }
+
+private:
+    TimerNode slots[LEVELS][SLOTS]; // list heads
+    uint64_t current;               // last tick processed
+    size_t count = 0;
+
+    void place(TimerNode& node);
+    void cascade(int level);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <type_traits>
+
+// Static user-level tracepoints (USDT, provider "proxy") on the request
+// lifecycle. Each site compiles to a single nop plus an ELF .note.stapsdt
+// entry describing where its arguments live, the same layout <sys/sdt.h>
+// emits, so bpftrace, perf and SystemTap can attach without a rebuild.
+// Nothing runs while no tracer is attached.
+//
+//   PROXY_TRACE(accept, connId, clientIp);
+//
+// Probes are compiled in on Linux x86-64/AArch64 with GCC or Clang; elsewhere,
+// or with PROXY_NO_USDT defined, PROXY_TRACE expands to nothing.
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__)) && defined(__GNUC__) && \
+    !defined(PROXY_NO_USDT)
+#define PROXY_USDT 1
+
+// "<size>@<operand>" per argument; a negative size marks a signed value.
+#define PROXY_TRACE_SIZE(x) ((std::is_signed<typename std::decay<decltype(x)>::type>::value ? 1 : -1) * (int)sizeof(x))
+
+#define PROXY_TRACE_NOTE(name, args)                                          \
+    "990: nop\n"                                                              \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                             \
+    ".balign 4\n"                                                             \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                        \
+    "991: .asciz \"stapsdt\"\n"                                               \
+    "992: .balign 4\n"                                                        \
+    "993: .8byte 990b\n"                                                      \
+    ".8byte _.stapsdt.base\n"                                                 \
+    ".8byte 0\n"                                                              \
+    ".asciz \"proxy\"\n"                                                      \
+    ".asciz \"" name "\"\n"                                                   \
+    ".asciz \"" args "\"\n"                                                   \
+    "994: .balign 4\n"                                                        \
+    ".popsection\n"                                                           \
+    ".ifndef _.stapsdt.base\n"                                                \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"   \
+    ".weak _.stapsdt.base\n"                                                  \
+    ".hidden _.stapsdt.base\n"                                                \
+    "_.stapsdt.base: .space 1\n"                                              \
+    ".size _.stapsdt.base, 1\n"                                               \
+    ".popsection\n"                                                           \
+    ".endif\n"
+
+#define PROXY_TRACE_1(name, a1)                                               \
+    __asm__ __volatile__(PROXY_TRACE_NOTE(#name, "%n0@%1")                    \
+                         :: "n"(PROXY_TRACE_SIZE(a1)), "nor"(a1))
+#define PROXY_TRACE_2(name, a1, a2)                                           \
+    __asm__ __volatile__(PROXY_TRACE_NOTE(#name, "%n0@%1 %n2@%3")             \
+                         :: "n"(PROXY_TRACE_SIZE(a1)), "nor"(a1),             \
+                            "n"(PROXY_TRACE_SIZE(a2)), "nor"(a2))
+#define PROXY_TRACE_3(name, a1, a2, a3)                                       \
+    __asm__ __volatile__(PROXY_TRACE_NOTE(#name, "%n0@%1 %n2@%3 %n4@%5")      \
+                         :: "n"(PROXY_TRACE_SIZE(a1)), "nor"(a1),             \
+                            "n"(PROXY_TRACE_SIZE(a2)), "nor"(a2),             \
+                            "n"(PROXY_TRACE_SIZE(a3)), "nor"(a3))
+#define PROXY_TRACE_4(name, a1, a2, a3, a4)                                   \
+    __asm__ __volatile__(PROXY_TRACE_NOTE(#name, "%n0@%1 %n2@%3 %n4@%5 %n6@%7") \
+                         :: "n"(PROXY_TRACE_SIZE(a1)), "nor"(a1),             \
+                            "n"(PROXY_TRACE_SIZE(a2)), "nor"(a2),             \
+                            "n"(PROXY_TRACE_SIZE(a3)), "nor"(a3),             \
+                            "n"(PROXY_TRACE_SIZE(a4)), "nor"(a4))
+
+#define PROXY_TRACE_PICK(_1, _2, _3, _4, macro, ...) macro
+#define PROXY_TRACE(name, ...)                                                \
+    PROXY_TRACE_PICK(__VA_ARGS__, PROXY_TRACE_4, PROXY_TRACE_3, PROXY_TRACE_2, PROXY_TRACE_1, )(name, __VA_ARGS__)
+
+#else
+#define PROXY_TRACE(name, ...) ((void)0)
+#endif
+
+#endif
\ No newline at end of file
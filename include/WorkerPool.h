@@ -0,0 +1,76 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+// Pre-spawned worker threads for connection handlers, so the accept loop does
+// not create and tear down a thread per connection. Each worker owns a deque:
+// it runs its own tasks oldest first, and a worker that runs dry steals the
+// newest task from a randomly chosen victim before going to sleep.
+//
+//   - `threads` workers are started up front and never exit.
+//   - When every worker is busy, the pool grows one worker at a time up to
+//     `maxThreads`; workers beyond `threads` exit after `idleMs` without work.
+//   - At `maxThreads`, new connections wait in the deques. Admission control
+//     (MAX_CONNECTIONS) bounds how many can wait.
+//
+// Handlers block on sockets, so a task the caller waits for (the second half
+// of a tunnel, a request body pump) must not queue behind other connections:
+// poolStart() hands it to a sleeping worker, or starts a thread for it even
+// past the cap. Those are bounded by the admitted connections. If no thread
+// can be created at all the task does not run, and the caller fails the
+// request rather than running both halves on one thread.
+//
+// Worker stacks are `stackBytes` (POSIX and Windows) instead of the platform
+// default of 1-8 MB. With `threads` at 0 the pool is off and every connection
+// gets its own std::thread, as before.
+
+struct WorkerPoolConfig {
+    int threads = 0;
+    int maxThreads = 0;              // 0 means `threads`
+    size_t stackBytes = 256u << 10;
+    int idleMs = 30000;
+};
+
+struct WorkerPoolStats {
+    uint64_t workers = 0;   // live pool workers
+    uint64_t idle = 0;      // sleeping, waiting for work
+    uint64_t queued = 0;    // tasks waiting in the deques
+    uint64_t executed = 0;
+    uint64_t stolen = 0;    // tasks run by a worker other than the one they were queued on
+    uint64_t spawned = 0;   // workers started beyond the initial set
+    uint64_t overflow = 0;  // poolStart() threads started past the cap
+};
+
+bool initWorkerPool(const WorkerPoolConfig& config);
+bool workerPoolEnabled();
+
+// Queues a task. From a worker it goes on that worker's own deque; from any
+// other thread the deques are filled round robin.
+void poolSubmit(std::function<void()> task);
+
+// A task that runs alongside the caller, who later waits for it. Same shape
+// as std::thread so call sites read the same; without the pool it is one.
+// When no thread could be started the task is dropped and joinable() is false.
+class PoolThread {
+public:
+    PoolThread() = default;
+    explicit PoolThread(std::function<void()> task);
+    PoolThread(PoolThread&&) = default;
+    PoolThread& operator=(PoolThread&&) = default;
+    bool joinable() const { return done != nullptr || thread.joinable(); }
+    void join();
+
+private:
+    struct Done;
+    std::shared_ptr<Done> done;
+    std::thread thread;
+};
+
+WorkerPoolStats workerPoolStats();
+
+#endif
\ No newline at end of file
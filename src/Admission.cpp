@@ -0,0 +1,143 @@
+/**
+ * @file Admission.cpp
+ * @brief Connection and upstream-connect caps, and dispatch-delay driven
+ *        load shedding for the accept loop.
+ */
+
+#include "../include/Admission.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+static AdmissionConfig cfg;
+static std::atomic<int> active{0};
+static std::atomic<int> connecting{0};
+static std::atomic<uint64_t> rejectedFull{0};
+static std::atomic<uint64_t> rejectedShed{0};
+static std::atomic<uint64_t> rejectedConnect{0};
+
+// Shedding controller, touched by the accept loop and every new handler.
+static std::mutex shedMtx;
+static std::atomic<bool> shedding{false}; // ratio > 0; lets the accept loop skip the lock
+static double shedRatio = 0;
+static double shedCredit = 0;             // spreads rejections evenly at the current ratio
+static uint64_t windowEnd = 0;
+static uint64_t windowMin = UINT64_MAX;
+static uint64_t lastWindowMin = 0;
+static int pending = 0;                   // queued for a handler, not yet started
+static uint64_t pendingSince = 0;         // accept time of the oldest of them, as FIFO order tells it
+
+void initAdmission(const AdmissionConfig& config) {
+    std::lock_guard<std::mutex> lock(shedMtx);
+    cfg = config;
+    if (cfg.shedIntervalMs <= 0) cfg.shedIntervalMs = 100;
+    shedRatio = 0;
+    shedCredit = 0;
+    windowEnd = 0;
+    windowMin = UINT64_MAX;
+    pending = 0;
+    shedding.store(false, std::memory_order_relaxed);
+}
+
+bool admissionEnabled() {
+    return cfg.maxConnections > 0 || cfg.maxConnecting > 0 || cfg.shedTargetMs > 0;
+}
+
+// Closes every window that has ended by `now`. A window in which no handler
+// started has no minimum: if connections are still queued, it is judged by
+// how long the oldest has waited by the window's end, since a saturated box
+// dispatches nothing at all; if none are, it leaves the ratio as it was.
+static void rollWindows(uint64_t now) {
+    uint64_t interval = (uint64_t)cfg.shedIntervalMs * 1000000;
+    uint64_t target = (uint64_t)cfg.shedTargetMs * 1000000;
+    if (windowEnd == 0) windowEnd = now + interval;
+    while (now >= windowEnd) {
+        if (windowMin != UINT64_MAX) {
+            if (windowMin > target) shedRatio = std::min(shedRatio + 0.1, 0.95);
+            else shedRatio = shedRatio < 0.01 ? 0 : shedRatio / 2;
+            lastWindowMin = windowMin;
+        } else if (pending > 0) {
+            uint64_t waited = windowEnd > pendingSince ? windowEnd - pendingSince : 0;
+            if (waited > target) shedRatio = std::min(shedRatio + 0.1, 0.95);
+            lastWindowMin = waited;
+        }
+        windowMin = UINT64_MAX;
+        windowEnd += interval;
+        if (pending == 0 && now >= windowEnd + interval) {
+            // Whole windows without a connection: nothing is queued.
+            shedRatio = 0;
+            windowEnd = now + interval;
+        }
+    }
+    shedding.store(shedRatio > 0, std::memory_order_relaxed);
+}
+
+AdmitVerdict admitConnection(uint64_t nowNs) {
+    if (cfg.shedTargetMs > 0) {
+        std::lock_guard<std::mutex> lock(shedMtx);
+        rollWindows(nowNs);
+        if (shedding.load(std::memory_order_relaxed)) {
+            shedCredit += shedRatio;
+            if (shedCredit >= 1) {
+                shedCredit -= 1;
+                rejectedShed.fetch_add(1, std::memory_order_relaxed);
+                return ADMIT_SHED;
+            }
+        }
+    }
+    int now = active.fetch_add(1, std::memory_order_relaxed);
+    if (cfg.maxConnections > 0 && now >= cfg.maxConnections) {
+        active.fetch_sub(1, std::memory_order_relaxed);
+        rejectedFull.fetch_add(1, std::memory_order_relaxed);
+        return ADMIT_FULL;
+    }
+    return ADMIT_OK;
+}
+
+void admissionQueued(uint64_t acceptedNs) {
+    if (cfg.shedTargetMs <= 0) return;
+    std::lock_guard<std::mutex> lock(shedMtx);
+    if (pending++ == 0) pendingSince = acceptedNs;
+}
+
+void admissionDispatched(uint64_t acceptedNs, uint64_t nowNs) {
+    if (cfg.shedTargetMs <= 0) return;
+    uint64_t delay = nowNs > acceptedNs ? nowNs - acceptedNs : 0;
+    std::lock_guard<std::mutex> lock(shedMtx);
+    rollWindows(nowNs);
+    windowMin = std::min(windowMin, delay);
+    // The ones still queued came in after this one, or sooner if a worker
+    // took a newer task first; either way none is older than pendingSince.
+    if (pending > 0 && --pending > 0) pendingSince = std::max(pendingSince, acceptedNs);
+}
+
+void admissionRelease() {
+    active.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool upstreamConnectBegin() {
+    int now = connecting.fetch_add(1, std::memory_order_relaxed);
+    if (cfg.maxConnecting > 0 && now >= cfg.maxConnecting) {
+        connecting.fetch_sub(1, std::memory_order_relaxed);
+        rejectedConnect.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void upstreamConnectEnd() {
+    connecting.fetch_sub(1, std::memory_order_relaxed);
+}
+
+AdmissionStats admissionStats() {
+    AdmissionStats s;
+    s.active = (uint64_t)std::max(0, active.load(std::memory_order_relaxed));
+    s.connecting = (uint64_t)std::max(0, connecting.load(std::memory_order_relaxed));
+    s.rejectedFull = rejectedFull.load(std::memory_order_relaxed);
+    s.rejectedShed = rejectedShed.load(std::memory_order_relaxed);
+    s.rejectedConnect = rejectedConnect.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(shedMtx);
+    s.shedRatio = shedRatio;
+    s.windowMinDelayUs = lastWindowMin / 1000;
+    return s;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+/**
+ * @file Arena.cpp
+ * @brief Request-scoped bump allocation over pooled blocks.
+ */
+
+#include "../include/Arena.h"
+#include "../include/BufferPool.h"
+#include <cstdint>
+#include <new>
+
+// Sits at the start of each block. Heap blocks carry BUF_CLASS_COUNT.
+struct alignas(std::max_align_t) RequestArena::Block {
+    Block* next;
+    BufferClass cls;
+    size_t size;
+};
+
+void RequestArena::reset() {
+    while (blocks) {
+        Block* b = blocks;
+        blocks = b->next;
+        if (b->cls == BUF_CLASS_COUNT) ::operator delete(b);
+        else bufferRelease(reinterpret_cast<char*>(b), b->cls);
+    }
+    cursor = limit = nullptr;
+    usedBytes = reservedBytes = 0;
+}
+
+void* RequestArena::do_allocate(size_t bytes, size_t align) {
+    uintptr_t at = ((uintptr_t)cursor + (align - 1)) & ~(uintptr_t)(align - 1);
+    if (!cursor || at + bytes > (uintptr_t)limit) {
+        // Each new block is at least one class larger than the last, so a
+        // growing string spills into few blocks.
+        size_t need = sizeof(Block) + bytes + align;
+        int cls = blocks ? (blocks->cls + 1 < BUF_IO_LARGE ? blocks->cls + 1 : BUF_IO_LARGE) : BUF_HEADER;
+        while (cls < BUF_CLASS_COUNT && bufferClassSize((BufferClass)cls) < need) cls++;
+        Block* b;
+        size_t size;
+        if (cls == BUF_CLASS_COUNT) {
+            size = need;
+            b = static_cast<Block*>(::operator new(size));
+        } else {
+            size = bufferClassSize((BufferClass)cls);
+            b = reinterpret_cast<Block*>(bufferAcquire((BufferClass)cls));
+        }
+        *b = Block{ blocks, (BufferClass)cls, size };
+        blocks = b;
+        cursor = reinterpret_cast<char*>(b + 1);
+        limit = reinterpret_cast<char*>(b) + size;
+        reservedBytes += size;
+        at = ((uintptr_t)cursor + (align - 1)) & ~(uintptr_t)(align - 1);
+    }
+    cursor = reinterpret_cast<char*>(at + bytes);
+    usedBytes += bytes;
+    return reinterpret_cast<void*>(at);
+}
\ No newline at end of file
@@ -0,0 +1,338 @@
+/**
+ * @file AsyncProxy.cpp
+ * @brief Coroutine connection handler: the pass-through proxy on EventLoop
+ *        threads, one coroutine frame per connection instead of a thread.
+ */
+
+#include "../include/AsyncProxy.h"
+#include "../include/Arena.h"
+#include "../include/Config.h"
+#include "../include/EventLoop.h"
+#include "../include/Parser.h"
+#include "../include/ProxyCore.h"
+#include "../include/Filter.h"
+#include "../include/Logger.h"
+#include "../include/Framing.h"
+#include "../include/CircuitBreaker.h"
+#include "../include/Metrics.h"
+#include "../include/Latency.h"
+#include "../include/Deadline.h"
+#include "../include/Admission.h"
+#include "../include/Trace.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static std::vector<EventLoop*> loops;
+static std::atomic<unsigned> nextLoop{0};
+static std::atomic<uint64_t> nextConnId{1};
+static std::atomic<uint64_t> openConnections{0};
+static std::atomic<uint64_t> servedConnections{0};
+
+// Same bookkeeping as the threaded handler's ActiveConnection.
+struct AsyncConnection {
+    uint64_t start = latencyNow();
+    uint64_t id = nextConnId.fetch_add(1, std::memory_order_relaxed);
+    std::pmr::string host;
+
+    explicit AsyncConnection(std::pmr::memory_resource* mr) : host(mr) {
+        metricAdd(M_CONNECTIONS);
+        metricAdd(M_ACTIVE_CONNECTIONS);
+        openConnections.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~AsyncConnection() {
+        metricAdd(M_ACTIVE_CONNECTIONS, -1);
+        openConnections.fetch_sub(1, std::memory_order_relaxed);
+        servedConnections.fetch_add(1, std::memory_order_relaxed);
+        uint64_t duration = latencyNow() - start;
+        latencyRecord(LAT_TOTAL, duration);
+        PROXY_TRACE(close, id, host.c_str(), duration);
+    }
+};
+
+// recvHeaders() with co_await. Like the relay buffers below, the header
+// buffer is held only while bytes are arriving.
+static Task<int> readHead(IoWatch& client, std::pmr::string& out) {
+    PooledBuffer buffer;
+    const uint64_t limit = Config::current()->maxHeaderBytes;
+    while (true) {
+        int n = co_await asyncRecvBuffered(client, buffer, BUF_HEADER);
+        if (n <= 0) co_return n;
+        if (out.capacity() < 2048) out.reserve(2048); // as recvHeaders() does
+        out.append(buffer.data(), n);
+        if (out.find("\r\n\r\n") != std::string::npos) break;
+        if (out.length() > limit) co_return -2;
+    }
+    co_return (int)out.length();
+}
+
+// asyncRecvBuffered() at the relay buffer's current size, as ProxyCore's recvRelay().
+static Task<int> recvRelay(IoWatch& src, IoWatch& dst, RelayBuffer& buf) {
+    int n = co_await asyncRecvBuffered(src, buf.pooled, buf.sizeClass());
+    if (buf.record(n)) tuneRelaySockets(src.fd, dst.fd, bufferClassSize(buf.sizeClass()));
+    co_return n;
+}
+
+static Task<void> relay(IoWatch& src, IoWatch& dst, Metric bytes, uint64_t conn, ConnDeadlines& deadlines) {
+    RelayBuffer buffer;
+    int upstream = bytes == M_BYTES_UPSTREAM;
+    int n;
+    tuneRelaySockets(src.fd, dst.fd, bufferClassSize(buffer.sizeClass()));
+    while ((n = co_await recvRelay(src, dst, buffer)) > 0) {
+        if (co_await asyncSendAll(dst, buffer.pooled.data(), n) == SOCKET_ERROR) break;
+        deadlineTouch(&deadlines);
+        metricAdd(bytes, n);
+        PROXY_TRACE(relay, conn, n, upstream);
+    }
+    shutdown(dst.fd, SD_SEND);
+}
+
+// forwardRequestBody() as a coroutine running beside the response relay.
+static Task<void> pumpBody(IoWatch& client, IoWatch& remote, RequestBodyFraming& body, uint64_t conn,
+                           ConnDeadlines& deadlines) {
+    RelayBuffer buffer;
+    while (!body.complete()) {
+        int n = co_await recvRelay(client, remote, buffer);
+        if (n <= 0) break;
+        size_t used = body.consume(buffer.pooled.data(), (size_t)n);
+        if (body.chunks.failed()) break;
+        if (co_await asyncSendAll(remote, buffer.pooled.data(), (int)used) == SOCKET_ERROR) break;
+        deadlineTouch(&deadlines);
+        metricAdd(M_BYTES_UPSTREAM, (int64_t)used);
+        PROXY_TRACE(relay, conn, (int)used, 1);
+    }
+    if (!body.complete()) shutdown(remote.fd, SD_BOTH);
+}
+
+static Task<void> forwardHttp(IoWatch& client, IoWatch& remote, const HttpRequest& req, const char* ipStr,
+                              uint64_t conn, ConnDeadlines& deadlines) {
+    RequestBodyFraming body;
+    body.chunked = req.chunked;
+    body.remaining = (!req.chunked && req.contentLength > 0) ? req.contentLength : 0;
+
+    RequestSlices finalRequest = buildRequestSlices(req);
+    if (req.headerLen > 0 && req.raw.size() > req.headerLen) {
+        size_t early = req.raw.size() - req.headerLen;
+        size_t extra = early - body.consume(req.raw.data() + req.headerLen, early);
+        finalRequest.parts[finalRequest.count - 1].len -= extra;
+        finalRequest.totalLen -= extra;
+    }
+
+    TaskGroup bodyPump;
+    metricAdd(M_BYTES_UPSTREAM, (int64_t)finalRequest.totalLen);
+    uint64_t sentAt = latencyNow();
+    if (co_await asyncSendAllv(remote, finalRequest.parts, finalRequest.count) != SOCKET_ERROR && !body.complete()) {
+        bodyPump.spawn(pumpBody(client, remote, body, conn, deadlines));
+    }
+
+    ResponseParser response(req.method == "HEAD");
+    RelayBuffer buffer;
+    int n = 0;
+    long long totalBytes = 0;
+    while (!response.done() && (n = co_await recvRelay(remote, client, buffer)) > 0) {
+        if (sentAt) {
+            uint64_t ttfb = latencyNow() - sentAt;
+            latencyRecord(LAT_TTFB, ttfb);
+            PROXY_TRACE(first_byte, conn, req.host.c_str(), ttfb);
+            sentAt = 0;
+        }
+        PROXY_TRACE(relay, conn, n, 0);
+        deadlineTouch(&deadlines);
+        size_t used = response.feed(buffer.pooled.data(), (size_t)n); // takes nothing once failed
+        if (response.headFailed() && totalBytes == 0) break;
+        if (response.failed()) used = (size_t)n;
+        if (co_await asyncSendAll(client, buffer.pooled.data(), (int)used) == SOCKET_ERROR) break;
+        totalBytes += (long long)used;
+    }
+    if (n == 0) response.finishOnClose();
+    if (bodyPump.running()) {
+        shutdown(client.fd, SD_RECEIVE); // response is over; stop waiting on the uploader
+        co_await bodyPump.wait();
+    }
+    if (response.headFailed() && totalBytes == 0) {
+        // No body can be delimited after that head, and nothing of it was sent.
+        long long sent = co_await asyncSendAll(client, HTTP_502.c_str(), (int)HTTP_502.length()) == SOCKET_ERROR
+                             ? 0 : (long long)HTTP_502.length();
+        logProxy(ipStr, req.host, req.port, req.method, req.path, "ERR_CONN", sent, 502);
+        co_return;
+    }
+    bool complete = response.done() || (response.failed() && n == 0);
+    logProxy(ipStr, req.host, req.port, req.method, req.path, complete ? "ALLOWED" : "INCOMPLETE",
+             totalBytes, response.status(), (long long)response.bodyBytes());
+}
+
+// DNS on a helper thread, then a non-blocking connect. Leaves `remote` set
+// only when the connection is up.
+static Task<bool> connectUpstream(EventLoop& loop, const HttpRequest& req, uint64_t conn, ConnDeadlines& deadlines,
+                                  IoWatch*& remote) {
+    PROXY_TRACE(dns_start, conn, req.host.c_str());
+    uint64_t t0 = latencyNow();
+    sockaddr_in addr{};
+    int rc = co_await asyncResolve(loop, req.host.c_str(), req.port.c_str(), addr);
+    uint64_t t1 = latencyNow();
+    latencyRecord(LAT_DNS, t1 - t0);
+    PROXY_TRACE(dns_end, conn, req.host.c_str(), rc);
+    if (rc != 0) co_return false;
+
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) co_return false;
+    IoWatch* w = loop.watch(s);
+    if (!w) {
+        closesocket(s);
+        co_return false;
+    }
+    PROXY_TRACE(connect_start, conn, req.host.c_str(), req.port.c_str());
+    deadlineWatchRemote(deadlines, s);
+    deadlineStart(deadlines, DL_CONNECT);
+    bool ok = co_await asyncConnect(*w, (const sockaddr*)&addr, (int)sizeof(addr));
+    deadlineStop(deadlines, DL_CONNECT);
+    latencyRecord(LAT_CONNECT, latencyNow() - t1);
+    int connected = ok;
+    PROXY_TRACE(connect_end, conn, req.host.c_str(), connected);
+    if (!ok) {
+        deadlineWatchRemote(deadlines, INVALID_SOCKET);
+        loop.unwatch(w);
+        closesocket(s);
+        co_return false;
+    }
+    remote = w;
+    co_return true;
+}
+
+// handleClient() up to the point where the sockets are closed, which serve() does.
+static Task<void> handle(EventLoop& loop, RequestArena& arena, AsyncConnection& active, ConnDeadlines& deadlines,
+                         IoWatch& client, IoWatch*& remote) {
+    deadlineStart(deadlines, DL_HEADER);
+    sockaddr_in clientAddr;
+    socklen_t addrLen = sizeof(clientAddr);
+    char ipStr[INET_ADDRSTRLEN] = "Unknown";
+    if (getpeername(client.fd, (sockaddr*)&clientAddr, &addrLen) == 0) {
+        inet_ntop(AF_INET, &clientAddr.sin_addr, ipStr, sizeof(ipStr));
+    }
+    const char* clientIp = ipStr;
+    PROXY_TRACE(accept, active.id, clientIp);
+
+    std::pmr::string rawData(&arena);
+    int received = co_await readHead(client, rawData);
+    deadlineStop(deadlines, DL_HEADER);
+    if (received <= 0) {
+        if (received == -2) metricAdd(M_REQ_MALFORMED);
+        co_return;
+    }
+    deadlineStart(deadlines, DL_IDLE);
+
+    HttpRequest req = parseHttpRequest(std::move(rawData));
+    if (req.host.empty()) {
+        metricAdd(M_REQ_MALFORMED);
+        co_return;
+    }
+    if (req.badFraming) {
+        metricAdd(M_REQ_MALFORMED);
+        co_await asyncSendAll(client, HTTP_400.c_str(), (int)HTTP_400.length());
+        co_return;
+    }
+    active.host = req.host;
+    PROXY_TRACE(headers, active.id, req.host.c_str(), req.method.c_str(), received);
+
+    uint64_t filterStart = latencyNow();
+    bool blocked = isBlocked(req.host);
+    latencyRecord(LAT_FILTER, latencyNow() - filterStart);
+    PROXY_TRACE(filter, active.id, req.host.c_str(), (int)blocked);
+    if (blocked) {
+        co_await asyncSendAll(client, HTTP_403.c_str(), (int)HTTP_403.length());
+        logProxy(ipStr, req.host, req.port, req.method, req.path, "BLOCKED", 0);
+        co_return;
+    }
+
+    bool probe = false;
+    bool connected = false;
+    bool admitted = upstreamConnectBegin();
+    bool allowed = admitted && upstreamAllow(req.host, req.port, probe);
+    if (allowed) {
+        connected = co_await connectUpstream(loop, req, active.id, deadlines, remote);
+        upstreamResult(req.host, req.port, connected, probe);
+    }
+    if (admitted) upstreamConnectEnd();
+    if (!connected) {
+        const std::string& reply = admitted ? HTTP_502 : HTTP_503;
+        co_await asyncSendAll(client, reply.c_str(), (int)reply.length());
+        logProxy(ipStr, req.host, req.port, req.method, req.path,
+                 !admitted ? "ERR_OVERLOAD" : allowed ? "ERR_CONN" : "ERR_CIRCUIT", 0);
+        co_return;
+    }
+
+    if (req.method == "CONNECT") {
+        if (co_await asyncSendAll(client, HTTP_200_CON.c_str(), (int)HTTP_200_CON.length()) != SOCKET_ERROR) {
+            logProxy(ipStr, req.host, req.port, "CONNECT", "-", "TUNNEL", 0);
+
+            metricAdd(M_ACTIVE_TUNNELS);
+            deadlineStart(deadlines, DL_LIFETIME);
+            TaskGroup upstream;
+            upstream.spawn(relay(client, *remote, M_BYTES_UPSTREAM, active.id, deadlines));
+            co_await relay(*remote, client, M_BYTES_DOWNSTREAM, active.id, deadlines);
+            shutdown(client.fd, SD_RECEIVE); // origin is done; stop waiting on the client
+            co_await upstream.wait();
+            metricAdd(M_ACTIVE_TUNNELS, -1);
+        }
+    } else {
+        co_await forwardHttp(client, *remote, req, ipStr, active.id, deadlines);
+    }
+}
+
+// Deadlines come off the wheel before the descriptors they name are closed,
+// and the watches before the descriptors, as in closeConnection().
+static Task<void> serve(EventLoop& loop, SOCKET clientSocket, std::function<void()> done) {
+    {
+        RequestArena arena;
+        AsyncConnection active(&arena);
+        ConnDeadlines deadlines(clientSocket);
+        IoWatch* client = loop.watch(clientSocket);
+        IoWatch* remote = nullptr;
+        if (client) co_await handle(loop, arena, active, deadlines, *client, remote);
+        deadlineStopAll(deadlines);
+        if (remote) {
+            SOCKET s = remote->fd;
+            loop.unwatch(remote);
+            closesocket(s);
+        }
+        loop.unwatch(client);
+        closesocket(clientSocket);
+    }
+    if (done) done();
+}
+
+bool initAsyncHandler(const AsyncConfig& config) {
+    if (!loops.empty() || config.loops <= 0) return !loops.empty();
+    for (int i = 0; i < config.loops; i++) {
+        EventLoop* loop = new EventLoop(); // runs until exit, never destroyed
+        if (!loop->valid()) {
+            delete loop;
+            break;
+        }
+        loops.push_back(loop);
+        std::thread([loop] { loop->run(); }).detach();
+    }
+    return !loops.empty();
+}
+
+bool asyncHandlerEnabled() {
+    return !loops.empty();
+}
+
+void asyncServe(SOCKET clientSocket, std::function<void()> done) {
+    EventLoop* loop = loops[nextLoop.fetch_add(1, std::memory_order_relaxed) % loops.size()];
+    uint64_t acceptedAt = latencyNow();
+    admissionQueued(acceptedAt);
+    loop->post([loop, clientSocket, acceptedAt, done] {
+        admissionDispatched(acceptedAt, latencyNow());
+        spawnDetached(serve(*loop, clientSocket, done));
+    });
+}
+
+AsyncStats asyncStats() {
+    AsyncStats s;
+    s.loops = loops.size();
+    s.connections = openConnections.load(std::memory_order_relaxed);
+    s.served = servedConnections.load(std::memory_order_relaxed);
+    return s;
+}
\ No newline at end of file
@@ -0,0 +1,199 @@
+/**
+ * @file BufferPool.cpp
+ * @brief Size-classed slab buffers with per-thread free lists and a global
+ *        depot that trades whole batches.
+ */
+
+#include "../include/BufferPool.h"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+struct ClassSpec {
+    size_t size;
+    int threadMax; // free buffers a thread keeps before returning a batch
+    int batch;     // buffers moved per depot trade
+    size_t slabBytes;
+    const char* name;
+};
+
+// A thread keeps at most ~128-256 KB per class; a slab is carved into batches.
+static const ClassSpec specs[BUF_CLASS_COUNT] = {
+    { 4096, 32, 16, 256u << 10, "header" },
+    { 16384, 8, 4, 1u << 20, "io" },
+    { 65536, 4, 2, 1u << 20, "io_large" },
+};
+
+struct FreeBuf {
+    FreeBuf* next;
+};
+
+struct Batch {
+    FreeBuf* head;
+    int count;
+};
+
+struct alignas(64) Depot {
+    std::mutex mtx;
+    std::vector<Batch> batches;
+    uint64_t buffers = 0;
+    std::atomic<uint64_t> slabBytes{0};
+    std::atomic<uint64_t> depotFetches{0};
+    std::atomic<uint64_t> depotReturns{0};
+};
+
+// Counters every acquire and release touch, apart from the depot's lock.
+struct alignas(64) ClassCounters {
+    std::atomic<uint64_t> inUse{0};
+    std::atomic<uint64_t> acquired{0};
+};
+
+// Never destroyed: thread lists flush into the depot from thread_local
+// destructors, which may run after static destructors at exit.
+static Depot* depots = new Depot[BUF_CLASS_COUNT];
+static ClassCounters* counters = new ClassCounters[BUF_CLASS_COUNT];
+
+static void depotPut(int c, Batch b) {
+    Depot& d = depots[c];
+    std::lock_guard<std::mutex> lock(d.mtx);
+    d.batches.push_back(b);
+    d.buffers += (uint64_t)b.count;
+    d.depotReturns.fetch_add(1, std::memory_order_relaxed);
+}
+
+// One batch from the depot, carving a new slab into batches when it is empty.
+static Batch depotTake(int c) {
+    const ClassSpec& spec = specs[c];
+    Depot& d = depots[c];
+    std::lock_guard<std::mutex> lock(d.mtx);
+    if (d.batches.empty()) {
+        char* slab = static_cast<char*>(std::malloc(spec.slabBytes));
+        if (!slab) throw std::bad_alloc();
+        d.slabBytes.fetch_add(spec.slabBytes, std::memory_order_relaxed);
+        size_t n = spec.slabBytes / spec.size;
+        for (size_t i = 0; i < n;) {
+            Batch b{ nullptr, 0 };
+            for (; i < n && b.count < spec.batch; i++, b.count++) {
+                FreeBuf* f = reinterpret_cast<FreeBuf*>(slab + i * spec.size);
+                f->next = b.head;
+                b.head = f;
+            }
+            d.batches.push_back(b);
+            d.buffers += (uint64_t)b.count;
+        }
+    }
+    Batch b = d.batches.back();
+    d.batches.pop_back();
+    d.buffers -= (uint64_t)b.count;
+    d.depotFetches.fetch_add(1, std::memory_order_relaxed);
+    return b;
+}
+
+struct ThreadLists {
+    FreeBuf* heads[BUF_CLASS_COUNT] = {};
+    int counts[BUF_CLASS_COUNT] = {};
+
+    ~ThreadLists() {
+        for (int c = 0; c < BUF_CLASS_COUNT; c++) {
+            if (counts[c] > 0) depotPut(c, Batch{ heads[c], counts[c] });
+        }
+    }
+};
+
+static thread_local ThreadLists lists;
+
+size_t bufferClassSize(BufferClass c) {
+    return specs[c].size;
+}
+
+const char* bufferClassName(BufferClass c) {
+    return specs[c].name;
+}
+
+char* bufferAcquire(BufferClass c) {
+    ThreadLists& l = lists;
+    if (!l.heads[c]) {
+        Batch b = depotTake(c);
+        l.heads[c] = b.head;
+        l.counts[c] = b.count;
+    }
+    FreeBuf* f = l.heads[c];
+    l.heads[c] = f->next;
+    l.counts[c]--;
+    counters[c].inUse.fetch_add(1, std::memory_order_relaxed);
+    counters[c].acquired.fetch_add(1, std::memory_order_relaxed);
+    return reinterpret_cast<char*>(f);
+}
+
+void bufferRelease(char* p, BufferClass c) {
+    ThreadLists& l = lists;
+    FreeBuf* f = reinterpret_cast<FreeBuf*>(p);
+    f->next = l.heads[c];
+    l.heads[c] = f;
+    l.counts[c]++;
+    counters[c].inUse.fetch_sub(1, std::memory_order_relaxed);
+    if (l.counts[c] <= specs[c].threadMax) return;
+    // Over the limit: the most recently freed half stays (still warm in cache).
+    const ClassSpec& spec = specs[c];
+    FreeBuf* keepTail = l.heads[c];
+    for (int i = 1; i < l.counts[c] - spec.batch; i++) keepTail = keepTail->next;
+    Batch b{ keepTail->next, spec.batch };
+    keepTail->next = nullptr;
+    l.counts[c] -= spec.batch;
+    depotPut(c, b);
+}
+
+static RelayBufferConfig relayCfg;
+static std::atomic<uint64_t> relayGrows{0};
+static std::atomic<uint64_t> relayShrinks{0};
+
+void initRelayBuffers(const RelayBufferConfig& config) {
+    relayCfg = config;
+}
+
+bool relaySocketTuning() { return relayCfg.tuneSocketBuffers; }
+
+RelayBuffer::RelayBuffer() : cls(relayCfg.adaptive ? BUF_HEADER : BUF_IO) {}
+
+bool RelayBuffer::record(int n) {
+    if (!relayCfg.adaptive || n <= 0) return false;
+    size_t size = specs[cls].size;
+    if ((size_t)n == size) {
+        sparseReads = 0;
+        if (++fullReads < 2 || cls == BUF_IO_LARGE) return false;
+        cls = (BufferClass)(cls + 1);
+        relayGrows.fetch_add(1, std::memory_order_relaxed);
+    } else if ((size_t)n < size / 4) {
+        fullReads = 0;
+        if (++sparseReads < 8 || cls == BUF_HEADER) return false;
+        cls = (BufferClass)(cls - 1);
+        relayShrinks.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        fullReads = sparseReads = 0;
+        return false;
+    }
+    fullReads = sparseReads = 0;
+    return true;
+}
+
+BufferPoolStats bufferPoolStats() {
+    BufferPoolStats s;
+    for (int c = 0; c < BUF_CLASS_COUNT; c++) {
+        BufferClassStats& cs = s.classes[c];
+        Depot& d = depots[c];
+        {
+            std::lock_guard<std::mutex> lock(d.mtx);
+            cs.depot = d.buffers;
+        }
+        cs.slabBytes = d.slabBytes.load(std::memory_order_relaxed);
+        cs.depotFetches = d.depotFetches.load(std::memory_order_relaxed);
+        cs.depotReturns = d.depotReturns.load(std::memory_order_relaxed);
+        cs.inUse = counters[c].inUse.load(std::memory_order_relaxed);
+        cs.acquired = counters[c].acquired.load(std::memory_order_relaxed);
+    }
+    s.relayGrows = relayGrows.load(std::memory_order_relaxed);
+    s.relayShrinks = relayShrinks.load(std::memory_order_relaxed);
+    return s;
+}
\ No newline at end of file
@@ -0,0 +1,389 @@
+/**
+ * @file Cache.cpp
+ * @brief In-memory HTTP response cache: a sharded LRU with a byte budget and
+ *        the subset of RFC 9111 freshness / validation rules the proxy needs.
+ */
+
+#include "../include/Cache.h"
+#include "../include/Framing.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+static const int CACHE_SHARDS = 16;
+
+struct CacheShard {
+    std::mutex mtx;
+    std::list<std::pair<std::string, CacheEntryPtr>> lru; // front = most recently used
+    std::unordered_map<std::string, std::list<std::pair<std::string, CacheEntryPtr>>::iterator> index;
+    size_t bytes = 0;
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long evictions = 0;
+};
+
+static CacheShard shards[CACHE_SHARDS];
+static size_t shardBudget = 0;
+static size_t maxObject = 0;
+static bool enabled = false;
+
+void initCache(size_t budgetBytes, size_t maxObjectBytes) {
+    shardBudget = budgetBytes / CACHE_SHARDS;
+    maxObject = std::min(maxObjectBytes, shardBudget);
+    enabled = shardBudget > 0 && maxObject > 0;
+}
+
+bool cacheEnabled() { return enabled; }
+size_t cacheMaxObjectBytes() { return maxObject; }
+
+std::string cacheKey(const HttpRequest& req) {
+    std::string key;
+    key.reserve(req.host.size() + req.port.size() + req.path.size() + 2);
+    for (char c : req.host) key += (char)std::tolower((unsigned char)c);
+    key += ':';
+    key += req.port;
+    key += ' ';
+    key += req.path;
+    return key;
+}
+
+static CacheShard& shardFor(const std::string& key) {
+    return shards[std::hash<std::string>()(key) % CACHE_SHARDS];
+}
+
+static size_t entryCharge(const std::string& key, const CachedResponse& e) {
+    return key.size() + e.wire->size() + e.etag.size() + e.lastModified.size() + 128;
+}
+
+// IMF-fixdate only ("Sun, 06 Nov 1994 08:49:37 GMT"); anything else is invalid.
+static bool parseHttpDate(const std::string& s, time_t& out) {
+    static const char* MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char mon[4] = {0};
+    int day, year, hh, mm, ss;
+    if (std::sscanf(s.c_str(), "%*3s, %d %3s %d %d:%d:%d GMT", &day, mon, &year, &hh, &mm, &ss) != 6) return false;
+    const char* m = std::strstr(MONTHS, mon);
+    if (!m || (m - MONTHS) % 3 != 0) return false;
+    tm t{};
+    t.tm_year = year - 1900;
+    t.tm_mon = (int)((m - MONTHS) / 3);
+    t.tm_mday = day;
+    t.tm_hour = hh;
+    t.tm_min = mm;
+    t.tm_sec = ss;
+#ifdef _WIN32
+    out = _mkgmtime(&t);
+#else
+    out = timegm(&t);
+#endif
+    return out != (time_t)-1;
+}
+
+static std::string formatHttpDate(time_t t) {
+    char buf[64];
+    tm g{};
+#ifdef _WIN32
+    gmtime_s(&g, &t);
+#else
+    gmtime_r(&t, &g);
+#endif
+    std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &g);
+    return buf;
+}
+
+struct CacheControl {
+    bool noStore = false;
+    bool noCache = false;
+    bool isPrivate = false;
+    long long maxAge = -1;
+    long long sMaxAge = -1;
+};
+
+static CacheControl parseCacheControl(const std::string& value) {
+    CacheControl cc;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == std::string::npos) comma = value.size();
+        std::string d = value.substr(pos, comma - pos);
+        d.erase(0, d.find_first_not_of(" \t"));
+        d.erase(d.find_last_not_of(" \t") + 1);
+        std::transform(d.begin(), d.end(), d.begin(), ::tolower);
+        if (d == "no-store") cc.noStore = true;
+        else if (d.compare(0, 8, "no-cache") == 0) cc.noCache = true;
+        else if (d.compare(0, 7, "private") == 0) cc.isPrivate = true;
+        else if (d.compare(0, 8, "max-age=") == 0) cc.maxAge = std::atoll(d.c_str() + 8);
+        else if (d.compare(0, 9, "s-maxage=") == 0) cc.sMaxAge = std::atoll(d.c_str() + 9);
+        pos = comma + 1;
+    }
+    return cc;
+}
+
+// Everything the cache needs to know about one response head.
+struct ResponsePolicy {
+    int status = 0;
+    bool storable = false;
+    long long freshFor = -1; // -1: no explicit freshness information
+    long long initialAge = 0;
+    std::string etag;
+    std::string lastModified;
+    std::string vary;
+};
+
+static ResponsePolicy parsePolicy(const char* head, size_t headLen, time_t requestTime, time_t responseTime) {
+    ResponsePolicy p;
+    if (headLen < 12) return p;
+    p.status = std::atoi(head + 9);
+
+    std::string value;
+    CacheControl cc;
+    if (findHeader(head, headLen, "Cache-Control", value)) cc = parseCacheControl(value);
+    if (cc.sMaxAge < 0 && cc.maxAge < 0 && findHeader(head, headLen, "Pragma", value) && value == "no-cache") cc.noCache = true;
+
+    time_t date = 0;
+    bool hasDate = findHeader(head, headLen, "Date", value) && parseHttpDate(value, date);
+    long long ageHeader = findHeader(head, headLen, "Age", value) ? std::atoll(value.c_str()) : 0;
+
+    if (cc.sMaxAge >= 0) {
+        p.freshFor = cc.sMaxAge;
+    } else if (cc.maxAge >= 0) {
+        p.freshFor = cc.maxAge;
+    } else if (findHeader(head, headLen, "Expires", value)) {
+        time_t expires;
+        // An unparseable Expires (e.g. "0") means "already expired".
+        p.freshFor = parseHttpDate(value, expires) ? std::max<long long>(0, (long long)(expires - (hasDate ? date : responseTime))) : 0;
+    }
+    if (cc.noCache) p.freshFor = 0;
+
+    long long apparentAge = hasDate ? std::max<long long>(0, (long long)(responseTime - date)) : 0;
+    p.initialAge = std::max(apparentAge, ageHeader) + (long long)(responseTime - requestTime);
+
+    findHeader(head, headLen, "ETag", p.etag);
+    findHeader(head, headLen, "Last-Modified", p.lastModified);
+    findHeader(head, headLen, "Vary", p.vary);
+
+    static const int STORABLE_STATUS[] = { 200, 203, 300, 301, 308, 404, 410 };
+    bool statusOk = std::find(std::begin(STORABLE_STATUS), std::end(STORABLE_STATUS), p.status) != std::end(STORABLE_STATUS);
+    bool hasValidators = !p.etag.empty() || !p.lastModified.empty();
+    p.storable = statusOk && !cc.noStore && !cc.isPrivate && p.vary.find('*') == std::string::npos &&
+                 !findHeader(head, headLen, "Set-Cookie", value) && (p.freshFor > 0 || hasValidators);
+    if (p.freshFor < 0) p.freshFor = 0;
+    return p;
+}
+
+bool cacheResponseMeta(const char* head, size_t headLen, time_t requestTime, time_t responseTime, CacheMeta& meta) {
+    ResponsePolicy p = parsePolicy(head, headLen, requestTime, responseTime);
+    meta.status = p.status;
+    meta.storable = p.storable;
+    meta.varies = !p.vary.empty();
+    meta.initialAge = p.initialAge;
+    meta.freshFor = p.freshFor;
+    return p.storable;
+}
+
+std::string cacheStripAge(const char* head, size_t headLen) {
+    std::string out;
+    out.reserve(headLen);
+    size_t line = 0;
+    while (line < headLen) {
+        const char* nl = (const char*)std::memchr(head + line, '\n', headLen - line);
+        size_t eol = nl ? (size_t)(nl - head) + 1 : headLen;
+        size_t len = eol - line;
+        if (len >= 2 && head[eol - 2] == '\r') len -= 2;
+        if (!headerNameIs(head + line, len, "Age", 3)) out.append(head + line, eol - line);
+        line = eol;
+    }
+    return out;
+}
+
+// Offset of the final (non-1xx) head inside a captured response.
+static size_t finalHeadStart(const std::string& wire, size_t& headLen) {
+    size_t pos = 0;
+    while (true) {
+        size_t end = wire.find("\r\n\r\n", pos);
+        if (end == std::string::npos || end - pos < 12) return std::string::npos;
+        if (wire[pos + 9] != '1') {
+            headLen = end + 4 - pos;
+            return pos;
+        }
+        pos = end + 4;
+    }
+}
+
+static std::vector<std::pair<std::string, std::string>> varyValues(const HttpRequest& req, const std::string& vary) {
+    std::vector<std::pair<std::string, std::string>> out;
+    size_t pos = 0;
+    while (pos < vary.size()) {
+        size_t comma = vary.find(',', pos);
+        if (comma == std::string::npos) comma = vary.size();
+        std::string name = vary.substr(pos, comma - pos);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (!name.empty()) {
+            std::string value;
+            findHeader(req.raw.data(), req.headerLen ? req.headerLen : req.raw.size(), name.c_str(), value);
+            out.emplace_back(name, value);
+        }
+        pos = comma + 1;
+    }
+    return out;
+}
+
+bool isCacheableRequest(const HttpRequest& req) {
+    if (req.method != "GET" || req.headerLen == 0) return false;
+    static const char* BYPASS[] = { "Authorization", "Range", "If-None-Match", "If-Modified-Since",
+                                    "If-Match", "If-Unmodified-Since", "If-Range" };
+    std::string value;
+    for (const char* h : BYPASS) {
+        if (findHeader(req.raw.data(), req.headerLen, h, value)) return false;
+    }
+    if (findHeader(req.raw.data(), req.headerLen, "Cache-Control", value) && parseCacheControl(value).noStore) return false;
+    return true;
+}
+
+CacheEntryPtr cacheLookup(const HttpRequest& req, time_t now, bool& fresh) {
+    fresh = false;
+    std::string key = cacheKey(req);
+    CacheShard& shard = shardFor(key);
+    CacheEntryPtr entry;
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            shard.misses++;
+            return nullptr;
+        }
+        entry = it->second->second;
+        for (const auto& v : entry->vary) {
+            std::string value;
+            findHeader(req.raw.data(), req.headerLen, v.first.c_str(), value);
+            if (value != v.second) {
+                shard.misses++;
+                return nullptr;
+            }
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        shard.hits++;
+    }
+
+    std::string value;
+    bool clientRevalidates = false;
+    if (findHeader(req.raw.data(), req.headerLen, "Cache-Control", value)) {
+        CacheControl cc = parseCacheControl(value);
+        clientRevalidates = cc.noCache || (cc.maxAge >= 0 && entry->currentAge(now) > cc.maxAge);
+    } else if (findHeader(req.raw.data(), req.headerLen, "Pragma", value) && value == "no-cache") {
+        clientRevalidates = true;
+    }
+    fresh = !clientRevalidates && entry->isFresh(now);
+    return entry;
+}
+
+static void publish(const std::string& key, CacheEntryPtr entry) {
+    size_t charge = entryCharge(key, *entry);
+    CacheShard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.bytes -= entryCharge(key, *it->second->second);
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+    while (!shard.lru.empty() && shard.bytes + charge > shardBudget) {
+        auto& victim = shard.lru.back();
+        shard.bytes -= entryCharge(victim.first, *victim.second);
+        shard.index.erase(victim.first);
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+    shard.lru.emplace_front(key, std::move(entry));
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += charge;
+}
+
+bool cacheWorthCapturing(const std::string& wire) {
+    size_t headLen = 0;
+    size_t start = finalHeadStart(wire, headLen);
+    if (start == std::string::npos) return true; // head not complete yet
+    time_t now = std::time(nullptr);
+    ResponsePolicy p = parsePolicy(wire.data() + start, headLen, now, now);
+    std::string value;
+    if (findHeader(wire.data() + start, headLen, "Content-Length", value) &&
+        std::strtoull(value.c_str(), NULL, 10) > maxObject) return false;
+    return p.storable;
+}
+
+bool cacheStore(const HttpRequest& req, const std::string& wire, long long bodyBytes,
+                time_t requestTime, time_t responseTime) {
+    if (!enabled || wire.size() > maxObject) return false;
+    size_t headLen = 0;
+    size_t start = finalHeadStart(wire, headLen);
+    if (start == std::string::npos) return false;
+
+    const char* head = wire.data() + start;
+    ResponsePolicy p = parsePolicy(head, headLen, requestTime, responseTime);
+    if (!p.storable) return false;
+
+    // Store the head without Age: it is recomputed on every hit.
+    auto stored = std::make_shared<std::string>(cacheStripAge(head, headLen));
+    size_t storedHeadLen = stored->size();
+    stored->append(wire, start + headLen, std::string::npos);
+
+    auto entry = std::make_shared<CachedResponse>();
+    entry->wire = std::move(stored);
+    entry->headLen = storedHeadLen;
+    entry->status = p.status;
+    entry->bodyBytes = bodyBytes;
+    entry->storedAt = responseTime;
+    entry->initialAge = p.initialAge;
+    entry->freshFor = p.freshFor;
+    entry->etag = p.etag;
+    entry->lastModified = p.lastModified;
+    entry->vary = varyValues(req, p.vary);
+    publish(cacheKey(req), std::move(entry));
+    return true;
+}
+
+CacheEntryPtr cacheRefresh(const HttpRequest& req, const CacheEntryPtr& entry,
+                           const char* head, size_t headLen, time_t requestTime, time_t responseTime) {
+    ResponsePolicy p = parsePolicy(head, headLen, requestTime, responseTime);
+    auto refreshed = std::make_shared<CachedResponse>(*entry);
+    refreshed->storedAt = responseTime;
+    refreshed->initialAge = p.initialAge;
+
+    // The 304 only updates freshness when it carries its own freshness information.
+    std::string value;
+    if (findHeader(head, headLen, "Cache-Control", value) || findHeader(head, headLen, "Expires", value)) {
+        refreshed->freshFor = p.freshFor;
+    }
+    if (!p.etag.empty()) refreshed->etag = p.etag;
+    if (!p.lastModified.empty()) refreshed->lastModified = p.lastModified;
+    if (enabled) publish(cacheKey(req), refreshed);
+    return refreshed;
+}
+
+std::string cacheConditionalHeaders(const CachedResponse& entry) {
+    std::string out;
+    if (!entry.etag.empty()) out += "If-None-Match: " + entry.etag + "\r\n";
+    if (!entry.lastModified.empty()) out += "If-Modified-Since: " + entry.lastModified + "\r\n";
+    else if (entry.etag.empty()) out += "If-Modified-Since: " + formatHttpDate(entry.storedAt) + "\r\n";
+    return out;
+}
+
+CacheStats cacheStats() {
+    CacheStats s;
+    for (CacheShard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        s.entries += shard.index.size();
+        s.bytes += shard.bytes;
+        s.hits += shard.hits;
+        s.misses += shard.misses;
+        s.evictions += shard.evictions;
+    }
+    return s;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+/**
+ * @file CircuitBreaker.cpp
+ * @brief Negative cache for failing upstreams: a sharded host:port health
+ *        table with closed / open / half-open circuit breaker states.
+ */
+
+#include "../include/CircuitBreaker.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+typedef std::chrono::steady_clock Clock;
+
+struct UpstreamHealth {
+    enum State { CLOSED, OPEN, HALF_OPEN };
+    State state = CLOSED;
+    int failures = 0;         // consecutive
+    int probesInFlight = 0;
+    int openMs = 0;           // current open period, doubled on every failed probe
+    Clock::time_point openUntil;
+    Clock::time_point lastFailure;
+};
+
+struct HealthShard {
+    std::mutex mtx;
+    std::unordered_map<std::string, UpstreamHealth> table;
+    Clock::time_point nextSweep;
+};
+
+static const int HEALTH_SHARDS = 16;
+static HealthShard shards[HEALTH_SHARDS];
+static CircuitBreakerConfig cfg;
+static bool enabled = false;
+static std::atomic<uint64_t> fastFails{0};
+static std::atomic<uint64_t> trips{0};
+
+void initCircuitBreaker(const CircuitBreakerConfig& config) {
+    cfg = config;
+    if (cfg.halfOpenProbes < 1) cfg.halfOpenProbes = 1;
+    if (cfg.maxOpenMs < cfg.openMs) cfg.maxOpenMs = cfg.openMs;
+    enabled = cfg.failureThreshold > 0 && cfg.openMs > 0;
+    for (HealthShard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.table.clear();
+    }
+}
+
+bool circuitBreakerEnabled() { return enabled; }
+
+static std::string upstreamKey(std::string_view host, std::string_view port) {
+    std::string key;
+    key.reserve(host.size() + port.size() + 1);
+    for (char c : host) key += (char)std::tolower((unsigned char)c);
+    key += ':';
+    key += port;
+    return key;
+}
+
+static HealthShard& shardFor(const std::string& key) {
+    return shards[std::hash<std::string>()(key) % HEALTH_SHARDS];
+}
+
+// Only failures add entries, and only a success removes one. A host that
+// fails and is never asked for again would stay for good, so entries quiet
+// for twice the longest open period, past their open period and with no
+// probe out, are dropped. Runs at most once a second per shard, from the
+// failure path; the caller holds shard.mtx.
+static void sweep(HealthShard& shard, Clock::time_point now) {
+    if (now < shard.nextSweep) return;
+    shard.nextSweep = now + std::chrono::seconds(1);
+    auto idleAfter = std::chrono::milliseconds(2 * (long long)cfg.maxOpenMs);
+    for (auto it = shard.table.begin(); it != shard.table.end();) {
+        const UpstreamHealth& h = it->second;
+        bool idle = h.probesInFlight == 0 && now >= h.openUntil && now - h.lastFailure >= idleAfter;
+        if (idle) it = shard.table.erase(it);
+        else ++it;
+    }
+}
+
+bool upstreamAllow(std::string_view host, std::string_view port, bool& probe) {
+    probe = false;
+    if (!enabled) return true;
+    std::string key = upstreamKey(host, port);
+    HealthShard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.table.find(key);
+    if (it == shard.table.end()) return true; // healthy upstreams have no entry
+
+    UpstreamHealth& h = it->second;
+    if (h.state == UpstreamHealth::OPEN && Clock::now() >= h.openUntil) h.state = UpstreamHealth::HALF_OPEN;
+    if (h.state == UpstreamHealth::HALF_OPEN && h.probesInFlight < cfg.halfOpenProbes) {
+        h.probesInFlight++;
+        probe = true;
+        return true;
+    }
+    if (h.state == UpstreamHealth::CLOSED) return true;
+    fastFails++;
+    return false;
+}
+
+void upstreamResult(std::string_view host, std::string_view port, bool ok, bool probe) {
+    if (!enabled) return;
+    std::string key = upstreamKey(host, port);
+    HealthShard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.table.find(key);
+    if (ok) {
+        if (it == shard.table.end()) return;
+        if (it->second.state != UpstreamHealth::CLOSED) {
+            std::cout << "[CIRCUIT] " << key << " recovered; breaker closed" << std::endl;
+        }
+        shard.table.erase(it);
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (it == shard.table.end()) {
+        sweep(shard, now);
+        it = shard.table.emplace(key, UpstreamHealth()).first;
+    }
+    UpstreamHealth& h = it->second;
+    if (probe && h.probesInFlight > 0) h.probesInFlight--;
+    h.failures++;
+    h.lastFailure = now;
+    bool reopen = probe && h.state == UpstreamHealth::HALF_OPEN;
+    if (reopen || (h.state == UpstreamHealth::CLOSED && h.failures >= cfg.failureThreshold)) {
+        h.openMs = reopen ? std::min(h.openMs * 2, cfg.maxOpenMs) : cfg.openMs;
+        h.state = UpstreamHealth::OPEN;
+        h.openUntil = now + std::chrono::milliseconds(h.openMs);
+        trips++;
+        std::cout << "[CIRCUIT] " << key << " open for " << h.openMs << " ms after " << h.failures
+                  << " consecutive connect failures" << std::endl;
+    }
+}
+
+CircuitBreakerStats circuitBreakerStats() {
+    CircuitBreakerStats s;
+    s.fastFails = fastFails;
+    s.trips = trips;
+    for (HealthShard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        s.tracked += shard.table.size();
+        for (const auto& entry : shard.table) {
+            if (entry.second.state != UpstreamHealth::CLOSED) s.open++;
+        }
+    }
+    return s;
+}
\ No newline at end of file
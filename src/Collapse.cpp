@@ -0,0 +1,106 @@
+/**
+ * @file Collapse.cpp
+ * @brief Collapsed forwarding: one upstream fetch per URL in flight, with
+ *        concurrent identical requests streaming the leader's bytes.
+ */
+
+#include "../include/Collapse.h"
+#include "../include/ProxyCore.h"
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+static int waitMs = 0;
+static size_t maxShared = 0;
+static std::mutex tableMtx;
+static std::unordered_map<std::string, SharedFetchPtr> inFlight;
+
+void initCollapse(int timeoutMs, size_t maxBytes) {
+    waitMs = timeoutMs > 0 ? timeoutMs : 0;
+    maxShared = maxBytes;
+}
+
+bool collapseEnabled() { return waitMs > 0 && maxShared > 0; }
+size_t collapseMaxBytes() { return maxShared; }
+
+SharedFetchPtr collapseJoin(const std::string& key, bool& leader) {
+    std::lock_guard<std::mutex> lock(tableMtx);
+    SharedFetchPtr& slot = inFlight[key];
+    leader = !slot;
+    if (leader) {
+        slot = std::make_shared<SharedFetch>();
+        slot->key = key;
+    }
+    return slot;
+}
+
+// New arrivals stop joining once the leader has declined or finished.
+static void unregister(SharedFetch& fetch) {
+    std::lock_guard<std::mutex> lock(tableMtx);
+    auto it = inFlight.find(fetch.key);
+    if (it != inFlight.end() && it->second.get() == &fetch) inFlight.erase(it);
+}
+
+void collapseStart(SharedFetch& fetch, int status, size_t headLen, size_t bodyLen) {
+    size_t totalBytes = headLen + bodyLen;
+    std::lock_guard<std::mutex> lock(fetch.mtx);
+    fetch.bytes.reset(new char[totalBytes > 0 ? totalBytes : 1]);
+    fetch.capacity = totalBytes;
+    fetch.status = status;
+    fetch.bodyBytes = (long long)bodyLen;
+    fetch.state = SharedFetch::STREAMING;
+    fetch.cv.notify_all();
+}
+
+void collapsePublish(SharedFetch& fetch, const char* data, size_t len) {
+    std::lock_guard<std::mutex> lock(fetch.mtx);
+    if (fetch.state != SharedFetch::STREAMING || fetch.length + len > fetch.capacity) return;
+    std::memcpy(fetch.bytes.get() + fetch.length, data, len);
+    fetch.length += len;
+    fetch.cv.notify_all();
+}
+
+void collapseDecline(SharedFetch& fetch, bool awaitFinish) {
+    unregister(fetch);
+    std::lock_guard<std::mutex> lock(fetch.mtx);
+    if (fetch.state != SharedFetch::WAITING) return;
+    fetch.state = SharedFetch::DECLINED;
+    fetch.awaitFinish = awaitFinish;
+    fetch.cv.notify_all();
+}
+
+void collapseFinish(SharedFetch& fetch, bool complete) {
+    unregister(fetch);
+    std::lock_guard<std::mutex> lock(fetch.mtx);
+    if (fetch.state == SharedFetch::WAITING) fetch.state = SharedFetch::DECLINED;
+    fetch.finished = true;
+    fetch.complete = complete && fetch.length == fetch.capacity;
+    fetch.cv.notify_all();
+}
+
+long long collapseFollow(SOCKET client, SharedFetch& fetch, bool& complete) {
+    complete = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitMs);
+    std::unique_lock<std::mutex> lock(fetch.mtx);
+    if (!fetch.cv.wait_until(lock, deadline, [&] { return fetch.state != SharedFetch::WAITING; })) return -1;
+    if (fetch.state == SharedFetch::DECLINED) {
+        if (fetch.awaitFinish) fetch.cv.wait_until(lock, deadline, [&] { return fetch.finished; });
+        return -1;
+    }
+
+    // The buffer never reallocates, so published bytes can be sent without the lock.
+    size_t sent = 0;
+    while (true) {
+        fetch.cv.wait(lock, [&] { return fetch.length > sent || fetch.finished; });
+        size_t available = fetch.length;
+        if (available == sent) break;
+        const char* data = fetch.bytes.get() + sent;
+        lock.unlock();
+        int ok = sendAll(client, data, (int)(available - sent));
+        lock.lock();
+        if (ok == SOCKET_ERROR) break;
+        sent = available;
+    }
+    complete = fetch.complete && sent == fetch.capacity;
+    return (long long)sent;
+}
\ No newline at end of file
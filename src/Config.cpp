@@ -1,31 +1,360 @@
+/**
+ * @file Config.cpp
+ * @brief server.cfg parsing and validation into an immutable, atomically
+ *        published Settings snapshot.
+ */
+
 #include "../include/Config.h"
+#include <cctype>
+#include <charconv>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <mutex>
 
-std::map<std::string, std::string> Config::settings;
+std::atomic<std::shared_ptr<const Settings>> Config::snapshot;
 
-bool Config::load(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) return false;
+static std::mutex reloadMtx; // one load or reload at a time
+static std::string loadedPath;
+
+// ---------------------------------------------------------------- key tables
+
+struct IntKey {
+    const char* name;
+    int Settings::*field;
+    long long min, max;
+};
+
+// Stored in ms; a bare value is ms.
+struct DurationKey {
+    const char* name;
+    int Settings::*field;
+    long long minMs, maxMs;
+};
+
+// Stored in bytes; a bare value is in `unit` bytes.
+struct SizeKey {
+    const char* name;
+    uint64_t Settings::*field;
+    uint64_t unit;
+    uint64_t min, max;
+};
+
+struct BoolKey {
+    const char* name;
+    bool Settings::*field;
+};
+
+struct StringKey {
+    const char* name;
+    std::string Settings::*field;
+};
+
+static const long long INT_LIMIT = 2147483647;
+static const uint64_t KB = 1024, MB = 1024 * KB, GB = 1024 * MB;
+
+static const IntKey INT_KEYS[] = {
+    { "PORT", &Settings::port, 1, 65535 },
+    { "CACHE_DISK_INDEX_SLOTS", &Settings::cacheDiskIndexSlots, 1, 1 << 28 },
+    { "CIRCUIT_FAILURE_THRESHOLD", &Settings::circuitFailureThreshold, 0, INT_LIMIT },
+    { "CIRCUIT_HALF_OPEN_PROBES", &Settings::circuitHalfOpenProbes, 1, INT_LIMIT },
+    { "RATE_CONN_PER_SEC", &Settings::rateConnPerSec, 0, INT_LIMIT },
+    { "RATE_CONN_BURST", &Settings::rateConnBurst, 0, INT_LIMIT },
+    { "RATE_MAX_CONCURRENT", &Settings::rateMaxConcurrent, 0, INT_LIMIT },
+    { "MAX_CONNECTIONS", &Settings::maxConnections, 0, INT_LIMIT },
+    { "MAX_UPSTREAM_CONNECTS", &Settings::maxUpstreamConnects, 0, INT_LIMIT },
+    { "WORKER_THREADS", &Settings::workerThreads, 0, 100000 },
+    { "WORKER_MAX_THREADS", &Settings::workerMaxThreads, 0, 100000 },
+    { "ASYNC_LOOPS", &Settings::asyncLoops, 0, 1024 },
+    { "METRICS_PORT", &Settings::metricsPort, 0, 65535 },
+};
+
+static const DurationKey DURATION_KEYS[] = {
+    { "COLLAPSE_TIMEOUT_MS", &Settings::collapseTimeoutMs, 0, INT_LIMIT },
+    { "CIRCUIT_OPEN_MS", &Settings::circuitOpenMs, 0, INT_LIMIT },
+    { "CIRCUIT_MAX_OPEN_MS", &Settings::circuitMaxOpenMs, 0, INT_LIMIT },
+    { "RATE_IDLE_MS", &Settings::rateIdleMs, 1, INT_LIMIT },
+    { "HEADER_TIMEOUT_MS", &Settings::headerTimeoutMs, 0, INT_LIMIT },
+    { "CONNECT_TIMEOUT_MS", &Settings::connectTimeoutMs, 0, INT_LIMIT },
+    { "IDLE_TIMEOUT_MS", &Settings::idleTimeoutMs, 0, INT_LIMIT },
+    { "TUNNEL_MAX_LIFETIME_MS", &Settings::tunnelMaxLifetimeMs, 0, INT_LIMIT },
+    { "SHED_TARGET_MS", &Settings::shedTargetMs, 0, INT_LIMIT },
+    { "SHED_INTERVAL_MS", &Settings::shedIntervalMs, 1, INT_LIMIT },
+    { "WORKER_IDLE_MS", &Settings::workerIdleMs, 1, INT_LIMIT },
+    { "LATENCY_MERGE_MS", &Settings::latencyMergeMs, 1, INT_LIMIT },
+    { "RESTART_DRAIN_MS", &Settings::restartDrainMs, 0, INT_LIMIT },
+    { "SHUTDOWN_DRAIN_MS", &Settings::shutdownDrainMs, 0, INT_LIMIT },
+};
+
+static const SizeKey SIZE_KEYS[] = {
+    { "MAX_HEADER_SIZE", &Settings::maxHeaderBytes, 1, 1 * KB, 1 * MB },
+    { "CACHE_MEMORY_MB", &Settings::cacheMemoryBytes, MB, 0, 1024 * GB },
+    { "CACHE_MAX_OBJECT_KB", &Settings::cacheMaxObjectBytes, KB, 0, 1024 * GB },
+    { "CACHE_DISK_MB", &Settings::cacheDiskBytes, MB, 0, 1024 * 1024 * GB },
+    { "CACHE_DISK_SEGMENT_MB", &Settings::cacheDiskSegmentBytes, MB, 1 * MB, 1024 * GB },
+    { "COLLAPSE_MAX_KB", &Settings::collapseMaxBytes, KB, 0, 1024 * GB },
+    { "RATE_KB_PER_SEC", &Settings::rateBytesPerSec, KB, 0, 1024 * GB },
+    { "RATE_KB_BURST", &Settings::rateBytesBurst, KB, 0, 1024 * GB },
+    { "SHAPE_KB_PER_SEC", &Settings::shapeBytesPerSec, KB, 0, 1024 * GB },
+    { "SHAPE_QUANTUM_KB", &Settings::shapeQuantumBytes, KB, 1 * KB, 1 * GB },
+    { "WORKER_STACK_KB", &Settings::workerStackBytes, KB, 64 * KB, 1 * GB },
+};
+
+static const BoolKey BOOL_KEYS[] = {
+    { "RELAY_ADAPTIVE_BUFFERS", &Settings::relayAdaptiveBuffers },
+    { "RELAY_TUNE_SOCKET_BUFFERS", &Settings::relayTuneSocketBuffers },
+    { "LATENCY_HISTOGRAMS", &Settings::latencyHistograms },
+};
+
+static const StringKey STRING_KEYS[] = {
+    { "FILTER_PATH", &Settings::filterPath },
+    { "LOG_PATH", &Settings::logPath },
+    { "CACHE_DISK_PATH", &Settings::cacheDiskPath },
+    { "RATE_LIMIT_RULES", &Settings::rateLimitRules },
+    { "METRICS_ADDRESS", &Settings::metricsAddress },
+    { "RESTART_SOCKET", &Settings::restartSocket },
+};
+
+// Read on every request, so a reload applies them.
+static const char* const RELOADABLE[] = { "FILTER_PATH", "LOG_PATH", "MAX_HEADER_SIZE" };
+
+// ---------------------------------------------------------------- value parsing
+
+static std::string_view trim(std::string_view s) {
+    size_t b = 0, e = s.size();
+    while (b < e && std::isspace((unsigned char)s[b])) b++;
+    while (e > b && std::isspace((unsigned char)s[e - 1])) e--;
+    return s.substr(b, e - b);
+}
+
+static bool equalsNoCase(std::string_view a, const char* b) {
+    size_t n = std::strlen(b);
+    if (a.size() != n) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+// A non-negative integer followed by an optional unit suffix.
+static bool splitNumber(std::string_view v, unsigned long long& n, std::string_view& suffix) {
+    auto r = std::from_chars(v.data(), v.data() + v.size(), n);
+    if (r.ec != std::errc() || r.ptr == v.data()) return false;
+    suffix = trim(v.substr((size_t)(r.ptr - v.data())));
+    return true;
+}
+
+static bool parseInt(std::string_view v, long long& out) {
+    bool negative = !v.empty() && v[0] == '-';
+    unsigned long long n;
+    std::string_view suffix;
+    if (!splitNumber(negative ? v.substr(1) : v, n, suffix) || !suffix.empty() || n > (unsigned long long)INT_LIMIT) {
+        return false;
+    }
+    out = negative ? -(long long)n : (long long)n;
+    return true;
+}
+
+static bool parseDurationMs(std::string_view v, long long& out) {
+    unsigned long long n;
+    std::string_view suffix;
+    if (!splitNumber(v, n, suffix)) return false;
+    unsigned long long mul;
+    if (suffix.empty() || equalsNoCase(suffix, "ms")) mul = 1;
+    else if (equalsNoCase(suffix, "s")) mul = 1000;
+    else if (equalsNoCase(suffix, "m")) mul = 60 * 1000;
+    else if (equalsNoCase(suffix, "h")) mul = 3600 * 1000;
+    else return false;
+    if (n > (unsigned long long)INT_LIMIT / mul) return false;
+    out = (long long)(n * mul);
+    return true;
+}
+
+static bool parseBytes(std::string_view v, uint64_t unit, uint64_t& out) {
+    unsigned long long n;
+    std::string_view suffix;
+    if (!splitNumber(v, n, suffix)) return false;
+    uint64_t mul;
+    if (suffix.empty()) mul = unit;
+    else if (equalsNoCase(suffix, "b")) mul = 1;
+    else if (equalsNoCase(suffix, "k") || equalsNoCase(suffix, "kb")) mul = KB;
+    else if (equalsNoCase(suffix, "m") || equalsNoCase(suffix, "mb")) mul = MB;
+    else if (equalsNoCase(suffix, "g") || equalsNoCase(suffix, "gb")) mul = GB;
+    else return false;
+    if (n > UINT64_MAX / mul) return false;
+    out = n * mul;
+    return true;
+}
 
+static bool parseBool(std::string_view v, bool& out) {
+    for (const char* t : { "1", "true", "on", "yes" }) {
+        if (equalsNoCase(v, t)) {
+            out = true;
+            return true;
+        }
+    }
+    for (const char* f : { "0", "false", "off", "no" }) {
+        if (equalsNoCase(v, f)) {
+            out = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isIPv4(std::string_view v) {
+    int parts = 0;
+    while (true) {
+        unsigned n;
+        auto r = std::from_chars(v.data(), v.data() + v.size(), n);
+        if (r.ec != std::errc() || r.ptr == v.data() || n > 255 || r.ptr - v.data() > 3) return false;
+        parts++;
+        v.remove_prefix((size_t)(r.ptr - v.data()));
+        if (v.empty()) return parts == 4;
+        if (v[0] != '.' || parts == 4) return false;
+        v.remove_prefix(1);
+    }
+}
+
+// Sets one key from its text; an empty string on success, else what is wrong.
+static std::string apply(Settings& s, std::string_view key, std::string_view value) {
+    for (const IntKey& k : INT_KEYS) {
+        if (key != k.name) continue;
+        long long n;
+        if (!parseInt(value, n)) return "expected an integer";
+        if (n < k.min || n > k.max) return "must be between " + std::to_string(k.min) + " and " + std::to_string(k.max);
+        s.*k.field = (int)n;
+        return "";
+    }
+    for (const DurationKey& k : DURATION_KEYS) {
+        if (key != k.name) continue;
+        long long ms;
+        if (!parseDurationMs(value, ms)) return "expected a duration such as 1500, 1500ms, 30s or 2m";
+        if (ms < k.minMs || ms > k.maxMs) {
+            return "must be between " + std::to_string(k.minMs) + " and " + std::to_string(k.maxMs) + " ms";
+        }
+        s.*k.field = (int)ms;
+        return "";
+    }
+    for (const SizeKey& k : SIZE_KEYS) {
+        if (key != k.name) continue;
+        uint64_t bytes;
+        if (!parseBytes(value, k.unit, bytes)) return "expected a size such as 64, 512KB or 16MB";
+        if (bytes < k.min || bytes > k.max) {
+            return "must be between " + std::to_string(k.min) + " and " + std::to_string(k.max) + " bytes";
+        }
+        s.*k.field = bytes;
+        return "";
+    }
+    for (const BoolKey& k : BOOL_KEYS) {
+        if (key != k.name) continue;
+        if (!parseBool(value, s.*k.field)) return "expected 0/1, true/false, on/off or yes/no";
+        return "";
+    }
+    for (const StringKey& k : STRING_KEYS) {
+        if (key != k.name) continue;
+        s.*k.field = std::string(value);
+        return "";
+    }
+    return "unknown setting";
+}
+
+// Rules that span keys.
+static void checkTogether(const Settings& s, std::vector<std::string>& errors) {
+    if (s.filterPath.empty()) errors.push_back("FILTER_PATH: must not be empty");
+    if (s.logPath.empty()) errors.push_back("LOG_PATH: must not be empty");
+    if (!isIPv4(s.metricsAddress)) errors.push_back("METRICS_ADDRESS: expected an IPv4 address");
+    if (s.circuitMaxOpenMs < s.circuitOpenMs) errors.push_back("CIRCUIT_MAX_OPEN_MS: must not be below CIRCUIT_OPEN_MS");
+    if (s.workerMaxThreads != 0 && s.workerMaxThreads < s.workerThreads) {
+        errors.push_back("WORKER_MAX_THREADS: must be 0 or at least WORKER_THREADS");
+    }
+    if (s.metricsPort != 0 && s.metricsPort == s.port) errors.push_back("METRICS_PORT: must differ from PORT");
+}
+
+// ---------------------------------------------------------------- Config
+
+bool Config::parse(const std::string& filename, Settings& out, std::vector<std::string>& errors) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        errors.push_back(filename + ": cannot be read");
+        return false;
+    }
+    Settings s;
     std::string line;
+    int lineNo = 0;
+    size_t before = errors.size();
     while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue; 
-        std::istringstream is_line(line);
-        std::string key, value;
-        if (std::getline(is_line, key, '=') && std::getline(is_line, value)) {
-            Config::settings[key] = value;
+        lineNo++;
+        std::string_view text = trim(line);
+        if (text.empty() || text[0] == '#') continue;
+        size_t eq = text.find('=');
+        std::string where = filename + ":" + std::to_string(lineNo) + ": ";
+        if (eq == std::string_view::npos) {
+            errors.push_back(where + "expected KEY=value");
+            continue;
         }
+        std::string_view key = trim(text.substr(0, eq));
+        std::string problem = apply(s, key, trim(text.substr(eq + 1)));
+        if (!problem.empty()) errors.push_back(where + std::string(key) + ": " + problem);
     }
+    checkTogether(s, errors);
+    if (errors.size() != before) return false;
+    out = std::move(s);
     return true;
 }
 
-int Config::getInt(const std::string& key, int defaultVal) {
-    try {
-        return settings.count(key) ? std::stoi(settings[key]) : defaultVal;
-    } catch (...) { return defaultVal; }
+void Config::publish(const Settings& next) {
+    // Readers still holding the old snapshot keep it alive; the last of them frees it.
+    snapshot.store(std::make_shared<const Settings>(next), std::memory_order_release);
+}
+
+const std::shared_ptr<const Settings>& Config::defaults() {
+    static const std::shared_ptr<const Settings> d = std::make_shared<const Settings>();
+    return d;
 }
 
-std::string Config::getString(const std::string& key, const std::string& defaultVal) {
-    return settings.count(key) ? settings[key] : defaultVal;
+const std::string& Config::path() { return loadedPath; }
+
+bool Config::load(const std::string& filename, std::vector<std::string>* errors) {
+    std::lock_guard<std::mutex> lock(reloadMtx);
+    loadedPath = filename;
+    if (!std::ifstream(filename).is_open()) return false;
+    Settings s;
+    std::vector<std::string> problems;
+    if (!parse(filename, s, problems)) {
+        if (errors) *errors = problems;
+        return false;
+    }
+    publish(s);
+    return true;
+}
+
+bool Config::reload(std::vector<std::string>& errors, std::vector<std::string>& restartOnly) {
+    std::lock_guard<std::mutex> lock(reloadMtx);
+    Settings next;
+    if (!parse(loadedPath, next, errors)) return false;
+    if (!std::ifstream(next.filterPath).is_open()) {
+        errors.push_back("FILTER_PATH: " + next.filterPath + " cannot be read");
+        return false;
+    }
+
+    std::shared_ptr<const Settings> held = current();
+    const Settings& running = *held;
+    auto reloadable = [](const char* name) {
+        for (const char* r : RELOADABLE) {
+            if (std::strcmp(r, name) == 0) return true;
+        }
+        return false;
+    };
+    auto keep = [&](const char* name, auto field) {
+        if (reloadable(name) || next.*field == running.*field) return;
+        next.*field = running.*field;
+        restartOnly.push_back(name);
+    };
+    for (const IntKey& k : INT_KEYS) keep(k.name, k.field);
+    for (const DurationKey& k : DURATION_KEYS) keep(k.name, k.field);
+    for (const SizeKey& k : SIZE_KEYS) keep(k.name, k.field);
+    for (const BoolKey& k : BOOL_KEYS) keep(k.name, k.field);
+    for (const StringKey& k : STRING_KEYS) keep(k.name, k.field);
+    publish(next);
+    return true;
 }
\ No newline at end of file
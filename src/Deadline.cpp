@@ -0,0 +1,135 @@
+/**
+ * @file Deadline.cpp
+ * @brief Connection deadlines on a shared timing wheel, driven by one
+ *        ticker thread. Timer callbacks run under the wheel lock, which is
+ *        what makes stopping a deadline a guarantee that it will not fire.
+ */
+
+#include "../include/Deadline.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+std::atomic<uint64_t> deadlineClockMs{0};
+
+static std::mutex wheelMtx;
+static TimerWheel* wheel = nullptr; // created with the ticker
+static DeadlineConfig cfg;
+static uint64_t expiredCount[DL_KIND_COUNT] = {};
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+// Starts at 1 so a zero lastActivity never reads as "just now".
+static uint64_t nowMs() {
+    return 1 + (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch)
+                   .count();
+}
+
+static int durationMs(DeadlineKind kind) {
+    switch (kind) {
+    case DL_HEADER: return cfg.headerMs;
+    case DL_CONNECT: return cfg.connectMs;
+    case DL_IDLE: return cfg.idleMs;
+    default: return cfg.tunnelMaxMs;
+    }
+}
+
+// Rounds up, so a deadline never fires early.
+static uint64_t tickAt(uint64_t ms) {
+    return (ms + (uint64_t)cfg.tickMs - 1) / (uint64_t)cfg.tickMs;
+}
+
+static void expire(TimerNode* node) {
+    DeadlineTimer& timer = *reinterpret_cast<DeadlineTimer*>(node);
+    ConnDeadlines& d = *timer.owner;
+    if (timer.kind == DL_IDLE) {
+        uint64_t due = d.lastActivity.load(std::memory_order_relaxed) + (uint64_t)cfg.idleMs;
+        if (cfg.idleMs > 0 && due > nowMs()) {
+            wheel->arm(timer.node, tickAt(due));
+            return;
+        }
+    }
+    expiredCount[timer.kind]++;
+    if (timer.kind == DL_HEADER) {
+#ifdef _WIN32
+        send(d.client, HTTP_408.c_str(), (int)HTTP_408.size(), 0);
+#else
+        send(d.client, HTTP_408.c_str(), HTTP_408.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+#endif
+    }
+    if (timer.kind != DL_CONNECT) shutdown(d.client, SD_BOTH);
+    if (d.remote != INVALID_SOCKET) shutdown(d.remote, SD_BOTH);
+}
+
+void initDeadlines(const DeadlineConfig& config) {
+    std::lock_guard<std::mutex> lock(wheelMtx);
+    int tickMs = wheel ? cfg.tickMs : (config.tickMs > 0 ? config.tickMs : 10);
+    cfg = config;
+    cfg.tickMs = tickMs;
+    if (wheel) return;
+    uint64_t start = nowMs();
+    deadlineClockMs.store(start, std::memory_order_relaxed);
+    wheel = new TimerWheel(start / (uint64_t)tickMs);
+    std::thread([tickMs] {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(tickMs));
+            uint64_t now = nowMs();
+            deadlineClockMs.store(now, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(wheelMtx);
+            wheel->advance(now / (uint64_t)tickMs);
+        }
+    }).detach();
+}
+
+bool deadlinesEnabled() {
+    std::lock_guard<std::mutex> lock(wheelMtx);
+    return wheel != nullptr;
+}
+
+ConnDeadlines::ConnDeadlines(SOCKET clientSocket) : client(clientSocket) {
+    for (int k = 0; k < DL_KIND_COUNT; k++) {
+        timers[k].owner = this;
+        timers[k].kind = (DeadlineKind)k;
+        timers[k].node.fire = expire;
+    }
+}
+
+ConnDeadlines::~ConnDeadlines() {
+    deadlineStopAll(*this);
+}
+
+void deadlineStart(ConnDeadlines& d, DeadlineKind kind) {
+    std::lock_guard<std::mutex> lock(wheelMtx);
+    int ms = durationMs(kind);
+    if (!wheel || ms <= 0) return;
+    uint64_t now = nowMs();
+    if (kind == DL_IDLE) d.lastActivity.store(now, std::memory_order_relaxed);
+    wheel->arm(d.timers[kind].node, tickAt(now + (uint64_t)ms));
+}
+
+void deadlineStop(ConnDeadlines& d, DeadlineKind kind) {
+    // Always under the lock: the ticker may be inside this timer's callback.
+    std::lock_guard<std::mutex> lock(wheelMtx);
+    if (wheel) wheel->cancel(d.timers[kind].node);
+}
+
+void deadlineStopAll(ConnDeadlines& d) {
+    for (int k = 0; k < DL_KIND_COUNT; k++) deadlineStop(d, (DeadlineKind)k);
+}
+
+void deadlineWatchRemote(ConnDeadlines& d, SOCKET remote) {
+    std::lock_guard<std::mutex> lock(wheelMtx);
+    d.remote = remote;
+}
+
+DeadlineStats deadlineStats() {
+    std::lock_guard<std::mutex> lock(wheelMtx);
+    DeadlineStats s;
+    if (wheel) s.armed = wheel->size();
+    for (int k = 0; k < DL_KIND_COUNT; k++) s.expired[k] = expiredCount[k];
+    return s;
+}
+
+const char* deadlineKindName(DeadlineKind kind) {
+    static const char* names[DL_KIND_COUNT] = { "header", "connect", "idle", "lifetime" };
+    return names[kind];
+}
\ No newline at end of file
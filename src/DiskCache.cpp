@@ -0,0 +1,506 @@
+/**
+ * @file DiskCache.cpp
+ * @brief Disk-backed response cache tier: append-only segment files, an
+ *        mmap'd hash index that survives restarts, and sendfile() hits.
+ *
+ * Layout under the cache directory:
+ *   index.dat        IndexHeader + slotCount IndexSlots (mmap'd, MAP_SHARED)
+ *   seg-NNNNNNNN.dat records: RecordHeader, key, head (Age stripped), body
+ *
+ * The index is split into PROBE-slot buckets; a key only ever lives in its
+ * own bucket, so each bucket is guarded by one of STRIPES mutexes and no
+ * tombstones are needed. Records are verified against their on-disk header
+ * and key before being served, which also covers slots torn by a crash.
+ */
+
+#include "../include/DiskCache.h"
+#include "../include/ProxyCore.h"
+#include "../include/Framing.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#ifdef _WIN32
+
+struct DiskSegment {};
+
+bool initDiskCache(const DiskCacheConfig& config) {
+    if (!config.dir.empty()) std::cerr << "[WARNING] Disk cache is not supported on Windows; tier disabled." << std::endl;
+    return false;
+}
+void shutdownDiskCache() {}
+bool diskCacheEnabled() { return false; }
+bool diskCacheLookup(const HttpRequest&, time_t, DiskCacheHit&) { return false; }
+long long diskCacheServe(SOCKET, const DiskCacheHit&) { return 0; }
+std::unique_ptr<DiskCacheWriter> diskCacheBegin(const HttpRequest&, const std::string&, uint64_t) { return nullptr; }
+bool diskCacheWrite(DiskCacheWriter&, const char*, size_t) { return false; }
+void diskCacheCommit(DiskCacheWriter&, const CacheMeta&, time_t) {}
+DiskCacheStats diskCacheStats() { return DiskCacheStats(); }
+
+#else
+
+namespace fs = std::filesystem;
+
+struct DiskSegment {
+    uint32_t id = 0;
+    int fd = -1;
+    std::string path;
+    uint64_t size = 0; // bytes reserved so far; guarded by segMtx
+
+    ~DiskSegment() {
+        if (fd >= 0) close(fd);
+    }
+};
+
+static const uint64_t INDEX_MAGIC = 0x5844494458525050ull;
+static const uint64_t RECORD_MAGIC = 0x3143455258525050ull;
+static const uint32_t INDEX_VERSION = 1;
+static const uint32_t PROBE = 16;
+static const int STRIPES = 64;
+
+struct IndexHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t nextSegment;
+    uint32_t reserved[11];
+};
+
+struct IndexSlot {
+    uint64_t keyHash; // 0 = empty
+    uint64_t recordOffset;
+    uint64_t bodyOffset;
+    uint64_t bodyLen;
+    int64_t storedAt;
+    int64_t initialAge;
+    int64_t freshFor;
+    uint32_t segment;
+    uint32_t status;
+    uint32_t headLen;
+    uint32_t keyLen;
+};
+
+struct RecordHeader {
+    uint64_t magic;
+    uint64_t keyHash;
+    uint32_t keyLen;
+    uint32_t headLen;
+    uint64_t bodyLen;
+};
+
+static DiskCacheConfig cfg;
+// Cleared by shutdownDiskCache() while it holds segMtx and every stripe, so
+// code that re-checks it under a stripe may touch the mapping until it lets go.
+static std::atomic<bool> enabled{false};
+static uint32_t bucketCount = 1; // slotCount / PROBE, readable without the mapping
+
+static int indexFd = -1;
+static size_t indexMapLen = 0;
+static IndexHeader* indexHeader = nullptr;
+static IndexSlot* slots = nullptr;
+static std::mutex stripes[STRIPES];
+
+static std::mutex segMtx;
+static std::map<uint32_t, std::shared_ptr<DiskSegment>> segments; // id order == age order
+static std::shared_ptr<DiskSegment> active;
+static uint64_t totalBytes = 0;
+
+static std::atomic<uint64_t> hitCount{0};
+static std::atomic<uint64_t> evictedCount{0};
+
+static uint64_t hashKey(const std::string& key) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h ? h : 1;
+}
+
+static uint32_t bucketOf(uint64_t hash) {
+    return (uint32_t)(hash % bucketCount);
+}
+
+static std::string segmentPath(uint32_t id) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%08u.dat", id);
+    return (fs::path(cfg.dir) / name).string();
+}
+
+static bool writeFully(int fd, const char* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, (off_t)offset);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+static bool readFully(int fd, char* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, data, len, (off_t)offset);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+// Drops every index slot that points into segment `id`.
+static void forgetSegment(uint32_t id) {
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        std::lock_guard<std::mutex> lock(stripes[b % STRIPES]);
+        if (!enabled) return;
+        IndexSlot* bucket = slots + (size_t)b * PROBE;
+        for (uint32_t i = 0; i < PROBE; i++) {
+            if (bucket[i].keyHash && bucket[i].segment == id) bucket[i].keyHash = 0;
+        }
+    }
+}
+
+// Caller holds segMtx. Removes the oldest non-active segments until the
+// budget is respected and returns them for index cleanup outside the lock.
+static std::vector<std::shared_ptr<DiskSegment>> evictLocked() {
+    std::vector<std::shared_ptr<DiskSegment>> victims;
+    while (totalBytes > cfg.budgetBytes && segments.size() > 1) {
+        auto oldest = segments.begin();
+        if (oldest->second == active) break;
+        totalBytes -= oldest->second->size;
+        victims.push_back(oldest->second);
+        segments.erase(oldest);
+    }
+    return victims;
+}
+
+static void dropSegments(const std::vector<std::shared_ptr<DiskSegment>>& victims) {
+    // Open hits keep their own shared_ptr (and fd), so unlinking is safe.
+    for (const auto& seg : victims) {
+        forgetSegment(seg->id);
+        unlink(seg->path.c_str());
+        evictedCount++;
+    }
+}
+
+// Caller holds segMtx.
+static bool rollSegmentLocked() {
+    auto seg = std::make_shared<DiskSegment>();
+    seg->id = indexHeader->nextSegment++;
+    seg->path = segmentPath(seg->id);
+    seg->fd = open(seg->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (seg->fd < 0) return false;
+    segments[seg->id] = seg;
+    active = seg;
+    return true;
+}
+
+bool initDiskCache(const DiskCacheConfig& config) {
+    shutdownDiskCache();
+    if (config.dir.empty() || config.budgetBytes == 0) return false;
+    cfg = config;
+    cfg.indexSlots = (cfg.indexSlots / PROBE) * PROBE;
+    if (cfg.indexSlots < PROBE) cfg.indexSlots = PROBE;
+
+    std::error_code ec;
+    fs::create_directories(cfg.dir, ec);
+    std::string indexPath = (fs::path(cfg.dir) / "index.dat").string();
+    indexFd = open(indexPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (indexFd < 0) {
+        std::cerr << "[ERROR] Could not open disk cache index: " << indexPath << std::endl;
+        return false;
+    }
+
+    indexMapLen = sizeof(IndexHeader) + (size_t)cfg.indexSlots * sizeof(IndexSlot);
+    struct stat st;
+    bool fresh = fstat(indexFd, &st) != 0 || (size_t)st.st_size != indexMapLen;
+    if (fresh && (ftruncate(indexFd, 0) != 0 || ftruncate(indexFd, (off_t)indexMapLen) != 0)) {
+        close(indexFd);
+        indexFd = -1;
+        return false;
+    }
+    void* map = mmap(NULL, indexMapLen, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+    if (map == MAP_FAILED) {
+        close(indexFd);
+        indexFd = -1;
+        return false;
+    }
+    indexHeader = (IndexHeader*)map;
+    slots = (IndexSlot*)((char*)map + sizeof(IndexHeader));
+    if (fresh || indexHeader->magic != INDEX_MAGIC || indexHeader->version != INDEX_VERSION ||
+        indexHeader->slotCount != cfg.indexSlots) {
+        std::memset(map, 0, indexMapLen);
+        indexHeader->magic = INDEX_MAGIC;
+        indexHeader->version = INDEX_VERSION;
+        indexHeader->slotCount = cfg.indexSlots;
+        indexHeader->nextSegment = 1;
+    }
+    bucketCount = cfg.indexSlots / PROBE;
+
+    // Reopen surviving segments; new records always go to a fresh segment so a
+    // torn tail from an unclean shutdown is never appended to.
+    std::vector<std::shared_ptr<DiskSegment>> victims;
+    {
+        std::lock_guard<std::mutex> lock(segMtx);
+        for (const auto& entry : fs::directory_iterator(cfg.dir, ec)) {
+            std::string name = entry.path().filename().string();
+            unsigned id;
+            if (std::sscanf(name.c_str(), "seg-%08u.dat", &id) != 1) continue;
+            auto seg = std::make_shared<DiskSegment>();
+            seg->id = id;
+            seg->path = entry.path().string();
+            seg->fd = open(seg->path.c_str(), O_RDWR);
+            if (seg->fd < 0) continue;
+            seg->size = (uint64_t)fs::file_size(entry.path(), ec);
+            totalBytes += seg->size;
+            segments[id] = seg;
+            if (id >= indexHeader->nextSegment) indexHeader->nextSegment = id + 1;
+        }
+        if (!rollSegmentLocked()) return false;
+        enabled = true;
+        victims = evictLocked();
+    }
+    dropSegments(victims);
+    return true;
+}
+
+// Safe while handlers are still serving: with segMtx and every stripe held,
+// no one is inside the mapping, and anyone arriving later sees `enabled`
+// false. Hits already found keep their segment's descriptor.
+void shutdownDiskCache() {
+    std::lock_guard<std::mutex> lock(segMtx);
+    std::unique_lock<std::mutex> held[STRIPES];
+    for (int i = 0; i < STRIPES; i++) held[i] = std::unique_lock<std::mutex>(stripes[i]);
+    enabled = false;
+    if (indexHeader) {
+        msync(indexHeader, indexMapLen, MS_SYNC);
+        munmap(indexHeader, indexMapLen);
+        indexHeader = nullptr;
+        slots = nullptr;
+    }
+    if (indexFd >= 0) close(indexFd);
+    indexFd = -1;
+    segments.clear();
+    active.reset();
+    totalBytes = 0;
+}
+
+bool diskCacheEnabled() { return enabled; }
+
+bool diskCacheLookup(const HttpRequest& req, time_t now, DiskCacheHit& hit) {
+    if (!enabled) return false;
+    // A client asking for revalidation goes to the origin; the memory tier handles it.
+    std::string value;
+    if ((findHeader(req.raw.data(), req.headerLen, "Cache-Control", value) &&
+         (value.find("no-cache") != std::string::npos || value.find("max-age=0") != std::string::npos)) ||
+        (findHeader(req.raw.data(), req.headerLen, "Pragma", value) && value.find("no-cache") != std::string::npos)) {
+        return false;
+    }
+    std::string key = cacheKey(req);
+    uint64_t hash = hashKey(key);
+    uint32_t b = bucketOf(hash);
+
+    IndexSlot slot{};
+    {
+        std::lock_guard<std::mutex> lock(stripes[b % STRIPES]);
+        if (!enabled) return false;
+        IndexSlot* bucket = slots + (size_t)b * PROBE;
+        for (uint32_t i = 0; i < PROBE; i++) {
+            if (bucket[i].keyHash == hash) {
+                slot = bucket[i];
+                break;
+            }
+        }
+    }
+    if (!slot.keyHash || slot.keyLen != key.size()) return false;
+
+    long long age = slot.initialAge + (now > slot.storedAt ? (long long)(now - slot.storedAt) : 0);
+    if (age >= slot.freshFor) return false;
+
+    std::shared_ptr<DiskSegment> seg;
+    {
+        std::lock_guard<std::mutex> lock(segMtx);
+        auto it = segments.find(slot.segment);
+        if (it == segments.end()) return false;
+        seg = it->second;
+    }
+
+    // Verify the record itself before trusting the slot.
+    std::string buf(sizeof(RecordHeader) + slot.keyLen + slot.headLen, '\0');
+    if (!readFully(seg->fd, &buf[0], buf.size(), slot.recordOffset)) return false;
+    RecordHeader rh;
+    std::memcpy(&rh, buf.data(), sizeof(rh));
+    if (rh.magic != RECORD_MAGIC || rh.keyHash != hash || rh.keyLen != slot.keyLen ||
+        rh.headLen != slot.headLen || rh.bodyLen != slot.bodyLen ||
+        buf.compare(sizeof(RecordHeader), key.size(), key) != 0) {
+        return false;
+    }
+
+    hit.segment = seg;
+    hit.head = buf.substr(sizeof(RecordHeader) + slot.keyLen);
+    hit.bodyOffset = slot.bodyOffset;
+    hit.bodyLen = slot.bodyLen;
+    hit.age = age;
+    hit.status = (int)slot.status;
+    hitCount++;
+    return true;
+}
+
+long long diskCacheServe(SOCKET client, const DiskCacheHit& hit) {
+    if (hit.head.size() < 4) return 0;
+    std::string age = "Age: " + std::to_string(hit.age) + "\r\n";
+    IoSlice parts[3] = {
+        { hit.head.data(), hit.head.size() - 2 },
+        { age.data(), age.size() },
+        { hit.head.data() + hit.head.size() - 2, 2 },
+    };
+    if (sendAllv(client, parts, 3) == SOCKET_ERROR) return 0;
+    long long sent = (long long)(hit.head.size() + age.size());
+
+    uint64_t offset = hit.bodyOffset;
+    uint64_t remaining = hit.bodyLen;
+#ifdef __linux__
+    while (remaining > 0) {
+        off_t off = (off_t)offset;
+        size_t want = remaining < (1u << 30) ? (size_t)remaining : (1u << 30);
+        ssize_t n = sendfile(client, hit.segment->fd, &off, want);
+        if (n <= 0) break;
+        offset += (uint64_t)n;
+        remaining -= (uint64_t)n;
+        sent += n;
+    }
+#else
+    char buffer[65536];
+    while (remaining > 0) {
+        size_t want = remaining < sizeof(buffer) ? (size_t)remaining : sizeof(buffer);
+        ssize_t n = pread(hit.segment->fd, buffer, want, (off_t)offset);
+        if (n <= 0 || sendAll(client, buffer, (int)n) == SOCKET_ERROR) break;
+        offset += (uint64_t)n;
+        remaining -= (uint64_t)n;
+        sent += n;
+    }
+#endif
+    return sent;
+}
+
+std::unique_ptr<DiskCacheWriter> diskCacheBegin(const HttpRequest& req, const std::string& head, uint64_t bodyLen) {
+    if (!enabled || head.size() < 4) return nullptr;
+    auto w = std::make_unique<DiskCacheWriter>();
+    w->key = cacheKey(req);
+    w->keyHash = hashKey(w->key);
+    std::string stored = cacheStripAge(head.data(), head.size());
+    w->headLen = (uint32_t)stored.size();
+    w->bodyLen = bodyLen;
+
+    uint64_t recordSize = sizeof(RecordHeader) + w->key.size() + stored.size() + bodyLen;
+    if (recordSize > cfg.budgetBytes / 2) return nullptr;
+
+    std::vector<std::shared_ptr<DiskSegment>> victims;
+    {
+        std::lock_guard<std::mutex> lock(segMtx);
+        if (!enabled) return nullptr;
+        if (active->size > 0 && active->size + recordSize > cfg.segmentBytes) {
+            if (!rollSegmentLocked()) return nullptr;
+        }
+        w->segment = active;
+        w->recordOffset = active->size;
+        active->size += recordSize;
+        totalBytes += recordSize;
+        victims = evictLocked();
+    }
+    dropSegments(victims);
+
+    RecordHeader rh{ RECORD_MAGIC, w->keyHash, (uint32_t)w->key.size(), w->headLen, bodyLen };
+    std::string prefix((const char*)&rh, sizeof(rh));
+    prefix += w->key;
+    prefix += stored;
+    w->bodyOffset = w->recordOffset + prefix.size();
+    if (!writeFully(w->segment->fd, prefix.data(), prefix.size(), w->recordOffset)) return nullptr;
+    return w;
+}
+
+bool diskCacheWrite(DiskCacheWriter& w, const char* data, size_t len) {
+    if (w.failed || w.written + len > w.bodyLen) {
+        w.failed = true;
+        return false;
+    }
+    if (!writeFully(w.segment->fd, data, len, w.bodyOffset + w.written)) {
+        w.failed = true;
+        return false;
+    }
+    w.written += len;
+    return true;
+}
+
+void diskCacheCommit(DiskCacheWriter& w, const CacheMeta& meta, time_t storedAt) {
+    if (!enabled || w.failed || w.written != w.bodyLen) return;
+    uint32_t b = bucketOf(w.keyHash);
+    std::lock_guard<std::mutex> lock(stripes[b % STRIPES]);
+    if (!enabled) return;
+    IndexSlot* bucket = slots + (size_t)b * PROBE;
+
+    // Same key, else an empty slot, else the entry that was stored longest ago.
+    IndexSlot* target = nullptr;
+    for (uint32_t i = 0; i < PROBE && !target; i++) {
+        if (bucket[i].keyHash == w.keyHash) target = &bucket[i];
+    }
+    for (uint32_t i = 0; i < PROBE && !target; i++) {
+        if (bucket[i].keyHash == 0) target = &bucket[i];
+    }
+    if (!target) {
+        target = &bucket[0];
+        for (uint32_t i = 1; i < PROBE; i++) {
+            if (bucket[i].storedAt < target->storedAt) target = &bucket[i];
+        }
+    }
+
+    target->keyHash = 0; // invalidate while the slot is rewritten
+    target->recordOffset = w.recordOffset;
+    target->bodyOffset = w.bodyOffset;
+    target->bodyLen = w.bodyLen;
+    target->storedAt = (int64_t)storedAt;
+    target->initialAge = meta.initialAge;
+    target->freshFor = meta.freshFor;
+    target->segment = w.segment->id;
+    target->status = (uint32_t)meta.status;
+    target->headLen = w.headLen;
+    target->keyLen = (uint32_t)w.key.size();
+    target->keyHash = w.keyHash;
+}
+
+DiskCacheStats diskCacheStats() {
+    DiskCacheStats s;
+    s.hits = hitCount;
+    s.evictedSegments = evictedCount;
+    {
+        std::lock_guard<std::mutex> lock(segMtx);
+        s.segments = segments.size();
+        s.bytes = totalBytes;
+    }
+    if (!enabled) return s;
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        std::lock_guard<std::mutex> lock(stripes[b % STRIPES]);
+        if (!enabled) break;
+        for (uint32_t i = 0; i < PROBE; i++) {
+            if (slots[(size_t)b * PROBE + i].keyHash) s.entries++;
+        }
+    }
+    return s;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,372 @@
+/**
+ * @file EventLoop.cpp
+ * @brief epoll executor, socket awaitables and the pooled coroutine frame
+ *        allocator behind the async connection handler.
+ */
+
+#include "../include/EventLoop.h"
+#include "../include/WorkerPool.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <thread>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+// Frames are rounded up to 64 bytes and kept on per-thread free lists up to
+// 4 KB; bigger frames are rare and go straight to the global allocator. A
+// loop thread frees what it allocated, so the lists never need a lock.
+static const size_t FRAME_GRAIN = 64;
+static const size_t FRAME_CLASSES = 64;
+static const size_t FRAME_CACHE_PER_CLASS = 4096;
+
+struct FreeFrame {
+    FreeFrame* next;
+};
+
+struct FrameCache {
+    FreeFrame* heads[FRAME_CLASSES] = {};
+    size_t counts[FRAME_CLASSES] = {};
+    ~FrameCache() {
+        for (size_t c = 0; c < FRAME_CLASSES; c++) {
+            while (FreeFrame* f = heads[c]) {
+                heads[c] = f->next;
+                ::operator delete(f);
+            }
+        }
+    }
+};
+
+static thread_local FrameCache frameCache;
+static std::atomic<uint64_t> framesLive{0};
+static std::atomic<uint64_t> frameBytesLive{0};
+static std::atomic<uint64_t> framesAllocated{0};
+static std::atomic<uint64_t> framesReused{0};
+
+void* coroFrameAlloc(size_t size) {
+    size_t cls = (size + FRAME_GRAIN - 1) / FRAME_GRAIN;
+    framesLive.fetch_add(1, std::memory_order_relaxed);
+    frameBytesLive.fetch_add(size, std::memory_order_relaxed);
+    framesAllocated.fetch_add(1, std::memory_order_relaxed);
+    if (cls >= FRAME_CLASSES) return ::operator new(size);
+    if (FreeFrame* f = frameCache.heads[cls]) {
+        frameCache.heads[cls] = f->next;
+        frameCache.counts[cls]--;
+        framesReused.fetch_add(1, std::memory_order_relaxed);
+        return f;
+    }
+    return ::operator new(cls * FRAME_GRAIN);
+}
+
+void coroFrameFree(void* p, size_t size) {
+    size_t cls = (size + FRAME_GRAIN - 1) / FRAME_GRAIN;
+    framesLive.fetch_sub(1, std::memory_order_relaxed);
+    frameBytesLive.fetch_sub(size, std::memory_order_relaxed);
+    if (cls >= FRAME_CLASSES || frameCache.counts[cls] >= FRAME_CACHE_PER_CLASS) {
+        ::operator delete(p);
+        return;
+    }
+    FreeFrame* f = static_cast<FreeFrame*>(p);
+    f->next = frameCache.heads[cls];
+    frameCache.heads[cls] = f;
+    frameCache.counts[cls]++;
+}
+
+CoroFrameStats coroFrameStats() {
+    CoroFrameStats s;
+    s.live = framesLive.load(std::memory_order_relaxed);
+    s.liveBytes = frameBytesLive.load(std::memory_order_relaxed);
+    s.allocated = framesAllocated.load(std::memory_order_relaxed);
+    s.reused = framesReused.load(std::memory_order_relaxed);
+    return s;
+}
+
+// Starts eagerly, frees its own frame when done and tells the group, if any.
+struct TaskRunner {
+    struct promise_type : FramePooled {
+        TaskRunner get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    static TaskRunner run(TaskGroup* group, Task<void> task) {
+        co_await task;
+        if (group && --group->pending == 0 && group->waiter) {
+            std::coroutine_handle<> waiter = std::exchange(group->waiter, {});
+            waiter.resume();
+        }
+    }
+};
+
+void spawnDetached(Task<void> task) {
+    TaskRunner::run(nullptr, std::move(task));
+}
+
+void TaskGroup::spawn(Task<void> task) {
+    pending++;
+    TaskRunner::run(this, std::move(task));
+}
+
+#ifdef __linux__
+
+EventLoop::EventLoop() {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd < 0 || wakeFd < 0) {
+        if (epfd >= 0) close(epfd);
+        if (wakeFd >= 0) close(wakeFd);
+        epfd = wakeFd = -1;
+        return;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr; // the wake-up descriptor
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+}
+
+EventLoop::~EventLoop() {
+    if (epfd >= 0) close(epfd);
+    if (wakeFd >= 0) close(wakeFd);
+    for (IoWatch* w : spare) delete w;
+    for (IoWatch* w : retired) delete w;
+}
+
+void EventLoop::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(postMtx);
+        posted.push_back(std::move(fn));
+    }
+    uint64_t one = 1;
+    ssize_t rc = write(wakeFd, &one, sizeof(one));
+    (void)rc; // a full counter still leaves the loop woken
+}
+
+IoWatch* EventLoop::watch(SOCKET s) {
+    IoWatch* w;
+    if (!spare.empty()) {
+        w = spare.back();
+        spare.pop_back();
+        *w = IoWatch();
+    } else {
+        w = new IoWatch();
+    }
+    w->fd = s;
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = w;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, s, &ev) != 0) {
+        spare.push_back(w);
+        return nullptr;
+    }
+    active++;
+    return w;
+}
+
+void EventLoop::unwatch(IoWatch* w) {
+    if (!w) return;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, w->fd, nullptr);
+    w->fd = INVALID_SOCKET;
+    w->reader = w->writer = {};
+    retired.push_back(w);
+    active--;
+}
+
+void EventLoop::run() {
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+    std::vector<std::function<void()>> work;
+    while (true) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            IoWatch* w = static_cast<IoWatch*>(events[i].data.ptr);
+            if (!w) {
+                uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0) {}
+                std::lock_guard<std::mutex> lock(postMtx);
+                work.swap(posted);
+                continue;
+            }
+            if (w->fd == INVALID_SOCKET) continue; // unwatched earlier in this batch
+            uint32_t e = events[i].events;
+            // Errors and hang-ups wake both sides; the next syscall reports them.
+            // Both handles are taken first: resuming the reader may end the
+            // connection, and the watch with it.
+            std::coroutine_handle<> reader, writer;
+            if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                w->readable = true;
+                reader = std::exchange(w->reader, {});
+            }
+            if (e & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                w->writable = true;
+                writer = std::exchange(w->writer, {});
+            }
+            if (reader) reader.resume();
+            if (writer) writer.resume();
+        }
+        for (auto& fn : work) fn();
+        work.clear();
+        // Nothing from this batch can name the retired watches any more.
+        spare.insert(spare.end(), retired.begin(), retired.end());
+        retired.clear();
+    }
+}
+
+Task<int> asyncRecv(IoWatch& w, char* buf, int len) {
+    while (true) {
+        ssize_t n = recv(w.fd, buf, (size_t)len, MSG_DONTWAIT);
+        if (n >= 0) co_return (int)n;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) co_return SOCKET_ERROR;
+        w.readable = false;
+        co_await IoWait{ w, false };
+    }
+}
+
+Task<int> asyncRecvBuffered(IoWatch& w, PooledBuffer& buf, BufferClass c) {
+    while (true) {
+        if (!w.readable) {
+            buf.release();
+            co_await IoWait{ w, false };
+        }
+        char* p = buf.acquire(c);
+        ssize_t n = recv(w.fd, p, buf.size(), MSG_DONTWAIT);
+        if (n >= 0) co_return (int)n;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) co_return SOCKET_ERROR;
+        w.readable = false;
+    }
+}
+
+Task<int> asyncSendAll(IoWatch& w, const char* buf, int len) {
+    int total = 0;
+    while (total < len) {
+        ssize_t n = send(w.fd, buf + total, (size_t)(len - total), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            total += (int)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) co_return SOCKET_ERROR;
+        w.writable = false;
+        co_await IoWait{ w, true };
+    }
+    co_return total;
+}
+
+Task<int> asyncSendAllv(IoWatch& w, IoSlice* slices, int count) {
+    const int MAX_IOV = 16;
+    int total = 0;
+    while (count > 0) {
+        int batch = count < MAX_IOV ? count : MAX_IOV;
+        iovec iov[MAX_IOV];
+        for (int i = 0; i < batch; i++) {
+            iov[i].iov_base = const_cast<char*>(slices[i].data);
+            iov[i].iov_len = slices[i].len;
+        }
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = batch;
+        ssize_t n = sendmsg(w.fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            w.writable = false;
+            co_await IoWait{ w, true };
+            continue;
+        }
+        if (n <= 0) co_return SOCKET_ERROR;
+        size_t sent = (size_t)n;
+        total += (int)sent;
+        while (count > 0 && sent >= slices->len) {
+            sent -= slices->len;
+            slices++;
+            count--;
+        }
+        if (count > 0) {
+            slices->data += sent;
+            slices->len -= sent;
+        }
+    }
+    co_return total;
+}
+
+Task<bool> asyncConnect(IoWatch& w, const sockaddr* addr, int addrLen) {
+    if (connect(w.fd, addr, (socklen_t)addrLen) == 0) co_return true;
+    if (errno != EINPROGRESS) co_return false;
+    w.writable = false;
+    co_await IoWait{ w, true };
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    co_return getsockopt(w.fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0;
+}
+
+#else
+
+// No epoll: the async handler reports itself unavailable (see valid()).
+EventLoop::EventLoop() {}
+EventLoop::~EventLoop() {}
+void EventLoop::post(std::function<void()> fn) { (void)fn; }
+IoWatch* EventLoop::watch(SOCKET s) { (void)s; return nullptr; }
+void EventLoop::unwatch(IoWatch* w) { (void)w; }
+void EventLoop::run() {}
+
+Task<int> asyncRecv(IoWatch& w, char* buf, int len) { co_return recv(w.fd, buf, len, 0); }
+Task<int> asyncRecvBuffered(IoWatch& w, PooledBuffer& buf, BufferClass c) {
+    co_return recv(w.fd, buf.acquire(c), (int)bufferClassSize(c), 0);
+}
+Task<int> asyncSendAll(IoWatch& w, const char* buf, int len) { co_return send(w.fd, buf, len, 0); }
+Task<int> asyncSendAllv(IoWatch& w, IoSlice* slices, int count) { (void)w; (void)slices; (void)count; co_return SOCKET_ERROR; }
+Task<bool> asyncConnect(IoWatch& w, const sockaddr* addr, int addrLen) { co_return connect(w.fd, addr, addrLen) == 0; }
+
+#endif
+
+// Lives in the awaiting coroutine's frame until the resolver thread posts
+// the resumption back to the loop.
+struct ResolveAwait {
+    EventLoop& loop;
+    const char* host;
+    const char* port;
+    sockaddr_in& out;
+    int rc = 0;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        auto lookup = [this, h] {
+            addrinfo hints{}, *res = nullptr;
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+            rc = getaddrinfo(host, port, &hints, &res);
+            if (rc == 0) {
+                out = *(const sockaddr_in*)res->ai_addr;
+                freeaddrinfo(res);
+            }
+            loop.post([h] { h.resume(); });
+        };
+        if (workerPoolEnabled()) poolSubmit(lookup);
+        else std::thread(lookup).detach();
+    }
+    int await_resume() const noexcept { return rc; }
+};
+
+Task<int> asyncResolve(EventLoop& loop, const char* host, const char* port, sockaddr_in& out) {
+    // A literal address needs no lookup, and no thread.
+    out.sin_family = AF_INET;
+    if (inet_pton(AF_INET, host, &out.sin_addr) == 1) {
+        char* end = nullptr;
+        long p = std::strtol(port, &end, 10);
+        if (*port && *end == '\0' && p > 0 && p < 65536) {
+            out.sin_port = htons((u_short)p);
+            co_return 0;
+        }
+    }
+    co_return co_await ResolveAwait{ loop, host, port, out };
+}
\ No newline at end of file
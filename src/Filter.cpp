@@ -3,9 +3,10 @@
 #include <set>
 #include <iostream>
 #include <algorithm>
+#include <memory_resource>
 #include <mutex>
 
-std::set<std::string> blockedDomains;
+std::set<std::string, std::less<>> blockedDomains;
 std::mutex filterMtx;
 
 std::string normalize(std::string str) {
@@ -16,36 +17,49 @@ std::string normalize(std::string str) {
     return str;
 }
 
-void loadFilters(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(filterMtx);
+bool loadFilters(const std::string& filename) {
     std::ifstream file(filename);
-    std::string line;
-    
-    blockedDomains.clear();
-    if (file.is_open()) {
-        while (std::getline(file, line)) {
-            std::string clean = normalize(line);
-            if (!clean.empty()) blockedDomains.insert(clean);
-        }
-        std::cout << "[INIT] Filter list loaded: " << blockedDomains.size() << " domains." << std::endl;
-    } else {
+    if (!file.is_open()) {
         std::cerr << "[ERROR] Could not find filter file: " << filename << std::endl;
+        return false;
+    }
+    // Built outside the lock; lookups see the old list or the new one, never a partial one.
+    std::set<std::string, std::less<>> fresh;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string clean = normalize(line);
+        if (!clean.empty()) fresh.insert(clean);
     }
+    if (file.bad()) {
+        std::cerr << "[ERROR] Could not read filter file: " << filename << std::endl;
+        return false;
+    }
+    size_t count = fresh.size();
+    {
+        std::lock_guard<std::mutex> lock(filterMtx);
+        blockedDomains.swap(fresh);
+    }
+    std::cout << "[INIT] Filter list loaded: " << count << " domains." << std::endl;
+    return true; // the old list is freed here, outside the lock
 }
 
-bool isBlocked(std::string host) {
+bool isBlocked(std::string_view host) {
+    // normalize() into a stack buffer: a DNS name fits, a longer one spills to the heap.
+    size_t first = host.find_first_not_of(" \t\r\n");
+    if (first == std::string_view::npos) return false;
+    host = host.substr(first, host.find_last_not_of(" \t\r\n") + 1 - first);
+    char buffer[256];
+    std::pmr::monotonic_buffer_resource mr(buffer, sizeof(buffer));
+    std::pmr::string lowered(host, &mr);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+    std::string_view name = lowered;
+
     std::lock_guard<std::mutex> lock(filterMtx);
-    host = normalize(host);
-    
-    if (blockedDomains.count(host)) return true;
-    
-    for (const auto& blocked : blockedDomains) {
-        std::string suffix = "." + blocked;
-        if (host.length() > suffix.length()) {
-            if (host.compare(host.length() - suffix.length(), suffix.length(), suffix) == 0) {
-                return true;
-            }
-        }
+    if (blockedDomains.count(name)) return true;
+
+    // A subdomain: the part after any dot but a leading one is a blocked entry.
+    for (size_t dot = name.find('.', 1); dot != std::string_view::npos; dot = name.find('.', dot + 1)) {
+        if (blockedDomains.count(name.substr(dot + 1))) return true;
     }
     return false;
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+/**
+ * @file Framing.cpp
+ * @brief Streaming HTTP/1.1 message framing: chunked transfer coding and
+ *        response body delimitation (Content-Length, chunked, close, no body).
+ */
+
+#include "../include/Framing.h"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#endif
+
+bool headerNameIs(const char* line, size_t lineLen, const char* name, size_t nameLen) {
+    return lineLen > nameLen && line[nameLen] == ':' && strncasecmp(line, name, nameLen) == 0;
+}
+
+bool findHeader(const char* head, size_t headLen, const char* name, std::string& value) {
+    size_t nameLen = std::strlen(name);
+    const char* end = head + headLen;
+    const char* line = (const char*)std::memchr(head, '\n', headLen);
+    while (line && ++line < end) {
+        const char* eol = (const char*)std::memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        size_t len = eol - line;
+        if (len > 0 && line[len - 1] == '\r') len--;
+        if (len == 0) break;
+        if (headerNameIs(line, len, name, nameLen)) {
+            const char* v = line + nameLen + 1;
+            const char* vend = line + len;
+            while (v < vend && (*v == ' ' || *v == '\t')) v++;
+            while (vend > v && (vend[-1] == ' ' || vend[-1] == '\t')) vend--;
+            value.assign(v, vend - v);
+            return true;
+        }
+        line = eol;
+    }
+    return false;
+}
+
+bool nextListToken(const char*& value, const char* end, const char*& token, size_t& tokenLen) {
+    while (value < end) {
+        const char* comma = (const char*)std::memchr(value, ',', end - value);
+        const char* stop = comma ? comma : end;
+        const char* b = value;
+        const char* e = stop;
+        value = comma ? comma + 1 : end;
+        while (b < e && (*b == ' ' || *b == '\t')) b++;
+        while (e > b && (e[-1] == ' ' || e[-1] == '\t')) e--;
+        if (b < e) {
+            token = b;
+            tokenLen = e - b;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool lastCodingIsChunked(const char* value, size_t len) {
+    const char* end = value + len;
+    const char* token = nullptr;
+    size_t tokenLen = 0;
+    const char* t;
+    size_t n;
+    while (nextListToken(value, end, t, n)) {
+        token = t;
+        tokenLen = n;
+    }
+    return tokenLen == 7 && strncasecmp(token, "chunked", 7) == 0;
+}
+
+bool headerHasToken(const char* value, size_t len, const char* token) {
+    const char* end = value + len;
+    size_t want = std::strlen(token);
+    const char* t;
+    size_t n;
+    while (nextListToken(value, end, t, n)) {
+        if (n == want && strncasecmp(t, token, n) == 0) return true;
+    }
+    return false;
+}
+
+long long parseContentLength(std::string_view v) {
+    size_t b = 0, e = v.size();
+    while (b < e && (v[b] == ' ' || v[b] == '\t')) b++;
+    while (e > b && (v[e - 1] == ' ' || v[e - 1] == '\t')) e--;
+    if (b == e) return -1;
+    long long n = 0;
+    for (size_t i = b; i < e; i++) {
+        if (v[i] < '0' || v[i] > '9') return -1;
+        int d = v[i] - '0';
+        if (n > (LLONG_MAX - d) / 10) return -1;
+        n = n * 10 + d;
+    }
+    return n;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+size_t ChunkedDecoder::feed(const char* data, size_t len) {
+    size_t i = 0;
+    while (i < len && state != DONE && state != FAILED) {
+        if (state == DATA) {
+            // Bulk skip: payload bytes are passed through untouched.
+            size_t take = (len - i) < remaining ? (len - i) : (size_t)remaining;
+            i += take;
+            remaining -= take;
+            payload += take;
+            if (remaining == 0) state = DATA_CR;
+            continue;
+        }
+
+        char c = data[i++];
+        switch (state) {
+        case SIZE: {
+            int v = hexValue(c);
+            if (v >= 0) {
+                if (++sizeDigits > 15) { state = FAILED; break; }
+                remaining = (remaining << 4) | (uint64_t)v;
+            } else if (sizeDigits == 0) {
+                state = FAILED;
+            } else if (c == ';' || c == ' ' || c == '\t') {
+                state = SIZE_EXT;
+            } else if (c == '\r') {
+                state = SIZE_LF;
+            } else {
+                state = FAILED;
+            }
+            break;
+        }
+        case SIZE_EXT:
+            if (c == '\r') state = SIZE_LF;
+            break;
+        case SIZE_LF:
+            if (c != '\n') { state = FAILED; break; }
+            sizeDigits = 0;
+            state = remaining ? DATA : TRAILER_START;
+            break;
+        case DATA_CR:
+            state = (c == '\r') ? DATA_LF : FAILED;
+            break;
+        case DATA_LF:
+            state = (c == '\n') ? SIZE : FAILED;
+            break;
+        case TRAILER_START:
+            state = (c == '\r') ? FINAL_LF : TRAILER_LINE;
+            break;
+        case TRAILER_LINE:
+            if (c == '\r') state = TRAILER_LF;
+            break;
+        case TRAILER_LF:
+            state = (c == '\n') ? TRAILER_START : FAILED;
+            break;
+        case FINAL_LF:
+            state = (c == '\n') ? DONE : FAILED;
+            break;
+        default:
+            break;
+        }
+    }
+    return i;
+}
+
+size_t ResponseParser::feed(const char* data, size_t len) {
+    size_t i = 0;
+    while (i < len && state != DONE && state != FAILED) {
+        switch (state) {
+        case HEAD: {
+            // Append what we have and look for the blank line, re-scanning only
+            // the last three bytes of the previous fragment.
+            size_t old = head.size();
+            size_t take = len - i;
+            if (old + take > MAX_HEAD) take = MAX_HEAD - old;
+            head.append(data + i, take);
+            size_t end = head.find("\r\n\r\n", old > 3 ? old - 3 : 0);
+            if (end == std::string::npos) {
+                i += take;
+                if (head.size() >= MAX_HEAD) state = FAILED;
+                break;
+            }
+            i += end + 4 - old;
+            head.resize(end + 4);
+            parseHead();
+            break;
+        }
+        case BODY_LENGTH: {
+            size_t take = (len - i) < remaining ? (len - i) : (size_t)remaining;
+            i += take;
+            remaining -= take;
+            body += take;
+            if (remaining == 0) state = DONE;
+            break;
+        }
+        case BODY_CHUNKED:
+            i += chunks.feed(data + i, len - i);
+            if (chunks.done()) state = DONE;
+            else if (chunks.failed()) state = FAILED;
+            break;
+        case BODY_CLOSE:
+            body += len - i;
+            i = len;
+            break;
+        default:
+            break;
+        }
+    }
+    return i;
+}
+
+void ResponseParser::parseHead() {
+    // Status line: HTTP/1.x SSS reason
+    if (head.size() < 12 || head.compare(0, 5, "HTTP/") != 0 || head[8] != ' ') {
+        state = FAILED;
+        return;
+    }
+    statusCode = std::atoi(head.c_str() + 9);
+    if (statusCode < 100 || statusCode > 999) {
+        statusCode = 0;
+        state = FAILED;
+        return;
+    }
+    keepAlive = head.compare(5, 3, "1.0") != 0;
+
+    long long contentLength = -1;
+    bool chunked = false, transferEncoded = false;
+    size_t line = head.find("\r\n");
+    while (line != std::string::npos) {
+        line += 2;
+        size_t eol = head.find("\r\n", line);
+        if (eol == std::string::npos || eol == line) break;
+        const char* p = head.c_str() + line;
+        size_t n = eol - line;
+        if (headerNameIs(p, n, "Content-Length", 14)) {
+            // A repeat of the same length is harmless; two different ones
+            // leave no way to tell where the body ends.
+            long long v = parseContentLength(std::string_view(p + 15, n - 15));
+            if (v < 0 || (contentLength >= 0 && v != contentLength)) {
+                statusCode = 0;
+                state = FAILED;
+                return;
+            }
+            contentLength = v;
+        } else if (headerNameIs(p, n, "Transfer-Encoding", 17)) {
+            // A later line appends to the list, so its last coding is the final one.
+            transferEncoded = true;
+            chunked = lastCodingIsChunked(p + 18, n - 18);
+        } else if (headerNameIs(p, n, "Connection", 10)) {
+            if (headerHasToken(p + 11, n - 11, "close")) keepAlive = false;
+            else if (headerHasToken(p + 11, n - 11, "keep-alive")) keepAlive = true;
+        }
+        line = eol;
+    }
+
+    if (statusCode < 200) {
+        // Interim response (100 Continue, 103 Early Hints): the final one follows.
+        head.clear();
+        statusCode = 0;
+        return;
+    }
+
+    if (headRequest || statusCode == 204 || statusCode == 304) {
+        bodyFraming = NONE;
+        state = DONE;
+    } else if (transferEncoded) {
+        // RFC 9112 6.3: Transfer-Encoding overrides Content-Length, and a body
+        // whose final coding is not chunked runs until the origin closes.
+        bodyFraming = chunked ? CHUNKED : CLOSE;
+        state = chunked ? BODY_CHUNKED : BODY_CLOSE;
+    } else if (contentLength >= 0) {
+        bodyFraming = LENGTH;
+        remaining = (uint64_t)contentLength;
+        state = remaining ? BODY_LENGTH : DONE;
+    } else {
+        bodyFraming = CLOSE;
+        state = BODY_CLOSE;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+/**
+ * @file Latency.cpp
+ * @brief Per-thread latency histogram slots, the periodic merger and the
+ *        Prometheus / shutdown renderings of the merged percentiles.
+ */
+
+#include "../include/Latency.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+struct alignas(64) LatencySlot {
+    LatencySlot* next = nullptr;
+    LatencyHistogram phases[LAT_PHASE_COUNT];
+};
+
+// Slots are allocated on demand and never freed: the list only ever grows to
+// the peak number of threads recording at once. Released slots wait on a free
+// list, so leasing stays O(1) however many long-lived workers hold one. A slot
+// starts at a few hundred bytes per phase and grows a page per range it sees.
+static std::atomic<LatencySlot*> slotList{nullptr};
+static std::mutex freeMtx;
+static std::vector<LatencySlot*> freeSlots;
+static bool latencyOn = false;
+static thread_local LatencySlot* mySlot = nullptr;
+
+static std::mutex snapshotMtx;
+static LatencySnapshot merged[LAT_PHASE_COUNT];
+static bool mergerRunning = false;
+
+struct LatencyLease {
+    ~LatencyLease() {
+        if (!mySlot) return;
+        std::lock_guard<std::mutex> lock(freeMtx);
+        freeSlots.push_back(mySlot);
+    }
+};
+
+static LatencySlot* leaseSlot() {
+    static thread_local LatencyLease lease;
+    (void)lease;
+    {
+        std::lock_guard<std::mutex> lock(freeMtx);
+        if (!freeSlots.empty()) {
+            mySlot = freeSlots.back();
+            freeSlots.pop_back();
+            return mySlot;
+        }
+    }
+    LatencySlot* s = new LatencySlot();
+    s->next = slotList.load(std::memory_order_relaxed);
+    while (!slotList.compare_exchange_weak(s->next, s, std::memory_order_release, std::memory_order_relaxed)) {}
+    return mySlot = s;
+}
+
+void setLatencyEnabled(bool on) { latencyOn = on; }
+bool latencyEnabled() { return latencyOn; }
+
+void latencyRecord(LatencyPhase phase, uint64_t ns) {
+    if (!latencyOn) return;
+    LatencySlot* s = mySlot ? mySlot : leaseSlot();
+    s->phases[phase].record(ns);
+}
+
+uint64_t latencyNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencySnapshot::add(const LatencyHistogram& h) {
+    for (int p = 0; p < LatencyHistogram::PAGES; p++) {
+        const LatencyHistogram::Page* page = h.pages[p].load(std::memory_order_acquire);
+        if (!page) continue;
+        for (int i = 0; i < LatencyHistogram::HALF; i++) {
+            uint64_t c = page->counts[i].load(std::memory_order_relaxed);
+            counts[p * LatencyHistogram::HALF + i] += c;
+            count += c;
+        }
+    }
+    sum += h.sum.load(std::memory_order_relaxed);
+    uint64_t m = h.max.load(std::memory_order_relaxed);
+    if (m > max) max = m;
+}
+
+uint64_t LatencySnapshot::percentile(double q) const {
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)std::ceil(q * (double)count);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            uint64_t v = LatencyHistogram::valueOf(b);
+            return v < max ? v : max;
+        }
+    }
+    return max;
+}
+
+LatencySnapshot latencyMerge(LatencyPhase phase) {
+    LatencySnapshot snap;
+    for (LatencySlot* s = slotList.load(std::memory_order_acquire); s; s = s->next) snap.add(s->phases[phase]);
+    return snap;
+}
+
+void startLatencyMerger(int intervalMs) {
+    {
+        std::lock_guard<std::mutex> lock(snapshotMtx);
+        if (mergerRunning || intervalMs <= 0) return;
+        mergerRunning = true;
+    }
+    std::thread([intervalMs] {
+        while (true) {
+            LatencySnapshot fresh[LAT_PHASE_COUNT];
+            for (int p = 0; p < LAT_PHASE_COUNT; p++) fresh[p] = latencyMerge((LatencyPhase)p);
+            {
+                std::lock_guard<std::mutex> lock(snapshotMtx);
+                for (int p = 0; p < LAT_PHASE_COUNT; p++) merged[p] = std::move(fresh[p]);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        }
+    }).detach();
+}
+
+LatencySnapshot latencySnapshot(LatencyPhase phase) {
+    std::lock_guard<std::mutex> lock(snapshotMtx);
+    if (!mergerRunning) return latencyMerge(phase);
+    return merged[phase];
+}
+
+const char* latencyPhaseName(LatencyPhase phase) {
+    static const char* NAMES[LAT_PHASE_COUNT] = { "ttfb", "dns", "connect", "filter", "total" };
+    return NAMES[phase];
+}
+
+std::string renderLatencyMetrics() {
+    static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+    std::ostringstream out;
+    out << "# HELP proxy_latency_seconds Request phase latency (ttfb, dns, connect, filter, total).\n"
+        << "# TYPE proxy_latency_seconds summary\n";
+    for (int p = 0; p < LAT_PHASE_COUNT; p++) {
+        LatencySnapshot snap = latencySnapshot((LatencyPhase)p);
+        const char* name = latencyPhaseName((LatencyPhase)p);
+        for (double q : QUANTILES) {
+            out << "proxy_latency_seconds{phase=\"" << name << "\",quantile=\"" << q << "\"} "
+                << snap.percentile(q) / 1e9 << "\n";
+        }
+        out << "proxy_latency_seconds_sum{phase=\"" << name << "\"} " << snap.sum / 1e9 << "\n";
+        out << "proxy_latency_seconds_count{phase=\"" << name << "\"} " << snap.count << "\n";
+    }
+    return out.str();
+}
+
+void dumpLatency(std::ostream& out) {
+    char line[128];
+    std::snprintf(line, sizeof(line), " %-9s %10s %10s %10s %10s %10s\n", "phase", "count", "p50 ms", "p99 ms",
+                  "p99.9 ms", "max ms");
+    out << line;
+    for (int p = 0; p < LAT_PHASE_COUNT; p++) {
+        LatencySnapshot snap = latencyMerge((LatencyPhase)p);
+        std::snprintf(line, sizeof(line), " %-9s %10llu %10.3f %10.3f %10.3f %10.3f\n",
+                      latencyPhaseName((LatencyPhase)p), (unsigned long long)snap.count, snap.percentile(0.5) / 1e6,
+                      snap.percentile(0.99) / 1e6, snap.percentile(0.999) / 1e6, snap.max / 1e6);
+        out << line;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,309 @@
+/**
+ * @file Lifecycle.cpp
+ * @brief Listener handoff to a successor process over a Unix socket, a
+ *        stoppable accept loop, and connection draining.
+ */
+
+#include "../include/Lifecycle.h"
+#include "../include/Admission.h"
+#include "../include/DiskCache.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/un.h>
+#endif
+
+static RestartConfig cfg;
+static std::atomic<bool> stopping{false};
+static std::atomic<bool> handed{false};
+static std::atomic<bool> drainingNow{false};
+static int wakeFds[2] = { -1, -1 }; // written by requestStop(), polled by waitForClient()
+static int reloadFds[2] = { -1, -1 }; // written by requestReload(), read by the watcher
+
+void initRestart(const RestartConfig& config) {
+    cfg = config;
+#ifdef _WIN32
+    if (!cfg.socketPath.empty()) std::cerr << "[WARNING] Hot restart is not available on Windows." << std::endl;
+    cfg.socketPath.clear();
+#endif
+}
+
+bool restartEnabled() { return !cfg.socketPath.empty(); }
+
+void requestStop() {
+    stopping.store(true);
+#ifndef _WIN32
+    if (wakeFds[1] >= 0) {
+        char b = 1;
+        ssize_t n = write(wakeFds[1], &b, 1); // async-signal-safe
+        (void)n;
+    }
+#endif
+}
+
+bool stopRequested() { return stopping.load(); }
+
+bool handedOff() { return handed.load(); }
+
+int drainConnections(int deadlineMs) {
+    typedef std::chrono::steady_clock Clock;
+    drainingNow.store(true);
+    auto deadline = Clock::now() + std::chrono::milliseconds(deadlineMs);
+    auto report = Clock::now() + std::chrono::seconds(1);
+    uint64_t open;
+    while ((open = admissionStats().active) > 0 && Clock::now() < deadline) {
+        if (Clock::now() >= report) {
+            long long leftMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            std::cout << "[DRAIN] " << open << " connection(s) open, " << leftMs << " ms left" << std::endl;
+            report += std::chrono::seconds(1);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return (int)open;
+}
+
+bool draining() { return drainingNow.load(); }
+
+bool acceptBackoff(const char* tag) {
+#ifdef _WIN32
+    int err = WSAGetLastError();
+    if (err == WSAENOTSOCK || err == WSAEINVAL) return false;
+    if (err == WSAEINTR || err == WSAEWOULDBLOCK || err == WSAECONNRESET) return true;
+    std::string reason = "error " + std::to_string(err);
+#else
+    int err = errno;
+    if (err == EBADF || err == ENOTSOCK || err == EINVAL) return false;
+    if (err == EINTR || err == EAGAIN || err == EWOULDBLOCK || err == ECONNABORTED) return true;
+    std::string reason = std::strerror(err);
+#endif
+    static std::atomic<int64_t> lastReport{0};
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last = lastReport.load();
+    if (now - last >= 1000 && lastReport.compare_exchange_strong(last, now)) {
+        std::cerr << "[" << tag << "] accept() failed: " << reason << "; retrying." << std::endl;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return true;
+}
+
+#ifdef _WIN32
+
+void startReloadWatcher(std::function<void()>) {}
+void requestReload() {}
+
+bool inheritListeners(std::vector<SOCKET>&) { return false; }
+bool startRestartServer(const std::vector<SOCKET>&) { return false; }
+void prepareListener(SOCKET) {}
+bool waitForClient(SOCKET) { return !stopRequested(); }
+
+#else
+
+void startReloadWatcher(std::function<void()> onReload) {
+    if (reloadFds[0] >= 0 || pipe(reloadFds) != 0) return;
+    for (int fd : reloadFds) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(reloadFds[1], F_SETFL, O_NONBLOCK); // the handler never blocks on a full pipe
+    std::thread([onReload] {
+        char b;
+        while (true) {
+            ssize_t n = read(reloadFds[0], &b, 1);
+            if (n == 1) onReload();
+            else if (n == 0 || errno != EINTR) break;
+        }
+    }).detach();
+}
+
+void requestReload() {
+    if (reloadFds[1] >= 0) {
+        char b = 1;
+        ssize_t n = write(reloadFds[1], &b, 1); // async-signal-safe
+        (void)n;
+    }
+}
+
+// Takeover exchange, one connection per attempt:
+//   successor -> owner  Hello
+//   owner -> successor  Handoff, with the present listeners as SCM_RIGHTS
+//   successor -> owner  'A' (has them)
+//   owner -> successor  'D' (stopped accepting, disk cache released)
+static const uint32_t MAGIC = 0x53525850; // "PXRS"
+static const int MAX_LISTENERS = 4;
+
+struct Hello {
+    uint32_t magic;
+    uint32_t pid;
+};
+
+struct Handoff {
+    uint32_t magic;
+    uint32_t count;   // entries in the listener list
+    uint32_t present; // bit i: entry i has a descriptor attached
+};
+
+static bool unixAddress(sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (cfg.socketPath.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, cfg.socketPath.c_str(), cfg.socketPath.size());
+    return true;
+}
+
+static void setTimeouts(int fd, int ms) {
+    timeval tv{ ms / 1000, (ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static bool readByte(int fd, char want) {
+    char b = 0;
+    return recv(fd, &b, 1, 0) == 1 && b == want;
+}
+
+bool inheritListeners(std::vector<SOCKET>& listeners) {
+    sockaddr_un addr;
+    if (!restartEnabled() || !unixAddress(addr)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd); // nobody there: a cold start
+        return false;
+    }
+    setTimeouts(fd, 10000);
+
+    Hello hello{ MAGIC, (uint32_t)getpid() };
+    Handoff h{};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_LISTENERS)];
+    iovec iov{ &h, sizeof(h) };
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (send(fd, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello) ||
+        recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(h) || h.magic != MAGIC || h.count > MAX_LISTENERS) {
+        close(fd);
+        return false;
+    }
+    int fds[MAX_LISTENERS];
+    int received = 0;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+        received = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        std::memcpy(fds, CMSG_DATA(c), sizeof(int) * received);
+    }
+    listeners.assign(h.count, INVALID_SOCKET);
+    int next = 0;
+    for (uint32_t i = 0; i < h.count; i++) {
+        if ((h.present & (1u << i)) && next < received) listeners[i] = fds[next++];
+    }
+    if (listeners.empty() || listeners[0] == INVALID_SOCKET || send(fd, "A", 1, MSG_NOSIGNAL) != 1) {
+        for (int i = 0; i < received; i++) close(fds[i]);
+        listeners.clear();
+        close(fd);
+        return false;
+    }
+    // The listeners are ours now. A predecessor that dies before 'D' has
+    // nothing left to release.
+    readByte(fd, 'D');
+    close(fd);
+    return true;
+}
+
+// One takeover attempt on an accepted connection; true once the successor
+// has the listeners.
+static bool handOff(int conn, const std::vector<SOCKET>& listeners) {
+    if (stopRequested()) return false; // shutting down: the successor starts cold once the port is free
+    setTimeouts(conn, 10000);
+    Hello hello{};
+    if (recv(conn, &hello, sizeof(hello), MSG_WAITALL) != (ssize_t)sizeof(hello) || hello.magic != MAGIC) return false;
+
+    Handoff h{ MAGIC, (uint32_t)listeners.size(), 0 };
+    int fds[MAX_LISTENERS];
+    int count = 0;
+    for (size_t i = 0; i < listeners.size() && i < MAX_LISTENERS; i++) {
+        if (listeners[i] == INVALID_SOCKET) continue;
+        h.present |= 1u << i;
+        fds[count++] = listeners[i];
+    }
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_LISTENERS)];
+    iovec iov{ &h, sizeof(h) };
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+    cmsghdr* c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    std::memcpy(CMSG_DATA(c), fds, sizeof(int) * count);
+    if (sendmsg(conn, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(h) || !readByte(conn, 'A')) {
+        std::cerr << "[RESTART] Takeover by pid " << hello.pid << " did not complete; still serving." << std::endl;
+        return false;
+    }
+
+    handed.store(true);
+    requestStop();
+    shutdownDiskCache(); // the successor maps the same index
+    send(conn, "D", 1, MSG_NOSIGNAL);
+    std::cout << "[RESTART] Listeners handed to pid " << hello.pid << "; draining " << admissionStats().active
+              << " connection(s) for up to " << cfg.drainMs << " ms." << std::endl;
+    return true;
+}
+
+bool startRestartServer(const std::vector<SOCKET>& listeners) {
+    sockaddr_un addr;
+    if (!restartEnabled()) return false;
+    if (!unixAddress(addr)) {
+        std::cerr << "[ERROR] RESTART_SOCKET path is too long: " << cfg.socketPath << std::endl;
+        return false;
+    }
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(cfg.socketPath.c_str()); // a dead predecessor's, or the one we just took over from
+    if (s < 0 || bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, 4) != 0) {
+        std::cerr << "[ERROR] Could not listen for hot restart on " << cfg.socketPath << std::endl;
+        if (s >= 0) close(s);
+        return false;
+    }
+    std::thread([s, listeners] {
+        while (true) {
+            int conn = accept(s, NULL, NULL);
+            if (conn < 0) {
+                if (acceptBackoff("RESTART")) continue;
+                break;
+            }
+            bool done = handOff(conn, listeners);
+            close(conn);
+            if (done) break;
+        }
+        // The path now belongs to the successor; only our descriptor goes.
+        close(s);
+    }).detach();
+    return true;
+}
+
+void prepareListener(SOCKET listener) {
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+    if (wakeFds[0] < 0 && pipe(wakeFds) == 0) {
+        for (int fd : wakeFds) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+}
+
+bool waitForClient(SOCKET listener) {
+    pollfd fds[2] = { { listener, POLLIN, 0 }, { wakeFds[0], POLLIN, 0 } };
+    while (!stopRequested()) {
+        int n = poll(fds, wakeFds[0] >= 0 ? 2 : 1, -1);
+        if (n > 0 && (fds[0].revents & POLLIN)) return !stopRequested();
+    }
+    return false;
+}
+
+#endif
\ No newline at end of file
@@ -1,41 +1,127 @@
 #include "../include/Logger.h"
 #include "../include/Config.h"
+#include "../include/Metrics.h"
+#include <charconv>
+#include <ctime>
+#include <fcntl.h>
 #include <iostream>
-#include <fstream>
+#include <memory_resource>
 #include <mutex>
-#include <ctime>
-#include <iomanip>
-#include <sstream>
 
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
 
 std::mutex logMtx;
 
-std::string getTimestamp() {
-    auto t = std::time(nullptr);
-    auto tm = *std::localtime(&t);
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+// Every request outcome passes through logProxy(), so it also feeds the counters.
+static Metric outcomeMetric(std::string_view status) {
+    static const struct { const char* status; Metric metric; } OUTCOMES[] = {
+        { "ALLOWED", M_REQ_ALLOWED }, { "INCOMPLETE", M_REQ_INCOMPLETE }, { "BLOCKED", M_REQ_BLOCKED },
+        { "TUNNEL", M_REQ_TUNNEL }, { "HIT", M_REQ_HIT }, { "HIT_DISK", M_REQ_HIT_DISK },
+        { "REVALIDATED", M_REQ_REVALIDATED }, { "COLLAPSED", M_REQ_COLLAPSED },
+        { "ERR_CONN", M_ERR_CONN }, { "ERR_CIRCUIT", M_ERR_CIRCUIT },
+    };
+    for (const auto& o : OUTCOMES) {
+        if (status == o.status) return o.metric;
+    }
+    return METRIC_COUNT;
+}
+
+// Formats the local time into `out`, which holds at least 20 bytes.
+static size_t formatTimestamp(char* out, size_t cap) {
+    std::time_t t = std::time(nullptr);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    return std::strftime(out, cap, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+static void appendNumber(std::pmr::string& out, long long v) {
+    char digits[24];
+    auto r = std::to_chars(digits, digits + sizeof(digits), v);
+    out.append(digits, r.ptr);
+}
+
+// Appends one line to the log file. Opening and closing per line keeps the
+// old behaviour: every line is with the OS at once, and a rotated log file is
+// picked up by the next request.
+static bool appendToLog(const std::string& path, const std::pmr::string& line) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_TEXT, _S_IREAD | _S_IWRITE);
+    if (fd < 0) return false;
+    bool ok = _write(fd, line.data(), (unsigned)line.size()) == (int)line.size();
+    _close(fd);
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = write(fd, line.data(), line.size()) == (ssize_t)line.size();
+    close(fd);
+#endif
+    return ok;
 }
 
-void logProxy(const std::string& ip, const std::string& host, const std::string& port,
-              const std::string& method, const std::string& path, const std::string& status, int bytes) {
+void logProxy(std::string_view ip, std::string_view host, std::string_view port, std::string_view method,
+              std::string_view path, std::string_view status, long long bytes, int httpStatus, long long bodyBytes) {
+    Metric outcome = outcomeMetric(status);
+    if (outcome != METRIC_COUNT) metricAdd(outcome);
+    metricAdd(M_BYTES_DOWNSTREAM, bytes);
+
+    // Both lines are built on the stack; only an unusually long host spills to the heap.
+    char scratch[2048];
+    std::pmr::monotonic_buffer_resource mr(scratch, sizeof(scratch));
+    char ts[32];
+    std::string_view stamp(ts, formatTimestamp(ts, sizeof(ts)));
+
+    // Upstream status code and decoded body size are appended so existing columns keep their positions.
+    std::pmr::string line(&mr);
+    line.reserve(512);
+    line.append(stamp).append(",").append(ip).append(",").append(host).append(",").append(method).append(",");
+    line.append(status).append(",");
+    appendNumber(line, bytes);
+    line += ',';
+    appendNumber(line, httpStatus);
+    line += ',';
+    appendNumber(line, bodyBytes < 0 ? 0 : bodyBytes);
+    line += '\n';
+
+    std::pmr::string console(&mr);
+    console.reserve(512);
+    console.append("[").append(stamp).append("] [").append(ip).append("] ").append(method);
+    if (method.size() < 8) console.append(8 - method.size(), ' ');
+    console.append(host).append(":").append(port).append(" -> ").append(status);
+    if (httpStatus > 0) {
+        console += ' ';
+        appendNumber(console, httpStatus);
+    }
+    console.append(" (");
+    appendNumber(console, bytes);
+    console.append(" bytes");
+    if (bodyBytes >= 0) {
+        console.append(", body ");
+        appendNumber(console, bodyBytes);
+    }
+    console.append(")\n");
+
     std::lock_guard<std::mutex> lock(logMtx);
-    std::string ts = getTimestamp();
-    
-    // Use the config value or default
-    std::string logFilePath = Config::getString("LOG_PATH", "proxy.log");
-
-    std::ofstream logFile(logFilePath, std::ios::app);
-    if (logFile.is_open()) {
-        logFile << ts << "," << ip << "," << host << "," << method << "," << status << "," << bytes << std::endl; 
-        logFile.close(); // Closing forces the OS to write to disk immediately
-    } else {
+    // The current snapshot, so a reload moves logging to the new path.
+    std::shared_ptr<const Settings> cfg = Config::current();
+    const std::string& logFilePath = cfg->logPath;
+    if (!appendToLog(logFilePath, line)) {
         // If it fails, print to console so you know why
         std::cerr << "[ERROR] Could not write to log file: " << logFilePath << std::endl;
     }
+    std::cout.write(console.data(), (std::streamsize)console.size()).flush();
+}
 
-    // Console output stays the same
-    std::cout << "[" << ts << "] [" << ip << "] " << std::left << std::setw(8) << method 
-              << host << ":" << port << " -> " << status << " (" << bytes << " bytes)" << std::endl;
+void flushLogs() {
+    std::lock_guard<std::mutex> lock(logMtx);
+    std::cout.flush();
+    std::cerr.flush();
 }
\ No newline at end of file
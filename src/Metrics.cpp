@@ -0,0 +1,299 @@
+/**
+ * @file Metrics.cpp
+ * @brief Per-thread metric slots, Prometheus text rendering and the admin
+ *        listener that serves it.
+ */
+
+#include "../include/Metrics.h"
+#include "../include/ProxyCore.h"
+#include "../include/Parser.h"
+#include "../include/Cache.h"
+#include "../include/DiskCache.h"
+#include "../include/CircuitBreaker.h"
+#include "../include/Latency.h"
+#include "../include/RateLimit.h"
+#include "../include/Shaper.h"
+#include "../include/Deadline.h"
+#include "../include/Admission.h"
+#include "../include/WorkerPool.h"
+#include "../include/AsyncProxy.h"
+#include "../include/EventLoop.h"
+#include "../include/BufferPool.h"
+#include "../include/Lifecycle.h"
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+static const int MAX_SLOTS = 1024;
+static MetricSlot slots[MAX_SLOTS];
+static MetricSlot overflow;
+
+bool metricsOn = false;
+thread_local MetricSlot* metricsSlot = nullptr;
+
+// Returns the slot to the pool when its thread exits; the values stay, so
+// counters are never lost and the next owner keeps adding to them.
+struct SlotLease {
+    ~SlotLease() {
+        if (metricsSlot && !metricsSlot->shared) metricsSlot->owned.store(false, std::memory_order_release);
+    }
+};
+
+MetricSlot* metricsLeaseSlot() {
+    static thread_local SlotLease lease;
+    (void)lease;
+    size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % MAX_SLOTS;
+    for (int i = 0; i < MAX_SLOTS; i++) {
+        MetricSlot& slot = slots[(start + i) % MAX_SLOTS];
+        bool expected = false;
+        if (!slot.owned.load(std::memory_order_relaxed) &&
+            slot.owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            metricsSlot = &slot;
+            return metricsSlot;
+        }
+    }
+    overflow.shared = true;
+    metricsSlot = &overflow;
+    return metricsSlot;
+}
+
+void setMetricsEnabled(bool on) { metricsOn = on; }
+
+int64_t metricValue(Metric m) {
+    int64_t sum = overflow.values[m].load(std::memory_order_relaxed);
+    for (const MetricSlot& slot : slots) sum += slot.values[m].load(std::memory_order_relaxed);
+    return sum;
+}
+
+static void family(std::ostringstream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+std::string renderMetrics() {
+    int64_t v[METRIC_COUNT];
+    for (int m = 0; m < METRIC_COUNT; m++) v[m] = metricValue((Metric)m);
+
+    std::ostringstream out;
+    family(out, "proxy_connections_total", "counter", "Client connections accepted.");
+    out << "proxy_connections_total " << v[M_CONNECTIONS] << "\n";
+    family(out, "proxy_active_connections", "gauge", "Client connections being handled.");
+    out << "proxy_active_connections " << v[M_ACTIVE_CONNECTIONS] << "\n";
+    family(out, "proxy_active_tunnels", "gauge", "CONNECT tunnels currently relaying.");
+    out << "proxy_active_tunnels " << v[M_ACTIVE_TUNNELS] << "\n";
+    family(out, "proxy_draining", "gauge", "1 once the proxy has stopped accepting and waits for open connections.");
+    out << "proxy_draining " << (draining() ? 1 : 0) << "\n";
+    family(out, "proxy_bytes_total", "counter", "Bytes relayed, by direction.");
+    out << "proxy_bytes_total{direction=\"upstream\"} " << v[M_BYTES_UPSTREAM] << "\n";
+    out << "proxy_bytes_total{direction=\"downstream\"} " << v[M_BYTES_DOWNSTREAM] << "\n";
+
+    static const struct { Metric metric; const char* outcome; } OUTCOMES[] = {
+        { M_REQ_ALLOWED, "allowed" }, { M_REQ_INCOMPLETE, "incomplete" }, { M_REQ_BLOCKED, "blocked" },
+        { M_REQ_TUNNEL, "tunnel" }, { M_REQ_HIT, "hit" }, { M_REQ_HIT_DISK, "hit_disk" },
+        { M_REQ_REVALIDATED, "revalidated" }, { M_REQ_COLLAPSED, "collapsed" }, { M_REQ_MALFORMED, "malformed" },
+    };
+    family(out, "proxy_requests_total", "counter", "Requests handled, by outcome.");
+    for (const auto& o : OUTCOMES) out << "proxy_requests_total{outcome=\"" << o.outcome << "\"} " << v[o.metric] << "\n";
+    family(out, "proxy_upstream_errors_total", "counter", "Upstream connect failures; circuit = failed fast by an open breaker.");
+    out << "proxy_upstream_errors_total{kind=\"connect\"} " << v[M_ERR_CONN] << "\n";
+    out << "proxy_upstream_errors_total{kind=\"circuit\"} " << v[M_ERR_CIRCUIT] << "\n";
+
+    if (cacheEnabled()) {
+        CacheStats c = cacheStats();
+        family(out, "proxy_cache_entries", "gauge", "Responses held by the in-memory cache.");
+        out << "proxy_cache_entries " << c.entries << "\n";
+        family(out, "proxy_cache_bytes", "gauge", "Bytes held by the in-memory cache.");
+        out << "proxy_cache_bytes " << c.bytes << "\n";
+        family(out, "proxy_cache_evictions_total", "counter", "In-memory cache evictions.");
+        out << "proxy_cache_evictions_total " << c.evictions << "\n";
+    }
+    if (diskCacheEnabled()) {
+        DiskCacheStats d = diskCacheStats();
+        family(out, "proxy_disk_cache_bytes", "gauge", "Bytes in disk cache segments.");
+        out << "proxy_disk_cache_bytes " << d.bytes << "\n";
+        family(out, "proxy_disk_cache_entries", "gauge", "Entries in the disk cache index.");
+        out << "proxy_disk_cache_entries " << d.entries << "\n";
+    }
+    if (circuitBreakerEnabled()) {
+        CircuitBreakerStats b = circuitBreakerStats();
+        family(out, "proxy_circuit_open", "gauge", "Upstreams whose breaker is open or half-open.");
+        out << "proxy_circuit_open " << b.open << "\n";
+        family(out, "proxy_circuit_trips_total", "counter", "Times a breaker opened.");
+        out << "proxy_circuit_trips_total " << b.trips << "\n";
+    }
+    if (rateLimitEnabled()) {
+        RateLimitStats r = rateLimitStats();
+        family(out, "proxy_rate_limited_total", "counter", "Connections refused with 429, by limit.");
+        out << "proxy_rate_limited_total{limit=\"rate\"} " << r.rejectedRate << "\n";
+        out << "proxy_rate_limited_total{limit=\"concurrent\"} " << r.rejectedConcurrent << "\n";
+        family(out, "proxy_rate_throttled_seconds_total", "counter", "Time client reads were delayed by byte limits.");
+        out << "proxy_rate_throttled_seconds_total " << r.throttledMs / 1000.0 << "\n";
+        family(out, "proxy_rate_tracked_clients", "gauge", "Client addresses with rate limit state.");
+        out << "proxy_rate_tracked_clients " << r.tracked << "\n";
+    }
+    if (admissionEnabled()) {
+        AdmissionStats a = admissionStats();
+        family(out, "proxy_admission_rejected_total", "counter", "Connections or requests refused with 503, by reason.");
+        out << "proxy_admission_rejected_total{reason=\"full\"} " << a.rejectedFull << "\n";
+        out << "proxy_admission_rejected_total{reason=\"shed\"} " << a.rejectedShed << "\n";
+        out << "proxy_admission_rejected_total{reason=\"connect\"} " << a.rejectedConnect << "\n";
+        family(out, "proxy_admission_admitted", "gauge", "Admitted connections still open.");
+        out << "proxy_admission_admitted " << a.active << "\n";
+        family(out, "proxy_admission_connecting", "gauge", "Upstream connects in flight.");
+        out << "proxy_admission_connecting " << a.connecting << "\n";
+        family(out, "proxy_admission_shed_ratio", "gauge", "Share of new connections currently shed.");
+        out << "proxy_admission_shed_ratio " << a.shedRatio << "\n";
+        family(out, "proxy_admission_dispatch_delay_seconds", "gauge",
+               "Minimum accept-to-handler delay over the last shedding window.");
+        out << "proxy_admission_dispatch_delay_seconds " << a.windowMinDelayUs / 1e6 << "\n";
+    }
+    if (workerPoolEnabled()) {
+        WorkerPoolStats w = workerPoolStats();
+        family(out, "proxy_worker_threads", "gauge", "Live worker threads in the handler pool.");
+        out << "proxy_worker_threads " << w.workers << "\n";
+        family(out, "proxy_worker_idle", "gauge", "Workers sleeping for lack of work.");
+        out << "proxy_worker_idle " << w.idle << "\n";
+        family(out, "proxy_worker_queued", "gauge", "Connections waiting for a free worker.");
+        out << "proxy_worker_queued " << w.queued << "\n";
+        family(out, "proxy_worker_tasks_total", "counter", "Tasks run by pool workers.");
+        out << "proxy_worker_tasks_total " << w.executed << "\n";
+        family(out, "proxy_worker_steals_total", "counter", "Tasks taken from another worker's deque.");
+        out << "proxy_worker_steals_total " << w.stolen << "\n";
+        family(out, "proxy_worker_spawned_total", "counter", "Workers started beyond the pre-spawned set.");
+        out << "proxy_worker_spawned_total " << w.spawned << "\n";
+        family(out, "proxy_worker_overflow_total", "counter",
+               "Tunnel halves and body pumps given their own thread because the pool was at its cap.");
+        out << "proxy_worker_overflow_total " << w.overflow << "\n";
+    }
+    if (asyncHandlerEnabled()) {
+        AsyncStats a = asyncStats();
+        CoroFrameStats f = coroFrameStats();
+        family(out, "proxy_async_connections", "gauge", "Connections open on the event loops.");
+        out << "proxy_async_connections " << a.connections << "\n";
+        family(out, "proxy_coroutine_frames", "gauge", "Live coroutine frames.");
+        out << "proxy_coroutine_frames " << f.live << "\n";
+        family(out, "proxy_coroutine_frame_bytes", "gauge", "Bytes held by live coroutine frames.");
+        out << "proxy_coroutine_frame_bytes " << f.liveBytes << "\n";
+        family(out, "proxy_coroutine_frames_reused_total", "counter", "Frames served from a per-thread free list.");
+        out << "proxy_coroutine_frames_reused_total " << f.reused << "\n";
+    }
+    {
+        BufferPoolStats b = bufferPoolStats();
+        struct PoolFamily {
+            const char* name;
+            const char* type;
+            const char* help;
+            uint64_t BufferClassStats::*field;
+        };
+        const PoolFamily families[] = {
+            { "proxy_buffer_slab_bytes", "gauge", "Bytes of buffer slabs, by size class.", &BufferClassStats::slabBytes },
+            { "proxy_buffer_in_use", "gauge", "Pooled buffers held by connections, by size class.",
+              &BufferClassStats::inUse },
+            { "proxy_buffer_depot", "gauge", "Free buffers in the global depot, by size class.", &BufferClassStats::depot },
+            { "proxy_buffer_acquired_total", "counter", "Buffer acquisitions, by size class.",
+              &BufferClassStats::acquired },
+            { "proxy_buffer_depot_fetches_total", "counter", "Per-thread free lists refilled from the depot.",
+              &BufferClassStats::depotFetches },
+        };
+        for (const PoolFamily& g : families) {
+            family(out, g.name, g.type, g.help);
+            for (int c = 0; c < BUF_CLASS_COUNT; c++) {
+                out << g.name << "{class=\"" << bufferClassName((BufferClass)c) << "\"} " << b.classes[c].*g.field
+                    << "\n";
+            }
+        }
+        uint64_t held = 0;
+        for (int c = 0; c < BUF_CLASS_COUNT; c++) held += b.classes[c].inUse * bufferClassSize((BufferClass)c);
+        family(out, "proxy_buffer_bytes_per_connection", "gauge",
+               "Pooled buffer bytes held, divided by the connections being handled.");
+        out << "proxy_buffer_bytes_per_connection "
+            << (v[M_ACTIVE_CONNECTIONS] > 0 ? (double)held / (double)v[M_ACTIVE_CONNECTIONS] : 0.0) << "\n";
+        family(out, "proxy_relay_buffer_resizes_total", "counter", "Relay buffers moved to another size class.");
+        out << "proxy_relay_buffer_resizes_total{direction=\"grow\"} " << b.relayGrows << "\n";
+        out << "proxy_relay_buffer_resizes_total{direction=\"shrink\"} " << b.relayShrinks << "\n";
+    }
+    if (deadlinesEnabled()) {
+        DeadlineStats d = deadlineStats();
+        family(out, "proxy_deadline_expired_total", "counter", "Connections closed by a deadline, by kind.");
+        for (int k = 0; k < DL_KIND_COUNT; k++) {
+            out << "proxy_deadline_expired_total{kind=\"" << deadlineKindName((DeadlineKind)k) << "\"} " << d.expired[k]
+                << "\n";
+        }
+        family(out, "proxy_deadline_armed", "gauge", "Deadlines currently on the timing wheel.");
+        out << "proxy_deadline_armed " << d.armed << "\n";
+    }
+    if (shaperOn) {
+        ShaperStats sh = shaperStats();
+        family(out, "proxy_shaper_waits_total", "counter", "Chunks that queued for bandwidth.");
+        out << "proxy_shaper_waits_total " << sh.waits << "\n";
+        family(out, "proxy_shaper_waiting_flows", "gauge", "Flows currently queued for bandwidth.");
+        out << "proxy_shaper_waiting_flows " << sh.waitingFlows << "\n";
+    }
+    if (latencyEnabled()) out << renderLatencyMetrics();
+    return out.str();
+}
+
+static void serveAdmin(SOCKET s) {
+    setSocketTimeout(s, 5000);
+    std::pmr::string request;
+    if (recvHeaders(s, request) > 0) {
+        std::string resp;
+        if (request.compare(0, 13, "GET /metrics ") == 0) {
+            std::string body = renderMetrics();
+            resp = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        } else {
+            resp = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+        sendAll(s, resp.c_str(), (int)resp.size());
+    }
+    closesocket(s);
+}
+
+static SOCKET adminSock = INVALID_SOCKET;
+// Connections being served; past the cap new ones are closed unanswered.
+static const int MAX_ADMIN_CLIENTS = 8;
+static std::atomic<int> adminClients{0};
+
+SOCKET metricsListener() { return adminSock; }
+
+bool startMetricsServer(const std::string& address, int port, SOCKET inherited) {
+    SOCKET s = inherited;
+    if (s == INVALID_SOCKET) {
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((u_short)port);
+        if (s == INVALID_SOCKET || inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1 ||
+            bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR || listen(s, 16) == SOCKET_ERROR) {
+            std::cerr << "[ERROR] Could not start metrics endpoint on " << address << ":" << port << std::endl;
+            if (s != INVALID_SOCKET) closesocket(s);
+            return false;
+        }
+    }
+    adminSock = s;
+    setMetricsEnabled(true);
+    // Each connection gets its own short-lived thread, so a client that
+    // connects and never sends a request holds up only itself until its
+    // timeout, not the scrapes behind it.
+    std::thread([s] {
+        while (true) {
+            SOCKET client = accept(s, NULL, NULL);
+            if (client == INVALID_SOCKET) {
+                if (acceptBackoff("METRICS")) continue;
+                break;
+            }
+            if (adminClients.fetch_add(1) >= MAX_ADMIN_CLIENTS) {
+                adminClients--;
+                closesocket(client);
+                continue;
+            }
+            std::thread([client] {
+                serveAdmin(client);
+                adminClients--;
+            }).detach();
+        }
+    }).detach();
+    return true;
+}
\ No newline at end of file
@@ -1,33 +1,53 @@
 #include "../include/Parser.h"
-#include <sstream>
+#include "../include/Config.h"
+#include "../include/Framing.h"
+#include <cctype>
+#include <charconv>
+#include <cstring>
 
-int recvHeaders(SOCKET sock, std::string& outData) {
+// One reservation covers a typical head, so appending to it does not regrow
+// through the request arena, which never reuses what it has handed out.
+static const size_t HEAD_RESERVE = 2048;
+
+int recvHeaders(SOCKET sock, std::pmr::string& outData) {
     char buffer[1024];
+    const uint64_t limit = Config::current()->maxHeaderBytes;
     while (true) {
-        int n = recv(sock, buffer, sizeof(buffer) - 1, 0);
+        int n = recv(sock, buffer, sizeof(buffer), 0);
         if (n <= 0) return n;
-        buffer[n] = '\0';
-        outData += buffer;
+        if (outData.capacity() < HEAD_RESERVE) outData.reserve(HEAD_RESERVE);
+        outData.append(buffer, n); // body bytes may follow the headers and may contain NULs
         if (outData.find("\r\n\r\n") != std::string::npos) break;
-        if (outData.length() > 8192) return -2; 
+        if (outData.length() > limit) return -2;
     }
     return (int)outData.length();
 }
 
-HttpRequest parseHttpRequest(const std::string& data) {
-    HttpRequest req;
-    req.raw = data;
+// The next whitespace-separated token from `pos`, as istream >> reads one.
+static std::string_view nextToken(std::string_view line, size_t& pos) {
+    while (pos < line.size() && std::isspace((unsigned char)line[pos])) pos++;
+    size_t start = pos;
+    while (pos < line.size() && !std::isspace((unsigned char)line[pos])) pos++;
+    return line.substr(start, pos - start);
+}
+
+HttpRequest parseHttpRequest(std::pmr::string&& raw) {
+    HttpRequest req(raw.get_allocator().resource());
+    req.raw = std::move(raw);
+    std::string_view data = req.raw;
     size_t firstLineEnd = data.find("\r\n");
     if (firstLineEnd == std::string::npos) return req;
 
-    std::string firstLine = data.substr(0, firstLineEnd);
-    std::istringstream iss(firstLine);
-    iss >> req.method >> req.path >> req.version;
+    std::string_view firstLine = data.substr(0, firstLineEnd);
+    size_t pos = 0;
+    req.method = nextToken(firstLine, pos);
+    req.path = nextToken(firstLine, pos);
+    req.version = nextToken(firstLine, pos);
 
     size_t hostPos = data.find("Host: ");
     if (hostPos != std::string::npos) {
         size_t hostEnd = data.find("\r\n", hostPos);
-        std::string hostLine = data.substr(hostPos + 6, hostEnd - (hostPos + 6));
+        std::string_view hostLine = data.substr(hostPos + 6, hostEnd - (hostPos + 6));
         size_t colon = hostLine.find(':');
         if (colon != std::string::npos) {
             req.host = hostLine.substr(0, colon);
@@ -37,29 +57,106 @@ HttpRequest parseHttpRequest(const std::string& data) {
             req.port = "80";
         }
     }
+
+    // Body framing: walk the header lines once for Content-Length / Transfer-Encoding.
+    int lengths = 0, codings = 0;
+    size_t line = firstLineEnd;
+    while (true) {
+        line += 2;
+        size_t eol = data.find("\r\n", line);
+        if (eol == std::string::npos) break;
+        if (eol == line) {
+            req.headerLen = eol + 2;
+            break;
+        }
+        const char* p = data.data() + line;
+        size_t len = eol - line;
+        if (headerNameIs(p, len, "Content-Length", 14)) {
+            lengths++;
+            req.contentLength = parseContentLength(data.substr(line + 15, len - 15));
+            if (req.contentLength < 0) req.badFraming = true;
+        } else if (headerNameIs(p, len, "Transfer-Encoding", 17)) {
+            codings++;
+            req.chunked = lastCodingIsChunked(p + 18, len - 18);
+        }
+        line = eol;
+    }
+    if (lengths > 1 || codings > 1 || (lengths && codings) || (codings && !req.chunked)) req.badFraming = true;
     return req;
 }
 
-std::string modifyRequestLine(const HttpRequest& req) {
-    // Reconstruct the request but force 'Connection: close'
-    std::string newHeaders = req.method + " " + req.path + " " + req.version + "\r\n";
-    
-    std::string remainder = req.raw;
-    size_t firstLineEnd = remainder.find("\r\n");
-    if (firstLineEnd != std::string::npos) {
-        remainder = remainder.substr(firstLineEnd + 2);
-    }
+HttpRequest parseHttpRequest(std::string_view data, std::pmr::memory_resource* mr) {
+    return parseHttpRequest(std::pmr::string(data, mr));
+}
 
-    auto fixHeader = [](std::string& s, const std::string& key) {
-        size_t pos = s.find(key + ":");
-        if (pos != std::string::npos) {
-            size_t end = s.find("\r\n", pos);
-            s.replace(pos, end - pos, key + ": close");
+RequestSlices buildRequestSlices(const HttpRequest& req) {
+    // Forces 'Connection: close' and 'Proxy-Connection: close' by pointing at
+    // the untouched spans of req.raw and splicing in a shared " close" snippet.
+    // The header block is walked once and the walk stops as soon as both
+    // headers have been seen, so large trailing headers are never scanned.
+    static const char CLOSE_VALUE[] = " close";
+    RequestSlices out;
+    const std::pmr::string& raw = req.raw;
+    const char* base = raw.data();
+
+    size_t spans[2][2];
+    int found = 0;
+    bool seenConn = false, seenProxy = false;
+    size_t line = raw.find("\r\n");
+    while (line != std::string::npos && found < 2) {
+        line += 2;
+        size_t eol = raw.find("\r\n", line);
+        if (eol == std::string::npos || eol == line) break; // end of header block
+        const char* p = base + line;
+        size_t len = eol - line;
+        if (!seenConn && headerNameIs(p, len, "Connection", 10)) {
+            seenConn = true;
+            spans[found][0] = line + 11;
+            spans[found++][1] = eol;
+        } else if (!seenProxy && headerNameIs(p, len, "Proxy-Connection", 16)) {
+            seenProxy = true;
+            spans[found][0] = line + 17;
+            spans[found++][1] = eol;
         }
-    };
+        line = eol;
+    }
 
-    fixHeader(remainder, "Connection");
-    fixHeader(remainder, "Proxy-Connection");
+    size_t cursor = 0;
+    for (int i = 0; i < found; i++) {
+        out.parts[out.count++] = { base + cursor, spans[i][0] - cursor };
+        out.parts[out.count++] = { CLOSE_VALUE, sizeof(CLOSE_VALUE) - 1 };
+        cursor = spans[i][1];
+    }
+    out.parts[out.count++] = { base + cursor, raw.size() - cursor };
+
+    out.totalLen = raw.size();
+    for (int i = 0; i < found; i++) {
+        out.totalLen -= spans[i][1] - spans[i][0];
+        out.totalLen += sizeof(CLOSE_VALUE) - 1;
+    }
+    return out;
+}
+
+void appendRequestHeaders(RequestSlices& slices, const HttpRequest& req, const std::string& headers) {
+    // Splits the last slice at the blank line and splices `headers` (CRLF-terminated
+    // lines, owned by the caller) in front of it.
+    if (req.headerLen < 2 || slices.count + 2 > RequestSlices::MAX_PARTS) return;
+    IoSlice& last = slices.parts[slices.count - 1];
+    const char* blank = req.raw.data() + req.headerLen - 2;
+    if (blank < last.data || blank > last.data + last.len) return;
+
+    IoSlice tail = { blank, (size_t)(last.data + last.len - blank) };
+    last.len = (size_t)(blank - last.data);
+    slices.parts[slices.count++] = { headers.data(), headers.size() };
+    slices.parts[slices.count++] = tail;
+    slices.totalLen += headers.size();
+}
 
-    return newHeaders + remainder;
+std::pmr::string modifyRequestLine(const HttpRequest& req, std::pmr::memory_resource* mr) {
+    // Flattened form of buildRequestSlices(), for callers that need one buffer.
+    RequestSlices slices = buildRequestSlices(req);
+    std::pmr::string out(mr);
+    out.reserve(slices.totalLen);
+    for (int i = 0; i < slices.count; i++) out.append(slices.parts[i].data, slices.parts[i].len);
+    return out;
 }
\ No newline at end of file
@@ -4,18 +4,83 @@
  */
 
 #include "../include/ProxyCore.h"
+#include "../include/Arena.h"
 #include "../include/Parser.h"
 #include "../include/Filter.h"
 #include "../include/Logger.h"
+#include "../include/Framing.h"
+#include "../include/Cache.h"
+#include "../include/DiskCache.h"
+#include "../include/Collapse.h"
+#include "../include/CircuitBreaker.h"
+#include "../include/Metrics.h"
+#include "../include/Latency.h"
+#include "../include/RateLimit.h"
+#include "../include/Shaper.h"
+#include "../include/Deadline.h"
+#include "../include/Admission.h"
+#include "../include/WorkerPool.h"
+#include "../include/BufferPool.h"
+#include "../include/Trace.h"
+#include <atomic>
+#include <cerrno>
+#include <ctime>
 #include <iostream>
-#include <thread>
 
+// Connection id carried by the trace probes, the client address the rate
+// limiter charges and the connection's deadlines. Each connection owns its
+// handler thread, so helpers called from it (connectToRemote, forwardHttp,
+// sendAll) pick them up here.
+static std::atomic<uint64_t> nextConnId{1};
+static thread_local uint64_t currentConn = 0;
+static thread_local uint32_t currentClientIp = 0;
+static thread_local ConnDeadlines* currentDeadlines = nullptr;
 
-void relay(SOCKET src, SOCKET dst) {
-    char buffer[32768]; 
+// Blocking recv() into a pooled buffer of class `c`. On POSIX the buffer goes
+// back to the pool whenever the socket runs dry, and the wait for more data is
+// a one-byte MSG_PEEK, so a quiet tunnel or a slow origin holds no buffer.
+static int recvPooled(SOCKET s, PooledBuffer& buf, BufferClass c) {
+#ifndef _WIN32
+    if (buf) {
+        int n = (int)recv(s, buf.acquire(c), bufferClassSize(c), MSG_DONTWAIT);
+        if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) return n;
+        buf.release();
+    }
+    char probe;
+    int ready = (int)recv(s, &probe, 1, MSG_PEEK);
+    if (ready <= 0) return ready;
+#endif
+    return (int)recv(s, buf.acquire(c), (int)bufferClassSize(c), 0);
+}
+
+void tuneRelaySockets(SOCKET src, SOCKET dst, size_t readBytes) {
+    if (!relaySocketTuning()) return;
+    // About four reads queued on each side of the relay.
+    int bytes = (int)readBytes * 4;
+    setsockopt(src, SOL_SOCKET, SO_RCVBUF, (const char*)&bytes, sizeof(bytes));
+    setsockopt(dst, SOL_SOCKET, SO_SNDBUF, (const char*)&bytes, sizeof(bytes));
+}
+
+// recvPooled() at the relay buffer's current size, feeding the result back.
+static int recvRelay(SOCKET src, SOCKET dst, RelayBuffer& buf) {
+    int n = recvPooled(src, buf.pooled, buf.sizeClass());
+    if (buf.record(n)) tuneRelaySockets(src, dst, bufferClassSize(buf.sizeClass()));
+    return n;
+}
+
+void relay(SOCKET src, SOCKET dst, Metric bytes, uint64_t conn, uint32_t clientIp, ConnDeadlines* deadlines) {
+    RelayBuffer buffer;
     int n;
-    while ((n = recv(src, buffer, sizeof(buffer), 0)) > 0) {
-        if (send(dst, buffer, n, 0) <= 0) break;
+    int upstream = bytes == M_BYTES_UPSTREAM;
+    ShapedFlow flow;
+    tuneRelaySockets(src, dst, bufferClassSize(buffer.sizeClass()));
+    while ((n = recvRelay(src, dst, buffer)) > 0) {
+        shapeBytes(flow, (size_t)n);
+        if (send(dst, buffer.pooled.data(), n, 0) <= 0) break;
+        deadlineTouch(deadlines);
+        metricAdd(bytes, n);
+        PROXY_TRACE(relay, conn, n, upstream);
+        clientThrottle(clientIp, (size_t)n);
     }
     shutdown(dst, SD_SEND); 
 }
@@ -26,92 +91,519 @@ int sendAll(SOCKET s, const char* buf, int len) {
         int sent = send(s, buf + totalSent, len - totalSent, 0);
         if (sent <= 0) return SOCKET_ERROR;
         totalSent += sent;
+        deadlineTouch(currentDeadlines);
+    }
+    return totalSent;
+}
+
+int sendAllv(SOCKET s, IoSlice* slices, int count) {
+    // One gather-write per round; partial sends advance the slice cursor in place.
+    const int MAX_IOV = 16;
+    int totalSent = 0;
+    while (count > 0) {
+        int batch = count < MAX_IOV ? count : MAX_IOV;
+#ifdef _WIN32
+        WSABUF bufs[MAX_IOV];
+        for (int i = 0; i < batch; i++) {
+            bufs[i].buf = const_cast<char*>(slices[i].data);
+            bufs[i].len = (ULONG)slices[i].len;
+        }
+        DWORD sentBytes = 0;
+        if (WSASend(s, bufs, (DWORD)batch, &sentBytes, 0, NULL, NULL) == SOCKET_ERROR || sentBytes == 0)
+            return SOCKET_ERROR;
+        size_t sent = sentBytes;
+#else
+        iovec iov[MAX_IOV];
+        for (int i = 0; i < batch; i++) {
+            iov[i].iov_base = const_cast<char*>(slices[i].data);
+            iov[i].iov_len = slices[i].len;
+        }
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = batch;
+        ssize_t n = sendmsg(s, &msg, MSG_NOSIGNAL);
+        if (n <= 0) return SOCKET_ERROR;
+        size_t sent = (size_t)n;
+#endif
+        totalSent += (int)sent;
+        deadlineTouch(currentDeadlines);
+        while (count > 0 && sent >= slices->len) {
+            sent -= slices->len;
+            slices++;
+            count--;
+        }
+        if (count > 0) {
+            slices->data += sent;
+            slices->len -= sent;
+        }
     }
     return totalSent;
 }
 
-SOCKET connectToRemote(const std::string& host, const std::string& port) {
+void rejectClient(SOCKET s, const std::string& response) {
+    send(s, response.c_str(), (int)response.size(), 0);
+    shutdown(s, SD_SEND);
+#ifndef _WIN32
+    // Closing with unread request bytes queued would send a RST that can
+    // overtake the response, so drain what already arrived, without blocking.
+    char scratch[4096];
+    while (recv(s, scratch, sizeof(scratch), MSG_DONTWAIT) > 0) {}
+#endif
+    closesocket(s);
+}
+
+SOCKET connectToRemote(const char* host, const char* port) {
     addrinfo hints{}, *res;
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
     
-    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) return INVALID_SOCKET;
+    uint64_t conn = currentConn;
+    PROXY_TRACE(dns_start, conn, host);
+    uint64_t t0 = latencyNow();
+    int rc = getaddrinfo(host, port, &hints, &res);
+    uint64_t t1 = latencyNow();
+    latencyRecord(LAT_DNS, t1 - t0);
+    PROXY_TRACE(dns_end, conn, host, rc);
+    if (rc != 0) return INVALID_SOCKET;
     
     SOCKET s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
     if (s != INVALID_SOCKET) {
-        if (connect(s, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR) {
+        PROXY_TRACE(connect_start, conn, host, port);
+        ConnDeadlines* deadlines = currentDeadlines;
+        if (deadlines) {
+            deadlineWatchRemote(*deadlines, s);
+            deadlineStart(*deadlines, DL_CONNECT);
+        }
+        int rc = connect(s, res->ai_addr, (int)res->ai_addrlen);
+        if (deadlines) deadlineStop(*deadlines, DL_CONNECT);
+        if (rc == SOCKET_ERROR) {
+            if (deadlines) deadlineWatchRemote(*deadlines, INVALID_SOCKET);
             closesocket(s);
             s = INVALID_SOCKET;
         }
+        latencyRecord(LAT_CONNECT, latencyNow() - t1);
+        int ok = s != INVALID_SOCKET;
+        PROXY_TRACE(connect_end, conn, host, ok);
     }
     freeaddrinfo(res);
     return s;
 }
 
 void setSocketTimeout(SOCKET s, int milliseconds) {
+#ifdef _WIN32
     DWORD timeout = milliseconds;
+#else
+    timeval timeout{ milliseconds / 1000, (milliseconds % 1000) * 1000 };
+#endif
     setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
     setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
 }
 
+// Request body framing state shared between the header send and the body pump.
+struct RequestBody : RequestBodyFraming {
+    uint64_t conn = 0;       // for the relay probe on the pump thread
+    uint32_t clientIp = 0;   // for the rate limiter on the pump thread
+    ConnDeadlines* deadlines = nullptr; // idle activity from the pump thread
+};
+
+// Streams the rest of the request body from client to upstream. Only one
+// buffer is used: a slow upstream blocks send(), which stops recv() from the
+// client, so TCP flow control pushes back on the uploader.
+void forwardRequestBody(SOCKET client, SOCKET remote, RequestBody* body) {
+    RelayBuffer buffer;
+    ShapedFlow flow;
+    while (!body->complete()) {
+        int n = recvRelay(client, remote, buffer);
+        if (n <= 0) break;
+        size_t used = body->consume(buffer.pooled.data(), (size_t)n);
+        if (body->chunks.failed()) break;
+        shapeBytes(flow, used);
+        if (sendAll(remote, buffer.pooled.data(), (int)used) == SOCKET_ERROR) break;
+        deadlineTouch(body->deadlines);
+        metricAdd(M_BYTES_UPSTREAM, (int64_t)used);
+        PROXY_TRACE(relay, body->conn, (int)used, 1);
+        clientThrottle(body->clientIp, used);
+    }
+    if (!body->complete()) {
+        // Truncated or malformed upload: abort the exchange so the response pump unblocks.
+        shutdown(remote, SD_BOTH);
+    }
+}
+
+// Sends a cached response with a freshly computed Age header spliced in before the blank line.
+static long long serveCached(SOCKET client, const CachedResponse& entry, time_t now) {
+    std::string age = "Age: " + std::to_string(entry.currentAge(now)) + "\r\n";
+    const std::string& wire = *entry.wire;
+    IoSlice parts[3] = {
+        { wire.data(), entry.headLen - 2 },
+        { age.data(), age.size() },
+        { wire.data() + entry.headLen - 2, wire.size() - (entry.headLen - 2) },
+    };
+    if (sendAllv(client, parts, 3) == SOCKET_ERROR) return 0;
+    return (long long)(wire.size() + age.size());
+}
+
+// Forwards one plain HTTP request and relays the response. `cached` is a stale
+// entry to revalidate (or null); `cacheable` enables capturing the response.
+// `share` is set when this request leads a collapsed fetch; it is always finished here.
+static void forwardHttp(SOCKET clientSocket, SOCKET remoteSocket, const HttpRequest& req, const char* ipStr,
+                        CacheEntryPtr cached, bool cacheable, SharedFetch* share) {
+    RequestBody body;
+    body.chunked = req.chunked;
+    body.remaining = (!req.chunked && req.contentLength > 0) ? req.contentLength : 0;
+    body.conn = currentConn;
+    body.clientIp = currentClientIp;
+    body.deadlines = currentDeadlines;
+
+    // Body bytes that arrived with the headers ride along in the last slice;
+    // anything past the end of this message is dropped.
+    RequestSlices finalRequest = buildRequestSlices(req);
+    if (req.headerLen > 0 && req.raw.size() > req.headerLen) {
+        size_t early = req.raw.size() - req.headerLen;
+        size_t extra = early - body.consume(req.raw.data() + req.headerLen, early);
+        finalRequest.parts[finalRequest.count - 1].len -= extra;
+        finalRequest.totalLen -= extra;
+    }
+
+    bool revalidating = cached && cached->hasValidators();
+    std::string conditional;
+    if (revalidating) {
+        conditional = cacheConditionalHeaders(*cached);
+        appendRequestHeaders(finalRequest, req, conditional);
+    }
+
+    time_t requestTime = std::time(nullptr);
+    PoolThread bodyPump;
+    metricAdd(M_BYTES_UPSTREAM, (int64_t)finalRequest.totalLen);
+    uint64_t sentAt = latencyNow();
+    if (sendAllv(remoteSocket, finalRequest.parts, finalRequest.count) != SOCKET_ERROR && !body.complete()) {
+        // Full duplex: the origin may answer (100 Continue, 413, ...) while the upload is still running.
+        bodyPump = PoolThread([clientSocket, remoteSocket, &body] {
+            forwardRequestBody(clientSocket, remoteSocket, &body);
+        });
+        if (!bodyPump.joinable()) {
+            // Out of threads: reading the response here without the upload
+            // going on alongside could wait on the origin for good.
+            if (share) collapseFinish(*share, false);
+            long long sent = sendAll(clientSocket, HTTP_503.c_str(), (int)HTTP_503.length()) == SOCKET_ERROR
+                                 ? 0 : (long long)HTTP_503.length();
+            logProxy(ipStr, req.host, req.port, req.method, req.path, "ERR_OVERLOAD", sent, 503);
+            return;
+        }
+    }
+
+    // The framer tells us where the response ends, so we stop as soon as it is
+    // complete instead of waiting for the origin to close.
+    ResponseParser response(req.method == "HEAD");
+    RelayBuffer relayBuffer;
+    int n = 0;
+    long long totalBytes = 0;
+    std::string capture;  // response bytes kept for the cache, bounded by cacheMaxObjectBytes()
+    std::string held;     // response head withheld while a revalidation is undecided
+    bool capturing = cacheable && cacheEnabled();
+    std::unique_ptr<DiskCacheWriter> diskWriter; // body streamed to the disk tier as it passes
+    CacheMeta meta;
+    uint64_t bodySeen = 0;
+    bool sharing = false;    // followers are streaming this response
+    bool clientGone = false; // keep fetching for the followers even if our own client left
+    bool headChecked = false;
+    bool notModified = false;
+    ShapedFlow flow;
+    while (!response.done() && (n = recvRelay(remoteSocket, clientSocket, relayBuffer)) > 0) {
+        const char* buffer = relayBuffer.pooled.data();
+        if (sentAt) {
+            uint64_t ttfb = latencyNow() - sentAt;
+            latencyRecord(LAT_TTFB, ttfb);
+            PROXY_TRACE(first_byte, body.conn, req.host.c_str(), ttfb);
+            sentAt = 0;
+        }
+        PROXY_TRACE(relay, body.conn, n, 0);
+        deadlineTouch(body.deadlines);
+        clientThrottle(body.clientIp, (size_t)n);
+        shapeBytes(flow, (size_t)n);
+        size_t used = response.feed(buffer, (size_t)n); // takes nothing once failed
+        if (response.headFailed() && totalBytes == 0) break; // answered with a 502 below
+        if (response.failed()) used = (size_t)n; // unparseable framing: degrade to pass-through until close
+
+        if (capturing) {
+            if (capture.size() + used > cacheMaxObjectBytes()) {
+                capturing = false;
+                std::string().swap(capture);
+            } else {
+                capture.append(buffer, used);
+            }
+        }
+        if (cacheable && !headChecked && response.status() != 0) {
+            headChecked = true;
+            if (capturing) capturing = cacheWorthCapturing(capture);
+            // Objects with a known length go to disk and to followers too; Vary is
+            // left to the memory tier.
+            const std::string& head = response.headBytes();
+            bool shareable = !response.failed() && response.framing() == ResponseParser::LENGTH &&
+                             cacheResponseMeta(head.data(), head.size(), requestTime, std::time(nullptr), meta) &&
+                             meta.storable && !meta.varies;
+            if (shareable && diskCacheEnabled()) diskWriter = diskCacheBegin(req, head, response.contentLength());
+            if (share) {
+                if (shareable && head.size() + response.contentLength() <= collapseMaxBytes()) {
+                    collapseStart(*share, response.status(), head.size(), (size_t)response.contentLength());
+                    collapsePublish(*share, head.data(), head.size());
+                    sharing = true;
+                } else {
+                    // After a 304 the followers can pick up the refreshed cache entry.
+                    collapseDecline(*share, response.status() == 304);
+                }
+            }
+        }
+        if ((diskWriter || sharing) && response.bodyBytes() > bodySeen) {
+            size_t fresh = (size_t)(response.bodyBytes() - bodySeen);
+            bodySeen = response.bodyBytes();
+            if (diskWriter && !diskCacheWrite(*diskWriter, buffer + used - fresh, fresh)) diskWriter.reset();
+            if (sharing) collapsePublish(*share, buffer + used - fresh, fresh);
+        }
+
+        if (revalidating) {
+            // The client did not send the validators, so a 304 must not reach it.
+            if (!response.failed() && (response.status() == 0 || response.status() == 304)) {
+                held.append(buffer, used);
+                notModified = response.status() == 304;
+                continue;
+            }
+            revalidating = false;
+            if (!held.empty() && sendAll(clientSocket, held.data(), (int)held.size()) == SOCKET_ERROR) {
+                if (!sharing) break;
+                clientGone = true;
+            }
+            totalBytes += (long long)held.size();
+        }
+
+        if (clientGone) continue;
+        if (sendAll(clientSocket, buffer, (int)used) == SOCKET_ERROR) {
+            if (!sharing) break;
+            clientGone = true;
+            continue;
+        }
+        totalBytes += (long long)used;
+    }
+    if (n == 0) response.finishOnClose();
+    if (bodyPump.joinable()) {
+        shutdown(clientSocket, SD_RECEIVE); // response is over; stop waiting on the uploader
+        bodyPump.join();
+    }
+
+    time_t responseTime = std::time(nullptr);
+    if (notModified && response.done()) {
+        cached = cacheRefresh(req, cached, held.data(), held.size(), requestTime, responseTime);
+        if (share) collapseFinish(*share, true);
+        totalBytes = serveCached(clientSocket, *cached, responseTime);
+        logProxy(ipStr, req.host, req.port, req.method, req.path, "REVALIDATED", totalBytes,
+                 cached->status, cached->bodyBytes);
+        return;
+    }
+    if (revalidating || (response.headFailed() && totalBytes == 0)) {
+        // The origin failed before its answer was complete, or sent a head
+        // whose body cannot be delimited, and the client has had nothing yet.
+        if (share) collapseFinish(*share, false);
+        long long sent = sendAll(clientSocket, HTTP_502.c_str(), (int)HTTP_502.length()) == SOCKET_ERROR
+                             ? 0 : (long long)HTTP_502.length();
+        logProxy(ipStr, req.host, req.port, req.method, req.path, "ERR_CONN", sent, 502);
+        return;
+    }
+    if (capturing && response.done()) {
+        cacheStore(req, capture, (long long)response.bodyBytes(), requestTime, responseTime);
+    }
+    if (diskWriter && response.done()) diskCacheCommit(*diskWriter, meta, responseTime);
+    if (share) collapseFinish(*share, response.done());
+    bool complete = response.done() || (response.failed() && n == 0);
+    logProxy(ipStr, req.host, req.port, req.method, req.path, complete ? "ALLOWED" : "INCOMPLETE",
+             totalBytes, response.status(), (long long)response.bodyBytes());
+}
+
+// Memory tier first, then disk. Returns true once a fresh hit has been sent; otherwise `cached` is left holding any stale memory entry to revalidate.
+static bool serveFromCache(SOCKET clientSocket, const HttpRequest& req, const char* ipStr, CacheEntryPtr& cached) {
+    bool fresh = false;
+    time_t now = std::time(nullptr);
+    if (cacheEnabled()) cached = cacheLookup(req, now, fresh);
+    if (cached && fresh) {
+        long long sent = serveCached(clientSocket, *cached, now);
+        logProxy(ipStr, req.host, req.port, req.method, req.path, "HIT", sent, cached->status, cached->bodyBytes);
+        return true;
+    }
+    DiskCacheHit hit;
+    if (diskCacheLookup(req, now, hit)) {
+        long long sent = diskCacheServe(clientSocket, hit);
+        logProxy(ipStr, req.host, req.port, req.method, req.path, "HIT_DISK", sent, hit.status,
+                 (long long)hit.bodyLen);
+        return true;
+    }
+    return false;
+}
+
+// Keeps the active-connections gauge, the total-duration histogram and the
+// close probe right on every return path.
+struct ActiveConnection {
+    uint64_t start = latencyNow();
+    uint64_t id = nextConnId.fetch_add(1, std::memory_order_relaxed);
+    std::pmr::string host; // set once the request is parsed
+
+    explicit ActiveConnection(std::pmr::memory_resource* mr) : host(mr) {
+        currentConn = id;
+        metricAdd(M_CONNECTIONS);
+        metricAdd(M_ACTIVE_CONNECTIONS);
+    }
+    ~ActiveConnection() {
+        metricAdd(M_ACTIVE_CONNECTIONS, -1);
+        uint64_t duration = latencyNow() - start;
+        latencyRecord(LAT_TOTAL, duration);
+        PROXY_TRACE(close, id, host.c_str(), duration);
+        currentConn = 0;
+        currentClientIp = 0;
+        currentDeadlines = nullptr;
+    }
+};
+
+// Deadlines come off the wheel before the descriptors they name are released.
+static void closeConnection(ConnDeadlines& deadlines, SOCKET client, SOCKET remote = INVALID_SOCKET) {
+    deadlineStopAll(deadlines);
+    if (remote != INVALID_SOCKET) closesocket(remote);
+    closesocket(client);
+}
 
 void handleClient(SOCKET clientSocket) {
-    setSocketTimeout(clientSocket, 10000); 
+    RequestArena arena; // outlives everything below that allocates from it
+    ActiveConnection active(&arena);
+    ConnDeadlines deadlines(clientSocket);
+    currentDeadlines = &deadlines;
+    deadlineStart(deadlines, DL_HEADER);
     sockaddr_in clientAddr;
-    int addrLen = sizeof(clientAddr);
+    socklen_t addrLen = sizeof(clientAddr);
     char ipStr[INET_ADDRSTRLEN] = "Unknown";
     if (getpeername(clientSocket, (sockaddr*)&clientAddr, &addrLen) == 0) {
         inet_ntop(AF_INET, &clientAddr.sin_addr, ipStr, sizeof(ipStr));
+        currentClientIp = ntohl(clientAddr.sin_addr.s_addr);
     }
+    const char* clientIp = ipStr;
+    PROXY_TRACE(accept, active.id, clientIp);
 
-    std::string rawData;
-    if (recvHeaders(clientSocket, rawData) <= 0) {
+    std::pmr::string rawData(&arena);
+    int received = recvHeaders(clientSocket, rawData);
+    deadlineStop(deadlines, DL_HEADER);
+    if (received <= 0) {
+        if (received == -2) metricAdd(M_REQ_MALFORMED);
         closesocket(clientSocket); 
         return;
     }
+    deadlineStart(deadlines, DL_IDLE);
 
-    HttpRequest req = parseHttpRequest(rawData);
+    HttpRequest req = parseHttpRequest(std::move(rawData));
     if (req.host.empty()) {
-        closesocket(clientSocket);
+        metricAdd(M_REQ_MALFORMED);
+        closeConnection(deadlines, clientSocket);
+        return;
+    }
+    if (req.badFraming) {
+        metricAdd(M_REQ_MALFORMED);
+        sendAll(clientSocket, HTTP_400.c_str(), (int)HTTP_400.length());
+        closeConnection(deadlines, clientSocket);
         return;
     }
+    active.host = req.host;
+    PROXY_TRACE(headers, active.id, req.host.c_str(), req.method.c_str(), received);
 
-    if (isBlocked(req.host)) {
+    uint64_t filterStart = latencyNow();
+    bool blocked = isBlocked(req.host);
+    latencyRecord(LAT_FILTER, latencyNow() - filterStart);
+    PROXY_TRACE(filter, active.id, req.host.c_str(), (int)blocked);
+    if (blocked) {
         sendAll(clientSocket, HTTP_403.c_str(), (int)HTTP_403.length());
         logProxy(ipStr, req.host, req.port, req.method, req.path, "BLOCKED", 0);
-        closesocket(clientSocket);
+        closeConnection(deadlines, clientSocket);
         return;
     }
 
-    SOCKET remoteSocket = connectToRemote(req.host, req.port);
+    // Fresh cache hits never touch the upstream path; stale entries with
+    // validators are revalidated by forwardHttp(). Misses on a URL that is
+    // already being fetched follow that fetch instead of opening another one.
+    bool cacheable = (cacheEnabled() || diskCacheEnabled() || collapseEnabled()) && isCacheableRequest(req);
+    CacheEntryPtr cached;
+    SharedFetchPtr shared;
+    if (cacheable) {
+        if (serveFromCache(clientSocket, req, ipStr, cached)) {
+            closeConnection(deadlines, clientSocket);
+            return;
+        }
+        if (collapseEnabled()) {
+            bool leader = false;
+            shared = collapseJoin(cacheKey(req), leader);
+            if (!leader) {
+                bool complete = false;
+                long long sent = collapseFollow(clientSocket, *shared, complete);
+                if (sent >= 0) {
+                    logProxy(ipStr, req.host, req.port, req.method, req.path, complete ? "COLLAPSED" : "INCOMPLETE",
+                             sent, shared->status, complete ? shared->bodyBytes : -1);
+                    closeConnection(deadlines, clientSocket);
+                    return;
+                }
+                // Declined or timed out: the leader may have refreshed the cache meanwhile.
+                shared.reset();
+                if (serveFromCache(clientSocket, req, ipStr, cached)) {
+                    closeConnection(deadlines, clientSocket);
+                    return;
+                }
+            }
+        }
+    }
+
+    // An open breaker answers immediately instead of re-running DNS and a
+    // blocking connect() against an upstream that keeps failing. Over the
+    // in-flight connect cap, the request is refused before the breaker is
+    // asked, so no probe slot is taken.
+    bool probe = false;
+    SOCKET remoteSocket = INVALID_SOCKET;
+    bool admitted = upstreamConnectBegin();
+    bool allowed = admitted && upstreamAllow(req.host, req.port, probe);
+    if (allowed) {
+        remoteSocket = connectToRemote(req.host.c_str(), req.port.c_str());
+        upstreamResult(req.host, req.port, remoteSocket != INVALID_SOCKET, probe);
+    }
+    if (admitted) upstreamConnectEnd();
     if (remoteSocket == INVALID_SOCKET) {
-        sendAll(clientSocket, HTTP_502.c_str(), (int)HTTP_502.length());
-        logProxy(ipStr, req.host, req.port, req.method, req.path, "ERR_CONN", 0);
-        closesocket(clientSocket); 
+        const std::string& reply = admitted ? HTTP_502 : HTTP_503;
+        sendAll(clientSocket, reply.c_str(), (int)reply.length());
+        logProxy(ipStr, req.host, req.port, req.method, req.path,
+                 !admitted ? "ERR_OVERLOAD" : allowed ? "ERR_CONN" : "ERR_CIRCUIT", 0);
+        if (shared) collapseFinish(*shared, false);
+        closeConnection(deadlines, clientSocket);
         return;
     }
-    setSocketTimeout(remoteSocket, 15000); 
 
     if (req.method == "CONNECT") {
-        if (sendAll(clientSocket, HTTP_200_CON.c_str(), (int)HTTP_200_CON.length()) != SOCKET_ERROR) {
+        // Joined rather than detached: the upstream half uses the sockets
+        // and the deadlines, which must outlive it. It starts before the 200,
+        // so a tunnel that cannot get a thread is still refused cleanly.
+        uint64_t connId = active.id;
+        uint32_t clientIp = currentClientIp;
+        PoolThread upstream([clientSocket, remoteSocket, connId, clientIp, &deadlines] {
+            relay(clientSocket, remoteSocket, M_BYTES_UPSTREAM, connId, clientIp, &deadlines);
+        });
+        if (!upstream.joinable()) {
+            sendAll(clientSocket, HTTP_503.c_str(), (int)HTTP_503.length());
+            logProxy(ipStr, req.host, req.port, "CONNECT", "-", "ERR_OVERLOAD", 0);
+        } else if (sendAll(clientSocket, HTTP_200_CON.c_str(), (int)HTTP_200_CON.length()) != SOCKET_ERROR) {
             logProxy(ipStr, req.host, req.port, "CONNECT", "-", "TUNNEL", 0);
             
-            std::thread(relay, clientSocket, remoteSocket).detach();
-            relay(remoteSocket, clientSocket);
+            metricAdd(M_ACTIVE_TUNNELS);
+            deadlineStart(deadlines, DL_LIFETIME);
+            relay(remoteSocket, clientSocket, M_BYTES_DOWNSTREAM, active.id, currentClientIp, &deadlines);
+            shutdown(clientSocket, SD_RECEIVE); // origin is done; stop waiting on the client
+            upstream.join();
+            metricAdd(M_ACTIVE_TUNNELS, -1);
+        } else {
+            shutdown(clientSocket, SD_BOTH); // ends the upstream half's read
+            upstream.join();
         }
     } else {
-        std::string finalRequest = modifyRequestLine(req); 
-        sendAll(remoteSocket, finalRequest.c_str(), (int)finalRequest.length());
-
-        char buffer[32768];
-        int n, totalBytes = 0;
-        while ((n = recv(remoteSocket, buffer, sizeof(buffer), 0)) > 0) {
-            if (sendAll(clientSocket, buffer, n) == SOCKET_ERROR) break;
-            totalBytes += n;
-        }
-        logProxy(ipStr, req.host, req.port, req.method, req.path, "ALLOWED", totalBytes);
+        forwardHttp(clientSocket, remoteSocket, req, ipStr, cached, cacheable, shared.get());
     }
 
-    closesocket(remoteSocket);
-    closesocket(clientSocket);
+    closeConnection(deadlines, clientSocket, remoteSocket);
 }
\ No newline at end of file
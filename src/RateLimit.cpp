@@ -0,0 +1,272 @@
+/**
+ * @file RateLimit.cpp
+ * @brief Per-client token buckets for connection rate, concurrency and
+ *        bandwidth, kept in a sharded table keyed by source address.
+ */
+
+#include "../include/RateLimit.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct SubnetRule {
+    uint32_t network = 0;
+    uint32_t mask = 0;
+    int prefix = 0;
+    RateLimits limits;
+};
+
+// Holds up to `burst` tokens and gains `rate` per second, worked out from the
+// time since it was last touched instead of by a timer.
+struct TokenBucket {
+    double tokens = 0;
+    Clock::time_point refilled;
+
+    void refill(double rate, double burst, Clock::time_point now) {
+        double elapsed = std::chrono::duration<double>(now - refilled).count();
+        tokens = std::min(burst, tokens + elapsed * rate);
+        refilled = now;
+    }
+};
+
+struct ClientState {
+    const RateLimits* limits = nullptr;
+    TokenBucket conns;
+    TokenBucket bytes;
+    int open = 0;
+    bool limited = false; // so only the start of a limited spell is logged
+    Clock::time_point lastSeen;
+};
+
+struct ClientShard {
+    std::mutex mtx;
+    std::unordered_map<uint32_t, ClientState> table;
+    Clock::time_point nextSweep;
+};
+
+static const int CLIENT_SHARDS = 64;
+static const double MAX_THROTTLE_SECONDS = 1.0; // per read; a larger debt is paid over several reads
+static ClientShard shards[CLIENT_SHARDS];
+static RateLimits defaults;
+static std::vector<SubnetRule> rules; // longest prefix first, fixed after init
+static std::chrono::milliseconds idleAfter(60000);
+static bool enabled = false;
+static bool bytesLimited = false;
+static std::atomic<uint64_t> rejectedRate{0};
+static std::atomic<uint64_t> rejectedConcurrent{0};
+static std::atomic<uint64_t> throttledMs{0};
+
+static std::string ipText(uint32_t ip) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%u.%u.%u.%u", ip >> 24, (ip >> 16) & 255, (ip >> 8) & 255, ip & 255);
+    return buf;
+}
+
+static bool unlimited(const RateLimits& l) {
+    return l.connPerSec <= 0 && l.maxConcurrent <= 0 && l.bytesPerSec <= 0;
+}
+
+static void fillBursts(RateLimits& l) {
+    if (l.connBurst <= 0) l.connBurst = l.connPerSec;
+    if (l.connBurst < 1) l.connBurst = 1;
+    if (l.bytesBurst <= 0) l.bytesBurst = l.bytesPerSec;
+}
+
+static bool parseSubnet(const std::string& text, uint32_t& network, uint32_t& mask, int& prefix) {
+    unsigned a, b, c, d;
+    int bits = 32;
+    int n = std::sscanf(text.c_str(), "%u.%u.%u.%u/%d", &a, &b, &c, &d, &bits);
+    if ((n != 4 && n != 5) || a > 255 || b > 255 || c > 255 || d > 255 || bits < 0 || bits > 32) return false;
+    mask = bits == 0 ? 0 : 0xFFFFFFFFu << (32 - bits);
+    network = ((a << 24) | (b << 16) | (c << 8) | d) & mask;
+    prefix = bits;
+    return true;
+}
+
+static bool parseRule(const std::string& line, SubnetRule& rule) {
+    std::istringstream is(line);
+    std::string subnet, field;
+    if (!(is >> subnet) || !parseSubnet(subnet, rule.network, rule.mask, rule.prefix)) return false;
+    rule.limits = defaults;
+    while (is >> field) {
+        size_t eq = field.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = field.substr(0, eq);
+        double value = std::atof(field.c_str() + eq + 1);
+        if (key == "conn_rate") rule.limits.connPerSec = value;
+        else if (key == "conn_burst") rule.limits.connBurst = value;
+        else if (key == "concurrent") rule.limits.maxConcurrent = (int)value;
+        else if (key == "kb_rate") rule.limits.bytesPerSec = value * 1024;
+        else if (key == "kb_burst") rule.limits.bytesBurst = value * 1024;
+        else return false;
+    }
+    fillBursts(rule.limits);
+    return true;
+}
+
+bool initRateLimit(const RateLimitConfig& config) {
+    for (ClientShard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.table.clear();
+    }
+    defaults = config.defaults; // rules inherit the unfilled values
+    idleAfter = std::chrono::milliseconds(config.idleMs > 0 ? config.idleMs : 60000);
+    rules.clear();
+
+    bool ok = true;
+    if (!config.rulesPath.empty()) {
+        std::ifstream file(config.rulesPath);
+        if (!file.is_open()) {
+            std::cerr << "[ERROR] Could not find rate limit rules: " << config.rulesPath << std::endl;
+        }
+        std::string line;
+        int lineNo = 0;
+        while (std::getline(file, line)) {
+            lineNo++;
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start == std::string::npos || line[start] == '#') continue;
+            SubnetRule rule;
+            if (!parseRule(line, rule)) {
+                std::cerr << "[ERROR] " << config.rulesPath << ":" << lineNo << ": bad rate limit rule" << std::endl;
+                ok = false;
+                continue;
+            }
+            rules.push_back(rule);
+        }
+        std::stable_sort(rules.begin(), rules.end(),
+                         [](const SubnetRule& x, const SubnetRule& y) { return x.prefix > y.prefix; });
+    }
+
+    fillBursts(defaults);
+    enabled = !unlimited(defaults);
+    bytesLimited = defaults.bytesPerSec > 0;
+    for (const SubnetRule& rule : rules) {
+        enabled = enabled || !unlimited(rule.limits);
+        bytesLimited = bytesLimited || rule.limits.bytesPerSec > 0;
+    }
+    return ok;
+}
+
+bool rateLimitEnabled() { return enabled; }
+
+static const RateLimits& limitsFor(uint32_t ip) {
+    for (const SubnetRule& rule : rules) {
+        if ((ip & rule.mask) == rule.network) return rule.limits;
+    }
+    return defaults;
+}
+
+static ClientShard& shardFor(uint32_t ip) {
+    return shards[(ip * 2654435761u) >> 26]; // top 6 bits of a multiplicative hash
+}
+
+// Drops addresses with nothing open that have been quiet for idleAfter. Runs
+// at most once a second per shard, under its lock.
+static void sweep(ClientShard& shard, Clock::time_point now) {
+    if (now < shard.nextSweep) return;
+    shard.nextSweep = now + std::chrono::seconds(1);
+    for (auto it = shard.table.begin(); it != shard.table.end();) {
+        if (it->second.open == 0 && now - it->second.lastSeen >= idleAfter) it = shard.table.erase(it);
+        else ++it;
+    }
+}
+
+RateVerdict clientAdmit(uint32_t ip) {
+    if (!enabled) return RATE_ALLOW;
+    const RateLimits& l = limitsFor(ip);
+    if (unlimited(l)) return RATE_ALLOW; // exempt subnets keep no state
+
+    ClientShard& shard = shardFor(ip);
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    sweep(shard, now);
+    auto it = shard.table.find(ip);
+    if (it == shard.table.end()) {
+        it = shard.table.emplace(ip, ClientState()).first;
+        ClientState& fresh = it->second;
+        fresh.limits = &l;
+        fresh.conns.tokens = l.connBurst;
+        fresh.bytes.tokens = l.bytesBurst;
+        fresh.conns.refilled = fresh.bytes.refilled = now;
+    }
+    ClientState& c = it->second;
+    c.lastSeen = now;
+
+    RateVerdict verdict = RATE_ALLOW;
+    if (l.maxConcurrent > 0 && c.open >= l.maxConcurrent) {
+        verdict = RATE_TOO_MANY;
+    } else if (l.connPerSec > 0) {
+        c.conns.refill(l.connPerSec, l.connBurst, now);
+        if (c.conns.tokens >= 1) c.conns.tokens -= 1;
+        else verdict = RATE_TOO_FAST;
+    }
+    if (verdict == RATE_ALLOW) {
+        c.open++;
+        c.limited = false;
+        return verdict;
+    }
+
+    (verdict == RATE_TOO_FAST ? rejectedRate : rejectedConcurrent)++;
+    if (!c.limited) {
+        c.limited = true;
+        std::cout << "[RATE] " << ipText(ip) << " limited: ";
+        if (verdict == RATE_TOO_FAST) std::cout << "over " << l.connPerSec << " new connections/s" << std::endl;
+        else std::cout << l.maxConcurrent << " connections already open" << std::endl;
+    }
+    return verdict;
+}
+
+void clientRelease(uint32_t ip) {
+    if (!enabled) return;
+    ClientShard& shard = shardFor(ip);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.table.find(ip);
+    if (it == shard.table.end() || it->second.open == 0) return;
+    it->second.open--;
+    it->second.lastSeen = Clock::now();
+}
+
+void clientThrottle(uint32_t ip, size_t bytes) {
+    if (!bytesLimited) return;
+    double wait = 0;
+    {
+        ClientShard& shard = shardFor(ip);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.table.find(ip);
+        if (it == shard.table.end()) return;
+        ClientState& c = it->second;
+        const RateLimits& l = *c.limits;
+        if (l.bytesPerSec <= 0) return;
+        Clock::time_point now = Clock::now();
+        c.bytes.refill(l.bytesPerSec, l.bytesBurst, now);
+        c.bytes.tokens -= (double)bytes;
+        c.lastSeen = now;
+        if (c.bytes.tokens < 0) wait = std::min(-c.bytes.tokens / l.bytesPerSec, MAX_THROTTLE_SECONDS);
+    }
+    if (wait > 0) {
+        throttledMs += (uint64_t)(wait * 1000);
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+RateLimitStats rateLimitStats() {
+    RateLimitStats s;
+    s.rejectedRate = rejectedRate;
+    s.rejectedConcurrent = rejectedConcurrent;
+    s.throttledMs = throttledMs;
+    for (ClientShard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        s.tracked += shard.table.size();
+    }
+    return s;
+}
\ No newline at end of file
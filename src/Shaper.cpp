@@ -0,0 +1,106 @@
+/**
+ * @file Shaper.cpp
+ * @brief Global token bucket with deficit round robin among the flows
+ *        waiting for it. Tickless: waiting flows wake on a timer and whoever
+ *        holds the lock hands out the tokens that have accrued.
+ */
+
+#include "../include/Shaper.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+typedef std::chrono::steady_clock Clock;
+
+bool shaperOn = false;
+static ShaperConfig cfg;
+static double burst = 0;
+static std::mutex shaperMtx;
+static std::deque<ShapedFlow*> ring; // flows waiting for tokens, in DRR order
+static double tokens = 0;
+static Clock::time_point refilled;
+static uint64_t grantedBytes = 0;
+static uint64_t waits = 0;
+
+void initShaper(const ShaperConfig& config) {
+    std::lock_guard<std::mutex> lock(shaperMtx);
+    cfg = config;
+    if (cfg.quantum == 0) cfg.quantum = 8192;
+    // 50 ms of traffic, and never less than one quantum, so an idle link
+    // lets a burst through without queueing.
+    burst = std::max(cfg.bytesPerSec / 20, (double)cfg.quantum);
+    tokens = burst;
+    refilled = Clock::now();
+    shaperOn = cfg.bytesPerSec > 0;
+}
+
+static void refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - refilled).count();
+    tokens = std::min(burst, tokens + elapsed * cfg.bytesPerSec);
+    refilled = now;
+}
+
+// Hands accrued tokens to the waiting flows. A flow's deficit grows by one
+// quantum when its turn starts; it keeps the turn until the deficit or its
+// chunk is used up, and leaves the ring (deficit reset) once fully granted.
+static void dispatch(Clock::time_point now) {
+    refill(now);
+    while (tokens >= 1 && !ring.empty()) {
+        ShapedFlow* f = ring.front();
+        if (!f->inTurn) {
+            f->deficit += cfg.quantum;
+            f->inTurn = true;
+        }
+        size_t grant = std::min({ f->deficit, f->pending, (size_t)tokens });
+        f->pending -= grant;
+        f->deficit -= grant;
+        tokens -= (double)grant;
+        grantedBytes += grant;
+        if (f->pending == 0) {
+            ring.pop_front();
+            f->deficit = 0;
+            f->inTurn = false;
+            f->cv.notify_one();
+        } else if (f->deficit == 0) {
+            ring.pop_front();
+            ring.push_back(f);
+            f->inTurn = false;
+        } else {
+            break; // out of tokens mid-turn; the flow resumes it next time
+        }
+    }
+}
+
+void shapeBytesSlow(ShapedFlow& flow, size_t bytes) {
+    if (bytes == 0) return;
+    std::unique_lock<std::mutex> lock(shaperMtx);
+    Clock::time_point now = Clock::now();
+    refill(now);
+    if (ring.empty() && tokens >= (double)bytes) {
+        tokens -= (double)bytes;
+        grantedBytes += bytes;
+        return;
+    }
+
+    waits++;
+    flow.pending = bytes;
+    ring.push_back(&flow);
+    dispatch(now);
+    while (flow.pending > 0) {
+        // Sleep until about one quantum has accrued (0.5..5 ms); any waiter
+        // that wakes dispatches for everyone, and grants wake their flows.
+        double seconds = std::min(std::max(((double)cfg.quantum - tokens) / cfg.bytesPerSec, 0.0005), 0.005);
+        flow.cv.wait_for(lock, std::chrono::duration<double>(seconds));
+        dispatch(Clock::now());
+    }
+}
+
+ShaperStats shaperStats() {
+    std::lock_guard<std::mutex> lock(shaperMtx);
+    ShaperStats s;
+    s.grantedBytes = grantedBytes;
+    s.waits = waits;
+    s.waitingFlows = ring.size();
+    return s;
+}
\ No newline at end of file
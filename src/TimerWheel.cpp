@@ -0,0 +1,94 @@
+/**
+ * @file TimerWheel.cpp
+ * @brief Hierarchical timing wheel with O(1) arm/cancel.
+ */
+
+#include "../include/TimerWheel.h"
+
+static void unlink(TimerNode& node) {
+    node.prev->next = node.next;
+    node.next->prev = node.prev;
+    node.prev = node.next = nullptr;
+}
+
+static void pushBack(TimerNode& head, TimerNode& node) {
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+}
+
+TimerWheel::TimerWheel(uint64_t startTick) : current(startTick) {
+    for (int l = 0; l < LEVELS; l++) {
+        for (int s = 0; s < SLOTS; s++) slots[l][s].prev = slots[l][s].next = &slots[l][s];
+    }
+}
+
+// Picks the lowest level whose span covers the distance to the deadline and
+// files the node under the deadline's digit at that level. A node at level L
+// comes back down when the low L digits of the clock roll over to it.
+void TimerWheel::place(TimerNode& node) {
+    uint64_t delta = node.expires - current;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) level++;
+    size_t slot = (size_t)(node.expires >> (SLOT_BITS * level)) & (SLOTS - 1);
+    pushBack(slots[level][slot], node);
+}
+
+void TimerWheel::arm(TimerNode& node, uint64_t expires) {
+    if (node.armed()) {
+        unlink(node);
+        count--;
+    }
+    const uint64_t span = (1ull << (SLOT_BITS * LEVELS)) - 1;
+    if (expires <= current) expires = current + 1;
+    if (expires - current > span) expires = current + span;
+    node.expires = expires;
+    place(node);
+    count++;
+}
+
+void TimerWheel::cancel(TimerNode& node) {
+    if (!node.armed()) return;
+    unlink(node);
+    count--;
+}
+
+void TimerWheel::cascade(int level) {
+    TimerNode& head = slots[level][(current >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    while (head.next != &head) {
+        TimerNode& node = *head.next;
+        unlink(node);
+        place(node);
+    }
+}
+
+size_t TimerWheel::advance(uint64_t nowTick) {
+    size_t fired = 0;
+    while (current < nowTick) {
+        current++;
+        // Highest level first, so nodes it hands down land in slots that are
+        // cascaded or fired later in this same tick.
+        int top = 0;
+        while (top < LEVELS - 1 && (current & ((1ull << (SLOT_BITS * (top + 1))) - 1)) == 0) top++;
+        for (int level = top; level >= 1; level--) cascade(level);
+
+        // Detach the due slot first: callbacks may re-arm into the wheel.
+        TimerNode& head = slots[0][current & (SLOTS - 1)];
+        if (head.next == &head) continue;
+        TimerNode due;
+        due.prev = head.prev;
+        due.next = head.next;
+        head.next->prev = &due;
+        head.prev->next = &due;
+        head.prev = head.next = &head;
+        while (due.next != &due) {
+            TimerNode& node = *due.next;
+            unlink(node);
+            count--;
+            fired++;
+            if (node.fire) node.fire(&node);
+        }
+    }
+    return fired;
+}
\ No newline at end of file
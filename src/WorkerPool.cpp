@@ -0,0 +1,332 @@
+/**
+ * @file WorkerPool.cpp
+ * @brief Work-stealing pool of small-stack worker threads for connection
+ *        handlers, with direct hand-off for tasks the caller waits on.
+ */
+
+#include "../include/WorkerPool.h"
+#include "../include/Common.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <vector>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef std::function<void()> Task;
+
+struct Worker {
+    std::mutex mtx;
+    std::deque<Task> tasks; // owner pops the front, thieves take the back
+};
+
+static WorkerPoolConfig cfg;
+static bool poolOn = false;
+static Worker* workers = nullptr;     // cfg.maxThreads slots
+static std::atomic<int> highWater{0}; // slots ever used; thieves look at these
+
+// Sleeping, waking and growing. `idle` counts sleeping workers nobody has
+// claimed yet; whoever needs one claims it by moving it to `wakeups`. The
+// containers are never destroyed: workers may still be using them while
+// static destructors run at exit.
+static std::mutex poolMtx;
+static std::condition_variable& poolCv = *new std::condition_variable;
+static int live = 0;
+static int idle = 0;
+static int wakeups = 0;
+static std::vector<int>& freeSlots = *new std::vector<int>;
+static std::deque<Task>& handoff = *new std::deque<Task>; // poolStart() tasks, each with a claimed worker
+
+static std::atomic<size_t> queued{0};
+static std::atomic<unsigned> nextSlot{0};
+static std::atomic<uint64_t> executed{0};
+static std::atomic<uint64_t> stolen{0};
+static std::atomic<uint64_t> spawned{0};
+static std::atomic<uint64_t> overflow{0};
+
+static thread_local int mySlot = -1;
+
+static void workerMain(int slot, Task first);
+
+// What a new thread runs: a pool worker (with its first task) or, for
+// `slot` -1, just the task.
+struct Launch {
+    int slot;
+    Task task;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI threadEntry(LPVOID arg) {
+#else
+static void* threadEntry(void* arg) {
+#endif
+    Launch* launch = static_cast<Launch*>(arg);
+    if (launch->slot >= 0) workerMain(launch->slot, std::move(launch->task));
+    else launch->task();
+    delete launch;
+    return 0;
+}
+
+// A detached thread with the configured stack size; std::thread cannot set
+// one. On failure the caller keeps `launch`.
+static bool startThread(Launch* launch) {
+#ifdef _WIN32
+    HANDLE h = CreateThread(NULL, cfg.stackBytes, threadEntry, launch, STACK_SIZE_PARAM_IS_A_RESERVATION, NULL);
+    if (h) CloseHandle(h);
+    return h != NULL;
+#else
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, std::max(cfg.stackBytes, (size_t)PTHREAD_STACK_MIN));
+    pthread_t t;
+    bool ok = pthread_create(&t, &attr, threadEntry, launch) == 0;
+    pthread_attr_destroy(&attr);
+    return ok;
+#endif
+}
+
+static bool popOwn(Worker& me, Task& task) {
+    std::lock_guard<std::mutex> lock(me.mtx);
+    if (me.tasks.empty()) return false;
+    task = std::move(me.tasks.front());
+    me.tasks.pop_front();
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Victims are tried from a random starting point so thieves spread out
+// instead of all hammering slot 0.
+static bool steal(int self, Task& task) {
+    if (queued.load(std::memory_order_relaxed) == 0) return false;
+    static thread_local uint32_t rng = 0x9e3779b9u ^ (uint32_t)(uintptr_t)&rng;
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    int n = highWater.load(std::memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        int v = (int)((rng + (uint32_t)i) % (uint32_t)n);
+        if (v == self) continue;
+        Worker& victim = workers[v];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (victim.tasks.empty()) continue;
+        task = std::move(victim.tasks.back());
+        victim.tasks.pop_back();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        stolen.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+static bool takeHandoff(Task& task) {
+    std::lock_guard<std::mutex> lock(poolMtx);
+    if (handoff.empty()) return false;
+    task = std::move(handoff.front());
+    handoff.pop_front();
+    return true;
+}
+
+static void workerMain(int slot, Task first) {
+    mySlot = slot;
+    Worker& me = workers[slot];
+    Task task = std::move(first);
+    while (true) {
+        if (task || takeHandoff(task) || popOwn(me, task) || steal(slot, task)) {
+            task();
+            task = nullptr; // drop the captures before sleeping
+            executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(poolMtx);
+        if (!handoff.empty() || queued.load(std::memory_order_relaxed) > 0) continue;
+        idle++;
+        if (poolCv.wait_for(lock, std::chrono::milliseconds(cfg.idleMs), [] { return wakeups > 0; })) {
+            wakeups--; // whoever claimed us already took us off `idle`
+            continue;
+        }
+        idle--;
+        if (slot >= cfg.threads) {
+            live--;
+            freeSlots.push_back(slot);
+            return;
+        }
+    }
+}
+
+// Caller holds poolMtx and has checked live < cfg.maxThreads.
+static int reserveSlot() {
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = highWater.load(std::memory_order_relaxed);
+        highWater.store(slot + 1, std::memory_order_release);
+    }
+    live++;
+    return slot;
+}
+
+// Starts a worker in a reserved slot, outside poolMtx: thread creation is the
+// slow part, and the accept loop should not hold everyone else up with it.
+// On failure the slot is released and `first` is left with the caller.
+static bool launchWorker(int slot, Task& first) {
+    Launch* launch = new Launch{ slot, std::move(first) };
+    if (startThread(launch)) return true;
+    first = std::move(launch->task);
+    delete launch;
+    std::lock_guard<std::mutex> lock(poolMtx);
+    live--;
+    freeSlots.push_back(slot);
+    return false;
+}
+
+static void claimWorker() {
+    idle--;
+    wakeups++;
+    poolCv.notify_one();
+}
+
+bool initWorkerPool(const WorkerPoolConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(poolMtx);
+        if (poolOn || config.threads <= 0) return poolOn;
+        cfg = config;
+        cfg.maxThreads = std::max(cfg.maxThreads, cfg.threads);
+        if (cfg.idleMs <= 0) cfg.idleMs = 30000;
+        workers = new Worker[cfg.maxThreads];
+    }
+    int started = 0;
+    for (int i = 0; i < cfg.threads; i++) {
+        int slot;
+        {
+            std::lock_guard<std::mutex> lock(poolMtx);
+            slot = reserveSlot();
+        }
+        Task none;
+        if (!launchWorker(slot, none)) break;
+        started++;
+    }
+    std::lock_guard<std::mutex> lock(poolMtx);
+    cfg.threads = started; // slots below this never retire
+    poolOn = started > 0;
+    return poolOn;
+}
+
+bool workerPoolEnabled() {
+    return poolOn;
+}
+
+// With no one asleep, a new worker is started with the task in hand (false at
+// the cap, or if the thread cannot be created).
+static bool growWith(Task& task) {
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(poolMtx);
+        if (idle > 0 || live >= cfg.maxThreads) return false;
+        slot = reserveSlot();
+    }
+    if (!launchWorker(slot, task)) return false;
+    spawned.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void poolSubmit(Task task) {
+    if (growWith(task)) return;
+    // Outside the pool, only the permanent workers' deques are used, so a
+    // task never lands on a worker that is about to retire.
+    int slot = mySlot >= 0 ? mySlot : (int)(nextSlot.fetch_add(1, std::memory_order_relaxed) % (unsigned)cfg.threads);
+    {
+        std::lock_guard<std::mutex> lock(workers[slot].mtx);
+        workers[slot].tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(poolMtx);
+    if (idle > 0) claimWorker();
+}
+
+// Never queues: a sleeping worker is claimed for the task, a new worker is
+// started, or, at the cap, a plain thread runs it. False, with the task
+// dropped, when no thread can be had. Running it here instead would
+// serialize it with the caller, who waits on it.
+static bool poolStart(Task task) {
+    int slot = -1;
+    {
+        std::lock_guard<std::mutex> lock(poolMtx);
+        if (idle > 0) {
+            handoff.push_back(std::move(task));
+            claimWorker();
+            return true;
+        }
+        if (live < cfg.maxThreads) slot = reserveSlot();
+    }
+    if (slot >= 0 && launchWorker(slot, task)) {
+        spawned.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    overflow.fetch_add(1, std::memory_order_relaxed);
+    Launch* launch = new Launch{ -1, std::move(task) };
+    if (startThread(launch)) return true;
+    delete launch;
+    return false;
+}
+
+struct PoolThread::Done {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool finished = false;
+};
+
+PoolThread::PoolThread(Task task) {
+    if (!poolOn) {
+        try {
+            thread = std::thread(std::move(task));
+        } catch (const std::system_error&) {
+            // Not joinable; the caller fails the request.
+        }
+        return;
+    }
+    done = std::make_shared<Done>();
+    std::shared_ptr<Done> d = done;
+    bool started = poolStart([d, task] {
+        task();
+        std::lock_guard<std::mutex> lock(d->mtx);
+        d->finished = true;
+        d->cv.notify_all();
+    });
+    if (!started) done.reset();
+}
+
+void PoolThread::join() {
+    if (thread.joinable()) {
+        thread.join();
+        return;
+    }
+    if (!done) return;
+    std::unique_lock<std::mutex> lock(done->mtx);
+    done->cv.wait(lock, [this] { return done->finished; });
+    lock.unlock();
+    done.reset();
+}
+
+WorkerPoolStats workerPoolStats() {
+    WorkerPoolStats s;
+    {
+        std::lock_guard<std::mutex> lock(poolMtx);
+        s.workers = (uint64_t)live;
+        s.idle = (uint64_t)idle;
+    }
+    s.queued = queued.load(std::memory_order_relaxed);
+    s.executed = executed.load(std::memory_order_relaxed);
+    s.stolen = stolen.load(std::memory_order_relaxed);
+    s.spawned = spawned.load(std::memory_order_relaxed);
+    s.overflow = overflow.load(std::memory_order_relaxed);
+    return s;
+}
\ No newline at end of file
@@ -2,29 +2,99 @@
 #include <thread>
 #include <iomanip>
 #include <filesystem>
+#include <csignal>
 #include "../include/Common.h"
 #include "../include/ProxyCore.h"
 #include "../include/Filter.h"
 #include "../include/Config.h"
+#include "../include/Cache.h"
+#include "../include/DiskCache.h"
+#include "../include/Collapse.h"
+#include "../include/CircuitBreaker.h"
+#include "../include/Metrics.h"
+#include "../include/Latency.h"
+#include "../include/RateLimit.h"
+#include "../include/Shaper.h"
+#include "../include/Deadline.h"
+#include "../include/Admission.h"
+#include "../include/WorkerPool.h"
+#include "../include/AsyncProxy.h"
+#include "../include/BufferPool.h"
+#include "../include/Lifecycle.h"
+#include "../include/Logger.h"
 
 namespace fs = std::filesystem;
 
 SOCKET listenSock = INVALID_SOCKET;
 
-BOOL WINAPI ctrl_handler(DWORD type) {
-    if (type == CTRL_C_EVENT) {
-        std::cout << "\n" << std::string(60, '=') << std::endl;
-        std::cout << "[SHUTDOWN] Signal received. Cleaning up resources..." << std::endl;
-        if (listenSock != INVALID_SOCKET) closesocket(listenSock);
-        WSACleanup();
-        std::cout << "[SHUTDOWN] Proxy Server halted safely." << std::endl;
-        std::cout << std::string(60, '=') << std::endl;
-        exit(0);
+// Runs once the accept loop has ended and the drain is over. `left` handlers
+// outlived the deadline; their sockets go with the process.
+void shutdownServer(const char* reason, int left) {
+    std::cout << "\n" << std::string(60, '=') << std::endl;
+    std::cout << "[SHUTDOWN] " << reason << " Cleaning up resources..." << std::endl;
+    if (left > 0) std::cout << "[SHUTDOWN] Drain deadline passed; closing " << left << " connection(s)." << std::endl;
+    // With handlers still running, the index stays mapped: it is MAP_SHARED,
+    // so the kernel writes it back once _Exit takes the process.
+    if (left == 0) shutdownDiskCache();
+    if (latencyEnabled()) {
+        std::cout << "[LATENCY] Per-phase latency since startup:" << std::endl;
+        dumpLatency(std::cout);
     }
+#ifdef _WIN32
+    if (left == 0) WSACleanup();
+#endif
+    std::cout << "[SHUTDOWN] Proxy Server halted safely." << std::endl;
+    std::cout << std::string(60, '=') << std::endl;
+    flushLogs();
+    // Handlers still running must not see static destructors.
+    if (left > 0) std::_Exit(0);
+    exit(0);
+}
+
+// Only stops the accept loop; main() drains and exits. A second signal
+// skips the drain.
+static volatile std::sig_atomic_t signals = 0;
+
+#ifdef _WIN32
+BOOL WINAPI ctrl_handler(DWORD type) {
+    if (type != CTRL_C_EVENT) return FALSE;
+    if (signals++) _exit(1);
+    requestStop();
+    // accept() is not polled on Windows; closing the listener wakes it.
+    SOCKET s = listenSock;
+    listenSock = INVALID_SOCKET;
+    closesocket(s);
     return TRUE;
 }
+#else
+void ctrl_handler(int) {
+    if (signals) _exit(1);
+    signals = 1;
+    requestStop(); // async-signal-safe: a flag and a pipe write
+}
+#endif
 
-void printBanner(int port) {
+// SIGHUP, from the reload watcher thread. A file that does not parse, or a
+// blocklist that cannot be read, leaves everything as it was. A blocklist
+// that disappears after the check is not applied either: loadFilters()
+// keeps the list in use.
+static void reloadConfig() {
+    std::vector<std::string> errors, restartOnly;
+    if (!Config::reload(errors, restartOnly)) {
+        std::cerr << "[CONFIG] " << Config::path() << " rejected; still running the previous settings." << std::endl;
+        for (const std::string& e : errors) std::cerr << "[CONFIG]   " << e << std::endl;
+        return;
+    }
+    for (const std::string& key : restartOnly) {
+        std::cout << "[CONFIG] " << key << " changed; it applies after a restart." << std::endl;
+    }
+    if (!loadFilters(Config::current()->filterPath)) {
+        std::cerr << "[CONFIG] Keeping the previous blocklist." << std::endl;
+    }
+    std::cout << "[CONFIG] Reloaded " << Config::path() << std::endl;
+}
+
+void printBanner(const Settings& cfg) {
     std::cout << std::string(60, '=') << std::endl;
     std::cout << "         CUSTOM NETWORK PROXY SERVER v1.0" << std::endl;
     std::cout << std::string(60, '=') << std::endl;
@@ -39,24 +109,144 @@ void printBanner(int port) {
         std::cout << " [FS]     Log directory found ... OK" << std::endl;
     }
 
-    std::cout << " [CONFIG] Port: " << port << std::endl;
+    std::cout << " [CONFIG] Port: " << cfg.port << std::endl;
     std::cout << " [FILTER] Logic operational." << std::endl;
-    std::cout << " [STATUS] Proxy is listening on 0.0.0.0:" << port << std::endl;
+    if (cacheEnabled()) {
+        std::cout << " [CACHE]  In-memory cache: " << (cfg.cacheMemoryBytes >> 20) << " MB" << std::endl;
+    }
+    if (diskCacheEnabled()) {
+        std::cout << " [CACHE]  Disk cache: " << cfg.cacheDiskPath << " (" << (cfg.cacheDiskBytes >> 20) << " MB)" << std::endl;
+    }
+    if (rateLimitEnabled()) {
+        std::cout << " [RATE]   Per-client limits: " << cfg.rateConnPerSec << " conn/s, " << cfg.rateMaxConcurrent
+                  << " concurrent, " << (cfg.rateBytesPerSec >> 10) << " KB/s (0 = unlimited)" << std::endl;
+    }
+    if (shaperOn) {
+        std::cout << " [SHAPE]  " << (cfg.shapeBytesPerSec >> 10) << " KB/s shared fairly across flows" << std::endl;
+    }
+    if (admissionEnabled()) {
+        std::cout << " [ADMIT]  Max " << cfg.maxConnections << " connections, " << cfg.maxUpstreamConnects
+                  << " upstream connects in flight, shed above " << cfg.shedTargetMs << " ms dispatch delay (0 = unlimited/off)" << std::endl;
+    }
+    if (workerPoolEnabled()) {
+        std::cout << " [WORKER] " << cfg.workerThreads << " workers pre-spawned, up to " << cfg.workerMaxThreads << ", "
+                  << (cfg.workerStackBytes >> 10) << " KB stacks" << std::endl;
+    }
+    if (asyncHandlerEnabled()) {
+        std::cout << " [ASYNC]  Coroutine handler on " << cfg.asyncLoops << " event loop thread(s)" << std::endl;
+    }
+    std::cout << " [RELAY]  " << (cfg.relayAdaptiveBuffers ? "Adaptive 4-64 KB" : "Fixed 16 KB")
+              << " relay buffers" << (relaySocketTuning() ? ", socket buffers follow" : "") << std::endl;
+    std::cout << " [TIMEOUT] Header " << cfg.headerTimeoutMs << " ms, connect " << cfg.connectTimeoutMs << " ms, idle "
+              << cfg.idleTimeoutMs << " ms, tunnel lifetime " << cfg.tunnelMaxLifetimeMs << " ms (0 = unlimited)"
+              << std::endl;
+    if (metricsOn) {
+        std::cout << " [METRICS] http://" << cfg.metricsAddress << ":" << cfg.metricsPort << "/metrics" << std::endl;
+    }
+    if (restartEnabled()) {
+        std::cout << " [RESTART] Hot restart via " << cfg.restartSocket << ", old process drains for " << cfg.restartDrainMs
+                  << " ms" << std::endl;
+    }
+    std::cout << " [STATUS] Proxy is listening on 0.0.0.0:" << cfg.port << std::endl;
     std::cout << std::string(60, '-') << std::endl;
     std::cout << " [READY]  Waiting for client connections..." << std::endl;
-    std::cout << " [HINT]   Press Ctrl+C to terminate the server." << std::endl;
+    std::cout << " [HINT]   Press Ctrl+C (or send SIGTERM) to drain and stop the server." << std::endl;
+#ifndef _WIN32
+    std::cout << " [HINT]   Send SIGHUP to reload " << Config::path() << "." << std::endl;
+#endif
     std::cout << std::string(60, '=') << std::endl << std::endl;
 }
 
 int main() {
-    if (!Config::load("config/server.cfg")) {
+    std::vector<std::string> configErrors;
+    if (!Config::load("config/server.cfg", &configErrors)) {
+        if (!configErrors.empty()) {
+            std::cerr << "[FATAL] Invalid configuration:" << std::endl;
+            for (const std::string& e : configErrors) std::cerr << "[FATAL]   " << e << std::endl;
+            return 1;
+        }
         std::cerr << "[WARNING] Using defaults. Ensure config/server.cfg exists." << std::endl;
     }
+    // Module settings are taken from this snapshot once; a reload only
+    // changes what is read per request.
+    std::shared_ptr<const Settings> startup = Config::current();
+    const Settings& cfg = *startup;
 
-    int port = Config::getInt("PORT", 8888);
-    std::string filterPath = Config::getString("FILTER_PATH", "config/blocked.txt");
-
-    loadFilters(filterPath);
+    loadFilters(cfg.filterPath);
+    // A running proxy hands over its listeners and releases the disk cache
+    // before this one opens it, so the takeover comes ahead of the caches.
+    RestartConfig restart;
+    restart.socketPath = cfg.restartSocket;
+    restart.drainMs = cfg.restartDrainMs;
+    initRestart(restart);
+    std::vector<SOCKET> inherited;
+    bool tookOver = inheritListeners(inherited);
+    initCache((size_t)cfg.cacheMemoryBytes, (size_t)cfg.cacheMaxObjectBytes);
+    DiskCacheConfig disk;
+    disk.dir = cfg.cacheDiskPath;
+    disk.budgetBytes = cfg.cacheDiskBytes;
+    disk.segmentBytes = cfg.cacheDiskSegmentBytes;
+    disk.indexSlots = (uint32_t)cfg.cacheDiskIndexSlots;
+    initDiskCache(disk);
+    initCollapse(cfg.collapseTimeoutMs, (size_t)cfg.collapseMaxBytes);
+    CircuitBreakerConfig breaker;
+    breaker.failureThreshold = cfg.circuitFailureThreshold;
+    breaker.openMs = cfg.circuitOpenMs;
+    breaker.maxOpenMs = cfg.circuitMaxOpenMs;
+    breaker.halfOpenProbes = cfg.circuitHalfOpenProbes;
+    initCircuitBreaker(breaker);
+    RateLimitConfig limits;
+    limits.defaults.connPerSec = cfg.rateConnPerSec;
+    limits.defaults.connBurst = cfg.rateConnBurst;
+    limits.defaults.maxConcurrent = cfg.rateMaxConcurrent;
+    limits.defaults.bytesPerSec = (double)cfg.rateBytesPerSec;
+    limits.defaults.bytesBurst = (double)cfg.rateBytesBurst;
+    limits.rulesPath = cfg.rateLimitRules;
+    limits.idleMs = cfg.rateIdleMs;
+    initRateLimit(limits);
+    ShaperConfig shaping;
+    shaping.bytesPerSec = (double)cfg.shapeBytesPerSec;
+    shaping.quantum = (size_t)cfg.shapeQuantumBytes;
+    initShaper(shaping);
+    DeadlineConfig deadlines;
+    deadlines.headerMs = cfg.headerTimeoutMs;
+    deadlines.connectMs = cfg.connectTimeoutMs;
+    deadlines.idleMs = cfg.idleTimeoutMs;
+    deadlines.tunnelMaxMs = cfg.tunnelMaxLifetimeMs;
+    initDeadlines(deadlines);
+    AdmissionConfig admission;
+    admission.maxConnections = cfg.maxConnections;
+    admission.maxConnecting = cfg.maxUpstreamConnects;
+    admission.shedTargetMs = cfg.shedTargetMs;
+    admission.shedIntervalMs = cfg.shedIntervalMs;
+    initAdmission(admission);
+    WorkerPoolConfig pool;
+    pool.threads = cfg.workerThreads;
+    pool.maxThreads = cfg.workerMaxThreads;
+    pool.stackBytes = (size_t)cfg.workerStackBytes;
+    pool.idleMs = cfg.workerIdleMs;
+    initWorkerPool(pool);
+    RelayBufferConfig relayBuffers;
+    relayBuffers.adaptive = cfg.relayAdaptiveBuffers;
+    relayBuffers.tuneSocketBuffers = cfg.relayTuneSocketBuffers;
+    initRelayBuffers(relayBuffers);
+    // The coroutine handler has no cache, collapsing, shaping or per-client
+    // byte limits; with any of those configured the threaded one serves.
+    AsyncConfig async;
+    async.loops = cfg.asyncLoops;
+    bool asyncCovers = !cacheEnabled() && !diskCacheEnabled() && !collapseEnabled() && !shaperOn &&
+                       limits.defaults.bytesPerSec <= 0 && limits.rulesPath.empty();
+    if (async.loops > 0 && !asyncCovers) {
+        std::cerr << "[WARNING] ASYNC_LOOPS ignored: caching, collapsing, shaping or per-client byte limits are on."
+                  << std::endl;
+    } else if (async.loops > 0 && !initAsyncHandler(async)) {
+        std::cerr << "[WARNING] Async handler unavailable on this platform; using threads." << std::endl;
+    }
+    if (cfg.latencyHistograms) {
+        setLatencyEnabled(true);
+        startLatencyMerger(cfg.latencyMergeMs);
+    }
+#ifdef _WIN32
     SetConsoleCtrlHandler(ctrl_handler, TRUE);
 
     WSADATA wsa;
@@ -64,29 +254,96 @@ int main() {
         std::cerr << "[FATAL] Winsock startup failed." << std::endl;
         return 1;
     }
+#else
+    std::signal(SIGINT, ctrl_handler);
+    std::signal(SIGTERM, ctrl_handler);
+    std::signal(SIGHUP, [](int) { requestReload(); });
+    std::signal(SIGPIPE, SIG_IGN); // peers that vanish mid-send must not kill the process
+#endif
 
-    listenSock = socket(AF_INET, SOCK_STREAM, 0);
     sockaddr_in serverAddr{};
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY; 
-    serverAddr.sin_port = htons((u_short)port);
+    serverAddr.sin_port = htons((u_short)cfg.port);
 
-    if (bind(listenSock, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR ||
-        listen(listenSock, SOMAXCONN) == SOCKET_ERROR) {
-        std::cerr << "[FATAL] Could not bind to port " << port << ". Is it already in use?" << std::endl;
+    if (tookOver) {
+        // Bound by the previous process; PORT and METRICS_PORT changes need a cold start.
+        listenSock = inherited[0];
+        std::cout << "[RESTART] Took over the listeners of the running proxy." << std::endl;
+    } else if ((listenSock = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET ||
+               bind(listenSock, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR ||
+               listen(listenSock, SOMAXCONN) == SOCKET_ERROR) {
+        std::cerr << "[FATAL] Could not bind to port " << cfg.port << ". Is it already in use?" << std::endl;
+#ifdef _WIN32
         WSACleanup();
+#endif
         return 1;
     }
 
-    printBanner(port);
+    prepareListener(listenSock);
+
+    SOCKET metricsSock = inherited.size() > 1 ? inherited[1] : INVALID_SOCKET;
+    if (cfg.metricsPort > 0) startMetricsServer(cfg.metricsAddress, cfg.metricsPort, metricsSock);
+    else if (metricsSock != INVALID_SOCKET) closesocket(metricsSock);
+    startRestartServer({ listenSock, metricsListener() });
+    startReloadWatcher(reloadConfig);
+
+    printBanner(cfg);
 
-    while (true) {
-        SOCKET client = accept(listenSock, NULL, NULL);
-        if (client != INVALID_SOCKET) {
-            std::thread(handleClient, client).detach();
+    while (waitForClient(listenSock)) {
+        sockaddr_in peer{};
+        socklen_t peerLen = sizeof(peer);
+        SOCKET client = accept(listenSock, (sockaddr*)&peer, &peerLen);
+        if (client == INVALID_SOCKET) {
+            // Out of descriptors the listener stays readable; without the
+            // pause this loop would spin. A closed listener means a stop.
+            if (acceptBackoff("ACCEPT")) continue;
+            break;
         }
+        // Overload and over-limit clients are answered from the accept loop,
+        // so a flood never gets a thread of its own.
+        uint64_t acceptedAt = latencyNow();
+        if (admitConnection(acceptedAt) != ADMIT_OK) {
+            rejectClient(client, HTTP_503);
+            continue;
+        }
+        uint32_t ip = ntohl(peer.sin_addr.s_addr);
+        bool limited = rateLimitEnabled();
+        if (limited && clientAdmit(ip) != RATE_ALLOW) {
+            admissionRelease();
+            rejectClient(client, HTTP_429);
+            continue;
+        }
+        if (asyncHandlerEnabled()) {
+            asyncServe(client, [ip, limited] {
+                if (limited) clientRelease(ip);
+                admissionRelease();
+            });
+            continue;
+        }
+        auto serve = [client, ip, limited, acceptedAt] {
+            admissionDispatched(acceptedAt, latencyNow());
+            handleClient(client);
+            if (limited) clientRelease(ip);
+            admissionRelease();
+        };
+        admissionQueued(acceptedAt);
+        if (workerPoolEnabled()) poolSubmit(serve);
+        else std::thread(serve).detach();
     }
 
-    WSACleanup();
+    // A signal or a successor ended the loop. After a handoff the successor
+    // accepts; otherwise new clients are refused from here on. Either way the
+    // admitted connections finish before the process goes.
+    bool handoff = handedOff();
+    if (listenSock != INVALID_SOCKET) closesocket(listenSock);
+    listenSock = INVALID_SOCKET;
+    int drainMs = handoff ? restart.drainMs : cfg.shutdownDrainMs;
+    if (!handoff) {
+        std::cout << "[SHUTDOWN] Signal received. Stopped accepting; draining " << admissionStats().active
+                  << " connection(s) for up to " << drainMs << " ms." << std::endl;
+    }
+    int left = drainConnections(drainMs);
+    shutdownServer(handoff ? "Listeners handed off and connections drained." : "Connections drained.", left);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+# Usage: cmake -DREADELF=<readelf> -DBINARY=<proxy_exe> -P check_usdt.cmake
+# Fails unless every request-lifecycle probe is present in the binary's
+# .note.stapsdt section under provider "proxy".
+
+set(PROBES accept headers filter dns_start dns_end connect_start connect_end first_byte relay close)
+
+execute_process(COMMAND ${READELF} -n ${BINARY}
+                OUTPUT_VARIABLE notes
+                RESULT_VARIABLE rc)
+if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "${READELF} -n ${BINARY} failed (${rc})")
+endif()
+
+set(missing "")
+foreach(probe ${PROBES})
+    if(notes MATCHES "Provider: proxy\n[ \t]*Name: ${probe}\n")
+        message(STATUS "[PASS] proxy:${probe}")
+    else()
+        list(APPEND missing ${probe})
+    endif()
+endforeach()
+
+if(missing)
+    message(FATAL_ERROR "[FAIL] probes missing from ${BINARY}: ${missing}")
+endif()
\ No newline at end of file
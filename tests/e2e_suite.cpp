@@ -0,0 +1,858 @@
+/**
+ * @file e2e_suite.cpp
+ * @brief End-to-end correctness and performance scenarios against a real
+ *        proxy_exe process, a local origin_server and a generated blocklist.
+ *
+ * Usage: e2e_suite <get|connect|blocked|malformed|c10k|overload|async|restart|shutdown|reload>
+ *                  --proxy <proxy_exe> --origin <origin_server> --loadgen <loadgen>
+ *                  [--baselines <file>] [--results <file>] [--connections <n>]
+ *
+ * Each run starts its own origin and proxy on free loopback ports inside a
+ * temp directory (config/server.cfg, config/blocked.txt, logs/) and kills
+ * them on exit. Performance numbers are compared with the baselines file:
+ *
+ *     tolerance 0.35
+ *     get_rps   2000  higher
+ *     c10k_s    20    lower
+ *
+ * "higher" metrics fail below baseline * (1 - tolerance), "lower" ones above
+ * baseline * (1 + tolerance). PROXY_PERF_TOLERANCE overrides the file's
+ * tolerance. Measured values are appended to --results in the same format so
+ * a new baseline can be pasted in after an intentional change. Comparisons
+ * only fail the run with PROXY_PERF_GATE=1, on a machine the baselines were
+ * recorded for; otherwise they are printed.
+ *
+ * Linux only; exits non-zero on any failed check.
+ */
+
+#include "../include/ProxyCore.h"
+#include "../bench/BenchUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+namespace fs = std::filesystem;
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string scenario;
+    std::string proxyBin, originBin, loadgenBin;
+    std::string baselines, results;
+    int connections = 10000;
+};
+
+static Options opt;
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    std::printf("[%s] %s\n", ok ? "PASS" : "FAIL", what.c_str());
+    std::fflush(stdout);
+    if (!ok) failures++;
+}
+
+// ---------------------------------------------------------------- processes
+
+static pid_t spawn(const std::vector<std::string>& args, const fs::path& cwd, const fs::path& output) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    if (chdir(cwd.c_str()) != 0) _exit(127);
+    int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        dup2(fd, 1);
+        dup2(fd, 2);
+        close(fd);
+    }
+    std::vector<char*> argv;
+    for (const std::string& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    _exit(127);
+}
+
+static bool alive(pid_t pid) {
+    int status;
+    return waitpid(pid, &status, WNOHANG) == 0;
+}
+
+static bool waitForPort(int port, pid_t pid) {
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (Clock::now() < deadline && alive(pid)) {
+        SOCKET s = connectLoopback(port);
+        if (s != INVALID_SOCKET) {
+            closesocket(s);
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+
+static int freePort() {
+    int port = 0;
+    SOCKET s = listenLoopback(port);
+    closesocket(s);
+    return port;
+}
+
+// Origin + proxy in a scratch directory, torn down with the object.
+struct Stack {
+    fs::path dir;
+    int proxyPort = 0, originPort = 0, sinkPort = 0;
+    pid_t proxy = -1, origin = -1;
+    std::string extraConfig; // scenario-specific server.cfg lines
+
+    bool start() {
+        dir = fs::temp_directory_path() / ("proxy-e2e-" + opt.scenario + "-" + std::to_string(getpid()));
+        fs::create_directories(dir / "config");
+        proxyPort = freePort();
+        originPort = freePort();
+        sinkPort = freePort();
+
+        std::ofstream cfg(dir / "config" / "server.cfg");
+        cfg << "PORT=" << proxyPort << "\nFILTER_PATH=config/blocked.txt\nLOG_PATH=logs/proxy.log\n" << extraConfig;
+        cfg.close();
+
+        // A list big enough that lookups are not free, plus the names the checks use.
+        std::ofstream list(dir / "config" / "blocked.txt");
+        list << "blocked.test\nAds.Example.Invalid  \n";
+        for (int i = 0; i < 10000; i++) list << "tracker-" << i << ".example.invalid\n";
+        list.close();
+
+        origin = spawn({ opt.originBin, "--port", std::to_string(originPort), "--sink-port", std::to_string(sinkPort) },
+                       dir, dir / "origin.out");
+        if (!waitForPort(originPort, origin) || !waitForPort(sinkPort, origin)) return false;
+        proxy = spawn({ opt.proxyBin }, dir, dir / "proxy.out");
+        return waitForPort(proxyPort, proxy);
+    }
+
+    std::string target() const { return "127.0.0.1:" + std::to_string(originPort); }
+
+    ~Stack() {
+        for (pid_t pid : { proxy, origin }) {
+            if (pid <= 0) continue;
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        std::error_code ec;
+        if (!dir.empty() && failures == 0) fs::remove_all(dir, ec);
+        else if (!dir.empty()) std::printf("[INFO] Kept %s for inspection\n", dir.c_str());
+    }
+};
+
+// ---------------------------------------------------------------- client helpers
+
+static void setTimeout(SOCKET s, int seconds) {
+    timeval tv{ seconds, 0 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// Sends raw bytes and returns everything the proxy answers until it closes.
+static std::string exchange(int port, const std::string& request, bool halfClose = false) {
+    SOCKET s = connectLoopback(port);
+    if (s == INVALID_SOCKET) return "";
+    setTimeout(s, 10);
+    sendAll(s, request.data(), (int)request.size());
+    if (halfClose) shutdown(s, SD_SEND);
+    std::string out = readAll(s);
+    closesocket(s);
+    return out;
+}
+
+static std::string get(const Stack& st, const std::string& host, const std::string& path) {
+    return exchange(st.proxyPort, "GET http://" + host + path + " HTTP/1.1\r\nHost: " + host +
+                                      "\r\nUser-Agent: e2e_suite\r\nConnection: close\r\n\r\n");
+}
+
+static int statusOf(const std::string& response) {
+    if (response.compare(0, 5, "HTTP/") != 0) return 0;
+    size_t sp = response.find(' ');
+    return sp == std::string::npos ? 0 : std::atoi(response.c_str() + sp + 1);
+}
+
+static size_t bodyLength(const std::string& response) {
+    size_t end = response.find("\r\n\r\n");
+    return end == std::string::npos ? 0 : response.size() - end - 4;
+}
+
+// Runs loadgen with a JSON result on stdout and pulls out one numeric field.
+static bool runLoadgen(const Stack& st, const std::string& args, std::map<std::string, double>& out) {
+    std::string cmd = opt.loadgenBin + " --proxy 127.0.0.1:" + std::to_string(st.proxyPort) + " --target " +
+                      st.target() + " " + args + " --json -";
+    std::printf("[INFO] %s\n", cmd.c_str());
+    std::fflush(stdout);
+    FILE* p = popen(cmd.c_str(), "r");
+    if (!p) return false;
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), p)) > 0) text.append(buf, n);
+    int rc = pclose(p);
+    std::fputs(text.c_str(), stdout);
+
+    size_t json = text.rfind("{\"label\"");
+    if (json == std::string::npos) return false;
+    for (const char* key : { "requests", "errors", "errors_rejected", "throughput_rps", "throughput_mib_s", "p50", "p99" }) {
+        size_t k = text.find(std::string("\"") + key + "\":", json);
+        if (k != std::string::npos) out[key] = std::atof(text.c_str() + k + std::strlen(key) + 3);
+    }
+    size_t rejected = text.find("\"rejected_latency_us\":", json);
+    size_t p99 = rejected == std::string::npos ? rejected : text.find("\"p99\":", rejected);
+    if (p99 != std::string::npos) out["rejected_p99"] = std::atof(text.c_str() + p99 + 6);
+    return rc == 0;
+}
+
+// ---------------------------------------------------------------- baselines
+
+struct Baseline {
+    double value;
+    bool higherIsBetter;
+};
+
+static double tolerance = 0.35;
+static bool perfGate = false; // PROXY_PERF_GATE=1: a regression fails the run instead of being reported
+static std::map<std::string, Baseline> baselines;
+
+static void loadBaselines() {
+    std::ifstream in(opt.baselines);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream is(line);
+        std::string name, dir;
+        double value = 0;
+        if (!(is >> name >> value)) continue;
+        if (name == "tolerance") {
+            tolerance = value;
+            continue;
+        }
+        is >> dir;
+        baselines[name] = { value, dir != "lower" };
+    }
+    if (const char* env = std::getenv("PROXY_PERF_TOLERANCE")) tolerance = std::atof(env);
+    const char* gate = std::getenv("PROXY_PERF_GATE");
+    perfGate = gate && *gate && std::strcmp(gate, "0") != 0;
+}
+
+static void perf(const std::string& name, double measured, bool higherIsBetter) {
+    if (!opt.results.empty()) {
+        std::ofstream res(opt.results, std::ios::app);
+        res << name << " " << measured << " " << (higherIsBetter ? "higher" : "lower") << "\n";
+    }
+    auto it = baselines.find(name);
+    if (it == baselines.end()) {
+        std::printf("[INFO] %s = %.1f (no baseline)\n", name.c_str(), measured);
+        return;
+    }
+    const Baseline& b = it->second;
+    double limit = b.higherIsBetter ? b.value * (1 - tolerance) : b.value * (1 + tolerance);
+    bool ok = b.higherIsBetter ? measured >= limit : measured <= limit;
+    char what[256];
+    std::snprintf(what, sizeof(what), "%s = %.1f (baseline %.1f, %s %.1f)", name.c_str(), measured, b.value,
+                  b.higherIsBetter ? "min" : "max", limit);
+    // Baselines are absolute numbers from one machine, so by default they
+    // are only reported; the functional checks alone decide the result.
+    if (perfGate) check(ok, what);
+    else std::printf("[%s] %s\n", ok ? "PERF" : "PERF REGRESSION", what);
+}
+
+// ---------------------------------------------------------------- scenarios
+
+static void scenarioGet(Stack& st) {
+    std::string fixed = get(st, st.target(), "/fixed/4096");
+    check(statusOf(fixed) == 200 && bodyLength(fixed) == 4096, "GET /fixed/4096 returns 200 with the full body");
+    std::string chunked = get(st, st.target(), "/chunked/100000?chunk=3000");
+    check(statusOf(chunked) == 200 && chunked.find("Transfer-Encoding: chunked") != std::string::npos &&
+              chunked.compare(chunked.size() - 5, 5, "0\r\n\r\n") == 0,
+          "GET /chunked/100000 is relayed with its terminating chunk");
+    std::string missing = get(st, st.target(), "/nope");
+    check(statusOf(missing) == 404, "origin 404 is passed through");
+
+    std::map<std::string, double> r;
+    check(runLoadgen(st, "--path /fixed/1024 --concurrency 8 --duration 3", r), "loadgen GET run has no errors");
+    perf("get_rps", r["throughput_rps"], true);
+    perf("get_p99_us", r["p99"], false);
+}
+
+static void scenarioConnect(Stack& st) {
+    SOCKET s = connectLoopback(st.proxyPort);
+    setTimeout(s, 10);
+    std::string req = "CONNECT 127.0.0.1:" + std::to_string(st.sinkPort) + " HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(st.sinkPort) + "\r\n\r\n";
+    sendAll(s, req.data(), (int)req.size());
+    std::string head;
+    bool established = readHeaders(s, head) && statusOf(head) == 200;
+    check(established, "CONNECT to the sink is established");
+    if (established) {
+        std::string payload(1 << 20, 'y');
+        sendAll(s, payload.data(), (int)payload.size());
+        shutdown(s, SD_SEND);
+        check(readAll(s) == std::to_string(payload.size()), "1 MiB crosses the tunnel intact");
+    }
+    closesocket(s);
+
+    std::map<std::string, double> r;
+    check(runLoadgen(st, "--connect 127.0.0.1:" + std::to_string(st.sinkPort) +
+                             " --tunnel-bytes 16777216 --concurrency 4 --duration 3", r),
+          "loadgen CONNECT run has no errors");
+    perf("connect_mib_s", r["throughput_mib_s"], true);
+}
+
+static void scenarioBlocked(Stack& st) {
+    for (const char* host : { "blocked.test", "www.blocked.test", "BLOCKED.TEST", "ads.example.invalid",
+                              "tracker-9999.example.invalid", "cdn.tracker-42.example.invalid" }) {
+        check(statusOf(get(st, host, "/")) == 403, std::string("GET ") + host + " is blocked with 403");
+    }
+    std::string tunnel = exchange(st.proxyPort, "CONNECT blocked.test:443 HTTP/1.1\r\nHost: blocked.test:443\r\n\r\n");
+    check(statusOf(tunnel) == 403, "CONNECT blocked.test:443 is blocked with 403");
+    check(statusOf(get(st, "notblocked.test.example", "/")) != 403 && statusOf(get(st, st.target(), "/fixed/16")) == 200,
+          "hosts off the list are not blocked");
+
+    // Subdomain misses walk the whole list, so this tracks filter cost per request.
+    const int N = 300;
+    auto t0 = Clock::now();
+    int blocked = 0;
+    for (int i = 0; i < N; i++) blocked += statusOf(get(st, "img" + std::to_string(i) + ".tracker-9999.example.invalid", "/")) == 403;
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    check(blocked == N, "every subdomain of a blocked domain is refused");
+    perf("blocked_rps", N / secs, true);
+}
+
+static void scenarioMalformed(Stack& st) {
+    struct Case {
+        const char* name;
+        std::string bytes;
+        bool halfClose;
+    };
+    std::string binary("\x16\x03\x01\x02\x00\x01\x00\x01\xfc\x03\x03\x00\x00\r\n\r\n", 18);
+    std::vector<Case> cases = {
+        { "non-HTTP line", "NOT_A_VALID_HTTP_REQUEST\r\n\r\n", false },
+        { "TLS ClientHello bytes", binary, false },
+        { "request without a host", "GET / HTTP/1.1\r\n\r\n", false },
+        { "headers past the 8 KB limit", "GET http://a.test/ HTTP/1.1\r\nX-Pad: " + std::string(16384, 'p'), false },
+        { "truncated headers then close", "GET http://a.test/ HTTP/1.1\r\nHost: a.te", true },
+        { "empty connection", "", true },
+    };
+    for (const Case& c : cases) {
+        auto t0 = Clock::now();
+        std::string reply = exchange(st.proxyPort, c.bytes, c.halfClose);
+        double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+        check(statusOf(reply) != 200 && secs < 9, std::string(c.name) + ": connection closed without a 200");
+    }
+
+    // Framing an origin could read differently from the proxy is refused
+    // before anything is sent upstream.
+    struct Smuggle {
+        const char* name;
+        const char* headers;
+    };
+    const Smuggle smuggles[] = {
+        { "Content-Length with chunked", "Content-Length: 5\r\nTransfer-Encoding: chunked\r\n" },
+        { "two Content-Lengths", "Content-Length: 5\r\nContent-Length: 0\r\n" },
+        { "Content-Length with a suffix", "Content-Length: 5abc\r\n" },
+        { "signed Content-Length", "Content-Length: +5\r\n" },
+        { "Content-Length past 2^63", "Content-Length: 99999999999999999999\r\n" },
+        { "coding that does not end in chunked", "Transfer-Encoding: chunked, gzip\r\n" },
+        { "coding that only ends with \"chunked\"", "Transfer-Encoding: xchunked\r\n" },
+    };
+    for (const Smuggle& c : smuggles) {
+        std::string reply = exchange(st.proxyPort, "POST http://" + st.target() + "/fixed/64 HTTP/1.1\r\nHost: " +
+                                                       st.target() + "\r\n" + c.headers + "\r\n0\r\n\r\n");
+        check(statusOf(reply) == 400, std::string(c.name) + ": refused with 400");
+    }
+    std::string listed = exchange(st.proxyPort, "POST http://" + st.target() + "/fixed/64 HTTP/1.1\r\nHost: " +
+                                                    st.target() + "\r\nTransfer-Encoding: gzip , chunked,\r\n\r\n0\r\n\r\n");
+    check(statusOf(listed) != 400, "a coding list ending in chunked is accepted");
+    check(statusOf(get(st, st.target(), "/conflict/64")) == 502, "conflicting response Content-Lengths get a 502");
+    check(alive(st.proxy), "proxy process survived the malformed input");
+    check(statusOf(get(st, st.target(), "/fixed/64")) == 200, "proxy still serves a valid request afterwards");
+}
+
+// Opens every connection before sending any request, so the proxy holds all
+// of them (and one thread each) at once.
+static void scenarioC10k(Stack& st) {
+    const int n = opt.connections;
+    std::vector<SOCKET> socks;
+    socks.reserve(n);
+    auto t0 = Clock::now();
+    for (int i = 0; i < n; i++) {
+        SOCKET s = connectLoopback(st.proxyPort);
+        if (s == INVALID_SOCKET) break;
+        setTimeout(s, 60);
+        socks.push_back(s);
+    }
+    check((int)socks.size() == n, "opened " + std::to_string(socks.size()) + " of " + std::to_string(n) +
+                                      " concurrent connections");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    check(alive(st.proxy), "proxy holds all connections open");
+
+    std::string req = "GET http://" + st.target() + "/fixed/512 HTTP/1.1\r\nHost: " + st.target() + "\r\n\r\n";
+    for (SOCKET s : socks) sendAll(s, req.data(), (int)req.size());
+    int ok = 0;
+    for (SOCKET s : socks) {
+        std::string reply = readAll(s);
+        ok += statusOf(reply) == 200 && bodyLength(reply) == 512;
+        closesocket(s);
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    check(ok == (int)socks.size(), std::to_string(ok) + " of " + std::to_string(socks.size()) +
+                                       " connections got a complete response");
+    perf("c10k_s", secs, false);
+}
+
+static long rssKb(pid_t pid) {
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) return std::atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+// utime + stime in clock ticks, from /proc/<pid>/stat.
+static long long cpuTicks(pid_t pid) {
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string text((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+    size_t end = text.rfind(')');
+    if (end == std::string::npos) return 0;
+    std::istringstream fields(text.substr(end + 2));
+    std::string skip;
+    for (int i = 0; i < 11; i++) fields >> skip; // state .. cmajflt
+    long long utime = 0, stime = 0;
+    fields >> utime >> stime;
+    return utime + stime;
+}
+
+static double scrape(int port, const std::string& metric) {
+    std::string page = exchange(port, "GET /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+    size_t at = page.find("\n" + metric + " ");
+    return at == std::string::npos ? -1 : std::atof(page.c_str() + at + metric.size() + 2);
+}
+
+// Limits for the overload scenario; the flood below is far past all of them.
+static const int OVERLOAD_MAX_CONNECTIONS = 64;
+static int overloadMetricsPort = 0;
+
+static void scenarioOverload(Stack& st) {
+    std::map<std::string, double> base;
+    check(runLoadgen(st, "--path /fixed/1024 --concurrency 4 --duration 2", base), "baseline run has no errors");
+    long baseRss = rssKb(st.proxy);
+
+    // Open loop at 600 req/s against a 500 ms origin needs ~300 connections;
+    // the proxy admits 64 at a time and refuses the rest at the listener. The
+    // rate is kept low enough that the load generator, sharing the CPU, does
+    // not starve everyone on a one-core box. Collapsing is off for this run:
+    // the identical no-store requests would otherwise wait out each other's
+    // leaders and measure that instead of admission.
+    std::map<std::string, double> flood, probe;
+    std::thread floodThread([&] {
+        runLoadgen(st, "--path /slow/500/1024 --mode open --rate 600 --threads 400 --duration 5", flood);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    std::atomic<bool> sampling{true};
+    long peakRss = baseRss;
+    double peakAdmitted = 0;
+    std::thread sampler([&] {
+        while (sampling) {
+            peakRss = std::max(peakRss, rssKb(st.proxy));
+            peakAdmitted = std::max(peakAdmitted, scrape(overloadMetricsPort, "proxy_admission_admitted"));
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    });
+    // A light client alongside the flood; whatever of it is admitted should
+    // be served about as fast as on an idle proxy.
+    runLoadgen(st, "--path /fixed/1024 --mode open --rate 100 --threads 4 --duration 2", probe);
+    sampling = false;
+    sampler.join();
+    floodThread.join();
+
+    double admittedProbes = probe["requests"] - probe["errors_rejected"];
+    std::printf("[INFO] baseline p50 %.0f us; under flood: probe p50 %.0f p99 %.0f us over %.0f admitted, %.0f refused; "
+                "flood %.0f refused (p99 %.0f us) of %.0f, admitted p99 %.0f us; peak %.0f admitted, RSS %ld -> %ld KiB\n",
+                base["p50"], probe["p50"], probe["p99"], admittedProbes, probe["errors_rejected"], flood["errors_rejected"],
+                flood["rejected_p99"], flood["requests"], flood["p99"], peakAdmitted, baseRss, peakRss);
+    check(flood["errors_rejected"] > flood["requests"] / 2, "most of the flood is refused with 503");
+    check(flood["errors"] == flood["errors_rejected"], "nothing in the flood fails except as a clean 503");
+    check(flood["rejected_p99"] < 100000, "refusals are fast (p99 under 100 ms)");
+    check(peakAdmitted >= 0 && peakAdmitted <= OVERLOAD_MAX_CONNECTIONS, "admitted connections never exceed MAX_CONNECTIONS");
+    check(peakRss - baseRss < 64 * 1024, "proxy memory stays bounded under the flood (< 64 MiB growth)");
+    check(flood["p99"] < 500000 + 500000, "admitted flood requests finish within 500 ms of the origin's delay");
+    // A few dozen probes on a shared core: judge the median, and require only
+    // that the tail never queues behind the flood's 500 ms requests.
+    check(admittedProbes > 0 && probe["errors"] == probe["errors_rejected"] &&
+              probe["p50"] < std::max(10 * base["p50"], 50000.0) && probe["p99"] < 500000,
+          "admitted probe requests stay fast (p50 < max(10x baseline, 50 ms), p99 < 500 ms)");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::map<std::string, double> after;
+    check(runLoadgen(st, "--path /fixed/1024 --concurrency 4 --duration 1", after),
+          "after the flood every request is admitted again");
+}
+
+// The pass-through checks again, on the coroutine handler, then idle
+// connections held open to see what each one costs the proxy.
+static int asyncMetricsPort = 0;
+
+static void scenarioAsync(Stack& st) {
+    std::string fixed = get(st, st.target(), "/fixed/4096");
+    check(statusOf(fixed) == 200 && bodyLength(fixed) == 4096, "GET /fixed/4096 returns 200 with the full body");
+    std::string chunked = get(st, st.target(), "/chunked/100000?chunk=3000");
+    check(statusOf(chunked) == 200 && chunked.compare(chunked.size() - 5, 5, "0\r\n\r\n") == 0,
+          "GET /chunked/100000 is relayed with its terminating chunk");
+    check(statusOf(get(st, st.target(), "/nope")) == 404, "origin 404 is passed through");
+    check(statusOf(get(st, st.target(), "/conflict/64")) == 502, "conflicting response Content-Lengths get a 502");
+    check(statusOf(get(st, "blocked.test", "/")) == 403, "blocked host gets 403");
+    check(scrape(asyncMetricsPort, "proxy_async_connections") >= 0, "the coroutine handler is serving");
+
+    std::string body(1 << 20, 'u');
+    std::string upload = exchange(st.proxyPort, "POST http://" + st.target() + "/upload HTTP/1.1\r\nHost: " +
+                                                    st.target() + "\r\nContent-Length: " + std::to_string(body.size()) +
+                                                    "\r\nConnection: close\r\n\r\n" + body);
+    check(statusOf(upload) == 200 && upload.compare(upload.size() - 7, 7, "1048576") == 0,
+          "1 MiB upload reaches the origin in full");
+
+    SOCKET s = connectLoopback(st.proxyPort);
+    setTimeout(s, 10);
+    std::string req = "CONNECT 127.0.0.1:" + std::to_string(st.sinkPort) + " HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(st.sinkPort) + "\r\n\r\n";
+    sendAll(s, req.data(), (int)req.size());
+    std::string head;
+    bool established = readHeaders(s, head) && statusOf(head) == 200;
+    if (established) {
+        sendAll(s, body.data(), (int)body.size());
+        shutdown(s, SD_SEND);
+        established = readAll(s) == std::to_string(body.size());
+    }
+    check(established, "1 MiB crosses a CONNECT tunnel intact");
+    closesocket(s);
+
+    const int n = std::min(opt.connections, 5000);
+    long rss0 = rssKb(st.proxy);
+    std::vector<SOCKET> socks;
+    for (int i = 0; i < n; i++) {
+        SOCKET c = connectLoopback(st.proxyPort);
+        if (c == INVALID_SOCKET) break;
+        setTimeout(c, 60);
+        socks.push_back(c);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    double perConnKb = (double)(rssKb(st.proxy) - rss0) / (double)std::max<size_t>(socks.size(), 1);
+    std::printf("[INFO] %zu idle connections: %.1f KiB of proxy RSS each\n", socks.size(), perConnKb);
+    check((int)socks.size() == n && perConnKb < 8, "idle connections cost under 8 KiB of proxy memory each");
+    std::string getReq = "GET http://" + st.target() + "/fixed/512 HTTP/1.1\r\nHost: " + st.target() + "\r\n\r\n";
+    for (SOCKET c : socks) sendAll(c, getReq.data(), (int)getReq.size());
+    int ok = 0;
+    for (SOCKET c : socks) {
+        std::string reply = readAll(c);
+        ok += statusOf(reply) == 200 && bodyLength(reply) == 512;
+        closesocket(c);
+    }
+    check(ok == (int)socks.size(), std::to_string(ok) + " of " + std::to_string(socks.size()) +
+                                       " held connections got a complete response");
+
+    std::map<std::string, double> r;
+    check(runLoadgen(st, "--path /fixed/1024 --concurrency 8 --duration 3", r), "loadgen GET run has no errors");
+    perf("async_get_rps", r["throughput_rps"], true);
+}
+
+// Two hot restarts under a steady load. Nothing may be refused, and a slow
+// response that started on the old process must finish there in full.
+static const int RESTART_DRAIN_MS = 10000;
+
+static void scenarioRestart(Stack& st) {
+    // Out of descriptors, accept() fails while the listener stays readable.
+    // The loop must wait that out instead of spinning, and serve again after.
+    size_t baseFds = (size_t)std::distance(fs::directory_iterator("/proc/" + std::to_string(st.proxy) + "/fd"),
+                                           fs::directory_iterator());
+    rlimit fdLimit{}, tight{};
+    prlimit(st.proxy, RLIMIT_NOFILE, nullptr, &fdLimit);
+    tight = fdLimit;
+    tight.rlim_cur = baseFds + 8;
+    if (prlimit(st.proxy, RLIMIT_NOFILE, &tight, nullptr) == 0) {
+        std::vector<SOCKET> idle;
+        for (int i = 0; i < 24; i++) {
+            SOCKET s = connectLoopback(st.proxyPort);
+            if (s != INVALID_SOCKET) idle.push_back(s);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        long long ticks0 = cpuTicks(st.proxy);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        double cpu = (double)(cpuTicks(st.proxy) - ticks0) / (double)sysconf(_SC_CLK_TCK);
+        for (SOCKET s : idle) closesocket(s);
+        prlimit(st.proxy, RLIMIT_NOFILE, &fdLimit, nullptr);
+        std::printf("[INFO] %.2f s of CPU in 1 s with the proxy out of descriptors\n", cpu);
+        check(cpu < 0.3, "out of descriptors, the accept loop backs off instead of spinning");
+        check(statusOf(get(st, st.target(), "/fixed/64")) == 200, "the proxy serves again once descriptors are free");
+    }
+
+    std::map<std::string, double> load;
+    std::thread loadThread([&] { runLoadgen(st, "--path /fixed/1024 --concurrency 8 --duration 5", load); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(800));
+    for (int round = 1; round <= 2; round++) {
+        std::string slow;
+        std::thread slowThread([&] { slow = get(st, st.target(), "/slow/1500/65536"); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        pid_t old = st.proxy;
+        st.proxy = spawn({ opt.proxyBin }, st.dir, st.dir / ("proxy-" + std::to_string(round) + ".out"));
+        int status = 0;
+        bool exited = false;
+        auto deadline = Clock::now() + std::chrono::milliseconds(RESTART_DRAIN_MS + 3000);
+        while (!exited && Clock::now() < deadline) {
+            exited = waitpid(old, &status, WNOHANG) == old;
+            if (!exited) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (!exited) {
+            kill(old, SIGKILL);
+            waitpid(old, nullptr, 0);
+        }
+        slowThread.join();
+        std::string n = "restart " + std::to_string(round) + ": ";
+        check(exited && WIFEXITED(status) && WEXITSTATUS(status) == 0, n + "the old proxy drains and exits cleanly");
+        check(statusOf(slow) == 200 && bodyLength(slow) == 65536, n + "a response in flight across the handoff arrives whole");
+        check(alive(st.proxy) && statusOf(get(st, st.target(), "/fixed/64")) == 200, n + "the new proxy serves");
+    }
+    loadThread.join();
+    std::printf("[INFO] %.0f requests across two restarts, %.0f errors\n", load["requests"], load["errors"]);
+    check(load["requests"] > 0 && load["errors"] == 0, "no request was refused or cut short by a restart");
+}
+
+// SIGTERM under load: the proxy refuses new clients, finishes every request
+// and tunnel it admitted, logs them, and exits 0.
+static const int SHUTDOWN_DRAIN_MS = 10000;
+static int shutdownMetricsPort = 0;
+
+static void scenarioShutdown(Stack& st) {
+    std::atomic<bool> signalled{false};
+    std::atomic<int> whole{0}, truncated{0}, unservedEarly{0};
+    auto client = [&](const std::string& path, size_t len) {
+        while (true) {
+            std::string reply = get(st, st.target(), path);
+            if (reply.empty()) {
+                // Refused: the proxy has stopped accepting. The flag goes up
+                // before kill() and is read once the refusal is in, so a
+                // refusal the signal caused is never counted as early.
+                if (signalled) return;
+                unservedEarly++;
+                continue;
+            }
+            if (statusOf(reply) == 200 && bodyLength(reply) == len) whole++;
+            else truncated++;
+        }
+    };
+    std::vector<std::thread> clients;
+    for (int i = 0; i < 6; i++) clients.emplace_back(client, "/fixed/65536", 65536);
+    for (int i = 0; i < 4; i++) clients.emplace_back(client, "/slow/800/262144", 262144);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    SOCKET tunnel = connectLoopback(st.proxyPort);
+    setTimeout(tunnel, 10);
+    std::string req = "CONNECT 127.0.0.1:" + std::to_string(st.sinkPort) + " HTTP/1.1\r\nHost: 127.0.0.1:" +
+                      std::to_string(st.sinkPort) + "\r\n\r\n";
+    sendAll(tunnel, req.data(), (int)req.size());
+    std::string head;
+    bool established = readHeaders(tunnel, head) && statusOf(head) == 200;
+
+    auto t0 = Clock::now();
+    signalled = true;
+    kill(st.proxy, SIGTERM);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    double drainingFlag = scrape(shutdownMetricsPort, "proxy_draining");
+    double open = scrape(shutdownMetricsPort, "proxy_active_connections");
+    std::printf("[INFO] 200 ms into the drain: proxy_draining %.0f, proxy_active_connections %.0f\n", drainingFlag, open);
+    check(drainingFlag == 1 && open >= 1, "the metrics endpoint reports the drain and the connections still open");
+    SOCKET late = connectLoopback(st.proxyPort);
+    check(late == INVALID_SOCKET, "new connections are refused once the drain starts");
+    if (late != INVALID_SOCKET) closesocket(late);
+
+    // The tunnel was open before the signal and still carries traffic.
+    if (established) {
+        std::string payload(1 << 20, 't');
+        sendAll(tunnel, payload.data(), (int)payload.size());
+        shutdown(tunnel, SD_SEND);
+        established = readAll(tunnel) == std::to_string(payload.size());
+    }
+    closesocket(tunnel);
+    check(established, "a tunnel opened before the signal carries 1 MiB during the drain");
+
+    for (auto& t : clients) t.join();
+    int status = 0;
+    bool exited = false;
+    while (!exited && Clock::now() - t0 < std::chrono::milliseconds(SHUTDOWN_DRAIN_MS + 3000)) {
+        exited = waitpid(st.proxy, &status, WNOHANG) == st.proxy;
+        if (!exited) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    if (exited) st.proxy = -1;
+    std::printf("[INFO] %d whole responses, %d truncated, %d unserved before the signal; exit after %.2f s\n",
+                whole.load(), truncated.load(), unservedEarly.load(), secs);
+    check(exited && WIFEXITED(status) && WEXITSTATUS(status) == 0 && secs * 1000 < SHUTDOWN_DRAIN_MS,
+          "the proxy exits 0 once drained, before the deadline");
+    check(whole > 0 && truncated == 0 && unservedEarly == 0, "no response was truncated by the shutdown");
+
+    std::ifstream log(st.dir / "logs" / "proxy.log");
+    std::string line;
+    int lines = 0;
+    while (std::getline(log, line)) lines++;
+    check(lines >= whole + 1, "every response and the tunnel were logged (" + std::to_string(lines) + " lines)");
+    std::ifstream out(st.dir / "proxy.out");
+    std::string console((std::istreambuf_iterator<char>(out)), std::istreambuf_iterator<char>());
+    check(console.find("halted safely") != std::string::npos, "the proxy reports a clean shutdown");
+}
+
+static std::string consoleOf(const Stack& st) {
+    std::ifstream out(st.dir / "proxy.out");
+    return std::string((std::istreambuf_iterator<char>(out)), std::istreambuf_iterator<char>());
+}
+
+static bool waitForConsole(const Stack& st, const std::string& needle, size_t from) {
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (Clock::now() < deadline) {
+        std::string console = consoleOf(st);
+        if (console.size() > from && console.find(needle, from) != std::string::npos) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+
+static size_t lineCount(const fs::path& path) {
+    std::ifstream in(path);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(in, line)) n++;
+    return n;
+}
+
+// SIGHUP under load: a valid file moves the log and picks up a new blocklist
+// entry; an invalid one is rejected and the proxy keeps its settings.
+static void scenarioReload(Stack& st) {
+    auto writeConfig = [&](const std::string& extra) {
+        std::ofstream cfg(st.dir / "config" / "server.cfg");
+        cfg << "PORT=" << st.proxyPort << "\nFILTER_PATH=config/blocked.txt\n" << extra;
+    };
+    const std::string host = "reloaded.example.invalid";
+    check(statusOf(get(st, host, "/")) != 403, host + " is not blocked before the reload");
+
+    std::map<std::string, double> load;
+    std::thread loadThread([&] { runLoadgen(st, "--path /fixed/1024 --concurrency 8 --duration 4", load); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::ofstream(st.dir / "config" / "blocked.txt", std::ios::app) << host << "\n";
+    writeConfig("LOG_PATH=logs/reloaded.log\nIDLE_TIMEOUT_MS=90s\n");
+    size_t seen = consoleOf(st).size();
+    kill(st.proxy, SIGHUP);
+    check(waitForConsole(st, "[CONFIG] Reloaded", seen), "a valid file is reloaded on SIGHUP");
+    check(consoleOf(st).find("IDLE_TIMEOUT_MS changed", seen) != std::string::npos,
+          "a restart-only change is reported, not applied");
+    check(statusOf(get(st, host, "/")) == 403, host + " is blocked after the reload");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    size_t moved = lineCount(st.dir / "logs" / "reloaded.log");
+    check(moved > 0, "requests are logged to the new LOG_PATH (" + std::to_string(moved) + " lines)");
+
+    writeConfig("LOG_PATH=logs/rejected.log\nIDLE_TIMEOUT_MS=banana\nNO_SUCH_KEY=1\n");
+    seen = consoleOf(st).size();
+    kill(st.proxy, SIGHUP);
+    check(waitForConsole(st, "rejected; still running the previous settings", seen), "an invalid file is rejected");
+    std::string console = consoleOf(st);
+    check(console.find("IDLE_TIMEOUT_MS", seen) != std::string::npos && console.find("NO_SUCH_KEY", seen) != std::string::npos,
+          "each bad line is reported");
+    check(statusOf(get(st, host, "/")) == 403 && statusOf(get(st, st.target(), "/fixed/64")) == 200,
+          "the previous settings still serve");
+    check(!fs::exists(st.dir / "logs" / "rejected.log") && lineCount(st.dir / "logs" / "reloaded.log") > moved,
+          "logging stays on the last good LOG_PATH");
+
+    // A blocklist that has gone away must not leave the proxy with an empty one.
+    fs::rename(st.dir / "config" / "blocked.txt", st.dir / "config" / "blocked.txt.moved");
+    writeConfig("LOG_PATH=logs/reloaded.log\n");
+    seen = consoleOf(st).size();
+    kill(st.proxy, SIGHUP);
+    check(waitForConsole(st, "rejected; still running the previous settings", seen) &&
+              statusOf(get(st, host, "/")) == 403 && statusOf(get(st, "blocked.test", "/")) == 403,
+          "a missing blocklist is rejected and the running one kept");
+    fs::rename(st.dir / "config" / "blocked.txt.moved", st.dir / "config" / "blocked.txt");
+
+    loadThread.join();
+    std::printf("[INFO] %.0f requests across three reloads, %.0f errors\n", load["requests"], load["errors"]);
+    check(load["requests"] > 0 && load["errors"] == 0, "no request failed during the reloads");
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) opt.scenario = argv[1];
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string key = argv[i], value = argv[i + 1];
+        if (key == "--proxy") opt.proxyBin = value;
+        else if (key == "--origin") opt.originBin = value;
+        else if (key == "--loadgen") opt.loadgenBin = value;
+        else if (key == "--baselines") opt.baselines = value;
+        else if (key == "--results") opt.results = value;
+        else if (key == "--connections") opt.connections = std::atoi(value.c_str());
+    }
+    if (opt.proxyBin.empty() || opt.originBin.empty() || opt.loadgenBin.empty()) {
+        std::fprintf(stderr, "usage: e2e_suite <get|connect|blocked|malformed|c10k|overload|async|restart|shutdown|reload> --proxy <bin> --origin <bin> "
+                             "--loadgen <bin> [--baselines <file>] [--results <file>] [--connections <n>]\n");
+        return 2;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    loadBaselines();
+
+    // c10k needs ~2 descriptors per connection in the proxy; children inherit this.
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    Stack st;
+    if (opt.scenario == "c10k") {
+        st.extraConfig = "MAX_CONNECTIONS=" + std::to_string(opt.connections + 1000) + "\nMAX_UPSTREAM_CONNECTS=0\n";
+    } else if (opt.scenario == "overload") {
+        overloadMetricsPort = freePort();
+        st.extraConfig = "MAX_CONNECTIONS=" + std::to_string(OVERLOAD_MAX_CONNECTIONS) +
+                         "\nMAX_UPSTREAM_CONNECTS=16\nSHED_TARGET_MS=20\nSHED_INTERVAL_MS=100\nCOLLAPSE_TIMEOUT_MS=0\nMETRICS_PORT=" +
+                         std::to_string(overloadMetricsPort) + "\n";
+    } else if (opt.scenario == "async") {
+        asyncMetricsPort = freePort();
+        st.extraConfig = "ASYNC_LOOPS=1\nCOLLAPSE_TIMEOUT_MS=0\nMAX_UPSTREAM_CONNECTS=0\nMAX_CONNECTIONS=" +
+                         std::to_string(opt.connections + 1000) +
+                         "\nMETRICS_PORT=" + std::to_string(asyncMetricsPort) + "\n";
+    } else if (opt.scenario == "restart") {
+        st.extraConfig = "RESTART_SOCKET=restart.sock\nRESTART_DRAIN_MS=" + std::to_string(RESTART_DRAIN_MS) + "\n";
+    } else if (opt.scenario == "shutdown") {
+        shutdownMetricsPort = freePort();
+        st.extraConfig = "SHUTDOWN_DRAIN_MS=" + std::to_string(SHUTDOWN_DRAIN_MS) + "\nCOLLAPSE_TIMEOUT_MS=0\nMETRICS_PORT=" +
+                         std::to_string(shutdownMetricsPort) + "\n";
+    }
+    if (!st.start()) {
+        check(false, "origin and proxy started");
+        return 1;
+    }
+
+    if (opt.scenario == "get") scenarioGet(st);
+    else if (opt.scenario == "connect") scenarioConnect(st);
+    else if (opt.scenario == "blocked") scenarioBlocked(st);
+    else if (opt.scenario == "malformed") scenarioMalformed(st);
+    else if (opt.scenario == "c10k") scenarioC10k(st);
+    else if (opt.scenario == "overload") scenarioOverload(st);
+    else if (opt.scenario == "async") scenarioAsync(st);
+    else if (opt.scenario == "restart") scenarioRestart(st);
+    else if (opt.scenario == "shutdown") scenarioShutdown(st);
+    else if (opt.scenario == "reload") scenarioReload(st);
+    else check(false, "unknown scenario " + opt.scenario);
+
+    if (opt.scenario != "shutdown") check(alive(st.proxy), "proxy still running at the end of the scenario");
+    std::printf("%s: %d failure(s)\n", opt.scenario.c_str(), failures);
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file